@@ -1,11 +1,23 @@
 #!/bin/sh
 
-for FILE in $@; do
-	./vktor-benchmark "$FILE"
-	RET=$?
-	if test $RET -ne 0; then
-		echo "Error: benchmarking $FILE failed, return code is $RET" &1>2 
-		exit
-	fi
-done
+# Run vktor-benchmark on all given files, saving the results as JSON.
+# 
+# RESULTS  - file to save the results in (default: benchmark-results.json)
+# BASELINE - results file of a previous run to compare against, if set
+# ITERATIONS, WARMUP, THRESHOLD - passed on to vktor-benchmark
 
+RESULTS=${RESULTS-benchmark-results.json}
+
+./vktor-benchmark -j -n ${ITERATIONS-10} -w ${WARMUP-2} "$@" > "$RESULTS"
+RET=$?
+if test $RET -ne 0; then
+	echo "Error: benchmarking failed, return code is $RET" 1>&2
+	exit $RET
+fi
+
+cat "$RESULTS"
+
+if test -n "$BASELINE"; then
+	./vktor-benchmark -c -t ${THRESHOLD-5} "$BASELINE" "$RESULTS"
+	exit $?
+fi
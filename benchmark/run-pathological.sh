@@ -0,0 +1,130 @@
+#!/bin/sh
+
+##
+# vktor JSON pull-parser library
+# 
+# Copyright (c) 2009 Shahar Evron
+#
+# Permission is hereby granted, free of charge, to any person
+# obtaining a copy of this software and associated documentation
+# files (the "Software"), to deal in the Software without
+# restriction, including without limitation the rights to use,
+# copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following
+# conditions:
+# 
+# The above copyright notice and this permission notice shall be
+# included in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+# OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+# NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+# HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+# WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+# OTHER DEALINGS IN THE SOFTWARE.
+##
+
+# vktor pathological input benchmark suite
+#
+# Runs every case listed in the baseline file (default: pathological.baseline
+# next to this script) at its base size and at SCALE times that size, and 
+# fails if:
+#
+#  - the time at the base size is over TOLERANCE times the recorded time
+#  - the peak memory at the base size is over the recorded budget
+#  - the time grows more than SLACK times faster than the input size, or the
+#    memory more than SLACK times faster than SCALE times the budget
+#
+# Run with -r to record a new baseline from the current results instead.
+
+SRCDIR=$(dirname $0)
+BASELINE=${BASELINE-$SRCDIR/pathological.baseline}
+GEN_DIR=${GEN_DIR-corpora}
+SCALE=${SCALE-4}
+SLACK=${SLACK-2}
+TOLERANCE=${TOLERANCE-3}
+RECORD=0
+FAILED=0
+
+if test "$1" = "-r"; then
+	RECORD=1
+	NEW_BASELINE=$(mktemp)
+	grep '^#' "$BASELINE" > "$NEW_BASELINE"
+fi
+
+mkdir -p $GEN_DIR
+
+# run_case <case> <size in bytes> <feed size> <max depth> 
+# prints "<median time in ms> <peak memory in kB>"
+run_case() {
+	FILE=$GEN_DIR/pathological-$1-$4-$2.json
+	if test ! -f $FILE; then
+		./vktor-gen -X $1 -d $4 -s $2 -o $FILE || exit 255
+	fi
+	
+	BUFFSIZE=$3 MAXDEPTH=$(($4 + 2)) ./vktor-benchmark -j -n 3 -w 1 $FILE > $FILE.result || return 1
+	
+	TIME=$(grep -o '"median_ns": [0-9]*' $FILE.result | sed 's/.* //')
+	RSS=$(grep -o '"peak_rss_kb": [0-9]*' $FILE.result | sed 's/.* //')
+	echo $(($TIME / 1000000)) $RSS
+}
+
+printf "%-10s %8s %6s %6s %10s %10s %10s %10s\n" case size feed depth \
+	"time ms" "mem kB" "x$SCALE time" "x$SCALE mem"
+
+grep -v '^#' "$BASELINE" | while read CASE SIZE FEED DEPTH BASE_TIME BASE_RSS; do
+	test -z "$CASE" && continue
+	
+	SIZE_B=$(($SIZE * 1024))
+	RES=$(run_case $CASE $SIZE_B $FEED $DEPTH) || { echo "$CASE FAIL: parsing failed"; exit 1; }
+	set -- $RES
+	TIME=$1; RSS=$2
+	RES=$(run_case $CASE $(($SIZE_B * $SCALE)) $FEED $DEPTH) || { echo "$CASE FAIL: parsing failed"; exit 1; }
+	set -- $RES
+	BIG_TIME=$1; BIG_RSS=$2
+	
+	printf "%-10s %7sK %6s %6s %10s %10s %10s %10s\n" $CASE $SIZE $FEED $DEPTH \
+		$TIME $RSS $BIG_TIME $BIG_RSS
+	
+	if test $RECORD -eq 1; then
+		# Record with some headroom for memory, time is checked with TOLERANCE
+		printf "%-10s %-9s %-6s %-6s %-9s %s\n" $CASE $SIZE $FEED $DEPTH \
+			$(($TIME + 1)) $(($RSS * 5 / 4)) >> "$NEW_BASELINE"
+		continue
+	fi
+	
+	if test $TIME -gt $(($BASE_TIME * $TOLERANCE)); then
+		echo "$CASE FAIL: took $TIME ms, baseline is $BASE_TIME ms"
+		FAILED=1
+	fi
+	if test $RSS -gt $BASE_RSS; then
+		echo "$CASE FAIL: used $RSS kB, budget is $BASE_RSS kB"
+		FAILED=1
+	fi
+	if test $BIG_TIME -gt $(($TIME * $SCALE * $SLACK + 1)); then
+		echo "$CASE FAIL: time is superlinear, ${SCALE}x input took $BIG_TIME ms vs. $TIME ms"
+		FAILED=1
+	fi
+	if test $BIG_RSS -gt $(($BASE_RSS * $SCALE * $SLACK)); then
+		echo "$CASE FAIL: memory is superlinear, ${SCALE}x input used $BIG_RSS kB vs. $RSS kB"
+		FAILED=1
+	fi
+	
+	test $FAILED -eq 0 || exit 1
+done
+RET=$?
+
+if test $RECORD -eq 1; then
+	if test $RET -eq 0; then
+		mv "$NEW_BASELINE" "$BASELINE"
+		echo "New baseline recorded in $BASELINE"
+	else
+		rm -f "$NEW_BASELINE"
+		echo "Some cases failed, baseline in $BASELINE was not changed"
+	fi
+fi
+
+exit $RET
@@ -26,39 +26,100 @@
  */
 
 /**
- * @file vktortest-benchmark.c 
- * 
+ * @file vktortest-benchmark.c
+ *
  * A simple program used to benchmark vktor.
  *
- * Takes a JSON file name as a parameter. Will parse this file and keep
- * a counter of the different JSON tokens in this file. 
+ * Takes one or more JSON file names as parameters. Each file is loaded into
+ * memory, parsed a few times to warm up and then parsed a number of timed
+ * iterations, keeping a counter of the different JSON tokens in the file.
+ * Reading the file is not included in the timing.
+ *
+ * For each file, the throughput (MB/s, tokens/s and ns/token) of the median
+ * iteration is printed along with the minimal, median and 99th percentile
+ * iteration times. With -j results are printed as JSON, which can be saved and
+ * later compared to another run using -c:
+ *
+ *   vktor-benchmark [-n iterations] [-w warmup] [-j] [-C] [-I|-A|-R] [-N|-L] file [file ...]
+ *   vktor-benchmark -c baseline.json current.json [-t threshold]
+ *
+ * With -N, files are read as NDJSON: each line is parsed as a separate JSON 
+ * document using a new parser.
+ *
+ * With -C, each document is fed to the parser at once using 
+ * vktor_feed_complete() instead of in BUFFSIZE chunks. With -I, parsers are 
+ * initialized in a preallocated memory block using vktor_parser_init_inplace().
+ * With -A, parsers allocate from a per-document bump allocator which is 
+ * released at once after each document, instead of using malloc(). With -R, 
+ * parsers are acquired from and released into a vktor_parser_pool instead of
+ * being initialized and freed for each document.
+ *
+ * With -L, files are read as NDJSON too but each line is treated as a small 
+ * message and timed on its own, from vktor_parser_init() to 
+ * vktor_parser_free(), which is what matters when parsing many small messages
+ * rather than a few large files. The p50, p99 and p99.9 latency per message 
+ * are reported, along with the time to the first token and the number of 
+ * memory allocations per message. Note that reading the clock adds a few tens
+ * of nanoseconds to each measurement.
  *
- * Additionally, will print the time it took to parse the entire file.
+ * Files compressed with gzip (named *.gz or starting with the gzip magic 
+ * bytes) are fed to the parser compressed, in BUFFSIZE chunks, and inflated
+ * by the parser itself into buffers of BUFFSIZE bytes (see 
+ * vktor_enable_inflate()). Inflating is included in the timing, and the 
+ * throughput is reported both in inflated and in compressed bytes per 
+ * second. Compressed files can't be used with -C, -N or -L.
+ *
+ * In compare mode, any file whose median time grew by more than threshold
+ * percent (default 5) is flagged as a regression and the program exits with 1.
+ *
+ * On Linux, -p will also read hardware performance counters (cycles,
+ * instructions, branch misses, L1 data cache and last level cache misses)
+ * around the timed iterations using perf_event_open(), and report them per
+ * input byte and per token. Counters which can't be opened (e.g. due to 
+ * perf_event_paranoid or running in a VM) are reported as unavailable.
  *
  * The return code of the program should be 0 if all is ok and the JSON file
- * was successfully parsed. Otherwise, one of the VKTOR_ERR codes as returned 
- * from the parser is returned in case of a parser error. 255 is retuned in 
+ * was successfully parsed. Otherwise, one of the VKTOR_ERR codes as returned
+ * from the parser is returned in case of a parser error. 255 is retuned in
  * case of an error unrelated to the parser.
- * 
+ *
  * You can use the code here as an example of how to write a simple JSON parser
  * using libvktor.
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <time.h>
-#include <sys/errno.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/resource.h>
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#endif
 
 #include <vktor.h>
 
-#define DEFAULT_BUFFSIZE 4096
-#define DEFAULT_MAXDEPTH 32
+#define DEFAULT_BUFFSIZE   4096
+#define DEFAULT_MAXDEPTH   32
+#define DEFAULT_ITERATIONS 10
+#define DEFAULT_WARMUP     2
+#define DEFAULT_THRESHOLD  5.0
+#define ARENA_TOKEN_SIZE   4096
+#define BUMP_ARENA_SIZE    (1024 * 1024)
 
-static unsigned int mallocs  = 0;
-static unsigned int reallocs = 0;
-static unsigned int frees    = 0;
+static unsigned long mallocs  = 0;
+static unsigned long reallocs = 0;
+static unsigned long frees    = 0;
+static long long     inflated = 0;
 
 void *my_malloc(size_t size);
 
@@ -66,115 +127,467 @@ void *my_realloc(void *pointer, size_t size);
 
 void  my_free(void *pointer);
 
-int 
-main(int argc, char *argv[], char *envp[]) 
+/* Token counters */
+typedef struct {
+	long nulls, falses, trues, ints, floats, strings, arrays, objects, obj_keys;
+	long total;
+} token_counters;
+
+/* Benchmark options */
+typedef struct {
+	int     buffsize;
+	int     maxdepth;
+	int     iterations;
+	int     warmup;
+	char    json;
+	char    memtest;
+	char    perf;
+	char    ndjson;
+	char    latency;
+	char    complete;
+	char    inflate;
+	char   *arena;
+	size_t  arena_size;
+	vktor_allocator *allocator;
+	vktor_parser_pool *pool;
+} bench_options;
+
+/* 
+ * Per-document bump allocator used with -A. Every block has a size header so 
+ * it can be reallocated; the whole arena is released at once after each 
+ * document. Requests which do not fit fall back to malloc(). 
+ */
+typedef struct {
+	char   *mem;
+	size_t  size;
+	size_t  used;
+	size_t *last;
+} bump_arena;
+
+#define BUMP_HEADER     (sizeof(size_t) * 2)
+#define BUMP_ALIGN(s)   (((s) + BUMP_HEADER - 1) & ~(BUMP_HEADER - 1))
+#define BUMP_OWNS(a, p) ((char *) (p) >= (a)->mem && \
+                         (char *) (p) < (a)->mem + (a)->size)
+
+/* Hardware performance counters read with -p */
+typedef enum {
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_BRANCH_MISSES,
+	PERF_L1D_MISSES,
+	PERF_LLC_MISSES,
+	PERF_NUM_COUNTERS
+} perf_counter;
+
+static const char *perf_counter_names[PERF_NUM_COUNTERS] = {
+	"cycles",
+	"instructions",
+	"branch_misses",
+	"l1d_misses",
+	"llc_misses"
+};
+
+/* Open counter file descriptors, -1 if a counter is not available */
+static int perf_fds[PERF_NUM_COUNTERS];
+
+/* Results of benchmarking a single file */
+typedef struct {
+	char           *file;
+	long            bytes;
+	token_counters  tokens;
+	int             iterations;
+	double          min_ns;
+	double          median_ns;
+	double          p99_ns;
+	double          mb_per_s;
+	double          tokens_per_s;
+	double          ns_per_token;
+	long long       counters[PERF_NUM_COUNTERS];
+	long            peak_rss_kb;
+	long            messages;
+	double          p999_ns;
+	double          ttft_p50_ns;
+	double          ttft_p99_ns;
+	double          ttft_p999_ns;
+	double          allocs_per_msg;
+	long            compressed_bytes;
+	double          compressed_mb_per_s;
+} bench_result;
+
+/* Get the current monotonic time in nanoseconds */
+static double
+now_ns(void)
 {
-	vktor_parser   *parser;
-	vktor_status    status;
-	vktor_error    *error = NULL;
-	char           *buffer;
-	size_t          read_bytes;
-	int             done = 0, ret = 0;
-	char           *envvar;
-	int             buffsize = DEFAULT_BUFFSIZE;
-	int             maxdepth = DEFAULT_MAXDEPTH;
-	FILE           *infile;
-	clock_t         runtime; 
-	char            memtest = 0;
+	struct timespec ts;
 
-	/* Counters */
-	int c_nulls = 0, c_falses = 0, c_trues = 0, 
-	    c_ints = 0, c_floats = 0, c_strings = 0,
-	    c_arrays = 0, c_objects = 0, c_obj_keys = 0;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
 
-	/* Set buffer size from environment, if set */
-	if ((envvar = getenv("BUFFSIZE")) != NULL) {
-		buffsize = atoi(envvar);
+/* Compare two doubles, used for sorting iteration times */
+static int
+cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+/* Get the p-th percentile of a sorted array using the nearest rank method */
+static double
+percentile(const double *sorted, int n, double p)
+{
+	int rank;
+
+	assert(n > 0);
+
+	rank = (int) (p / 100.0 * n + 0.999999);
+	if (rank < 1) rank = 1;
+	if (rank > n) rank = n;
+
+	return sorted[rank - 1];
+}
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+
+/* Open a single counter for the current thread, returns fd or -1 */
+static int
+perf_open(unsigned int type, unsigned long long config)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size           = sizeof(attr);
+	attr.type           = type;
+	attr.config         = config;
+	attr.disabled       = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv     = 1;
+
+	return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* Open all counters, returns the number of counters available */
+static int
+perf_init(void)
+{
+	int i, n = 0;
+
+	perf_fds[PERF_CYCLES]        = perf_open(PERF_TYPE_HARDWARE,
+		PERF_COUNT_HW_CPU_CYCLES);
+	perf_fds[PERF_INSTRUCTIONS]  = perf_open(PERF_TYPE_HARDWARE,
+		PERF_COUNT_HW_INSTRUCTIONS);
+	perf_fds[PERF_BRANCH_MISSES] = perf_open(PERF_TYPE_HARDWARE,
+		PERF_COUNT_HW_BRANCH_MISSES);
+	perf_fds[PERF_L1D_MISSES]    = perf_open(PERF_TYPE_HW_CACHE,
+		PERF_COUNT_HW_CACHE_L1D |
+		(PERF_COUNT_HW_CACHE_OP_READ << 8) |
+		(PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+	perf_fds[PERF_LLC_MISSES]    = perf_open(PERF_TYPE_HARDWARE,
+		PERF_COUNT_HW_CACHE_MISSES);
+
+	for (i = 0; i < PERF_NUM_COUNTERS; i++) {
+		if (perf_fds[i] >= 0) n++;
 	}
-	
-	/* Set max depth from environment, if set */
-	if ((envvar = getenv("MAXDEPTH")) != NULL) {
-		maxdepth = atoi(envvar);
+
+	return n;
+}
+
+/* Enable, disable or reset all open counters */
+static void
+perf_ioctl(unsigned long request)
+{
+	int i;
+
+	for (i = 0; i < PERF_NUM_COUNTERS; i++) {
+		if (perf_fds[i] >= 0) {
+			ioctl(perf_fds[i], request, 0);
+		}
 	}
+}
 
-	/* Open input file */
-	if (argc > 1) {
-		infile = fopen(argv[1], "r");
-	} else {
-		infile = stdin;
+#define perf_reset()   perf_ioctl(PERF_EVENT_IOC_RESET)
+#define perf_enable()  perf_ioctl(PERF_EVENT_IOC_ENABLE)
+#define perf_disable() perf_ioctl(PERF_EVENT_IOC_DISABLE)
+
+/* Read all counters into values, unavailable counters are set to -1 */
+static void
+perf_read(long long *values)
+{
+	int i;
+
+	for (i = 0; i < PERF_NUM_COUNTERS; i++) {
+		values[i] = -1;
+		if (perf_fds[i] >= 0 &&
+		    read(perf_fds[i], &values[i], sizeof(long long)) != sizeof(long long)) {
+			values[i] = -1;
+		}
 	}
+}
 
-	if (infile == NULL) {
-		perror("Error opening input file");
-		exit(255);
+#else /* HAVE_LINUX_PERF_EVENT_H */
+
+static int
+perf_init(void)
+{
+	int i;
+
+	for (i = 0; i < PERF_NUM_COUNTERS; i++) {
+		perf_fds[i] = -1;
 	}
 
-	/* Set memory handlers */
-	if (getenv("MEMTEST") != NULL) {
-		vktor_set_memory_handlers(my_malloc, my_realloc, my_free);
-		memtest = 1;
+	return 0;
+}
+
+static void
+perf_read(long long *values)
+{
+	int i;
+
+	for (i = 0; i < PERF_NUM_COUNTERS; i++) {
+		values[i] = -1;
 	}
+}
 
-	runtime = clock();
+#define perf_reset()
+#define perf_enable()
+#define perf_disable()
+
+#endif /* HAVE_LINUX_PERF_EVENT_H */
+
+/* Read an entire file into a newly allocated buffer */
+static char *
+load_file(const char *name, long *size)
+{
+	FILE   *fp;
+	char   *data = NULL;
+	size_t  len = 0, alloc = 0, n;
+
+	if ((fp = fopen(name, "r")) == NULL) {
+		return NULL;
+	}
 
-	parser = vktor_parser_init(maxdepth);
-	
 	do {
-		status = vktor_parse(parser, &error);
-		
-		switch (status) {
-			
-			case VKTOR_OK:
-				switch(vktor_get_token_type(parser)) {
-					case VKTOR_T_NULL: 
-						c_nulls++;
-						break;
+		if (len == alloc) {
+			alloc = (alloc == 0 ? 65536 : alloc * 2);
+			if ((data = realloc(data, alloc)) == NULL) {
+				fclose(fp);
+				return NULL;
+			}
+		}
+		n = fread(data + len, sizeof(char), alloc - len, fp);
+		len += n;
+	} while (n > 0);
 
-					case VKTOR_T_FALSE:
-						c_falses++;
-						break;
+	fclose(fp);
+	*size = (long) len;
+	return data;
+}
 
-					case VKTOR_T_TRUE:
-						c_trues++;
-						break;
+/* Check if a file is gzip compressed, by its name or magic bytes */
+static int
+is_compressed(const char *name, const char *data, long size)
+{
+	size_t len = strlen(name);
 
-					case VKTOR_T_INT:
-						c_ints++;
-						break;
+	return ((len > 3 && strcmp(name + len - 3, ".gz") == 0) ||
+	        (size >= 2 && (unsigned char) data[0] == 0x1f && 
+	                      (unsigned char) data[1] == 0x8b));
+}
 
-					case VKTOR_T_FLOAT:
-						c_floats++;
-						break;
+/* Count a token of the given type */
+static void
+count_token(token_counters *c, vktor_token type)
+{
+	switch(type) {
+		case VKTOR_T_NULL:
+			c->nulls++;
+			break;
 
-					case VKTOR_T_STRING:
-						c_strings++;
-						break;
+		case VKTOR_T_FALSE:
+			c->falses++;
+			break;
 
-					case VKTOR_T_ARRAY_START: 
-						c_arrays++;
-						break;
+		case VKTOR_T_TRUE:
+			c->trues++;
+			break;
 
-					case VKTOR_T_OBJECT_START:
-						c_objects++;
-						break;
+		case VKTOR_T_INT:
+			c->ints++;
+			break;
 
-					case VKTOR_T_OBJECT_KEY:
-						c_obj_keys++;
-						break;
+		case VKTOR_T_FLOAT:
+			c->floats++;
+			break;
 
-					default:
-						/* do nothing */
-						break;
+		case VKTOR_T_STRING:
+			c->strings++;
+			break;
+
+		case VKTOR_T_ARRAY_START:
+			c->arrays++;
+			break;
+
+		case VKTOR_T_OBJECT_START:
+			c->objects++;
+			break;
+
+		case VKTOR_T_OBJECT_KEY:
+			c->obj_keys++;
+			break;
+
+		default:
+			/* do nothing */
+			break;
+	}
+
+	c->total++;
+}
+
+/* Allocate a block from the bump arena, falling back to malloc() */
+static void *
+bump_malloc(void *ctx, size_t size)
+{
+	bump_arena *arena = ctx;
+	size_t     *block;
+	size_t      need = BUMP_HEADER + BUMP_ALIGN(size);
+
+	if (arena->size - arena->used < need) {
+		mallocs++;
+		if ((block = malloc(BUMP_HEADER + size)) == NULL) {
+			return NULL;
+		}
+	} else {
+		block = (size_t *) (arena->mem + arena->used);
+		arena->used += need;
+		arena->last = block;
+	}
+
+	block[0] = size;
+	return block + 2;
+}
+
+/* Free a block - only blocks which came from malloc() are actually freed */
+static void
+bump_free(void *ctx, void *ptr)
+{
+	bump_arena *arena = ctx;
+
+	if (ptr != NULL && ! BUMP_OWNS(arena, ptr)) {
+		frees++;
+		free((size_t *) ptr - 2);
+	}
+}
+
+/* Resize a block, growing the last block in the arena in place if possible */
+static void *
+bump_realloc(void *ctx, void *ptr, size_t size)
+{
+	bump_arena *arena = ctx;
+	size_t     *block;
+	void       *new;
+
+	if (ptr == NULL) {
+		return bump_malloc(ctx, size);
+	}
+
+	block = (size_t *) ptr - 2;
+	if (block[0] >= size) {
+		return ptr;
+	}
+
+	if (block == arena->last && 
+	    (char *) block + BUMP_HEADER + BUMP_ALIGN(size) <= 
+	    arena->mem + arena->size) {
+		arena->used = (char *) block - arena->mem + BUMP_HEADER + 
+			BUMP_ALIGN(size);
+		block[0] = size;
+		return ptr;
+	}
+
+	if ((new = bump_malloc(ctx, size)) == NULL) {
+		return NULL;
+	}
+
+	memcpy(new, ptr, block[0]);
+	bump_free(ctx, ptr);
+
+	return new;
+}
+
+/* Release everything allocated from the arena */
+static void
+bump_reset(bump_arena *arena)
+{
+	arena->used = 0;
+	arena->last = NULL;
+}
+
+/*
+ * Parse a single in-memory JSON document, feeding it to the parser in chunks
+ * of buffsize bytes. If first_token is not NULL and set to 0, the time at which
+ * the first token was read is stored in it. Returns 0 on success or an error 
+ * code.
+ */
+static int
+parse_document(const bench_options *opts, char *data, long size,
+               token_counters *counters, double *first_token)
+{
+	vktor_parser   *parser;
+	vktor_status    status;
+	vktor_error    *error = NULL;
+	long            offset = 0, chunk;
+	int             done = 0, ret = 0;
+
+	if (opts->pool != NULL) {
+		parser = vktor_parser_pool_acquire(opts->pool);
+	} else if (opts->arena != NULL) {
+		parser = vktor_parser_init_inplace(opts->arena, opts->arena_size, 
+			opts->maxdepth, opts->allocator);
+	} else {
+		parser = vktor_parser_init_allocator(opts->maxdepth, opts->allocator);
+	}
+
+	if (parser == NULL) {
+		fprintf(stderr, "Error: unable to initialize parser\n");
+		return 255;
+	}
+
+	if (opts->complete) {
+		vktor_feed_complete(parser, data, size, 0, &error);
+		offset = size;
+	}
+
+	// Compressed input is inflated in chunks of the same size it is fed in
+	if (opts->inflate && 
+	    vktor_enable_inflate(parser, opts->buffsize, &error) != VKTOR_OK) {
+		fprintf(stderr, "Paser error [%d]: %s\n", error->code, error->message);
+		ret = error->code;
+		done = 1;
+	}
+
+	while (! done) {
+		status = vktor_parse(parser, &error);
+
+		switch (status) {
+
+			case VKTOR_OK:
+				if (first_token != NULL && *first_token == 0) {
+					*first_token = now_ns();
 				}
+				count_token(counters, vktor_get_token_type(parser));
 				break;
-				
+
 			case VKTOR_MORE_DATA:
 				// We need to read more data
-				buffer = my_malloc(sizeof(char) * buffsize);
-				read_bytes = fread(buffer, sizeof(char), buffsize, infile);
-				if (read_bytes) {
-					vktor_feed(parser, buffer, read_bytes, 1, &error);
-					
+				chunk = size - offset;
+				if (chunk > opts->buffsize) {
+					chunk = opts->buffsize;
+				}
+
+				if (chunk > 0) {
+					vktor_feed(parser, data + offset, chunk, 0, &error);
+					offset += chunk;
+
 				} else {
 					// Nothing left to read
 					done = 1;
@@ -182,57 +595,781 @@ main(int argc, char *argv[], char *envp[])
 					fprintf(stderr, "Error: premature end of stream\n");
 				}
 				break;
-				
-			case VKTOR_COMPLETE: 
+
+			case VKTOR_COMPLETE:
 				// Parser says we are done
 				done = 1;
 				break;
-				
+
 			case VKTOR_ERROR:
 				// We have a parse error
-				fprintf(stderr, "Paser error [%d]: %s\n", error->code, 
+				fprintf(stderr, "Paser error [%d]: %s\n", error->code,
 					error->message);
 				ret = error->code;
 				done = 1;
 				break;
 		}
-		
-	} while (! done);
 
-	/* Calculate parsing time */
-	runtime = clock() - runtime;
+	}
 
 	if (error != NULL) {
 		vktor_error_free(error);
 	}
-	
-	vktor_parser_free(parser);
-	
+
+	if (opts->inflate) {
+		long long in, out;
+
+		vktor_get_inflate_stats(parser, &in, &out);
+		inflated += out;
+	}
+
+	if (opts->pool != NULL) {
+		vktor_parser_pool_release(opts->pool, parser);
+	} else {
+		vktor_parser_free(parser);
+	}
+
+	if (opts->allocator != NULL) {
+		bump_reset(opts->allocator->ctx);
+	}
+
+	return ret;
+}
+
+/*
+ * Parse an in-memory file once, either as a single document or as NDJSON.
+ * Returns 0 on success or an error code.
+ */
+static int
+parse_once(const bench_options *opts, char *data, long size,
+           token_counters *counters)
+{
+	char *line, *end;
+	int   ret = 0;
+
+	memset(counters, 0, sizeof(token_counters));
+
+	if (! opts->ndjson) {
+		return parse_document(opts, data, size, counters, NULL);
+	}
+
+	for (line = data; line < data + size && ret == 0; line = end + 1) {
+		if ((end = memchr(line, '\n', data + size - line)) == NULL) {
+			end = data + size;
+		}
+
+		if (end > line) {
+			ret = parse_document(opts, line, end - line, counters, NULL);
+		}
+	}
+
+	return ret;
+}
+
+/* Benchmark a single file, populating result */
+static int
+bench_file(const bench_options *file_opts, char *file, bench_result *result)
+{
+	bench_options  inflate_opts, *opts = &inflate_opts;
+	char          *data;
+	long           size;
+	double        *times, start;
+	int            i, ret = 0;
+	struct rusage  usage;
+
+	memset(result, 0, sizeof(bench_result));
+	result->file = file;
+
+	if ((data = load_file(file, &size)) == NULL) {
+		fprintf(stderr, "Error opening input file %s: %s\n", file,
+			strerror(errno));
+		return 255;
+	}
+
+	inflate_opts = *file_opts;
+	if (is_compressed(file, data, size)) {
+		if (opts->complete || opts->ndjson) {
+			fprintf(stderr, "Error: compressed file %s can't be read with "
+				"-C or -N\n", file);
+			free(data);
+			return 255;
+		}
+		inflate_opts.inflate = 1;
+	}
+
+	if ((times = malloc(sizeof(double) * opts->iterations)) == NULL) {
+		free(data);
+		return 255;
+	}
+
+	for (i = 0; i < opts->warmup && ret == 0; i++) {
+		ret = parse_once(opts, data, size, &result->tokens);
+	}
+
+	mallocs = reallocs = frees = 0;
+	inflated = 0;
+	if (opts->perf) {
+		perf_reset();
+	}
+
+	for (i = 0; i < opts->iterations && ret == 0; i++) {
+		if (opts->perf) {
+			perf_enable();
+		}
+		start = now_ns();
+		ret = parse_once(opts, data, size, &result->tokens);
+		times[i] = now_ns() - start;
+		if (opts->perf) {
+			perf_disable();
+		}
+	}
+
+	if (opts->perf) {
+		perf_read(result->counters);
+	}
+
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		result->peak_rss_kb = usage.ru_maxrss;
+	}
+
+	if (ret == 0) {
+		qsort(times, opts->iterations, sizeof(double), cmp_double);
+
+		result->bytes        = size;
+		result->iterations   = opts->iterations;
+		result->min_ns       = times[0];
+		result->median_ns    = percentile(times, opts->iterations, 50);
+		result->p99_ns       = percentile(times, opts->iterations, 99);
+		result->mb_per_s     = size / (result->median_ns / 1e9) / 1e6;
+		result->tokens_per_s = result->tokens.total / (result->median_ns / 1e9);
+		result->ns_per_token = (result->tokens.total > 0 ?
+			result->median_ns / result->tokens.total : 0);
+
+		// Throughput is in parsed bytes, compressed throughput is reported too
+		if (opts->inflate) {
+			result->bytes               = inflated / opts->iterations;
+			result->mb_per_s            = result->bytes / 
+				(result->median_ns / 1e9) / 1e6;
+			result->compressed_bytes    = size;
+			result->compressed_mb_per_s = size / 
+				(result->median_ns / 1e9) / 1e6;
+		}
+	}
+
+	free(times);
+	free(data);
+
+	return ret;
+}
+
+/*
+ * Benchmark the latency of parsing each line of an NDJSON file as a separate
+ * message, populating result
+ */
+static int
+latency_file(const bench_options *opts, char *file, bench_result *result)
+{
+	char    *data, *line, *end;
+	char   **msgs = NULL;
+	long    *lens = NULL;
+	long     size, count = 0, alloc = 0, n, m, samples;
+	double  *times, *ttfts, start, first;
+	int      i, ret = 0;
+	struct rusage usage;
+
+	memset(result, 0, sizeof(bench_result));
+	result->file = file;
+
+	if ((data = load_file(file, &size)) == NULL) {
+		fprintf(stderr, "Error opening input file %s: %s\n", file,
+			strerror(errno));
+		return 255;
+	}
+
+	if (is_compressed(file, data, size)) {
+		fprintf(stderr, "Error: compressed file %s can't be read with -L\n",
+			file);
+		free(data);
+		return 255;
+	}
+
+	// Index the messages first so that finding them is not timed
+	for (line = data; line < data + size; line = end + 1) {
+		if ((end = memchr(line, '\n', data + size - line)) == NULL) {
+			end = data + size;
+		}
+		if (end == line) {
+			continue;
+		}
+
+		if (count == alloc) {
+			alloc = (alloc == 0 ? 1024 : alloc * 2);
+			msgs = realloc(msgs, sizeof(char *) * alloc);
+			lens = realloc(lens, sizeof(long) * alloc);
+			if (msgs == NULL || lens == NULL) {
+				free(data);
+				return 255;
+			}
+		}
+		msgs[count]   = line;
+		lens[count++] = end - line;
+	}
+
+	if (count == 0) {
+		fprintf(stderr, "Error: no messages found in %s\n", file);
+		free(data);
+		return 255;
+	}
+
+	samples = count * opts->iterations;
+	times = malloc(sizeof(double) * samples);
+	ttfts = malloc(sizeof(double) * samples);
+	if (times == NULL || ttfts == NULL) {
+		free(msgs); free(lens); free(data);
+		return 255;
+	}
+
+	for (i = 0; i < opts->warmup && ret == 0; i++) {
+		for (m = 0; m < count && ret == 0; m++) {
+			ret = parse_document(opts, msgs[m], lens[m], &result->tokens, NULL);
+		}
+	}
+
+	mallocs = reallocs = 0;
+	memset(&result->tokens, 0, sizeof(token_counters));
+	for (n = 0, i = 0; i < opts->iterations && ret == 0; i++) {
+		for (m = 0; m < count && ret == 0; m++, n++) {
+			first = 0;
+			start = now_ns();
+			ret = parse_document(opts, msgs[m], lens[m], &result->tokens, &first);
+			times[n] = now_ns() - start;
+			ttfts[n] = (first > 0 ? first - start : times[n]);
+		}
+	}
+
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		result->peak_rss_kb = usage.ru_maxrss;
+	}
+
+	if (ret == 0) {
+		qsort(times, samples, sizeof(double), cmp_double);
+		qsort(ttfts, samples, sizeof(double), cmp_double);
+
+		result->bytes          = size;
+		result->messages       = count;
+		result->iterations     = opts->iterations;
+		result->min_ns         = times[0];
+		result->median_ns      = percentile(times, samples, 50);
+		result->p99_ns         = percentile(times, samples, 99);
+		result->p999_ns        = percentile(times, samples, 99.9);
+		result->ttft_p50_ns    = percentile(ttfts, samples, 50);
+		result->ttft_p99_ns    = percentile(ttfts, samples, 99);
+		result->ttft_p999_ns   = percentile(ttfts, samples, 99.9);
+		result->allocs_per_msg = (double) (mallocs + reallocs) / samples;
+
+		// Token counts and throughput are per iteration, like in bench_file()
+		result->tokens.total  /= opts->iterations;
+		result->mb_per_s       = size / (result->median_ns * count / 1e9) / 1e6;
+		result->tokens_per_s   = result->tokens.total /
+			(result->median_ns * count / 1e9);
+		result->ns_per_token   = (result->tokens.total > 0 ?
+			result->median_ns * count / result->tokens.total : 0);
+	}
+
+	free(ttfts);
+	free(times);
+	free(msgs);
+	free(lens);
+	free(data);
+
+	return ret;
+}
+
+/* Print the results of a latency benchmark in human readable format */
+static void
+print_latency_text(const bench_options *opts, const bench_result *r)
+{
 	printf("------------------------------------------------------------------------\n"
 	       "Finished parsing %s\n\n"
-	       
+	       "Messages:       %ld, %.0f bytes and %ld tokens on average\n"
+	       "Iterations:     %d (+%d warmup)\n"
+	       "Latency:        min %.0f ns, p50 %.0f ns, p99 %.0f ns, p99.9 %.0f ns\n"
+	       "First token:    p50 %.0f ns, p99 %.0f ns, p99.9 %.0f ns\n"
+	       "Allocations:    %.2f per message\n"
+	       "Throughput:     %.2f MB/s, %.0f messages/s at p50\n"
+	       "Peak memory:    %ld kB (including the input)\n"
+	       "------------------------------------------------------------------------\n",
+	       r->file, r->messages, (double) r->bytes / r->messages,
+	       r->tokens.total / r->messages, r->iterations, opts->warmup,
+	       r->min_ns, r->median_ns, r->p99_ns, r->p999_ns,
+	       r->ttft_p50_ns, r->ttft_p99_ns, r->ttft_p999_ns,
+	       r->allocs_per_msg, r->mb_per_s, 1e9 / r->median_ns, r->peak_rss_kb);
+}
+
+/* Print hardware counters per byte and per token */
+static void
+print_counters_text(const bench_result *r)
+{
+	double runs_bytes  = (double) r->bytes * r->iterations;
+	double runs_tokens = (double) r->tokens.total * r->iterations;
+	int    i;
+
+	printf("Hardware counters:          per byte     per token\n");
+	for (i = 0; i < PERF_NUM_COUNTERS; i++) {
+		if (r->counters[i] < 0) {
+			printf("  %-20s %12s\n", perf_counter_names[i], "unavailable");
+		} else {
+			printf("  %-20s %12.4f  %12.4f\n", perf_counter_names[i],
+				r->counters[i] / runs_bytes, r->counters[i] / runs_tokens);
+		}
+	}
+
+	if (r->counters[PERF_CYCLES] > 0 && r->counters[PERF_INSTRUCTIONS] >= 0) {
+		printf("  %-20s %12.2f\n", "instructions/cycle",
+			(double) r->counters[PERF_INSTRUCTIONS] / r->counters[PERF_CYCLES]);
+	}
+	printf("\n");
+}
+
+/* Print the results of a single file in human readable format */
+static void
+print_result_text(const bench_options *opts, const bench_result *r)
+{
+	printf("------------------------------------------------------------------------\n"
+	       "Finished parsing %s\n\n"
+
 	       "Sum of JSON tokens encountered:\n"
-	       "  null:       %d\n"
-	       "  false:      %d\n"
-	       "  true:       %d\n"
-	       "  integer:    %d\n"
-	       "  float:      %d\n"
-	       "  array:      %d\n"
-	       "  object:     %d\n"
-	       "  object key: %d\n\n",
-	       
-	       (argc > 1 ? argv[1] : "data from STDIN"), 
-	       c_nulls, c_falses, c_trues, c_ints, c_floats, c_arrays, c_objects, c_obj_keys);
-
-	if (memtest) {
-		printf("malloc()  calls: %u\n"
-		       "realloc() calls: %u\n"
-		       "free()    calls: %u\n\n", mallocs, reallocs, frees); 
-	}
-	 
-	printf("Total parsing time: %f seconds\n"
-	       "------------------------------------------------------------------------\n", 
-	       (double) runtime / CLOCKS_PER_SEC);
+	       "  null:       %ld\n"
+	       "  false:      %ld\n"
+	       "  true:       %ld\n"
+	       "  integer:    %ld\n"
+	       "  float:      %ld\n"
+	       "  string:     %ld\n"
+	       "  array:      %ld\n"
+	       "  object:     %ld\n"
+	       "  object key: %ld\n\n",
+
+	       r->file, r->tokens.nulls, r->tokens.falses, r->tokens.trues,
+	       r->tokens.ints, r->tokens.floats, r->tokens.strings,
+	       r->tokens.arrays, r->tokens.objects, r->tokens.obj_keys);
+
+	if (opts->memtest) {
+		printf("malloc()  calls: %lu per iteration\n"
+		       "realloc() calls: %lu per iteration\n"
+		       "free()    calls: %lu per iteration\n\n",
+		       mallocs / r->iterations, reallocs / r->iterations,
+		       frees / r->iterations);
+	}
+
+	if (opts->perf) {
+		print_counters_text(r);
+	}
+
+	if (r->compressed_bytes > 0) {
+		printf("Compressed:     %ld bytes (%.1fx), %.2f MB/s of compressed input\n",
+		       r->compressed_bytes, (double) r->bytes / r->compressed_bytes,
+		       r->compressed_mb_per_s);
+	}
+
+	printf("Input size:     %ld bytes, %ld tokens\n"
+	       "Iterations:     %d (+%d warmup)\n"
+	       "Parsing time:   min %.3f ms, median %.3f ms, p99 %.3f ms\n"
+	       "Throughput:     %.2f MB/s, %.0f tokens/s, %.1f ns/token\n"
+	       "Peak memory:    %ld kB (including the input)\n"
+	       "------------------------------------------------------------------------\n",
+	       r->bytes, r->tokens.total, r->iterations, opts->warmup,
+	       r->min_ns / 1e6, r->median_ns / 1e6, r->p99_ns / 1e6,
+	       r->mb_per_s, r->tokens_per_s, r->ns_per_token, r->peak_rss_kb);
+}
+
+/* Print a string as a JSON string, escaping as needed */
+static void
+print_json_str(const char *str)
+{
+	putchar('"');
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\') {
+			printf("\\%c", *str);
+		} else if ((unsigned char) *str < 0x20) {
+			printf("\\u%04x", *str);
+		} else {
+			putchar(*str);
+		}
+	}
+	putchar('"');
+}
+
+/* Print the results of a single file as a JSON object */
+static void
+print_result_json(const bench_options *opts, const bench_result *r, int first)
+{
+	printf("%s\n    {\"file\": ", (first ? "" : ","));
+	print_json_str(r->file);
+	printf(", \"bytes\": %ld, \"tokens\": %ld, \"iterations\": %d,\n"
+	       "     \"min_ns\": %.0f, \"median_ns\": %.0f, \"p99_ns\": %.0f,\n"
+	       "     \"mb_per_s\": %.3f, \"tokens_per_s\": %.0f, \"ns_per_token\": %.3f,\n"
+	       "     \"peak_rss_kb\": %ld",
+	       r->bytes, r->tokens.total, r->iterations,
+	       r->min_ns, r->median_ns, r->p99_ns,
+	       r->mb_per_s, r->tokens_per_s, r->ns_per_token, r->peak_rss_kb);
+
+	if (r->compressed_bytes > 0) {
+		printf(",\n     \"compressed_bytes\": %ld, \"compressed_mb_per_s\": %.3f",
+		       r->compressed_bytes, r->compressed_mb_per_s);
+	}
+
+	if (opts->latency) {
+		printf(",\n     \"messages\": %ld, \"p999_ns\": %.0f, \"allocs_per_msg\": %.2f,\n"
+		       "     \"ttft_p50_ns\": %.0f, \"ttft_p99_ns\": %.0f, \"ttft_p999_ns\": %.0f",
+		       r->messages, r->p999_ns, r->allocs_per_msg,
+		       r->ttft_p50_ns, r->ttft_p99_ns, r->ttft_p999_ns);
+	}
+
+	if (opts->memtest) {
+		printf(",\n     \"mallocs\": %lu, \"reallocs\": %lu, \"frees\": %lu",
+		       mallocs / r->iterations, reallocs / r->iterations,
+		       frees / r->iterations);
+	}
+
+	if (opts->perf) {
+		double runs_bytes  = (double) r->bytes * r->iterations;
+		double runs_tokens = (double) r->tokens.total * r->iterations;
+		int    i;
+
+		for (i = 0; i < PERF_NUM_COUNTERS; i++) {
+			if (r->counters[i] < 0) {
+				printf(",\n     \"%s_per_byte\": null, \"%s_per_token\": null",
+					perf_counter_names[i], perf_counter_names[i]);
+			} else {
+				printf(",\n     \"%s_per_byte\": %.4f, \"%s_per_token\": %.4f",
+					perf_counter_names[i], r->counters[i] / runs_bytes,
+					perf_counter_names[i], r->counters[i] / runs_tokens);
+			}
+		}
+	}
+
+	printf("}");
+}
+
+/* A single entry read back from a JSON results file */
+typedef struct {
+	char   *file;
+	double  median_ns;
+	double  mb_per_s;
+} saved_result;
+
+/*
+ * Load a results file previously written with -j, using vktor of course.
+ * Returns the number of results read, or -1 on error.
+ */
+static int
+load_results(const char *name, saved_result **results)
+{
+	vktor_parser *parser;
+	vktor_status  status;
+	vktor_error  *error = NULL;
+	char         *data, *str, *key = NULL;
+	long          size;
+	int           count = 0, alloc = 0, done = 0, ret = 0;
+	saved_result *r = NULL;
+
+	if ((data = load_file(name, &size)) == NULL) {
+		fprintf(stderr, "Error opening results file %s: %s\n", name,
+			strerror(errno));
+		return -1;
+	}
+
+	parser = vktor_parser_init(DEFAULT_MAXDEPTH);
+	vktor_feed(parser, data, size, 1, &error);
+
+	do {
+		status = vktor_parse(parser, &error);
+
+		switch (status) {
+			case VKTOR_OK:
+				if (vktor_get_depth(parser) != 3) {
+					break;
+				}
+
+				switch (vktor_get_token_type(parser)) {
+					case VKTOR_T_OBJECT_START:
+						if (count == alloc) {
+							alloc = (alloc == 0 ? 16 : alloc * 2);
+							r = realloc(r, sizeof(saved_result) * alloc);
+						}
+						memset(&r[count++], 0, sizeof(saved_result));
+						break;
+
+					case VKTOR_T_OBJECT_KEY:
+						free(key);
+						vktor_get_value_str_copy(parser, &key, &error);
+						break;
+
+					case VKTOR_T_STRING:
+						if (count > 0 && strcmp(key, "file") == 0) {
+							vktor_get_value_str_copy(parser, &str, &error);
+							r[count - 1].file = str;
+						}
+						break;
+
+					case VKTOR_T_INT:
+					case VKTOR_T_FLOAT:
+						if (count == 0) {
+							break;
+						} else if (strcmp(key, "median_ns") == 0) {
+							r[count - 1].median_ns = vktor_get_value_double(parser, &error);
+						} else if (strcmp(key, "mb_per_s") == 0) {
+							r[count - 1].mb_per_s = vktor_get_value_double(parser, &error);
+						}
+						break;
+
+					default:
+						break;
+				}
+				break;
+
+			case VKTOR_MORE_DATA:
+				fprintf(stderr, "Error: premature end of results file %s\n", name);
+				ret = -1;
+				done = 1;
+				break;
+
+			case VKTOR_COMPLETE:
+				done = 1;
+				break;
+
+			case VKTOR_ERROR:
+				fprintf(stderr, "Error reading results file %s [%d]: %s\n",
+					name, error->code, error->message);
+				ret = -1;
+				done = 1;
+				break;
+		}
+	} while (! done);
+
+	if (error != NULL) {
+		vktor_error_free(error);
+	}
+
+	vktor_parser_free(parser);
+	free(key);
+
+	*results = r;
+	return (ret == 0 ? count : -1);
+}
+
+/*
+ * Compare two results files, printing the difference in median time for each
+ * file found in both. Returns 1 if any regression over threshold percent was
+ * found, 0 if not and 255 on error.
+ */
+static int
+compare_results(const char *base_file, const char *cur_file, double threshold)
+{
+	saved_result *base, *cur;
+	int           nbase, ncur, i, j, ret = 0;
+	double        delta;
+
+	if ((nbase = load_results(base_file, &base)) < 0 ||
+	    (ncur  = load_results(cur_file,  &cur))  < 0) {
+		return 255;
+	}
+
+	printf("%-40s %12s %12s %9s\n", "file", "base MB/s", "new MB/s", "time");
+
+	for (i = 0; i < ncur; i++) {
+		for (j = 0; j < nbase; j++) {
+			if (base[j].file != NULL && cur[i].file != NULL &&
+			    strcmp(base[j].file, cur[i].file) == 0) {
+				break;
+			}
+		}
+
+		if (j == nbase || base[j].median_ns <= 0) {
+			printf("%-40s %12s %12.2f %9s\n", cur[i].file, "-",
+				cur[i].mb_per_s, "new");
+			continue;
+		}
+
+		delta = (cur[i].median_ns - base[j].median_ns) / base[j].median_ns * 100;
+		printf("%-40s %12.2f %12.2f %+8.1f%%%s\n", cur[i].file, base[j].mb_per_s,
+			cur[i].mb_per_s, delta, (delta > threshold ? "  REGRESSION" : ""));
+
+		if (delta > threshold) {
+			ret = 1;
+		}
+	}
+
+	return ret;
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-n iterations] [-w warmup] [-j] [-p] [-C] [-I|-A|-R] [-N|-L] file [file ...]\n"
+		"       %s -c baseline.json current.json [-t threshold]\n",
+		prog, prog);
+	exit(255);
+}
+
+int
+main(int argc, char *argv[])
+{
+	bench_options   opts;
+	bench_result    result;
+	bump_arena      bump;
+	vktor_allocator bump_allocator = { bump_malloc, bump_realloc, bump_free, 
+	                                   &bump };
+	char           *envvar;
+	char            compare = 0, pool = 0;
+	double          threshold = DEFAULT_THRESHOLD;
+	int             opt, i, ret = 0;
+
+	memset(&opts, 0, sizeof(opts));
+	opts.buffsize   = DEFAULT_BUFFSIZE;
+	opts.maxdepth   = DEFAULT_MAXDEPTH;
+	opts.iterations = DEFAULT_ITERATIONS;
+	opts.warmup     = DEFAULT_WARMUP;
+
+	/* Set buffer size from environment, if set */
+	if ((envvar = getenv("BUFFSIZE")) != NULL) {
+		opts.buffsize = atoi(envvar);
+	}
+
+	/* Set max depth from environment, if set */
+	if ((envvar = getenv("MAXDEPTH")) != NULL) {
+		opts.maxdepth = atoi(envvar);
+	}
+
+	while ((opt = getopt(argc, argv, "n:w:jpCIARNLct:")) != -1) {
+		switch (opt) {
+			case 'n':
+				opts.iterations = atoi(optarg);
+				break;
+			case 'w':
+				opts.warmup = atoi(optarg);
+				break;
+			case 'j':
+				opts.json = 1;
+				break;
+			case 'p':
+				opts.perf = 1;
+				break;
+			case 'C':
+				opts.complete = 1;
+				break;
+			case 'I':
+				// Room for the parser and some token memory
+				opts.arena_size = 1;
+				break;
+			case 'A':
+				opts.allocator = &bump_allocator;
+				break;
+			case 'R':
+				pool = 1;
+				break;
+			case 'N':
+				opts.ndjson = 1;
+				break;
+			case 'L':
+				opts.latency = 1;
+				break;
+			case 'c':
+				compare = 1;
+				break;
+			case 't':
+				threshold = atof(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (compare) {
+		if (argc - optind != 2) {
+			usage(argv[0]);
+		}
+		return compare_results(argv[optind], argv[optind + 1], threshold);
+	}
+
+	if (optind >= argc || opts.iterations < 1 || opts.buffsize < 1 || 
+	    (opts.arena_size != 0) + (opts.allocator != NULL) + pool > 1) {
+		usage(argv[0]);
+	}
+
+	/* Create the parser pool, keeping a single idle parser is enough here */
+	if (pool && (opts.pool = vktor_parser_pool_init(opts.maxdepth, 1, 
+	                                                NULL)) == NULL) {
+		return 255;
+	}
+
+	/* Allocate the memory block for parsers initialized in place */
+	if (opts.arena_size) {
+		opts.arena_size = vktor_parser_size() + ARENA_TOKEN_SIZE;
+		if ((opts.arena = malloc(opts.arena_size)) == NULL) {
+			return 255;
+		}
+	}
+
+	/* Allocate the per-document bump arena */
+	if (opts.allocator != NULL) {
+		memset(&bump, 0, sizeof(bump));
+		bump.size = BUMP_ARENA_SIZE;
+		if ((bump.mem = malloc(bump.size)) == NULL) {
+			free(opts.arena);
+			return 255;
+		}
+	}
+
+	/* Set memory handlers, latency mode always counts allocations */
+	if (getenv("MEMTEST") != NULL || opts.latency) {
+		vktor_set_memory_handlers(my_malloc, my_realloc, my_free);
+		opts.memtest = ! opts.latency;
+	}
+
+	/* Open hardware counters, if requested */
+	if (opts.perf && perf_init() == 0) {
+		fprintf(stderr, "Warning: hardware performance counters are not "
+			"available on this system\n");
+	}
+
+	if (opts.json) {
+		printf("{\"buffsize\": %d, \"files\": [", opts.buffsize);
+	}
+
+	for (i = optind; i < argc; i++) {
+		if (opts.latency) {
+			ret = latency_file(&opts, argv[i], &result);
+		} else {
+			ret = bench_file(&opts, argv[i], &result);
+		}
+
+		if (ret != 0) {
+			fprintf(stderr, "Error: benchmarking %s failed\n", argv[i]);
+			break;
+		}
+
+		if (opts.json) {
+			print_result_json(&opts, &result, (i == optind));
+		} else if (opts.latency) {
+			print_latency_text(&opts, &result);
+		} else {
+			print_result_text(&opts, &result);
+		}
+	}
+
+	if (opts.json) {
+		printf("\n]}\n");
+	}
+
+	free(opts.arena);
+	if (opts.allocator != NULL) {
+		free(bump.mem);
+	}
+	if (opts.pool != NULL) {
+		vktor_parser_pool_free(opts.pool);
+	}
 
 	return ret;
 }
@@ -0,0 +1,574 @@
+/* 
+ * vktor JSON pull-parser library
+ * 
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE. 
+ */
+
+/**
+ * @file vktor-gen.c
+ *
+ * Synthetic JSON corpus generator used for benchmarking vktor.
+ *
+ * Generates a JSON document (or NDJSON stream) of roughly the requested size
+ * made of records (objects) whose shape is controlled by command line options.
+ * The output only depends on the options and the seed, so the same corpus can
+ * be regenerated anywhere instead of being stored.
+ *
+ *   -s size     approximate output size, with optional K, M or G suffix
+ *   -o file     output file (default: standard output)
+ *   -S seed     random seed (default: 1)
+ *   -P preset   start from a preset: strings, escapes, unicode, integers,
+ *               floats, literals, deep, wide or mixed (default)
+ *   -l length   mean string length
+ *   -D dist     string length distribution: fixed, uniform or exp
+ *   -e ratio    ratio of escaped characters in strings (0 - 1)
+ *   -u ratio    ratio of non-ASCII characters in strings (0 - 1)
+ *   -f ratio    ratio of floats among numbers (0 - 1)
+ *   -t weights  relative weights of string, number, literal (true, false and
+ *               null) and nested values, e.g. "4,2,1,1"
+ *   -d depth    maximal nesting depth inside a record
+ *   -w width    mean number of keys in an object / items in an array
+ *   -n          write NDJSON (one record per line) instead of a single array
+ *   -X case     write an adversarial document instead of records, see below
+ *
+ * Options given after -P override the preset values.
+ *
+ * Adversarial documents (-X) are meant to catch superlinear behavior and are 
+ * made of a single huge value, or many copies of a degenerate one:
+ *
+ *   string      one string value of the given size
+ *   unicode     one string made of \uXXXX escapes, including surrogate pairs
+ *   key         an object with one huge key
+ *   number      one huge integer
+ *   nest        arrays nested -d levels deep, repeated to fill the size
+ *   tiny        an array of many single digit integers
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#define OUT_BUFFSIZE (256 * 1024)
+#define NUM_KEYS     64
+
+typedef enum {
+	DIST_FIXED,
+	DIST_UNIFORM,
+	DIST_EXP
+} length_dist;
+
+/* Corpus shape */
+typedef struct {
+	long long   size;
+	double      str_len;
+	length_dist str_dist;
+	double      escapes;
+	double      non_ascii;
+	double      floats;
+	double      w_string, w_number, w_literal, w_nested;
+	int         depth;
+	double      width;
+	char        ndjson;
+} gen_shape;
+
+/* Named presets, each stressing one parser path */
+typedef struct {
+	const char *name;
+	gen_shape   shape;
+} gen_preset;
+
+static const gen_preset presets[] = {
+	/*            size  len  dist          esc   non   flt   s  n  l  x  d   w     nd */
+	{"mixed",    {0,    12,  DIST_EXP,     0.01, 0.02, 0.3,  4, 2, 1, 1, 3,  8,    0}},
+	{"strings",  {0,    32,  DIST_EXP,     0,    0,    0,    1, 0, 0, 0, 1,  8,    0}},
+	{"escapes",  {0,    32,  DIST_EXP,     0.2,  0,    0,    1, 0, 0, 0, 1,  8,    0}},
+	{"unicode",  {0,    32,  DIST_EXP,     0,    0.5,  0,    1, 0, 0, 0, 1,  8,    0}},
+	{"integers", {0,    8,   DIST_FIXED,   0,    0,    0,    0, 1, 0, 0, 1,  8,    0}},
+	{"floats",   {0,    8,   DIST_FIXED,   0,    0,    1,    0, 1, 0, 0, 1,  8,    0}},
+	{"literals", {0,    8,   DIST_FIXED,   0,    0,    0,    0, 0, 1, 0, 1,  8,    0}},
+	{"deep",     {0,    8,   DIST_UNIFORM, 0,    0,    0.3,  1, 1, 1, 4, 24, 2,    0}},
+	{"wide",     {0,    8,   DIST_UNIFORM, 0,    0,    0.3,  1, 1, 1, 0, 1,  1000, 0}},
+	{NULL}
+};
+
+static const char *escapes[] = {
+	"\\n", "\\t", "\\r", "\\\"", "\\\\", "\\/", "\\b", "\\f", "\\u00e9", "\\u20ac"
+};
+
+static char               out_buffer[OUT_BUFFSIZE];
+static size_t             out_len = 0;
+static long long          out_total = 0;
+static FILE              *out;
+static unsigned long long rng_state;
+static char               keys[NUM_KEYS][16];
+
+/* xorshift64* - small, fast and the same everywhere */
+static unsigned long long
+rng_next(void)
+{
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return rng_state * 2685821657736338717ULL;
+}
+
+/* Random double in [0, 1) */
+static double
+rng_double(void)
+{
+	return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Random integer in [0, n) */
+static unsigned long
+rng_int(unsigned long n)
+{
+	return (unsigned long) (rng_double() * n);
+}
+
+/* Pick a random number around mean according to dist, at least min */
+static long
+rng_length(double mean, length_dist dist, long min)
+{
+	double n;
+
+	switch (dist) {
+		case DIST_FIXED:
+			n = mean;
+			break;
+
+		case DIST_UNIFORM:
+			n = rng_double() * mean * 2;
+			break;
+
+		default:
+			n = -mean * log1p(-rng_double());
+			break;
+	}
+
+	return ((long) n < min ? min : (long) n);
+}
+
+static void
+out_flush(void)
+{
+	fwrite(out_buffer, 1, out_len, out);
+	out_len = 0;
+}
+
+static void
+out_write(const char *str, size_t len)
+{
+	if (out_len + len > OUT_BUFFSIZE) {
+		out_flush();
+	}
+	memcpy(out_buffer + out_len, str, len);
+	out_len += len;
+	out_total += len;
+}
+
+static void
+out_str(const char *str)
+{
+	out_write(str, strlen(str));
+}
+
+#define out_char(c) do { char _c = (c); out_write(&_c, 1); } while (0)
+
+/* Write a random code point above 0x7f as UTF-8 */
+static void
+gen_non_ascii(void)
+{
+	char          utf8[4];
+	unsigned long cp;
+	double        r = rng_double();
+
+	if (r < 0.5) {
+		cp = 0x80 + rng_int(0x800 - 0x80);
+		utf8[0] = 0xc0 | (cp >> 6);
+		utf8[1] = 0x80 | (cp & 0x3f);
+		out_write(utf8, 2);
+	} else if (r < 0.9) {
+		do {
+			cp = 0x800 + rng_int(0x10000 - 0x800);
+		} while (cp >= 0xd800 && cp <= 0xdfff);
+		utf8[0] = 0xe0 | (cp >> 12);
+		utf8[1] = 0x80 | ((cp >> 6) & 0x3f);
+		utf8[2] = 0x80 | (cp & 0x3f);
+		out_write(utf8, 3);
+	} else {
+		cp = 0x10000 + rng_int(0x110000 - 0x10000);
+		utf8[0] = 0xf0 | (cp >> 18);
+		utf8[1] = 0x80 | ((cp >> 12) & 0x3f);
+		utf8[2] = 0x80 | ((cp >> 6) & 0x3f);
+		utf8[3] = 0x80 | (cp & 0x3f);
+		out_write(utf8, 4);
+	}
+}
+
+static void
+gen_string(const gen_shape *shape)
+{
+	static const char chars[] =
+		"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 _-.:";
+	long   len, i;
+	double r;
+
+	len = rng_length(shape->str_len, shape->str_dist, 0);
+
+	out_char('"');
+	for (i = 0; i < len; i++) {
+		r = rng_double();
+		if (r < shape->escapes) {
+			out_str(escapes[rng_int(sizeof(escapes) / sizeof(escapes[0]))]);
+		} else if (r < shape->escapes + shape->non_ascii) {
+			gen_non_ascii();
+		} else {
+			out_char(chars[rng_int(sizeof(chars) - 1)]);
+		}
+	}
+	out_char('"');
+}
+
+static void
+gen_number(const gen_shape *shape)
+{
+	char   num[64];
+	int    digits;
+
+	// Log-uniform magnitude so short and long numbers are both common
+	digits = 1 + rng_int(15);
+
+	if (rng_double() < shape->floats) {
+		if (rng_double() < 0.1) {
+			snprintf(num, sizeof(num), "%.*fe%d", (int) rng_int(15),
+				rng_double() * 10, (int) rng_int(40) - 20);
+		} else {
+			snprintf(num, sizeof(num), "%.*f", 1 + (int) rng_int(8),
+				(rng_double() - 0.5) * 2 * (double) (1ULL << (digits * 3)));
+		}
+	} else {
+		snprintf(num, sizeof(num), "%lld",
+			(long long) ((rng_double() - 0.3) * (double) (1ULL << (digits * 4))));
+	}
+
+	out_str(num);
+}
+
+static void gen_value(const gen_shape *shape, int depth);
+
+static void
+gen_object(const gen_shape *shape, int depth)
+{
+	long n, i;
+
+	n = rng_length(shape->width, DIST_UNIFORM, 1);
+
+	out_char('{');
+	for (i = 0; i < n; i++) {
+		if (i > 0) out_char(',');
+		out_char('"');
+		out_str(keys[(i < NUM_KEYS ? (unsigned long) i : rng_int(NUM_KEYS))]);
+		out_str("\":");
+		gen_value(shape, depth + 1);
+	}
+	out_char('}');
+}
+
+static void
+gen_array(const gen_shape *shape, int depth)
+{
+	long n, i;
+
+	n = rng_length(shape->width, DIST_UNIFORM, 1);
+
+	out_char('[');
+	for (i = 0; i < n; i++) {
+		if (i > 0) out_char(',');
+		gen_value(shape, depth + 1);
+	}
+	out_char(']');
+}
+
+static void
+gen_value(const gen_shape *shape, int depth)
+{
+	double total, r;
+
+	total = shape->w_string + shape->w_number + shape->w_literal;
+	if (depth < shape->depth) {
+		total += shape->w_nested;
+	}
+
+	r = rng_double() * total;
+
+	if ((r -= shape->w_string) < 0) {
+		gen_string(shape);
+	} else if ((r -= shape->w_number) < 0) {
+		gen_number(shape);
+	} else if ((r -= shape->w_literal) < 0) {
+		switch (rng_int(3)) {
+			case 0:  out_str("true");  break;
+			case 1:  out_str("false"); break;
+			default: out_str("null");  break;
+		}
+	} else if (rng_int(2)) {
+		gen_object(shape, depth);
+	} else {
+		gen_array(shape, depth);
+	}
+}
+
+/* Write an adversarial document, returns 0 if the case is unknown */
+static int
+gen_adversarial(const char *name, const gen_shape *shape)
+{
+	static const char *unicode[] = {
+		"\\u00e9", "\\u4e2d", "\\u20ac", "\\u0041", "\\ud83d\\ude00"
+	};
+	long long i;
+
+	if (strcmp(name, "string") == 0 || strcmp(name, "key") == 0) {
+		out_str(name[0] == 's' ? "[\"" : "{\"");
+		while (out_total < shape->size) {
+			out_char('a' + rng_int(26));
+		}
+		out_str(name[0] == 's' ? "\"]\n" : "\":0}\n");
+
+	} else if (strcmp(name, "unicode") == 0) {
+		out_str("[\"");
+		while (out_total < shape->size) {
+			out_str(unicode[rng_int(sizeof(unicode) / sizeof(unicode[0]))]);
+		}
+		out_str("\"]\n");
+
+	} else if (strcmp(name, "number") == 0) {
+		out_str("[1");
+		while (out_total < shape->size) {
+			out_char('0' + rng_int(10));
+		}
+		out_str("]\n");
+
+	} else if (strcmp(name, "nest") == 0) {
+		out_char('[');
+		do {
+			if (out_total > 1) out_char(',');
+			for (i = 0; i < shape->depth; i++) out_char('[');
+			for (i = 0; i < shape->depth; i++) out_char(']');
+		} while (out_total < shape->size);
+		out_str("]\n");
+
+	} else if (strcmp(name, "tiny") == 0) {
+		out_char('[');
+		do {
+			if (out_total > 1) out_char(',');
+			out_char('0' + rng_int(10));
+		} while (out_total < shape->size);
+		out_str("]\n");
+
+	} else {
+		return 0;
+	}
+
+	return 1;
+}
+
+static long long
+parse_size(const char *str)
+{
+	char      *end;
+	long long  size = strtoll(str, &end, 10);
+
+	switch (*end) {
+		case 'g': case 'G': size *= 1024; /* fall through */
+		case 'm': case 'M': size *= 1024; /* fall through */
+		case 'k': case 'K': size *= 1024;
+	}
+
+	return size;
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s -s size [-o file] [-S seed] [-P preset] [-l length] \n"
+		"         [-D fixed|uniform|exp] [-e ratio] [-u ratio] [-f ratio]\n"
+		"         [-t s,n,l,x] [-d depth] [-w width] [-n] [-X case]\n", prog);
+	exit(255);
+}
+
+int
+main(int argc, char *argv[])
+{
+	gen_shape  shape = presets[0].shape;
+	char      *adversarial = NULL;
+	int        opt, i;
+	long long  records = 0;
+
+	out = stdout;
+	rng_state = 1;
+
+	while ((opt = getopt(argc, argv, "s:o:S:P:l:D:e:u:f:t:d:w:nX:")) != -1) {
+		switch (opt) {
+			case 's':
+				shape.size = parse_size(optarg);
+				break;
+
+			case 'o':
+				if ((out = fopen(optarg, "w")) == NULL) {
+					perror("Error opening output file");
+					return 255;
+				}
+				break;
+
+			case 'S':
+				rng_state = strtoull(optarg, NULL, 10);
+				break;
+
+			case 'P':
+				for (i = 0; presets[i].name != NULL; i++) {
+					if (strcmp(presets[i].name, optarg) == 0) break;
+				}
+				if (presets[i].name == NULL) {
+					fprintf(stderr, "Unknown preset: %s\n", optarg);
+					return 255;
+				}
+				{
+					long long size = shape.size;
+					char      ndjson = shape.ndjson;
+
+					shape = presets[i].shape;
+					shape.size   = size;
+					shape.ndjson = ndjson;
+				}
+				break;
+
+			case 'l':
+				shape.str_len = atof(optarg);
+				break;
+
+			case 'D':
+				if (strcmp(optarg, "fixed") == 0) {
+					shape.str_dist = DIST_FIXED;
+				} else if (strcmp(optarg, "uniform") == 0) {
+					shape.str_dist = DIST_UNIFORM;
+				} else if (strcmp(optarg, "exp") == 0) {
+					shape.str_dist = DIST_EXP;
+				} else {
+					usage(argv[0]);
+				}
+				break;
+
+			case 'e':
+				shape.escapes = atof(optarg);
+				break;
+
+			case 'u':
+				shape.non_ascii = atof(optarg);
+				break;
+
+			case 'f':
+				shape.floats = atof(optarg);
+				break;
+
+			case 't':
+				if (sscanf(optarg, "%lf,%lf,%lf,%lf", &shape.w_string,
+				           &shape.w_number, &shape.w_literal,
+				           &shape.w_nested) != 4) {
+					usage(argv[0]);
+				}
+				break;
+
+			case 'd':
+				shape.depth = atoi(optarg);
+				break;
+
+			case 'w':
+				shape.width = atof(optarg);
+				break;
+
+			case 'n':
+				shape.ndjson = 1;
+				break;
+
+			case 'X':
+				adversarial = optarg;
+				break;
+
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (shape.size <= 0 || rng_state == 0 ||
+	    shape.w_string + shape.w_number + shape.w_literal <= 0) {
+		usage(argv[0]);
+	}
+
+	if (adversarial != NULL) {
+		if (! gen_adversarial(adversarial, &shape)) {
+			fprintf(stderr, "Unknown adversarial case: %s\n", adversarial);
+			return 255;
+		}
+		out_flush();
+		return (out != stdout && fclose(out) != 0 ? 255 : 0);
+	}
+
+	// Key names are reused between records like in real data
+	for (i = 0; i < NUM_KEYS; i++) {
+		snprintf(keys[i], sizeof(keys[i]), "%.*s_%d",
+			(int) (3 + i % 6), "record_field", i);
+	}
+
+	if (! shape.ndjson) {
+		out_char('[');
+	}
+
+	do {
+		if (records > 0 && ! shape.ndjson) {
+			out_str(",\n");
+		}
+		gen_object(&shape, 1);
+		if (shape.ndjson) {
+			out_char('\n');
+		}
+		records++;
+	} while (out_total < shape.size);
+
+	if (! shape.ndjson) {
+		out_str("]\n");
+	}
+
+	out_flush();
+
+	if (out != stdout && fclose(out) != 0) {
+		perror("Error writing output file");
+		return 255;
+	}
+
+	return 0;
+}
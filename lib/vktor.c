@@ -28,8 +28,10 @@
 /**
  * @file vktor.c
  * 
- * Main vktor library file. Defines the external API of vktor as well as some 
- * internal static functions, data types and macros.
+ * Main vktor library file. Defines the parser and most of the external API of
+ * vktor as well as some internal static functions. Validation, columnar 
+ * readers, offset indexes, schemas, checkpoints and parser pools are defined 
+ * in their own files, sharing the parser struct through vktor_internal.h.
  */
 
 /**
@@ -47,10 +49,21 @@
 #include <stdarg.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
+#include <float.h>
+#include <ctype.h>
 #include <assert.h>
 
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
 #include "vktor.h"
+#include "vktor_internal.h"
 #include "vktor_unicode.h"
+#include "vktor_base64.h"
+#include "vktor_typed.h"
+#include "vktor_hash.h"
 
 /**
  * Maximal error string length (mostly for internal use). 
@@ -73,184 +86,120 @@
 #endif
 
 /**
- * Convenience macro to check if we are at the end of a buffer
- */
-#define eobuffer(b) (b->ptr >= b->size)
-
-/**
- * Set some macros depending on whether byte counting is enabled or not 
- */
-#ifdef BYTECOUNTER
-
-#define INCREMENT_BUFFER_PTR(p) \
-	p->buffer->ptr++;       \
-	p->bytecounter++;       
-
-#define BYTECOUNT_TPL " at %d bytes"
-#define BYTECOUNT_VAL , parser->bytecounter
-
-#else
-
-#define INCREMENT_BUFFER_PTR(p) p->buffer->ptr++;
-#define BYTECOUNT_TPL
-#define BYTECOUNT_VAL
-
-#endif
-
-
-/**
- * When debugging is enabled, file and line info can be added to error macros 
+ * Default size of the buffers compressed input is inflated into
  */
-#ifdef ENABLE_DEBUG
-#define _VK_QUOTEME(x) #x
-#define VK_QUOTEME(x) _VK_QUOTEME(x)
-#define LINEINFO "[" __FILE__ ":" VK_QUOTEME(__LINE__) "] "
-#else
-#define LINEINFO 
+#ifndef VKTOR_INFLATE_CHUNK
+#define VKTOR_INFLATE_CHUNK 65536
 #endif
 
-/**
- * Convenience macro to set an 'unexpected character' error
- */
-#define set_error_unexpected_c(e, c)                                      \
-	set_error(e, VKTOR_ERR_UNEXPECTED_INPUT,                          \
-		LINEINFO "Unexpected character in input: '%c' (0x%02hhx)" \
-		BYTECOUNT_TPL, c, c BYTECOUNT_VAL)
-
-/**
- * A bitmask representing any 'value' token 
- */
-#define VKTOR_VALUE_TOKEN VKTOR_T_NULL         | \
-                          VKTOR_T_FALSE        | \
-                          VKTOR_T_TRUE         | \
-                          VKTOR_T_INT          | \
-                          VKTOR_T_FLOAT        | \
-                          VKTOR_T_STRING       | \
-                          VKTOR_T_ARRAY_START  | \
-                          VKTOR_T_OBJECT_START
-
-/**
- * Convenience macro to check if we are in a specific type of JSON struct
- */
-#define nest_stack_in(p, c) (p->nest_stack[p->nest_ptr] == c)
-
-/**
- * Convenience macro to easily set the expected next token map after a value
- * token, taking current struct struct (if any) into account.
- */
-#define expect_next_value_token(p)                        \
-	switch(p->nest_stack[p->nest_ptr]) {              \
-		case VKTOR_STRUCT_OBJECT:                 \
-			p->expected = VKTOR_C_COMMA |     \
-			              VKTOR_T_OBJECT_END; \
-			break;                            \
-			                                  \
-		case VKTOR_STRUCT_ARRAY:                  \
-			p->expected = VKTOR_C_COMMA |     \
-			              VKTOR_T_ARRAY_END;  \
-			break;                            \
-			                                  \
-		default:                                  \
-			p->expected = VKTOR_T_NONE;       \
-			break;                            \
-	}
-
 /**
  * Convenience macro to check, and reallocate if needed, the memory size for
- * reading a token
+ * reading a token. Memory is grown geometrically, by at least cs bytes.
  */
 #define check_reallocate_token_memory(cs)                                              \
 	if ((ptr + 5) >= maxlen) {                                                     \
-		maxlen = maxlen + cs;                                                  \
-		if ((token = vrealloc(token, maxlen * sizeof(char))) == NULL) {         \
-			set_error(error, VKTOR_ERR_OUT_OF_MEMORY,                      \
-				"unable to allocate %d more bytes for string parsing"  \
-				LINEINFO, cs);                                         \
+		maxlen = maxlen + (maxlen > cs ? maxlen : cs);                         \
+		if ((token = vrealloc(parser, token, maxlen * sizeof(char))) == NULL) { \
+			set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY,                      \
+				"unable to allocate %d bytes for token parsing"        \
+				LINEINFO, maxlen);                                     \
 			return VKTOR_ERROR;                                            \
 		}                                                                      \
+		parser->token_value = (void *) token;                                  \
+		parser->token_alloc = maxlen;                                          \
 	}
 
 /**
- * Buffer struct, containing some text to parse along with an internal pointer
- * and a link to the next buffer.
- * 
- * vktor internally holds text to be parsed as a linked list of buffers pushed
- * by the user, so no memory reallocations are required. Whenever a buffer is 
- * completely parsed, the parser will advance to the next buffer pointed by 
- * #next_buff and will free the previous buffer
+ * Error struct along with the allocator it was allocated with. The allocator 
+ * is kept out of vktor_error so that its public layout does not change.
+ */
+typedef struct _vktor_error_alloc_struct {
+	vktor_error     error;     /**< the error returned to the user */
+	vktor_allocator allocator; /**< allocator used for the error */
+} vktor_error_alloc;
+
+/**
+ * @enum vktor_number_kind
  * 
- * This is done internally by the parser
+ * Element types of arrays read by vktor_read_number_array() and friends
  */
-typedef struct _vktor_buffer_struct {
-	char                        *text;      /**< buffer text */
-	long                         size;      /**< buffer size */
-	long                         ptr;       /**< internal buffer position */
-	char                         free;      /**< free the bffer when done */
-	struct _vktor_buffer_struct *next_buff;	/**< pointer to the next buffer */
-} vktor_buffer;
+typedef enum {
+	VKTOR_NUM_DOUBLE, /**< double */
+	VKTOR_NUM_FLOAT,  /**< float */
+	VKTOR_NUM_INT64   /**< long long */
+} vktor_number_kind;
 
 /**
- * Parser struct - this is the main object used by the user to parse a JSON 
- * stream. 
+ * Powers of 10 which are exactly representable as doubles
  */
-struct _vktor_parser_struct {
-	vktor_buffer   *buffer;       /**< the current buffer being parsed */
-	vktor_buffer   *last_buffer;  /**< a pointer to the last buffer */
-	vktor_token     token_type;   /**< current token type */
-	void           *token_value;  /**< current token value, if any */
-	int             token_size;   /**< current token value length, if any */
-	char            token_resume; /**< current token is only half read */  
-	long            expected;     /**< bitmask of possible expected tokens */
-	vktor_struct   *nest_stack;   /**< array holding current nesting stack */
-	int             nest_ptr;     /**< pointer to the current nesting level */
-	int             max_nest;     /**< maximal nesting level */
-	unsigned long   unicode_c;    /**< temp container for unicode characters */
-#ifdef BYTECOUNTER
-	/** Total bytes parsed counter, only enabled if BYTECOUNTER is defined **/
-	unsigned long   bytecounter;  
-#endif
+static const double pow10_exact[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
 };
 
+static vktor_malloc  global_malloc  = malloc;
+static vktor_free    global_free    = free;
+static vktor_realloc global_realloc = realloc;
+
 /**
- * @enum vktor_specialchar
- * 
- * Special JSON characters - these are not returned to the user as tokens 
- * but still have a meaning when parsing JSON.
+ * Default allocator functions, using the memory handlers set globally with 
+ * vktor_set_memory_handlers()
  */
-typedef enum {
-	VKTOR_C_COMMA   = 1 << 16, /**< ",", used as struct separator */
-	VKTOR_C_COLON   = 1 << 17, /**< ":", used to separate object key:value */
-	VKTOR_C_DOT     = 1 << 18, /**< ".", used in floating-point numbers */ 
-	VKTOR_C_SIGNUM  = 1 << 19, /**< "+" or "-" used in numbers */
-	VKTOR_C_EXP     = 1 << 20, /**< "e" or "E" used for number exponent */
-	VKTOR_C_ESCAPED = 1 << 21, /**< An escaped character */
-	VKTOR_C_UNIC1   = 1 << 22, /**< Unicode encoded character (1st byte) */
-	VKTOR_C_UNIC2   = 1 << 23, /**< Unicode encoded character (2nd byte) */
-	VKTOR_C_UNIC3   = 1 << 24, /**< Unicode encoded character (3rd byte) */
-	VKTOR_C_UNIC4   = 1 << 25, /**< Unicode encoded character (4th byte) */
-	VKTOR_C_UNIC_LS = 1 << 26, /**< Unicode low surrogate */
-} vktor_specialchar;
-
-static vktor_malloc  vmalloc  = malloc;
-static vktor_free    vfree    = free;
-static vktor_realloc vrealloc = realloc;
+static void *
+default_malloc(void *ctx, size_t size)
+{
+	(void) ctx;
+	return global_malloc(size);
+}
+
+static void *
+default_realloc(void *ctx, void *pointer, size_t size)
+{
+	(void) ctx;
+	return global_realloc(pointer, size);
+}
+
+static void
+default_free(void *ctx, void *pointer)
+{
+	(void) ctx;
+	global_free(pointer);
+}
+
+const vktor_allocator vktor_default_allocator = {
+	default_malloc, 
+	default_realloc, 
+	default_free, 
+	NULL
+};
 
 /**
  * @brief Free a vktor_buffer struct
  * 
  * Free a vktor_buffer struct without following any next buffers in the chain. 
- * Call buffer_free_all() to free an entire chain of buffers.
+ * The buffer text is only freed if the buffer was fed with the free flag set,
+ * and buffers taken from the parser's buffer pool are returned to the pool.
+ * Call vktor_buffer_free_all() to free an entire chain of buffers.
  * 
+ * @param[in,out] parser the parser owning the buffer
  * @param[in,out] buffer the buffer to free
  */
 static void 
-buffer_free(vktor_buffer *buffer)
+buffer_free(vktor_parser *parser, vktor_buffer *buffer)
 {
 	assert(buffer != NULL);
 	assert(buffer->text != NULL);
 	
-	vfree(buffer->text);
-	vfree(buffer);
+	if (buffer->free) {
+		vfree(parser, buffer->text);
+	}
+	
+	if (buffer >= parser->buffer_pool && 
+	    buffer < parser->buffer_pool + VKTOR_BUFFER_POOL) {
+		parser->buffer_pool_used &= ~(1 << (buffer - parser->buffer_pool));
+	} else {
+		vfree(parser, buffer);
+	}
 }
 
 /**
@@ -259,18 +208,17 @@ buffer_free(vktor_buffer *buffer)
  * Free an entire linked list of vktor buffers. Will usually be called by 
  * vktor_parser_free() to free all buffers attached to a parser. 
  * 
+ * @param[in,out] parser the parser owning the buffers
  * @param[in,out] buffer the first buffer in the list to free
  */
-static void 
-buffer_free_all(vktor_buffer *buffer)
+void
+vktor_buffer_free_all(vktor_parser *parser, vktor_buffer *buffer)
 {
 	vktor_buffer *next;
 	
 	while (buffer != NULL) {
 		next = buffer->next_buff;
-		if (buffer->free) {
-			buffer_free(buffer);
-		}
+		buffer_free(parser, buffer);
 		buffer = next;
 	}
 }
@@ -281,58 +229,94 @@ buffer_free_all(vktor_buffer *buffer)
  * If eptr is NULL, will do nothing. Otherwise, will initialize a new error
  * struct with an error message and code, and set eptr to point to it. 
  * 
- * The error message is passed as an sprintf-style format and an arbitrary set
- * of parameters, just like sprintf() would be used. 
- * 
- * Used internally to pass error messages back to the user. 
+ * The error message is passed as a vsprintf-style format and argument list.
+ * The error struct and its message are allocated as a single block using the
+ * parser's allocator, which is kept alongside the error so it can be freed 
+ * later.
  * 
- * @param [in,out] eptr error struct pointer-pointer to populate or NULL
- * @param [in]     code error code
- * @param [in]     msg  error message (sprintf-style format)
+ * @param [in]     parser parser object the error occured in
+ * @param [in,out] eptr   error struct pointer-pointer to populate or NULL
+ * @param [in]     code   error code
+ * @param [in]     msg    error message (vsprintf-style format)
+ * @param [in]     ap     format arguments
  */
 static void 
-set_error(vktor_error **eptr, vktor_errcode code, const char *msg, ...)
+set_error_va(vktor_parser *parser, vktor_error **eptr, vktor_errcode code, 
+	const char *msg, va_list ap)
 {
-	vktor_error *err;
+	vktor_error_alloc *err;
 	
 	if (eptr == NULL) {
 		return;
 	}
 	
-	if ((err = vmalloc(sizeof(vktor_error))) == NULL) {
+	err = vmalloc(parser, sizeof(vktor_error_alloc) + VKTOR_MAX_E_LEN * sizeof(char));
+	if (err == NULL) {
 		return;
 	}
 	
-	err->code = code;
-	err->message = vmalloc(VKTOR_MAX_E_LEN * sizeof(char));
-	if (err->message != NULL) {
-		va_list ap;
-		      
-		va_start(ap, msg);
-		vsnprintf(err->message, VKTOR_MAX_E_LEN, msg, ap);
-		va_end(ap);
-	}
+	err->error.code    = code;
+	err->error.message = (char *) (err + 1);
+	err->allocator     = parser->allocator;
+	
+	vsnprintf(err->error.message, VKTOR_MAX_E_LEN, msg, ap);
+	
+	*eptr = &err->error;
+}
+
+/**
+ * @brief Initialize and populate new error struct
+ *
+ * Used internally to pass error messages back to the user. The error message
+ * is passed as an sprintf-style format and an arbitrary set of parameters, 
+ * just like sprintf() would be used. See set_error_va().
+ * 
+ * @param [in]     parser parser object the error occured in
+ * @param [in,out] eptr   error struct pointer-pointer to populate or NULL
+ * @param [in]     code   error code
+ * @param [in]     msg    error message (sprintf-style format)
+ */
+static void 
+set_error(vktor_parser *parser, vktor_error **eptr, vktor_errcode code, 
+	const char *msg, ...)
+{
+	va_list ap;
 	
-	*eptr = err;
+	va_start(ap, msg);
+	set_error_va(parser, eptr, code, msg, ap);
+	va_end(ap);
 }
 
 /**
  * @brief Initialize a vktor buffer struct
  * 
  * Initialize a vktor buffer struct and set it's associated text and other 
- * properties
+ * properties. The buffer is taken from the parser's buffer pool if there is a 
+ * free one, and only allocated on the heap otherwise. 
  * 
- * @param [in] text     buffer contents
- * @param [in] text_len the length of the buffer
- * @param [in] free     whether to free the buffer when done or not
- * @return A newly-allocated buffer struct
+ * @param [in,out] parser   the parser that will own the buffer
+ * @param [in]     text     buffer contents
+ * @param [in]     text_len the length of the buffer
+ * @param [in]     free     whether to free the buffer when done or not
+ * @return A newly-initialized buffer struct
  */
 static vktor_buffer*
-buffer_init(char *text, long text_len, char free)
+buffer_init(vktor_parser *parser, char *text, long text_len, char free)
 {
 	vktor_buffer *buffer;
+	int           i;
 	
-	if ((buffer = vmalloc(sizeof(vktor_buffer))) == NULL) {
+	for (i = 0; i < VKTOR_BUFFER_POOL; i++) {
+		if (! (parser->buffer_pool_used & (1 << i))) {
+			break;
+		}
+	}
+	
+	if (i < VKTOR_BUFFER_POOL) {
+		parser->buffer_pool_used |= (1 << i);
+		buffer = &parser->buffer_pool[i];
+		
+	} else if ((buffer = vmalloc(parser, sizeof(vktor_buffer))) == NULL) {
 		return NULL;
 	}
 	
@@ -345,6 +329,210 @@ buffer_init(char *text, long text_len, char free)
 	return buffer;
 }
 
+/**
+ * @brief Copy the unread data of a buffer chain into a single buffer
+ * 
+ * Copy the unread data of a chain of buffers into a single block owned by the 
+ * parser and replace the chain with it, so buffers fed by the user are no 
+ * longer referred to. Used by vktor_parser_hibernate(). A chain which already
+ * is a single unread block owned by the parser is left as is.
+ * 
+ * @param [in,out] parser parser owning the buffers
+ * @param [in,out] first  first buffer in the chain
+ * @param [in,out] last   last buffer in the chain
+ * @param [in,out] error  error struct pointer pointer or NULL
+ * 
+ * @return VKTOR_OK, or VKTOR_ERROR if memory can't be allocated, in which 
+ *         case the chain is left untouched
+ */
+static vktor_status
+buffer_compact(vktor_parser *parser, vktor_buffer **first, vktor_buffer **last,
+               vktor_error **error)
+{
+	vktor_buffer *buffer = *first, *tail_buffer = NULL;
+	char         *tail;
+	long          tail_size = 0, size;
+	
+	if (buffer == NULL || (buffer->next_buff == NULL && buffer->free && 
+	                       buffer->ptr == 0)) {
+		return VKTOR_OK;
+	}
+	
+	for (; buffer != NULL; buffer = buffer->next_buff) {
+		tail_size += buffer->size - buffer->ptr;
+	}
+	
+	if (tail_size > 0) {
+		if ((tail = vmalloc(parser, tail_size)) == NULL) {
+			set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+				"unable to allocate %ld bytes for unparsed data", tail_size);
+			return VKTOR_ERROR;
+		}
+		
+		tail_size = 0;
+		for (buffer = *first; buffer != NULL; buffer = buffer->next_buff) {
+			size = buffer->size - buffer->ptr;
+			memcpy(tail + tail_size, buffer->text + buffer->ptr, size);
+			tail_size += size;
+		}
+		
+		if ((tail_buffer = buffer_init(parser, tail, tail_size, 1)) == NULL) {
+			vfree(parser, tail);
+			set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+				"Unable to allocate memory buffer for %ld bytes", tail_size);
+			return VKTOR_ERROR;
+		}
+	}
+	
+	vktor_buffer_free_all(parser, *first);
+	*first = tail_buffer;
+	*last  = tail_buffer;
+	
+	return VKTOR_OK;
+}
+
+#ifdef HAVE_LIBZ
+/**
+ * @brief zlib allocation function using the parser's allocator
+ */
+static voidpf
+inflate_alloc(voidpf opaque, uInt items, uInt size)
+{
+	vktor_parser *parser = opaque;
+	
+	return vmalloc(parser, (size_t) items * size);
+}
+
+/**
+ * @brief zlib free function using the parser's allocator
+ */
+static void
+inflate_free(voidpf opaque, voidpf ptr)
+{
+	vktor_parser *parser = opaque;
+	
+	vfree(parser, ptr);
+}
+
+/**
+ * @brief Inflate compressed input into a new parser buffer
+ * 
+ * Inflate compressed data fed to the parser until a buffer of the inflate 
+ * chunk size is full or no compressed data is left, and append the buffer to
+ * the parser's buffer chain. Compressed buffers are freed as soon as they are
+ * inflated. Concatenated gzip members are inflated as a single stream. 
+ * 
+ * Errors are not returned but kept in the inflate status, and reported once 
+ * the parser runs out of data (see vktor_parse() and vktor_feed()). 
+ * 
+ * @param [in,out] parser parser object, with compressed input enabled
+ */
+static void
+parser_inflate(vktor_parser *parser)
+{
+	struct _vktor_inflate_struct *inf = parser->inflate;
+	vktor_buffer *input, *buffer;
+	char         *text = NULL;
+	long          produced = 0, avail;
+	int           zs;
+	
+	while (inf->input != NULL && inf->status >= 0) {
+		input = inf->input;
+		if (eobuffer(input)) {
+			inf->input = input->next_buff;
+			buffer_free(parser, input);
+			if (inf->input == NULL) {
+				inf->last_input = NULL;
+			}
+			continue;
+		}
+		
+		// More data after the end of a gzip member starts a new member
+		if (inf->status == Z_STREAM_END) {
+			inflateReset(&inf->stream);
+			inf->status = Z_OK;
+		}
+		
+		if (text == NULL && (text = vmalloc(parser, inf->chunk)) == NULL) {
+			inf->status = Z_MEM_ERROR;
+			break;
+		}
+		
+		avail = input->size - input->ptr;
+		inf->stream.next_in   = (Bytef *) input->text + input->ptr;
+		inf->stream.avail_in  = (uInt) avail;
+		inf->stream.next_out  = (Bytef *) text + produced;
+		inf->stream.avail_out = (uInt) (inf->chunk - produced);
+		
+		zs = inflate(&inf->stream, Z_NO_FLUSH);
+		
+		input->ptr += avail - inf->stream.avail_in;
+		inf->in    += avail - inf->stream.avail_in;
+		produced    = inf->chunk - inf->stream.avail_out;
+		
+		if (zs == Z_STREAM_END) {
+			inf->status = Z_STREAM_END;
+		} else if (zs == Z_NEED_DICT) {
+			inf->status = Z_DATA_ERROR;
+		} else if (zs != Z_OK && zs != Z_BUF_ERROR) {
+			inf->status = zs;
+		}
+		
+		if (produced == inf->chunk) {
+			break;
+		}
+	}
+	
+	if (produced == 0) {
+		if (text != NULL) {
+			vfree(parser, text);
+		}
+		return;
+	}
+	
+	if ((buffer = buffer_init(parser, text, produced, 1)) == NULL) {
+		vfree(parser, text);
+		inf->status = Z_MEM_ERROR;
+		return;
+	}
+	
+	parser->fed += produced;
+	inf->out    += produced;
+	
+	if (parser->last_buffer == NULL) {
+		parser->buffer = buffer;
+	} else {
+		parser->last_buffer->next_buff = buffer;
+	}
+	parser->last_buffer = buffer;
+}
+
+/**
+ * @brief Report an error which occured while inflating compressed input
+ * 
+ * @param [in]     parser parser object
+ * @param [in,out] error  error struct pointer pointer or NULL
+ * 
+ * @return VKTOR_ERROR
+ */
+static vktor_status
+parser_inflate_error(vktor_parser *parser, vktor_error **error)
+{
+	struct _vktor_inflate_struct *inf = parser->inflate;
+	
+	if (inf->status == Z_MEM_ERROR) {
+		set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+			"unable to allocate memory for inflated input");
+	} else {
+		set_error(parser, error, VKTOR_ERR_UNEXPECTED_INPUT, 
+			"invalid compressed input: %s", (inf->stream.msg != NULL ? 
+			inf->stream.msg : zError(inf->status)));
+	}
+	
+	return VKTOR_ERROR;
+}
+#endif
+
 /**
  * @brief Advance the parser to the next buffer
  * 
@@ -352,12 +540,13 @@ buffer_init(char *text, long text_len, char free)
  * when the end of the current buffer is reached, and more data is required. 
  * 
  * If no further buffers are available, will set vktor_parser->buffer and 
- * vktor_parser->last_buffer to NULL.
+ * vktor_parser->last_buffer to NULL, unless compressed input is enabled and 
+ * more of it can be inflated into a new buffer.
  * 
  * @param [in,out] parser The parser we are working with
  */
-static void 
-parser_advance_buffer(vktor_parser *parser)
+void
+vktor_parser_advance_buffer(vktor_parser *parser)
 {
 	vktor_buffer *next;
 	
@@ -365,13 +554,16 @@ parser_advance_buffer(vktor_parser *parser)
 	assert(eobuffer(parser->buffer));
 	
 	next = parser->buffer->next_buff;
-	if (parser->buffer->free) {
-		buffer_free(parser->buffer);
-	}
+	buffer_free(parser, parser->buffer);
 	parser->buffer = next;
 	
 	if (parser->buffer == NULL) {
 		parser->last_buffer = NULL;
+#ifdef HAVE_LIBZ
+		if (parser->inflate != NULL) {
+			parser_inflate(parser);
+		}
+#endif
 	}
 }
 
@@ -387,22 +579,51 @@ parser_advance_buffer(vktor_parser *parser)
  * @param [in]     token  New token type
  * @param [in]     value  New token value or NULL if no value
  */
-static void
-parser_set_token(vktor_parser *parser, vktor_token token, void *value)
+void
+vktor_parser_set_token(vktor_parser *parser, vktor_token token, void *value)
 {
 	parser->token_type = token;
 	if (parser->token_value != NULL) {
-		vfree(parser->token_value);
+		vfree(parser, parser->token_value);
 	}
 	parser->token_value = value;
 }
 
+/**
+ * @brief Allocate the state of an opt-in feature
+ * 
+ * Features which are not used by most parsers keep their state out of the 
+ * parser struct, and allocate it the first time they are used. The state is
+ * zeroed, and kept until the parser is freed or reset.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [in]     size   Size of the state
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return The allocated state, or NULL if out of memory
+ */
+void *
+vktor_parser_alloc_state(vktor_parser *parser, size_t size, vktor_error **error)
+{
+	void *state;
+	
+	if ((state = vmalloc(parser, size)) == NULL) {
+		set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+			"unable to allocate %d bytes for parser state", (int) size);
+		return NULL;
+	}
+	
+	memset(state, 0, size);
+	return state;
+}
+
 /**
  * @brief add a nesting level to the nesting stack
  * 
  * Add a nesting level to the nesting stack when a new array or object is 
  * encountered. Will make sure that the maximal nesting level is not 
- * overflowed.
+ * overflowed. The first VKTOR_NEST_INLINE levels are stored inside the parser
+ * struct; beyond that the stack is moved to the heap and grown geometrically.
  * 
  * @param [in,out] parser    Parser object
  * @param [in]     nest_type nesting type - array or object
@@ -410,20 +631,55 @@ parser_set_token(vktor_parser *parser, vktor_token token, void *value)
  * 
  * @return Status code - VKTOR_OK or VKTOR_ERROR
  */
-static vktor_status
-nest_stack_add(vktor_parser *parser, vktor_struct nest_type, 
+vktor_status
+vktor_nest_stack_add(vktor_parser *parser, vktor_struct nest_type, 
 	vktor_error **error)
 {
 	assert(parser != NULL);
 	
 	parser->nest_ptr++;
 	if (parser->nest_ptr >= parser->max_nest) {
-		set_error(error, VKTOR_ERR_MAX_NEST, 
+		set_error(parser, error, VKTOR_ERR_MAX_NEST, 
 			"maximal nesting level of %d reached", parser->max_nest);
 		return VKTOR_ERROR;
 	}
 	
-	parser->nest_stack[parser->nest_ptr] = nest_type;
+	if (parser->nest_ptr > parser->nest_size) {
+		unsigned char *stack;
+		int            size = parser->nest_size * 2;
+		
+		if (parser->nest_stack == parser->nest_inline) {
+			stack = vmalloc(parser, size / 8);
+			if (stack != NULL) {
+				memcpy(stack, parser->nest_inline, sizeof(parser->nest_inline));
+			}
+		} else {
+			stack = vrealloc(parser, parser->nest_stack, size / 8);
+		}
+		
+		if (stack == NULL) {
+			parser->nest_ptr--;
+			set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+				"unable to allocate %d bytes for nesting stack", size / 8);
+			return VKTOR_ERROR;
+		}
+		
+		parser->nest_stack = stack;
+		parser->nest_size  = size;
+	}
+	
+	if (nest_type == VKTOR_STRUCT_OBJECT) {
+		parser->nest_stack[(parser->nest_ptr - 1) >> 3] |= 
+			1 << ((parser->nest_ptr - 1) & 7);
+		
+		// Keys of a new object are matched from the start of the cached shape
+		if (parser->shape != NULL && parser->nest_ptr <= VKTOR_SHAPE_DEPTH) {
+			parser->shape->pos[parser->nest_ptr - 1] = 0;
+		}
+	} else {
+		parser->nest_stack[(parser->nest_ptr - 1) >> 3] &= 
+			~(1 << ((parser->nest_ptr - 1) & 7));
+	}
 	
 	return VKTOR_OK;
 }
@@ -439,15 +695,15 @@ nest_stack_add(vktor_parser *parser, vktor_struct nest_type,
  * 
  * @return Status code: VKTOR_OK or VKTOR_ERROR
  */
-static vktor_status
-nest_stack_pop(vktor_parser *parser, vktor_error **error)
+vktor_status
+vktor_nest_stack_pop(vktor_parser *parser, vktor_error **error)
 {
 	assert(parser != NULL);
-	assert(parser->nest_stack[parser->nest_ptr]);
+	assert(nest_stack_top(parser) != VKTOR_STRUCT_NONE);
 	
 	parser->nest_ptr--;
 	if (parser->nest_ptr < 0) {
-		set_error(error, VKTOR_ERR_INTERNAL_ERR, 
+		set_error(parser, error, VKTOR_ERR_INTERNAL_ERR, 
 			"internal parser error: nesting stack pointer underflow");
 		return VKTOR_ERROR;
 	}
@@ -462,6 +718,10 @@ nest_stack_pop(vktor_parser *parser, vktor_error **error)
  * escaped characters found along the way, and will gracefully handle buffer 
  * replacement. 
  * 
+ * If a string chunk size was set, string values reaching it are returned as a
+ * VKTOR_T_STRING_PART token, and the same token memory is reused for reading 
+ * the next part when resuming.
+ * 
  * Used by parser_read_string_token() and parser_read_objkey_token()
  * 
  * @param [in,out] parser Parser object
@@ -484,36 +744,59 @@ parser_read_string(vktor_parser *parser, vktor_error **error)
 	
 	// Allocate memory for reading the string
 	
+	ptr    = 0;
+	maxlen = 0;
+	token  = NULL;
+	
 	if (parser->token_resume) {
-		ptr = parser->token_size;
-		if (ptr < VKTOR_STR_MEMCHUNK) {
-			maxlen = VKTOR_STR_MEMCHUNK;
-			token = (void *) parser->token_value;
-			assert(token != NULL);
-		} else {
-			maxlen = ptr + VKTOR_STR_MEMCHUNK;
-			token = vrealloc(parser->token_value, sizeof(char) * maxlen);
-		}	
+		maxlen = parser->token_alloc;
+		token  = (char *) parser->token_value;
 		
-	} else {
-		token  = vmalloc(VKTOR_STR_MEMCHUNK * sizeof(char));
-		maxlen = VKTOR_STR_MEMCHUNK;
-		ptr    = 0;
+		// The memory of a delivered string part is reused for the next part
+		if (parser->token_type == VKTOR_T_STRING_PART) {
+			parser->token_type = VKTOR_T_STRING;
+		} else {
+			ptr = parser->token_size;
+		}
 	}
 	
-	if (token == NULL) {
-		set_error(error, VKTOR_ERR_OUT_OF_MEMORY, 
-			"unable to allocate %d bytes for string parsing", 
-			VKTOR_STR_MEMCHUNK);
-		return VKTOR_ERROR;
+	if (ptr + 5 >= maxlen) {
+		maxlen = ptr + VKTOR_STR_MEMCHUNK;
+		if (token == NULL) {
+			token = vmalloc(parser, maxlen * sizeof(char));
+		} else {
+			token = vrealloc(parser, token, maxlen * sizeof(char));
+		}
+		
+		if (token == NULL) {
+			set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+				"unable to allocate %d bytes for string parsing", maxlen);
+			return VKTOR_ERROR;
+		}
 	}
 	
+	// Keep the token in the parser, so it is freed even if reading fails
+	parser->token_value = (void *) token;
+	parser->token_alloc = maxlen;
+	
 	// Read string from buffer
 	
 	while (parser->buffer != NULL) {
 		while (! eobuffer(parser->buffer)) {
 			c = parser->buffer->text[parser->buffer->ptr];
 			
+			// Deliver a part of a long string value, unless in the middle of
+			// an escape sequence or at the end of the string
+			if (parser->string_chunk > 0 && ptr >= parser->string_chunk && 
+			    parser->token_type == VKTOR_T_STRING && 
+			    (parser->expected & VKTOR_T_STRING) && c != '"') {
+				token[ptr] = '\0';
+				parser->token_size   = ptr;
+				parser->token_type   = VKTOR_T_STRING_PART;
+				parser->token_resume = 1;
+				return VKTOR_OK;
+			}
+			
 			// Read an escaped character (previous char was '/')
 			if (parser->expected == VKTOR_C_ESCAPED) {
 				switch (c) {
@@ -574,6 +857,10 @@ parser_read_string(vktor_parser *parser, vktor_error **error)
 										   VKTOR_C_UNIC4)) {
 				
 				// Read an escaped unicode sequence
+				if (! isxdigit((unsigned char) c)) {
+					set_error_unexpected_c(error, c);
+					return VKTOR_ERROR;
+				}
 				c = vktor_unicode_hex_to_int((unsigned char) c);
 				switch(parser->expected) {
 					
@@ -594,7 +881,7 @@ parser_read_string(vktor_parser *parser, vktor_error **error)
 						
 					case VKTOR_C_UNIC4: 
 						parser->unicode_c = parser->unicode_c | c;
-						parser->expected = parser->expected = VKTOR_T_STRING;
+						parser->expected = VKTOR_T_STRING;
 						
 						if (VKTOR_UNICODE_HIGH_SURROGATE(parser->unicode_c)) {
 							// Expecting a low surrogate
@@ -654,7 +941,7 @@ parser_read_string(vktor_parser *parser, vktor_error **error)
 						break;
 						
 					default: // should not happen
-						set_error(error, VKTOR_ERR_INTERNAL_ERR, 
+						set_error(parser, error, VKTOR_ERR_INTERNAL_ERR, 
 							"internal parser error: expecing a Unicode sequence character");
 						return VKTOR_ERROR;
 						break;
@@ -662,19 +949,18 @@ parser_read_string(vktor_parser *parser, vktor_error **error)
 			
 			} else if (parser->expected == VKTOR_C_UNIC_LS) {
 				// Expecting another unicode character
-				switch(c) {
-					case '\\':
-						break;
-						
-					case 'u':
-						parser->expected = VKTOR_C_UNIC1;
-						break;
-					
-					default:
-						set_error_unexpected_c(error, c);
-						return VKTOR_ERROR;
-						break;
+				if (c != '\\') {
+					set_error_unexpected_c(error, c);
+					return VKTOR_ERROR;
+				}
+				parser->expected = VKTOR_C_UNIC_LU;
+				
+			} else if (parser->expected == VKTOR_C_UNIC_LU) {
+				if (c != 'u') {
+					set_error_unexpected_c(error, c);
+					return VKTOR_ERROR;
 				}
+				parser->expected = VKTOR_C_UNIC1;
 				
 			} else {
 				switch (c) {
@@ -717,7 +1003,7 @@ parser_read_string(vktor_parser *parser, vktor_error **error)
 		}
 		
 		if (done) break;
-		parser_advance_buffer(parser);
+		vktor_parser_advance_buffer(parser);
 	}
 	
 	parser->token_value = (void *) token;
@@ -751,14 +1037,14 @@ parser_read_string_token(vktor_parser *parser, vktor_error **error)
 	vktor_status status;
 	
 	if (! parser->token_resume) {
-		parser_set_token(parser, VKTOR_T_STRING, NULL);
+		vktor_parser_set_token(parser, VKTOR_T_STRING, NULL);
 	}
 	
 	// Read string	
 	status = parser_read_string(parser, error);
 	
-	// Set next expected token
-	if (status == VKTOR_OK) {
+	// Set next expected token, unless only a part of the string was read
+	if (status == VKTOR_OK && parser->token_type == VKTOR_T_STRING) {
 		expect_next_value_token(parser);
 	}
 	
@@ -766,28 +1052,153 @@ parser_read_string_token(vktor_parser *parser, vktor_error **error)
 }
 
 /**
- * @brief Read an object key token
+ * @brief Get the shape cache slot of the next object key
  * 
- * Read an object key using parser_read_string() and set the next expected 
- * token map accordingly
- * 
- * @param [in,out] parser Parser object
- * @param [out]    error  Error object pointer pointer or null
+ * @param [in] parser Parser object, with the shape cache enabled
  * 
- * @return Status code
+ * @return slot of the next key in the current object, or NULL if the object
+ *   is nested too deep or has too many keys to be cached
  */
-static vktor_status
-parser_read_objkey_token(vktor_parser *parser, vktor_error **error)
+static vktor_shape_key *
+shape_next_slot(vktor_parser *parser)
 {
-	vktor_status status;
+	int depth = parser->nest_ptr - 1;
 	
-	assert(nest_stack_in(parser, VKTOR_STRUCT_OBJECT));
+	if (depth >= VKTOR_SHAPE_DEPTH || 
+	    parser->shape->pos[depth] >= VKTOR_SHAPE_KEYS) {
+		return NULL;
+	}
 	
-	// Expecting a string
-	parser->expected = VKTOR_T_STRING;
+	return &parser->shape->keys[depth][parser->shape->pos[depth]];
+}
+
+/**
+ * @brief Look up the next object key in the shape cache
+ * 
+ * Check if the input right after the opening quote of an object key is the 
+ * key cached at the same position of the previous object, followed by the 
+ * closing quote. Only keys without escape sequences are cached, so the key 
+ * is read as is from the input. 
+ * 
+ * @param [in] parser Parser object, with the shape cache enabled
+ * @param [in] str    Position in the input after the opening quote
+ * @param [in] end    End of the available input
+ * 
+ * @return the cached key, or NULL on a cache miss
+ */
+static vktor_shape_key *
+shape_lookup(vktor_parser *parser, const char *str, const char *end)
+{
+	vktor_shape_key *slot = shape_next_slot(parser);
+	
+	if (slot == NULL || slot->len < 0 || end - str <= slot->len || 
+	    str[slot->len] != '"' || memcmp(str, slot->key, slot->len) != 0) {
+		return NULL;
+	}
+	
+	return slot;
+}
+
+/**
+ * @brief Update the shape cache after reading an object key
+ * 
+ * Count a cache hit, or a miss in which case the key just read replaces the
+ * cached key, and move on to the next key of the current object.
+ * 
+ * @param [in,out] parser Parser object, with the shape cache enabled
+ * @param [in]     hit    Cached key found by shape_lookup(), or NULL
+ */
+static void
+shape_update(vktor_parser *parser, vktor_shape_key *hit)
+{
+	vktor_shape_key *slot = shape_next_slot(parser);
+	unsigned char   *c;
+	int              i;
+	
+	parser->key_id = -1;
+	
+	if (hit != NULL) {
+		parser->shape->hits++;
+		parser->key_id = parser->shape->pos[parser->nest_ptr - 1]++;
+		return;
+	}
+	
+	parser->shape->misses++;
+	if (slot == NULL) {
+		return;
+	}
+	parser->shape->pos[parser->nest_ptr - 1]++;
+	
+	// Keys which would need escaping in the input are not cached
+	slot->len = -1;
+	if (parser->token_size > VKTOR_SHAPE_KEYLEN) {
+		return;
+	}
+	
+	c = (unsigned char *) parser->token_value;
+	for (i = 0; i < parser->token_size; i++) {
+		if (c[i] < 0x20 || c[i] == '"' || c[i] == '\\') {
+			return;
+		}
+	}
+	
+	memcpy(slot->key, c, parser->token_size);
+	slot->key[parser->token_size] = '\0';
+	slot->len = parser->token_size;
+}
+
+/**
+ * @brief Read an object key token
+ * 
+ * Read an object key using parser_read_string() and set the next expected 
+ * token map accordingly. If the shape cache is enabled, the key is first 
+ * looked up in it, and on a hit copied without being decoded.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [out]    error  Error object pointer pointer or null
+ * 
+ * @return Status code
+ */
+static vktor_status
+parser_read_objkey_token(vktor_parser *parser, vktor_error **error)
+{
+	vktor_status     status;
+	vktor_shape_key *slot;
+	char            *token;
+	
+	assert(nest_stack_in(parser, VKTOR_STRUCT_OBJECT));
 	
 	if (! parser->token_resume) {
-		parser_set_token(parser, VKTOR_T_OBJECT_KEY, NULL);
+		// Expecting a string - when resuming, expected holds the state of a
+		// partially read escape sequence
+		parser->expected = VKTOR_T_STRING;
+		vktor_parser_set_token(parser, VKTOR_T_OBJECT_KEY, NULL);
+		
+		if (parser->shape != NULL && (slot = shape_lookup(parser, 
+		    parser->buffer->text + parser->buffer->ptr, 
+		    parser->buffer->text + parser->buffer->size)) != NULL) {
+			if ((token = vmalloc(parser, slot->len + 1)) == NULL) {
+				set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+					"unable to allocate %d bytes for string parsing", 
+					slot->len + 1);
+				return VKTOR_ERROR;
+			}
+			memcpy(token, slot->key, slot->len + 1);
+			
+			parser->token_value = (void *) token;
+			parser->token_size  = slot->len;
+			parser->token_alloc = slot->len + 1;
+			
+			// Skip the key and its closing quote
+			parser->buffer->ptr += slot->len + 1;
+#ifdef BYTECOUNTER
+			parser->bytecounter += slot->len + 1;
+#endif
+			
+			shape_update(parser, slot);
+			parser->expected = VKTOR_C_COLON;
+			return VKTOR_OK;
+		}
 	}
 	
 	// Read string	
@@ -795,6 +1206,9 @@ parser_read_objkey_token(vktor_parser *parser, vktor_error **error)
 	
 	// Set next expected token
 	if (status == VKTOR_OK) {
+		if (parser->shape != NULL) {
+			shape_update(parser, NULL);
+		}
 		parser->expected = VKTOR_C_COLON;
 	}
 	
@@ -842,7 +1256,7 @@ parser_read_expectedstr(vktor_parser *parser, const char *expect, int explen,
 		}
 		
 		if (eobuffer(parser->buffer)) {
-			parser_advance_buffer(parser);
+			vktor_parser_advance_buffer(parser);
 			if (parser->buffer == NULL) {
 				parser->token_resume = 1;
 				return VKTOR_MORE_DATA;
@@ -881,7 +1295,7 @@ parser_read_null(vktor_parser *parser, vktor_error **error)
 	vktor_status st = parser_read_expectedstr(parser, "null", 4, error);
 	
 	if (st != VKTOR_ERROR) {
-		parser_set_token(parser, VKTOR_T_NULL, NULL);
+		vktor_parser_set_token(parser, VKTOR_T_NULL, NULL);
 		if (st == VKTOR_OK) {
 			// Set the next expected token
 			expect_next_value_token(parser);
@@ -908,7 +1322,7 @@ parser_read_true(vktor_parser *parser, vktor_error **error)
 	vktor_status st = parser_read_expectedstr(parser, "true", 4, error);
 	
 	if (st != VKTOR_ERROR) {
-		parser_set_token(parser, VKTOR_T_TRUE, NULL);
+		vktor_parser_set_token(parser, VKTOR_T_TRUE, NULL);
 		if (st == VKTOR_OK) {
 			// Set the next expected token
 			expect_next_value_token(parser);
@@ -935,7 +1349,7 @@ parser_read_false(vktor_parser *parser, vktor_error **error)
 	vktor_status st = parser_read_expectedstr(parser, "false", 5, error);
 	
 	if (st != VKTOR_ERROR) {
-		parser_set_token(parser, VKTOR_T_FALSE, NULL);
+		vktor_parser_set_token(parser, VKTOR_T_FALSE, NULL);
 		if (st == VKTOR_OK) {
 			// Set the next expected token
 			expect_next_value_token(parser);
@@ -966,22 +1380,16 @@ parser_read_number_token(vktor_parser *parser, vktor_error **error)
 	
 	assert(parser != NULL);
 	
+	ptr    = 0;
+	maxlen = 0;
+	token  = NULL;
+	
 	if (parser->token_resume) {
-		ptr = parser->token_size;
-		if (ptr < VKTOR_NUM_MEMCHUNK) {
-			maxlen = VKTOR_NUM_MEMCHUNK;
-			token = (void *) parser->token_value;
-			assert(token != NULL);
-		} else {
-			maxlen = ptr + VKTOR_NUM_MEMCHUNK;
-			token = vrealloc(parser->token_value, sizeof(char) * maxlen);
-		}
+		ptr    = parser->token_size;
+		maxlen = parser->token_alloc;
+		token  = (char *) parser->token_value;
 		
 	} else {
-		token  = vmalloc(VKTOR_NUM_MEMCHUNK * sizeof(char));
-		maxlen = VKTOR_NUM_MEMCHUNK;
-		ptr    = 0;
-		
 		// Reading a new token - set possible expected characters
 		parser->expected = VKTOR_T_INT    | 
 		                   VKTOR_T_FLOAT  | 
@@ -990,16 +1398,28 @@ parser_read_number_token(vktor_parser *parser, vktor_error **error)
 				   VKTOR_C_SIGNUM;
 						   
 		// Free previous token and set token type to INT until proven otherwise 
-		parser_set_token(parser, VKTOR_T_INT, NULL);
+		vktor_parser_set_token(parser, VKTOR_T_INT, NULL);
 	}
 	
-	if (token == NULL) {
-		set_error(error, VKTOR_ERR_OUT_OF_MEMORY, 
-			"unable to allocate %d bytes for string parsing", 
-			VKTOR_NUM_MEMCHUNK);
-		return VKTOR_ERROR;
+	if (ptr + 5 >= maxlen) {
+		maxlen = ptr + VKTOR_NUM_MEMCHUNK;
+		if (token == NULL) {
+			token = vmalloc(parser, maxlen * sizeof(char));
+		} else {
+			token = vrealloc(parser, token, maxlen * sizeof(char));
+		}
+		
+		if (token == NULL) {
+			set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+				"unable to allocate %d bytes for number parsing", maxlen);
+			return VKTOR_ERROR;
+		}
 	}
 	
+	// Keep the token in the parser, so it is freed even if reading fails
+	parser->token_value = (void *) token;
+	parser->token_alloc = maxlen;
+	
 	while (parser->buffer != NULL) {
 		while (! eobuffer(parser->buffer)) {
 			c = parser->buffer->text[parser->buffer->ptr];
@@ -1106,7 +1526,7 @@ parser_read_number_token(vktor_parser *parser, vktor_error **error)
 		}
 		
 		if (done) break;
-		parser_advance_buffer(parser);
+		vktor_parser_advance_buffer(parser);
 	}
 	
 	parser->token_value = (void *) token;
@@ -1124,430 +1544,3123 @@ parser_read_number_token(vktor_parser *parser, vktor_error **error)
 	}
 }
 
-/** @} */ // end of internal PAI
+/**
+ * Convenience macro to set an 'unexpected character' error when reading 
+ * complete input, making sure the parser position is up to date first
+ */
+#define complete_error_unexpected_c(p, pos)          \
+	{                                            \
+		vktor_complete_set_position(p, pos); \
+		set_error_unexpected_c(error, *pos); \
+		return VKTOR_ERROR;                  \
+	}
 
 /**
- * External API
+ * @brief Save the current position in complete input
  * 
- * @defgroup external External API
- * @{
+ * @param [in,out] parser Parser object
+ * @param [in]     pos    Current position
  */
+void
+vktor_complete_set_position(vktor_parser *parser, char *pos)
+{
+	parser->complete_ptr = pos;
+#ifdef BYTECOUNTER
+	parser->bytecounter = pos - parser->complete_text;
+#endif
+}
 
 /**
- * @brief Set memory handling function implementation
- *
- * Allows one to set alternative implementations of malloc, realloc and free. If 
- * set, the alternative implementations will be used by vktor globally to manage
- * memory. Since this has global effect it is recommended to set this once before
- * doing anything with vktor, and not to change this.
- *
- * You can pass NULL as any of the functions, in which case the standard malloc, 
- * realloc or free will be used.
- *
- * @param [in] vmalloc  malloc implementation
- * @param [in] vrealloc realloc implementation
- * @param [in] free     free implementation
+ * @brief Get the token memory of a parser reading complete input
+ * 
+ * Make sure the token memory reused for all tokens read from complete input is
+ * at least size bytes long, growing it geometrically if needed.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [in]     size   Required size in bytes
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Token memory or NULL if it could not be allocated
  */
-void 
-vktor_set_memory_handlers(vktor_malloc vmallocf, vktor_realloc vreallocf, 
-                          vktor_free vfreef)
+static char *
+complete_token_buff(vktor_parser *parser, long size, vktor_error **error)
 {
-	vmalloc  = (vmallocf  == NULL ? malloc  : vmallocf);
-	vrealloc = (vreallocf == NULL ? realloc : vreallocf);
-	vfree    = (vfreef    == NULL ? free    : vfreef);
+	long  newsize;
+	char *buff;
+	
+	if (size > parser->token_buff_size) {
+		newsize = parser->token_buff_size * 2;
+		if (newsize < size) {
+			newsize = (size < VKTOR_STR_MEMCHUNK ? VKTOR_STR_MEMCHUNK : size);
+		}
+		
+		// Token memory in caller provided memory is never reallocated
+		buff = (parser->token_buff_free ? 
+			vrealloc(parser, parser->token_buff, newsize) : vmalloc(parser, newsize));
+		if (buff == NULL) {
+			set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+				"unable to allocate %ld bytes for token" LINEINFO, newsize);
+			return NULL;
+		}
+		
+		parser->token_buff      = buff;
+		parser->token_buff_size = newsize;
+		parser->token_buff_free = 1;
+	}
+	
+	return parser->token_buff;
 }
 
 /**
- * @brief Initialize a new parser 
+ * @brief Read a string token from complete input
  * 
- * Initialize and return a new parser struct. Will return NULL if memory can't 
- * be allocated.
+ * Read a string starting right after the opening double-quote. The end of the
+ * string is found first, so the token memory is only checked once and strings
+ * without escape sequences are copied as is. 
  * 
- * @param [in] max_nest maximal nesting level
+ * Used by parser_parse_complete() for both string values and object keys.
  * 
- * @return a newly allocated parser
+ * @param [in,out] parser Parser object
+ * @param [in,out] pp     Position pointer, set to after the closing quote
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code - VKTOR_OK or VKTOR_ERROR
  */
-vktor_parser*
-vktor_parser_init(int max_nest)
+static vktor_status
+complete_read_string(vktor_parser *parser, char **pp, vktor_error **error)
 {
-	vktor_parser *parser;
+	char           *p = *pp, *end = parser->complete_end, *str;
+	char           *token;
+	unsigned char   utf8[5];
+	unsigned short  cp, low;
+	int             escaped = 0, ptr = 0, l, i;
 	
-	if ((parser = vmalloc(sizeof(vktor_parser))) == NULL) {
-		return NULL;
+	// Find the end of the string
+	for (str = p; p < end && *p != '"'; p++) {
+		if (*p == '\\') {
+			escaped = 1;
+			if (++p == end) break;
+			
+			// Fail on invalid escape sequences as early as the streaming 
+			// parser would
+			if (strchr("\"\\/bfnrtu", *p) == NULL || *p == '\0') {
+				complete_error_unexpected_c(parser, p);
+			}
+			
+		} else if (*p >= 0 && *p <= 0x1f) {
+			// Unicode control characters must be escaped
+			complete_error_unexpected_c(parser, p);
+		}
+	}
+	
+	if (p == end) {
+		complete_error_incomplete(parser, p);
+	}
+	
+	// Escape sequences only make strings shorter
+	if ((token = complete_token_buff(parser, p - str + 1, error)) == NULL) {
+		return VKTOR_ERROR;
 	}
+	
+	if (! escaped) {
+		memcpy(token, str, p - str);
+		ptr = p - str;
 		
-	parser->buffer       = NULL;
-	parser->last_buffer  = NULL;
-	parser->token_type   = VKTOR_T_NONE;
-	parser->token_value  = NULL;
-	parser->token_resume = 0;
-	parser->unicode_c    = 0;
+	} else {
+		for (end = p, p = str; p < end; p++) {
+			if (*p != '\\') {
+				token[ptr++] = *p;
+				continue;
+			}
+			
+			switch (*(++p)) {
+				case '"':
+				case '\\':
+				case '/':
+					token[ptr++] = *p;
+					break;
+					
+				case 'b': token[ptr++] = '\b'; break;
+				case 'f': token[ptr++] = '\f'; break;
+				case 'n': token[ptr++] = '\n'; break;
+				case 'r': token[ptr++] = '\r'; break;
+				case 't': token[ptr++] = '\t'; break;
+				
+				case 'u':
+					// Read an escaped unicode character, and possibly 
+					// its low surrogate 
+					for (cp = 0, i = 0; i < 4; i++) {
+						if (++p == end || ! isxdigit((unsigned char) *p)) {
+							complete_error_unexpected_c(parser, p);
+						}
+						cp = (cp << 4) | vktor_unicode_hex_to_int((unsigned char) *p);
+					}
+					
+					if (VKTOR_UNICODE_HIGH_SURROGATE(cp)) {
+						if (end - p < 7 || p[1] != '\\' || p[2] != 'u') {
+							complete_error_unexpected_c(parser, p + 1);
+						}
+						
+						for (p += 2, low = 0, i = 0; i < 4; i++) {
+							if (! isxdigit((unsigned char) *(++p))) {
+								complete_error_unexpected_c(parser, p);
+							}
+							low = (low << 4) | vktor_unicode_hex_to_int((unsigned char) *p);
+						}
+						
+						if (! VKTOR_UNICODE_LOW_SURROGATE(low)) {
+							complete_error_unexpected_c(parser, p);
+						}
+						l = vktor_unicode_sp_to_utf8(cp, low, utf8);
+						
+					} else {
+						l = vktor_unicode_cp_to_utf8(cp, utf8);
+					}
+					
+					if (l == 0) {
+						// invalid Unicode character
+						complete_error_unexpected_c(parser, p);
+					}
+					
+					for (i = 0; i < l; i++) {
+						token[ptr++] = utf8[i];
+					}
+					break;
+					
+				default:
+					complete_error_unexpected_c(parser, p);
+					break;
+			}
+		}
+	}
 	
-	// set expectated tokens
-	parser->expected   = VKTOR_VALUE_TOKEN;
-
-	// set up nesting stack
-	parser->nest_stack   = vmalloc(sizeof(vktor_struct) * max_nest);
-	parser->nest_ptr     = 0;
-	parser->max_nest     = max_nest;
+	token[ptr] = '\0';
+	parser->token_value = token;
+	parser->token_size  = ptr;
 	
-#ifdef BYTECOUNTER
-	parser->bytecounter = 0;
-#endif
-
-	return parser;
+	// Skip the closing quote
+	*pp = p + 1;
+	return VKTOR_OK;
 }
 
 /**
- * @brief Feed the parser's internal buffer with more JSON data
+ * @brief Read a number token from complete input
  * 
- * Feed the parser's internal buffer with more JSON data, to be used later when 
- * parsing. This function should be called before starting to parse at least
- * once, and again whenever new data is available and the VKTOR_MORE_DATA 
- * status is returned from vktor_parse().
+ * Read a number token, accepting exactly the same input as 
+ * parser_read_number_token(). Will set the token type to VKTOR_T_INT or 
+ * VKTOR_T_FLOAT accordingly.
  * 
- * @param [in] parser   parser object
- * @param [in] text     text to add to buffer
- * @param [in] text_len length of text to add to buffer
- * @param [in] char     whether to free the buffer when done (1) or not (0)
- * @param [in,out] err  pointer to an unallocated error struct to return any 
- *                      errors, or NULL if there is no need for error handling
+ * @param [in,out] parser Parser object
+ * @param [in,out] pp     Position pointer, set to after the number
+ * @param [out]    error  Error object pointer pointer or NULL
  * 
- * @return vktor status code 
- *  - VKTOR_OK on success 
- *  - VKTOR_ERROR otherwise
+ * @return Status code - VKTOR_OK or VKTOR_ERROR
  */
-vktor_status 
-vktor_feed(vktor_parser *parser, char *text, long text_len, 
-           char free, vktor_error **err) 
+static vktor_status
+complete_read_number(vktor_parser *parser, char **pp, vktor_error **error)
 {
-	vktor_buffer *buffer;
+	char        *p = *pp, *end = parser->complete_end, *token;
+	long         expected = VKTOR_C_DOT | VKTOR_C_EXP | VKTOR_C_SIGNUM;
+	vktor_token  type = VKTOR_T_INT;
+	int          len, exp = -1;
 	
-	// Create buffer
-	if ((buffer = buffer_init(text, text_len, free)) == NULL) {
-		set_error(err, VKTOR_ERR_OUT_OF_MEMORY, 
-			"Unable to allocate memory buffer for %ld bytes", text_len);
+	for (; p < end; p++) {
+		if (*p >= '0' && *p <= '9') {
+			expected &= ~VKTOR_C_SIGNUM;
+			
+		} else if (*p == '.') {
+			if (! (expected & VKTOR_C_DOT && p > *pp)) {
+				complete_error_unexpected_c(parser, p);
+			}
+			expected &= ~VKTOR_C_DOT;
+			type = VKTOR_T_FLOAT;
+			
+		} else if (*p == '-' || *p == '+') {
+			if (! (expected & VKTOR_C_SIGNUM)) {
+				complete_error_unexpected_c(parser, p);
+			}
+			expected &= ~VKTOR_C_SIGNUM;
+			
+		} else if (*p == 'e' || *p == 'E') {
+			if (! (expected & VKTOR_C_EXP && p > *pp) || 
+			    p[-1] == '.' || p[-1] == '+' || p[-1] == '-') {
+				complete_error_unexpected_c(parser, p);
+			}
+			expected = (expected & ~(VKTOR_C_EXP | VKTOR_C_DOT)) | VKTOR_C_SIGNUM;
+			type = VKTOR_T_FLOAT;
+			exp = p - *pp;
+			
+		} else {
+			break;
+		}
+	}
+	
+	// Check that we are not expecting more digits
+	switch (p[-1]) {
+		case 'e':
+		case 'E':
+		case '.':
+		case '+':
+		case '-':
+			if (p == end) {
+				complete_error_incomplete(parser, p);
+			}
+			complete_error_unexpected_c(parser, p);
+			break;
+	}
+	
+	len = p - *pp;
+	if ((token = complete_token_buff(parser, len + 1, error)) == NULL) {
 		return VKTOR_ERROR;
 	}
 	
-	// Link buffer to end of parser buffer chain
-	if (parser->last_buffer == NULL) {
-		assert(parser->buffer == NULL);
-		parser->buffer = buffer;
-		parser->last_buffer = buffer;
-	} else {
-		parser->last_buffer->next_buff = buffer;
-		parser->last_buffer = buffer;
+	memcpy(token, *pp, len);
+	token[len] = '\0';
+	if (exp >= 0) {
+		token[exp] = 'e';
 	}
 	
+	parser->token_type  = type;
+	parser->token_value = token;
+	parser->token_size  = len;
+	
+	*pp = p;
 	return VKTOR_OK;
 }
 
 /**
- * @brief Parse some JSON text and return on the next token
+ * @brief Read an expected token from complete input
  * 
- * Parse the text buffer until the next JSON token is encountered
+ * Used to read true, false, and null tokens from complete input.
  * 
- * In case of error, if error is not NULL, it will be populated with error 
- * information, and VKTOR_ERROR will be returned
+ * @param [in,out] parser Parser object
+ * @param [in,out] pp     Position pointer, set to after the token
+ * @param [in]     expect Expected token as string
+ * @param [in]     explen Expected token length
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code - VKTOR_OK or VKTOR_ERROR
+ */
+static vktor_status
+complete_read_expectedstr(vktor_parser *parser, char **pp, const char *expect,
+	int explen, vktor_error **error)
+{
+	char *p = *pp;
+	int   i;
+	
+	for (i = 0; i < explen; i++, p++) {
+		if (p == parser->complete_end) {
+			complete_error_incomplete(parser, p);
+		}
+		if (*p != expect[i]) {
+			complete_error_unexpected_c(parser, p);
+		}
+	}
+	
+	*pp = p;
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Parse complete input and return on the next token
+ * 
+ * The vktor_parse() implementation used for parsers fed with 
+ * vktor_feed_complete(). Accepts exactly the same input as the streaming 
+ * parser, but since the entire input is known to be available tokens are read
+ * in one go without any of the token resume logic.
  * 
  * @param [in,out] parser The parser object to work with
  * @param [out]    error  A vktor_error pointer pointer, or NULL
  * 
  * @return status code:
  *  - VKTOR_OK        if a token was encountered
- *  - VKTOR_ERROR     if an error has occured
- *  - VKTOR_MORE_DATA if we need more data in order to continue parsing
- *  - VKTOR_COMPLETE  if parsing is complete and no further data is expected
+ *  - VKTOR_ERROR     if an error has occured, including unexpected end of input
+ *  - VKTOR_COMPLETE  if parsing is complete
  */
-vktor_status 
-vktor_parse(vktor_parser *parser, vktor_error **error)
+static vktor_status
+parser_parse_complete(vktor_parser *parser, vktor_error **error)
 {
-	char c;
-	int  done;
+	char            *p = parser->complete_ptr, *end = parser->complete_end;
+	char            *token;
+	vktor_status     status;
+	vktor_shape_key *slot = NULL;
 	
-	assert(parser != NULL);
+	// Token values point to the reused token memory and are never freed
+	parser->token_value = NULL;
 	
-	// Do we have a buffer to work with?
-	while (parser->buffer != NULL) {
-		done = 0;
-		
-		// Do we need to continue reading the previous token?
-		if (parser->token_resume) {
-						
-		    switch (parser->token_type) {
-		    	case VKTOR_T_OBJECT_KEY:
-		    		return parser_read_objkey_token(parser, error);
-		    		break;
-		    		
-		    	case VKTOR_T_STRING:
-		    		return parser_read_string_token(parser, error);
-		    		break;
-		    	
-				case VKTOR_T_NULL:
-					return parser_read_null(parser, error);
-					break;
-					
-				case VKTOR_T_TRUE:
-					return parser_read_true(parser, error);
-					break;
+	for (; p < end; p++) {
+		switch (*p) {
+			case ' ':
+			case '\n':
+			case '\r':
+			case '\t':
+			case '\f':
+			case '\v':
+				// Whitespace
+				continue;
 				
-				case VKTOR_T_FALSE:
-					return parser_read_false(parser, error);
-					break;
+			case '{':
+				if (! (parser->expected & VKTOR_T_OBJECT_START)) {
+					complete_error_unexpected_c(parser, p);
+				}
 				
-				case VKTOR_T_INT:
-				case VKTOR_T_FLOAT:
-					return parser_read_number_token(parser, error);
-					break;
-					
-		    	default:
-		    		set_error(error, VKTOR_ERR_INTERNAL_ERR, 
-		    			"token resume flag is set but token type %d is unexpected",
-		    			parser->token_type);
-		    		return VKTOR_ERROR;
-		    		break;
-		    }
-		}
-		
-		while (! eobuffer(parser->buffer)) {
-			c = parser->buffer->text[parser->buffer->ptr];
-			
-			switch (c) {
-				case '{':
-					if (! parser->expected & VKTOR_T_OBJECT_START) {
-						set_error_unexpected_c(error, c);
-						return VKTOR_ERROR;
-					}
-					
-					if (nest_stack_add(parser, VKTOR_STRUCT_OBJECT, error) == VKTOR_ERROR) {
-						return VKTOR_ERROR;
-					}
-					
-					parser_set_token(parser, VKTOR_T_OBJECT_START, NULL);
-					
-					// Expecting: object key or object end
-					parser->expected = VKTOR_T_OBJECT_KEY |
-					                   VKTOR_T_OBJECT_END;
+				if (vktor_nest_stack_add(parser, VKTOR_STRUCT_OBJECT, error) == VKTOR_ERROR) {
+					return VKTOR_ERROR;
+				}
+				
+				parser->token_type = VKTOR_T_OBJECT_START;
+				parser->expected   = VKTOR_T_OBJECT_KEY | VKTOR_T_OBJECT_END;
+				break;
+				
+			case '[':
+				if (! (parser->expected & VKTOR_T_ARRAY_START)) {
+					complete_error_unexpected_c(parser, p);
+				}
+				
+				if (vktor_nest_stack_add(parser, VKTOR_STRUCT_ARRAY, error) == VKTOR_ERROR) {
+					return VKTOR_ERROR;
+				}
+				
+				parser->token_type = VKTOR_T_ARRAY_START;
+				parser->expected   = VKTOR_VALUE_TOKEN | VKTOR_T_ARRAY_END;
+				break;
+				
+			case '"':
+				if (parser->expected & VKTOR_T_OBJECT_KEY) {
+					assert(nest_stack_in(parser, VKTOR_STRUCT_OBJECT));
+					parser->token_type = VKTOR_T_OBJECT_KEY;
 					
-					done = 1;
-					break;
+				} else if (parser->expected & VKTOR_T_STRING) {
+					parser->token_type = VKTOR_T_STRING;
 					
-				case '[':
-					if (! parser->expected & VKTOR_T_ARRAY_START) {
-						set_error_unexpected_c(error, c);
+				} else {
+					complete_error_unexpected_c(parser, p);
+				}
+				
+				p++;
+				if (parser->token_type == VKTOR_T_OBJECT_KEY && 
+				    parser->shape != NULL && 
+				    (slot = shape_lookup(parser, p, end)) != NULL) {
+					// The key is the cached key of the same position
+					if ((token = complete_token_buff(parser, slot->len + 1, 
+					     error)) == NULL) {
 						return VKTOR_ERROR;
 					}
+					memcpy(token, slot->key, slot->len + 1);
+					parser->token_value = token;
+					parser->token_size  = slot->len;
+					p += slot->len + 1;
 					
-					if (nest_stack_add(parser, VKTOR_STRUCT_ARRAY, error) == VKTOR_ERROR) {
-						return VKTOR_ERROR;
+				} else if (complete_read_string(parser, &p, error) == VKTOR_ERROR) {
+					return VKTOR_ERROR;
+				}
+				
+				if (parser->token_type == VKTOR_T_OBJECT_KEY) {
+					if (parser->shape != NULL) {
+						shape_update(parser, slot);
 					}
-					
-					parser_set_token(parser, VKTOR_T_ARRAY_START, NULL);
-					
-					// Expecting: any value or array end
-					parser->expected = VKTOR_VALUE_TOKEN | 
+					parser->expected = VKTOR_C_COLON;
+				} else {
+					expect_next_value_token(parser);
+				}
+				
+				vktor_complete_set_position(parser, p);
+				return VKTOR_OK;
+				
+			case ',':
+				if (! (parser->expected & VKTOR_C_COMMA)) {
+					complete_error_unexpected_c(parser, p);
+				}
+				
+				if (nest_stack_in(parser, VKTOR_STRUCT_OBJECT)) {
+					parser->expected = VKTOR_T_OBJECT_KEY;
+				} else {
+					parser->expected = VKTOR_VALUE_TOKEN;
+				}
+				continue;
+				
+			case ':':
+				if (! (parser->expected & VKTOR_C_COLON)) {
+					complete_error_unexpected_c(parser, p);
+				}
+				
+				parser->expected = VKTOR_VALUE_TOKEN;
+				continue;
+				
+			case '}':
+				if (! (parser->expected & VKTOR_T_OBJECT_END &&
+				       nest_stack_in(parser, VKTOR_STRUCT_OBJECT))) {
+					complete_error_unexpected_c(parser, p);
+				}
+				
+				parser->token_type = VKTOR_T_OBJECT_END;
+				goto struct_end;
+				
+			case ']':
+				if (! (parser->expected & VKTOR_T_ARRAY_END &&
+				       nest_stack_in(parser, VKTOR_STRUCT_ARRAY))) {
+					complete_error_unexpected_c(parser, p);
+				}
+				
+				parser->token_type = VKTOR_T_ARRAY_END;
+				
+			struct_end:
+				if (vktor_nest_stack_pop(parser, error) == VKTOR_ERROR) {
+					return VKTOR_ERROR;
+				}
+				
+				if (parser->nest_ptr > 0) {
+					parser->expected = VKTOR_C_COMMA      | 
+					                   VKTOR_T_OBJECT_END | 
 					                   VKTOR_T_ARRAY_END;
-					
-					done = 1;
-					break;
-					
-				case '"':
-					if (! (parser->expected & (VKTOR_T_STRING | 
-					                           VKTOR_T_OBJECT_KEY))) {
-						set_error_unexpected_c(error, c);
-						return VKTOR_ERROR;
-					}
+				} else {
+					parser->expected = VKTOR_T_NONE;
+				}
+				break;
 				
-					INCREMENT_BUFFER_PTR(parser);
-					
-					if (parser->expected & VKTOR_T_OBJECT_KEY) {
-						return parser_read_objkey_token(parser, error);
-					} else {
-						return parser_read_string_token(parser, error);
-					}
-					
-					break;
+			case 't':
+			case 'f':
+			case 'n':
+				parser->token_type = (*p == 't' ? VKTOR_T_TRUE : 
+				                     (*p == 'f' ? VKTOR_T_FALSE : VKTOR_T_NULL));
+				if (! (parser->expected & parser->token_type)) {
+					complete_error_unexpected_c(parser, p);
+				}
 				
-				case ',':
-					if (! (parser->expected & VKTOR_C_COMMA)) {
+				if (*p == 't') {
+					status = complete_read_expectedstr(parser, &p, "true", 4, error);
+				} else if (*p == 'f') {
+					status = complete_read_expectedstr(parser, &p, "false", 5, error);
+				} else {
+					status = complete_read_expectedstr(parser, &p, "null", 4, error);
+				}
+				
+				if (status == VKTOR_ERROR) {
+					return VKTOR_ERROR;
+				}
+				
+				expect_next_value_token(parser);
+				vktor_complete_set_position(parser, p);
+				return VKTOR_OK;
+				
+			case '0':
+			case '1':
+			case '2':
+			case '3':
+			case '4':
+			case '5':
+			case '6':
+			case '7':
+			case '8':
+			case '9':
+			case '-':
+			case '+':
+				if (! (parser->expected & (VKTOR_T_INT | VKTOR_T_FLOAT))) {
+					complete_error_unexpected_c(parser, p);
+				}
+				
+				if (complete_read_number(parser, &p, error) == VKTOR_ERROR) {
+					return VKTOR_ERROR;
+				}
+				
+				expect_next_value_token(parser);
+				vktor_complete_set_position(parser, p);
+				return VKTOR_OK;
+				
+			default:
+				// Unexpected character
+				complete_error_unexpected_c(parser, p);
+				break;
+		}
+		
+		// Read a struct start or end token
+		vktor_complete_set_position(parser, p + 1);
+		return VKTOR_OK;
+	}
+	
+	vktor_complete_set_position(parser, p);
+	
+	if (root_value_done(parser)) {
+		return VKTOR_COMPLETE;
+	}
+	
+	complete_error_incomplete(parser, p);
+}
+
+/**
+ * @brief Read a base64 encoded string value from a range of input
+ * 
+ * Read a base64 encoded string value, decoding it directly from the input into
+ * an output buffer. Whitespace and separators before the string are skipped 
+ * the same way vktor_parse() skips them. The state of a partially read string
+ * is kept in the parser, so reading can continue on the next range of input.
+ * 
+ * Used by vktor_read_base64() on each input buffer, or on complete input.
+ * 
+ * @param [in,out] parser   Parser object
+ * @param [in,out] pos      Position in the input, advanced as it is read
+ * @param [in]     end      End of the input range
+ * @param [out]    out      Output buffer
+ * @param [in]     out_size Size of the output buffer
+ * @param [in,out] written  Number of bytes written to the output buffer
+ * @param [out]    error    Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK if the string ended or the output buffer is 
+ *   full (the token type is then VKTOR_T_STRING or VKTOR_T_STRING_PART), 
+ *   VKTOR_MORE_DATA at the end of the range or VKTOR_ERROR
+ */
+static vktor_status
+parser_read_base64(vktor_parser *parser, char **pos, char *end, 
+                   unsigned char *out, long out_size, long *written, 
+                   vktor_error **error)
+{
+	vktor_base64_decoder *dec = parser->base64;
+	char                 *p = *pos;
+	char                  c;
+	unsigned char         v;
+	unsigned long         bits;
+	long                  len;
+	int                   need;
+	
+	while (p < end) {
+		c = *p;
+		
+		switch (dec->state) {
+			case VKTOR_B64_NONE:
+				switch (c) {
+					case ' ':
+					case '\n':
+					case '\r':
+					case '\t':
+					case '\f':
+					case '\v':
+						// Whitespace
+						break;
+						
+					case ',':
+						// Only array members can follow a comma
+						if (! (parser->expected & VKTOR_C_COMMA && 
+						       nest_stack_in(parser, VKTOR_STRUCT_ARRAY))) {
+							set_error_unexpected_c(error, c);
+							return VKTOR_ERROR;
+						}
+						parser->expected = VKTOR_VALUE_TOKEN;
+						break;
+						
+					case ':':
+						if (! (parser->expected & VKTOR_C_COLON)) {
+							set_error_unexpected_c(error, c);
+							return VKTOR_ERROR;
+						}
+						parser->expected = VKTOR_VALUE_TOKEN;
+						break;
+						
+					case '"':
+						if (! (parser->expected & VKTOR_T_STRING)) {
+							set_error_unexpected_c(error, c);
+							return VKTOR_ERROR;
+						}
+						
+						vktor_parser_set_token(parser, VKTOR_T_STRING, NULL);
+						parser->token_resume = 1;
+						dec->state = VKTOR_B64_BODY;
+						dec->bits  = 0;
+						dec->count = 0;
+						dec->pad   = 0;
+						break;
+						
+					default:
 						set_error_unexpected_c(error, c);
 						return VKTOR_ERROR;
+						break;
+				}
+				
+				p++;
+				break;
+				
+			case VKTOR_B64_ESCAPED:
+				// Escaped line breaks are ignored, and an escaped slash is 
+				// read as a regular base64 character
+				if (c == 'n' || c == 'r') {
+					p++;
+				} else if (c != '/') {
+					set_error_unexpected_c(error, c);
+					return VKTOR_ERROR;
+				}
+				
+				dec->state = VKTOR_B64_BODY;
+				break;
+				
+			case VKTOR_B64_BODY:
+				// Decode as many complete groups as possible at once
+				if (dec->count == 0 && dec->pad == 0) {
+					p += vktor_base64_decode_groups(p, end - p, 
+						out + *written, out_size - *written, &len);
+					*written += len;
+					if (p >= end) {
+						break;
 					}
-					
-					switch(parser->nest_stack[parser->nest_ptr]) {
-						case VKTOR_STRUCT_OBJECT:
-							parser->expected = VKTOR_T_OBJECT_KEY;
-							break;
-							
-						case VKTOR_STRUCT_ARRAY:
-							parser->expected = VKTOR_VALUE_TOKEN;
-							break;
-							
-						default:
-							set_error(error, VKTOR_ERR_INTERNAL_ERR, 
-								"internal parser error: unexpected nesting stack member");
-							return VKTOR_ERROR;
-							break;
-					}
-					break;
+					c = *p;
+				}
 				
-				case ':':
-					if (! (parser->expected & VKTOR_C_COLON)) {
+				v = vktor_base64_table[(unsigned char) c];
+				if (v != VKTOR_BASE64_INVALID) {
+					if (dec->pad > 0) {
 						set_error_unexpected_c(error, c);
 						return VKTOR_ERROR;
 					}
 					
-					// Colon is only expected inside objects
-					assert(nest_stack_in(parser, VKTOR_STRUCT_OBJECT));
-					
-					// Next we expected a value
-					parser->expected = VKTOR_VALUE_TOKEN;
-					break;
+					// Leave the group's last character for the next call if
+					// there is no room for it in the output buffer
+					if (dec->count == 3 && out_size - *written < 3) {
+						parser->token_type = VKTOR_T_STRING_PART;
+						*pos = p;
+						return VKTOR_OK;
+					}
 					
-				case '}':
-					if (! (parser->expected & VKTOR_T_OBJECT_END &&
-					       nest_stack_in(parser, VKTOR_STRUCT_OBJECT))) {
+					dec->bits = (dec->bits << 6) | v;
+					if (++dec->count == 4) {
+						bits = dec->bits;
+						out[(*written)++] = (unsigned char) (bits >> 16);
+						out[(*written)++] = (unsigned char) (bits >> 8);
+						out[(*written)++] = (unsigned char) bits;
+						dec->bits  = 0;
+						dec->count = 0;
+					}
 					
+				} else if (c == '=') {
+					if (dec->count < 2 || 
+					    dec->count + dec->pad >= 4) {
 						set_error_unexpected_c(error, c);
 						return VKTOR_ERROR;
 					}
+					dec->pad++;
 					
-					parser_set_token(parser, VKTOR_T_OBJECT_END, NULL);
+				} else if (c == '\\') {
+					dec->state = VKTOR_B64_ESCAPED;
 					
-					if (nest_stack_pop(parser, error) == VKTOR_ERROR) {
+				} else if (c == '"') {
+					// End of string - a group may be left without padding
+					if (dec->count == 1 || (dec->pad > 0 && 
+					    dec->count + dec->pad != 4)) {
+						set_error_unexpected_c(error, c);
 						return VKTOR_ERROR;
-					} 
-					
-					if (parser->nest_ptr > 0) {
-						// Next can be either a comma, or end of array / object
-						parser->expected = VKTOR_C_COMMA | 
-											 VKTOR_T_OBJECT_END | 
-											 VKTOR_T_ARRAY_END;
-					} else {
-						// Next can be nothing
-						parser->expected = VKTOR_T_NONE;
 					}
-					                     
-					done = 1;
-					break;
 					
-				case ']':
-					if (! (parser->expected & VKTOR_T_ARRAY_END &&
-					       nest_stack_in(parser, VKTOR_STRUCT_ARRAY))) { 
+					need = (dec->count > 1 ? dec->count - 1 : 0);
+					if (out_size - *written < need) {
+						parser->token_type = VKTOR_T_STRING_PART;
+						*pos = p;
+						return VKTOR_OK;
+					}
 					
-						set_error_unexpected_c(error, c);
-						return VKTOR_ERROR;
+					bits = dec->bits << (6 * (4 - dec->count));
+					if (need > 0) {
+						out[(*written)++] = (unsigned char) (bits >> 16);
+					}
+					if (need > 1) {
+						out[(*written)++] = (unsigned char) (bits >> 8);
 					}
-					parser_set_token(parser, VKTOR_T_ARRAY_END, NULL);
 					
-					if (nest_stack_pop(parser, error) == VKTOR_ERROR) {
-						return VKTOR_ERROR;
-					} 
+					dec->state = VKTOR_B64_NONE;
+					parser->token_type   = VKTOR_T_STRING;
+					parser->token_resume = 0;
+					expect_next_value_token(parser);
 					
-					if (parser->nest_ptr > 0) {
-						// Next can be either a comma, or end of array / object
-						parser->expected = VKTOR_C_COMMA      | 
-						                   VKTOR_T_OBJECT_END | 
-										   VKTOR_T_ARRAY_END;
-					} else {
-						// Next can be nothing
-						parser->expected = VKTOR_T_NONE;
-					}
-					                     
-					done = 1;
-					break;
-					
-				case ' ':
-				case '\n':
-				case '\r':
-				case '\t':
-				case '\f':
-				case '\v':
-					// Whitespace - do nothing!
-					/** 
-					 * @todo consinder: read all whitespace without looping? 
-					 */
-					break;
-					
-				case 't':
-					// true?
-					if (! (parser->expected & VKTOR_T_TRUE)) {
-						set_error_unexpected_c(error, c);
-						return VKTOR_ERROR;
-					}
-					
-					return parser_read_true(parser, error);
-					break;
+					*pos = p + 1;
+					return VKTOR_OK;
 					
-				case 'f':
-					// false?
-					if (! (parser->expected & VKTOR_T_FALSE)) {
-						set_error_unexpected_c(error, c);
-						return VKTOR_ERROR;
-					}
-					
-					return parser_read_false(parser, error);
-					break;
+				} else {
+					set_error_unexpected_c(error, c);
+					return VKTOR_ERROR;
+				}
+				
+				p++;
+				break;
+		}
+	}
+	
+	*pos = p;
+	return VKTOR_MORE_DATA;
+}
 
-				case 'n':
-					// null?
-					if (! (parser->expected & VKTOR_T_NULL)) {
-						set_error_unexpected_c(error, c);
-						return VKTOR_ERROR;
+/**
+ * @brief Find the end of a number
+ * 
+ * Find the end of a number in a range of input, accepting exactly the same 
+ * input as parser_read_number_token(). 
+ * 
+ * @param [in]  start    Start of the number
+ * @param [in]  end      End of the input range
+ * @param [out] stop     Set to the character after the number, or to the 
+ *                       unexpected character in case of error
+ * @param [out] is_float Set to 1 if the number has a fraction or an exponent
+ * 
+ * @return Status code: VKTOR_OK, VKTOR_MORE_DATA if the number reaches the
+ *   end of the range, or VKTOR_ERROR if the number is invalid
+ */
+static vktor_status
+number_scan(const char *start, const char *end, const char **stop, 
+            int *is_float)
+{
+	const char *p;
+	long        expected = VKTOR_C_DOT | VKTOR_C_EXP | VKTOR_C_SIGNUM;
+	
+	*is_float = 0;
+	
+	for (p = start; p < end; p++) {
+		if (*p >= '0' && *p <= '9') {
+			expected &= ~VKTOR_C_SIGNUM;
+			
+		} else if (*p == '.') {
+			if (! (expected & VKTOR_C_DOT && p > start)) {
+				*stop = p;
+				return VKTOR_ERROR;
+			}
+			expected &= ~VKTOR_C_DOT;
+			*is_float = 1;
+			
+		} else if (*p == '-' || *p == '+') {
+			if (! (expected & VKTOR_C_SIGNUM)) {
+				*stop = p;
+				return VKTOR_ERROR;
+			}
+			expected &= ~VKTOR_C_SIGNUM;
+			
+		} else if (*p == 'e' || *p == 'E') {
+			if (! (expected & VKTOR_C_EXP && p > start) || 
+			    p[-1] == '.' || p[-1] == '+' || p[-1] == '-') {
+				*stop = p;
+				return VKTOR_ERROR;
+			}
+			expected = (expected & ~(VKTOR_C_EXP | VKTOR_C_DOT)) | VKTOR_C_SIGNUM;
+			*is_float = 1;
+			
+		} else {
+			break;
+		}
+	}
+	
+	*stop = p;
+	if (p == end) {
+		return VKTOR_MORE_DATA;
+	}
+	
+	// Check that we are not expecting more digits
+	switch (p[-1]) {
+		case 'e':
+		case 'E':
+		case '.':
+		case '+':
+		case '-':
+			return VKTOR_ERROR;
+			break;
+	}
+	
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Convert a number and store it in an array
+ * 
+ * Convert a valid number, as found by number_scan(), into an array element.
+ * Integers are converted directly, and so are floating point numbers with up
+ * to 15 digits and a small exponent, as both the digits and the power of 10 
+ * are then exact doubles and a single multiplication or division is correctly
+ * rounded. Other numbers are converted using strtod().
+ * 
+ * @param [in]  kind     Array element type
+ * @param [in]  str      Start of the number
+ * @param [in]  stop     Character after the number, which must not be a valid
+ *                       continuation of the number for strtod()
+ * @param [in]  is_float Whether the number has a fraction or an exponent
+ * @param [out] out      Array
+ * @param [in]  idx      Index of the element to store
+ * 
+ * @return 1 if the number was stored, 0 if it can not be represented as an
+ *   element of this type
+ */
+static int
+number_store(vktor_number_kind kind, const char *str, const char *stop, 
+             int is_float, void *out, long idx)
+{
+	const char         *p = str;
+	unsigned long long  mant = 0, limit;
+	int                 neg = 0, digits = 0, frac = 0, exp = 0, e10, e10_neg = 0;
+	double              val;
+	
+	if (*p == '-' || *p == '+') {
+		neg = (*p == '-');
+		p++;
+	}
+	
+	if (kind == VKTOR_NUM_INT64) {
+		if (is_float) {
+			return 0;
+		}
+		
+		limit = (neg ? (unsigned long long) LLONG_MAX + 1 : LLONG_MAX);
+		for (; p < stop; p++) {
+			if (mant > (limit - (*p - '0')) / 10) {
+				return 0;
+			}
+			mant = mant * 10 + (*p - '0');
+		}
+		
+		((long long *) out)[idx] = (neg ? (long long) (0ULL - mant) : (long long) mant);
+		return 1;
+	}
+	
+	// Digits and fraction
+	for (; p < stop && *p != 'e' && *p != 'E'; p++) {
+		if (*p == '.') {
+			frac = 1;
+		} else {
+			mant = mant * 10 + (*p - '0');
+			digits++;
+			exp -= frac;
+			if (digits > 15) {
+				break;
+			}
+		}
+	}
+	
+	// Exponent
+	if (p < stop && digits <= 15) {
+		p++;
+		if (*p == '-' || *p == '+') {
+			e10_neg = (*p == '-');
+			p++;
+		}
+		
+		// Large exponents are left for strtod()
+		for (e10 = 0; p < stop && e10 < 1000; p++) {
+			e10 = e10 * 10 + (*p - '0');
+		}
+		exp += (e10_neg ? -e10 : e10);
+	}
+	
+	if (digits <= 15 && p == stop && exp >= -22 && exp <= 22) {
+		val = (double) mant;
+		val = (exp < 0 ? val / pow10_exact[-exp] : val * pow10_exact[exp]);
+		if (neg) {
+			val = -val;
+		}
+		
+	} else {
+		errno = 0;
+		val = strtod(str, NULL);
+		if (errno == ERANGE) {
+			return 0;
+		}
+	}
+	
+	if (kind == VKTOR_NUM_FLOAT) {
+		if (val > FLT_MAX || val < -FLT_MAX) {
+			return 0;
+		}
+		((float *) out)[idx] = (float) val;
+	} else {
+		((double *) out)[idx] = val;
+	}
+	
+	return 1;
+}
+
+/**
+ * @brief Read numbers of an array from a range of input
+ * 
+ * Read consecutive numbers of an array, with the separating commas and any 
+ * whitespace, and store them directly in an array without creating tokens. 
+ * Stops at the end of the array, before the first value which is not a 
+ * number, or when the output array is full. 
+ * 
+ * Used by parser_read_number_array() on each input buffer, or on complete 
+ * input.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [in,out] pos    Position in the input, advanced as it is read
+ * @param [in]     end    End of the input range
+ * @param [in]     kind   Array element type
+ * @param [out]    out    Output array
+ * @param [in]     cap    Number of elements in the output array
+ * @param [in,out] count  Number of elements stored in the output array
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK if reading stopped (the token type is then 
+ *   VKTOR_T_ARRAY_END if the array has ended or VKTOR_T_NONE otherwise), 
+ *   VKTOR_ERROR, or VKTOR_MORE_DATA - if pos is not at the end of the range,
+ *   the number at pos must be read as a token
+ */
+static vktor_status
+parser_read_numbers(vktor_parser *parser, char **pos, char *end, 
+                    vktor_number_kind kind, void *out, long cap, long *count,
+                    vktor_error **error)
+{
+	char         *p;
+	const char   *stop;
+	int           is_float;
+	vktor_status  status;
+	
+	for (p = *pos; p < end; p++) {
+		switch (*p) {
+			case ' ':
+			case '\n':
+			case '\r':
+			case '\t':
+			case '\f':
+			case '\v':
+				// Whitespace
+				break;
+				
+			case ',':
+				if (! (parser->expected & VKTOR_C_COMMA)) {
+					*pos = p;
+					set_error_unexpected_c(error, *p);
+					return VKTOR_ERROR;
+				}
+				
+				parser->expected = VKTOR_VALUE_TOKEN;
+				break;
+				
+			case ']':
+				if (! (parser->expected & VKTOR_T_ARRAY_END)) {
+					*pos = p;
+					set_error_unexpected_c(error, *p);
+					return VKTOR_ERROR;
+				}
+				
+				if (vktor_nest_stack_pop(parser, error) == VKTOR_ERROR) {
+					return VKTOR_ERROR;
+				}
+				
+				if (parser->nest_ptr > 0) {
+					parser->expected = VKTOR_C_COMMA      | 
+					                   VKTOR_T_OBJECT_END | 
+					                   VKTOR_T_ARRAY_END;
+				} else {
+					parser->expected = VKTOR_T_NONE;
+				}
+				
+				parser->token_type = VKTOR_T_ARRAY_END;
+				*pos = p + 1;
+				return VKTOR_OK;
+				break;
+				
+			case '0':
+			case '1':
+			case '2':
+			case '3':
+			case '4':
+			case '5':
+			case '6':
+			case '7':
+			case '8':
+			case '9':
+			case '-':
+			case '+':
+				if (! (parser->expected & (VKTOR_T_INT | VKTOR_T_FLOAT))) {
+					*pos = p;
+					set_error_unexpected_c(error, *p);
+					return VKTOR_ERROR;
+				}
+				
+				if (*count == cap) {
+					*pos = p;
+					parser->token_type = VKTOR_T_NONE;
+					return VKTOR_OK;
+				}
+				
+				status = number_scan(p, end, &stop, &is_float);
+				if (status == VKTOR_ERROR) {
+					*pos = (char *) stop;
+					set_error_unexpected_c(error, *stop);
+					return VKTOR_ERROR;
+				}
+				
+				// Numbers which may continue in the next range, which strtod()
+				// would read as hexadecimal, or which cannot be stored, are 
+				// left to be read as a token
+				if (status == VKTOR_MORE_DATA || *stop == 'x' || *stop == 'X' ||
+				    ! number_store(kind, p, stop, is_float, out, *count)) {
+					*pos = p;
+					return VKTOR_MORE_DATA;
+				}
+				
+				(*count)++;
+				expect_next_value_token(parser);
+				p = (char *) stop - 1;
+				break;
+				
+			default:
+				// Not a number, let vktor_parse() read it
+				*pos = p;
+				parser->token_type = VKTOR_T_NONE;
+				return VKTOR_OK;
+				break;
+		}
+	}
+	
+	*pos = p;
+	return VKTOR_MORE_DATA;
+}
+
+/**
+ * @brief Read numbers of an array into a typed array
+ * 
+ * Implements vktor_read_number_array() and friends. Numbers which span input
+ * buffers, or which cannot be stored in the output array, are read as regular
+ * number tokens and then stored if possible.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [in]     kind   Array element type
+ * @param [out]    out    Output array
+ * @param [in]     cap    Number of elements in the output array
+ * @param [out]    count  Number of elements stored in the output array
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code, see vktor_read_number_array()
+ */
+static vktor_status
+parser_read_number_array(vktor_parser *parser, vktor_number_kind kind, 
+                         void *out, long cap, long *count, vktor_error **error)
+{
+	vktor_status  status;
+	char         *pos, *start;
+	int           read_token = 0;
+	
+	assert(parser != NULL);
+	assert(out != NULL);
+	assert(count != NULL);
+	
+	*count = 0;
+	
+	if (! nest_stack_in(parser, VKTOR_STRUCT_ARRAY) || 
+	    base64_active(parser) ||
+	    skip_active(parser) ||
+	    (parser->token_resume && parser->token_type != VKTOR_T_INT && 
+	     parser->token_type != VKTOR_T_FLOAT)) {
+		set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"parser is not reading the values of an array");
+		return VKTOR_ERROR;
+	}
+	
+	// Values which are not read as tokens can't be hashed
+	if (parser->hash != NULL) {
+		set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"numbers can't be read in bulk while hashing subtrees");
+		return VKTOR_ERROR;
+	}
+	
+	if (parser->schema != NULL) {
+		set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"numbers can't be read in bulk while a schema is enabled");
+		return VKTOR_ERROR;
+	}
+	
+	if (parser->complete_text != NULL) {
+		// Token values point to the reused token memory and are never freed
+		parser->token_value = NULL;
+		
+		while (1) {
+			pos = parser->complete_ptr;
+			status = parser_read_numbers(parser, &pos, parser->complete_end, 
+				kind, out, cap, count, error);
+			vktor_complete_set_position(parser, pos);
+			
+			if (status != VKTOR_MORE_DATA) {
+				return status;
+			}
+			
+			if (pos == parser->complete_end) {
+				complete_error_incomplete(parser, pos);
+			}
+			
+			if (complete_read_number(parser, &pos, error) == VKTOR_ERROR) {
+				return VKTOR_ERROR;
+			}
+			
+			vktor_complete_set_position(parser, pos);
+			expect_next_value_token(parser);
+			
+			// Keep the number as the current token if it cannot be stored 
+			if (! number_store(kind, parser->token_value, 
+			                   (char *) parser->token_value + parser->token_size,
+			                   parser->token_type == VKTOR_T_FLOAT, out, *count)) {
+				return VKTOR_OK;
+			}
+			
+			(*count)++;
+		}
+	}
+	
+	while (1) {
+		// Read a number as a token, or continue reading one
+		if (read_token || parser->token_resume) {
+			status = parser_read_number_token(parser, error);
+			if (status != VKTOR_OK) {
+				return status;
+			}
+			
+			// Keep the number as the current token if it cannot be stored 
+			if (! number_store(kind, parser->token_value, 
+			                   (char *) parser->token_value + parser->token_size,
+			                   parser->token_type == VKTOR_T_FLOAT, out, *count)) {
+				return VKTOR_OK;
+			}
+			
+			(*count)++;
+			read_token = 0;
+		}
+		
+		vktor_parser_set_token(parser, VKTOR_T_NONE, NULL);
+		
+		if (parser->buffer == NULL) {
+			return VKTOR_MORE_DATA;
+		}
+		
+		start = pos = parser->buffer->text + parser->buffer->ptr;
+		status = parser_read_numbers(parser, &pos, 
+			parser->buffer->text + parser->buffer->size, 
+			kind, out, cap, count, error);
+		
+		parser->buffer->ptr += pos - start;
+#ifdef BYTECOUNTER
+		parser->bytecounter += pos - start;
+#endif
+		
+		if (status != VKTOR_MORE_DATA) {
+			return status;
+		}
+		
+		if (eobuffer(parser->buffer)) {
+			vktor_parser_advance_buffer(parser);
+		} else {
+			read_token = 1;
+		}
+	}
+}
+
+/**
+ * @brief Start skipping the next value
+ * 
+ * Set the parser up for vktor_parser_skip() to skip the value which starts 
+ * at the current nesting level, allocating the skipping state if needed.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return VKTOR_OK, or VKTOR_ERROR if out of memory
+ */
+vktor_status
+vktor_parser_skip_start(vktor_parser *parser, vktor_error **error)
+{
+	if (parser->skip == NULL) {
+		parser->skip = vktor_parser_alloc_state(parser, sizeof(vktor_value_skipper),
+			error);
+		if (parser->skip == NULL) {
+			return VKTOR_ERROR;
+		}
+	}
+	
+	parser->skip->base  = parser->nest_ptr;
+	parser->skip->state = VKTOR_SKIP_START;
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Skip a value in a range of input
+ * 
+ * Skip over the next value, including any nested arrays and objects, without
+ * creating tokens. Whitespace and separators before the value are skipped 
+ * the same way vktor_parse() skips them. Nesting is tracked using the nesting
+ * stack so that arrays and objects are balanced, but the contents of strings,
+ * numbers, true, false and null are not validated, and neither are the 
+ * separators inside the value. The state of a partially skipped value is 
+ * kept in the parser, so skipping can continue on the next range of input.
+ * 
+ * Used by vktor_skip_value() and vktor_capture_value() on each input buffer,
+ * or on complete input.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [in,out] pos    Position in the input, advanced as it is read
+ * @param [in]     end    End of the input range
+ * @param [out]    value  Set to the first character of the value if it 
+ *                        starts in this range, or NULL
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK once the value is skipped, VKTOR_MORE_DATA at
+ *   the end of the range or VKTOR_ERROR
+ */
+vktor_status
+vktor_parser_skip(vktor_parser *parser, char **pos, char *end, char **value, 
+                  vktor_error **error)
+{
+	vktor_value_skipper *skip = parser->skip;
+	char                *p;
+	char                 c;
+	
+	for (p = *pos; p < end; ) {
+		c = *p;
+		
+		switch (skip->state) {
+			case VKTOR_SKIP_STRING:
+				if (c == '\\') {
+					skip->state = VKTOR_SKIP_ESCAPED;
+				} else if (c == '"') {
+					skip->state = VKTOR_SKIP_VALUE;
+					if (parser->nest_ptr == skip->base) {
+						*pos = p + 1;
+						return VKTOR_OK;
 					}
-					
-					return parser_read_null(parser, error);
+				}
+				break;
+				
+			case VKTOR_SKIP_ESCAPED:
+				skip->state = VKTOR_SKIP_STRING;
+				break;
+				
+			case VKTOR_SKIP_SCALAR:
+				if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || 
+				    (c >= 'A' && c <= 'Z') || c == '.' || c == '+' || c == '-') {
 					break;
-									
-				case '0':
-				case '1':
-				case '2':
-				case '3':
-				case '4':
-				case '5':
-				case '6':
-				case '7':
-				case '8':
-				case '9':
-				case '-':
-				case '+':
-					// Read a number
-					if (! (parser->expected & (VKTOR_T_INT | 
-					                           VKTOR_T_FLOAT))) {
+				}
+				
+				// The scalar has ended, read this character again
+				skip->state = VKTOR_SKIP_VALUE;
+				if (parser->nest_ptr == skip->base) {
+					*pos = p;
+					return VKTOR_OK;
+				}
+				continue;
+				
+			case VKTOR_SKIP_START:
+				switch (c) {
+					case ' ':
+					case '\n':
+					case '\r':
+					case '\t':
+					case '\f':
+					case '\v':
+						// Whitespace
+						break;
+						
+					case ',':
+						// Only array members can follow a comma
+						if (! (parser->expected & VKTOR_C_COMMA && 
+						       nest_stack_in(parser, VKTOR_STRUCT_ARRAY))) {
+							*pos = p;
+							set_error_unexpected_c(error, c);
+							return VKTOR_ERROR;
+						}
+						parser->expected = VKTOR_VALUE_TOKEN;
+						break;
+						
+					case ':':
+						if (! (parser->expected & VKTOR_C_COLON)) {
+							*pos = p;
+							set_error_unexpected_c(error, c);
+							return VKTOR_ERROR;
+						}
+						parser->expected = VKTOR_VALUE_TOKEN;
+						break;
+						
+					default:
+						if (! (parser->expected & VKTOR_T_NULL)) {
+							*pos = p;
+							set_error_unexpected_c(error, c);
+							return VKTOR_ERROR;
+						}
+						
+						// Start of the value, read this character again
+						skip->state = VKTOR_SKIP_VALUE;
+						if (value != NULL) {
+							*value = p;
+						}
+						continue;
+				}
+				break;
+				
+			case VKTOR_SKIP_VALUE:
+				switch (c) {
+					case ' ':
+					case '\n':
+					case '\r':
+					case '\t':
+					case '\f':
+					case '\v':
+						// Whitespace
+						break;
+						
+					case '"':
+						skip->state = VKTOR_SKIP_STRING;
+						break;
+						
+					case '{':
+					case '[':
+						if (vktor_nest_stack_add(parser, (c == '{' ? VKTOR_STRUCT_OBJECT : 
+						    VKTOR_STRUCT_ARRAY), error) == VKTOR_ERROR) {
+							*pos = p;
+							return VKTOR_ERROR;
+						}
+						break;
+						
+					case '}':
+					case ']':
+						if (parser->nest_ptr == skip->base ||
+						    ! nest_stack_in(parser, (c == '}' ? VKTOR_STRUCT_OBJECT : 
+						                             VKTOR_STRUCT_ARRAY))) {
+							*pos = p;
+							set_error_unexpected_c(error, c);
+							return VKTOR_ERROR;
+						}
+						
+						if (vktor_nest_stack_pop(parser, error) == VKTOR_ERROR) {
+							*pos = p;
+							return VKTOR_ERROR;
+						}
+						
+						if (parser->nest_ptr == skip->base) {
+							*pos = p + 1;
+							return VKTOR_OK;
+						}
+						break;
+						
+					case ',':
+					case ':':
+						if (parser->nest_ptr == skip->base) {
+							*pos = p;
+							set_error_unexpected_c(error, c);
+							return VKTOR_ERROR;
+						}
+						break;
+						
+					default:
+						if (! ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+						       c == '-' || c == '+')) {
+							*pos = p;
+							set_error_unexpected_c(error, c);
+							return VKTOR_ERROR;
+						}
+						
+						skip->state = VKTOR_SKIP_SCALAR;
+						break;
+				}
+				break;
+		}
+		
+		p++;
+	}
+	
+	*pos = p;
+	return VKTOR_MORE_DATA;
+}
+
+/**
+ * @brief Free all memory held by a parser
+ * 
+ * Free any buffers, token values and other memory allocated by the parser, 
+ * but not the parser struct itself. Used by vktor_parser_free() and when 
+ * resetting parsers released into a pool.
+ * 
+ * @param [in,out] parser Parser object
+ */
+static void
+parser_free_memory(vktor_parser *parser)
+{
+	if (parser->buffer != NULL) {
+		vktor_buffer_free_all(parser, parser->buffer);
+	}
+	
+	if (parser->token_value != NULL && parser->token_value != parser->token_buff) {
+		vfree(parser, parser->token_value);
+	}
+	
+	if (parser->token_buff_free) {
+		vfree(parser, parser->token_buff);
+	}
+	
+	if (parser->complete_free) {
+		vfree(parser, parser->complete_text);
+	}
+	
+	if (parser->nest_stack != parser->nest_inline) {
+		vfree(parser, parser->nest_stack);
+	}
+	
+	if (parser->shape != NULL) {
+		vfree(parser, parser->shape);
+	}
+	
+	if (parser->base64 != NULL) {
+		vfree(parser, parser->base64);
+	}
+	
+	if (parser->skip != NULL) {
+		if (parser->skip->capture_buff != NULL) {
+			vfree(parser, parser->skip->capture_buff);
+		}
+		vfree(parser, parser->skip);
+	}
+	
+	if (parser->valid != NULL) {
+		vfree(parser, parser->valid);
+	}
+	
+	if (parser->hash != NULL) {
+		vfree(parser, parser->hash->stack);
+		vfree(parser, parser->hash);
+	}
+	
+	if (parser->schema != NULL) {
+		vktor_parser_schema_free(parser, parser->schema);
+	}
+	
+#ifdef HAVE_LIBZ
+	if (parser->inflate != NULL) {
+		inflateEnd(&parser->inflate->stream);
+		vktor_buffer_free_all(parser, parser->inflate->input);
+		vfree(parser, parser->inflate);
+	}
+#endif
+}
+
+/**
+ * @brief Reset a parser to its initial state
+ * 
+ * Free all memory held by a parser and reinitialize it, keeping its allocator
+ * and maximal nesting level, so it can be used to parse a new stream.
+ * 
+ * @param [in,out] parser Parser object
+ */
+void
+vktor_parser_reset(vktor_parser *parser)
+{
+	vktor_allocator allocator = parser->allocator;
+	char            inplace   = parser->inplace;
+	
+	parser_free_memory(parser);
+	vktor_parser_init_inplace(parser, sizeof(vktor_parser), parser->max_nest, 
+		&allocator);
+	parser->inplace = inplace;
+}
+
+/**
+ * @brief Add the current token to the subtree hashes
+ * 
+ * Each scalar value and object key is hashed along with its token type, and
+ * the hash is combined in order into the hash of the array or object it is 
+ * in. When an array or object ends, its hash is finalized and combined into 
+ * the hash of its parent in the same way. Hashes therefore only depend on the
+ * tokens, and not on whitespace, escaping or how the input was split into 
+ * buffers and string parts.
+ * 
+ * @param [in,out] parser Parser object, with subtree hashing enabled
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK or VKTOR_ERROR
+ */
+static vktor_status
+parser_hash_token(vktor_parser *parser, vktor_error **error)
+{
+	vktor_token          token = parser->token_type;
+	unsigned long long  *stack, h;
+	vktor_hash_state     state;
+	int                  size;
+	
+	parser->hash->valid = 0;
+	
+	switch (token) {
+		case VKTOR_T_ARRAY_START:
+		case VKTOR_T_OBJECT_START:
+			if (parser->nest_ptr >= parser->hash->size) {
+				size  = parser->hash->size * 2;
+				stack = vrealloc(parser, parser->hash->stack, 
+					sizeof(unsigned long long) * size);
+				if (stack == NULL) {
+					set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+						"unable to allocate %d bytes for subtree hashes",
+						(int) sizeof(unsigned long long) * size);
+					return VKTOR_ERROR;
+				}
+				parser->hash->stack = stack;
+				parser->hash->size  = size;
+			}
+			
+			vktor_hash_init(&state, token);
+			parser->hash->stack[parser->nest_ptr] = vktor_hash_final(&state);
+			return VKTOR_OK;
+			
+		case VKTOR_T_ARRAY_END:
+		case VKTOR_T_OBJECT_END:
+			// The level of the struct was already popped
+			h = vktor_hash_combine(parser->hash->stack[parser->nest_ptr + 1], 
+				token);
+			vktor_hash_init(&state, h);
+			h = vktor_hash_final(&state);
+			break;
+			
+		case VKTOR_T_STRING_PART:
+			if (! parser->hash->in_part) {
+				vktor_hash_init(&parser->hash->str, VKTOR_T_STRING);
+				parser->hash->in_part = 1;
+			}
+			vktor_hash_update(&parser->hash->str, parser->token_value, 
+				parser->token_size);
+			return VKTOR_OK;
+			
+		case VKTOR_T_STRING:
+			if (! parser->hash->in_part) {
+				vktor_hash_init(&parser->hash->str, VKTOR_T_STRING);
+			}
+			parser->hash->in_part = 0;
+			vktor_hash_update(&parser->hash->str, parser->token_value, 
+				parser->token_size);
+			h = vktor_hash_final(&parser->hash->str);
+			break;
+			
+		case VKTOR_T_OBJECT_KEY:
+		case VKTOR_T_INT:
+		case VKTOR_T_FLOAT:
+			vktor_hash_init(&state, token);
+			vktor_hash_update(&state, parser->token_value, parser->token_size);
+			h = vktor_hash_final(&state);
+			break;
+			
+		default:
+			// true, false and null
+			vktor_hash_init(&state, token);
+			h = vktor_hash_final(&state);
+			break;
+	}
+	
+	if (parser->nest_ptr > 0) {
+		parser->hash->stack[parser->nest_ptr] = vktor_hash_combine(
+			parser->hash->stack[parser->nest_ptr], h);
+	}
+	
+	// Object keys are only a part of the object's hash
+	if (token != VKTOR_T_OBJECT_KEY) {
+		parser->hash->value = h;
+		parser->hash->valid = 1;
+	}
+	
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Read the next token
+ * 
+ * Read the next token from complete input or from the buffers, without the
+ * checks, subtree hashing and schema validation done by vktor_parse().
+ * 
+ * Used by vktor_parse(), and by vktor_skip_value() when skipping token by 
+ * token.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code, see vktor_parse()
+ */
+static vktor_status
+parser_parse_token(vktor_parser *parser, vktor_error **error)
+{
+	char c;
+	int  done;
+	
+	assert(parser != NULL);
+	
+	// Complete input is read by a separate, faster implementation
+	if (parser->complete_text != NULL) {
+		return parser_parse_complete(parser, error);
+	}
+	
+	// Do we have a buffer to work with?
+	while (parser->buffer != NULL) {
+		done = 0;
+		
+		// Do we need to continue reading the previous token?
+		if (parser->token_resume) {
+			
+		    switch (parser->token_type) {
+		    	case VKTOR_T_OBJECT_KEY:
+		    		return parser_read_objkey_token(parser, error);
+		    		break;
+		    		
+		    	case VKTOR_T_STRING:
+		    	case VKTOR_T_STRING_PART:
+		    		return parser_read_string_token(parser, error);
+		    		break;
+		    	
+				case VKTOR_T_NULL:
+					return parser_read_null(parser, error);
+					break;
+					
+				case VKTOR_T_TRUE:
+					return parser_read_true(parser, error);
+					break;
+				
+				case VKTOR_T_FALSE:
+					return parser_read_false(parser, error);
+					break;
+				
+				case VKTOR_T_INT:
+				case VKTOR_T_FLOAT:
+					return parser_read_number_token(parser, error);
+					break;
+					
+		    	default:
+		    		set_error(parser, error, VKTOR_ERR_INTERNAL_ERR, 
+		    			"token resume flag is set but token type %d is unexpected",
+		    			parser->token_type);
+		    		return VKTOR_ERROR;
+		    		break;
+		    }
+		}
+		
+		while (! eobuffer(parser->buffer)) {
+			c = parser->buffer->text[parser->buffer->ptr];
+			
+			switch (c) {
+				case '{':
+					if (! (parser->expected & VKTOR_T_OBJECT_START)) {
 						set_error_unexpected_c(error, c);
 						return VKTOR_ERROR;
 					}
 					
-					return parser_read_number_token(parser, error);
+					if (vktor_nest_stack_add(parser, VKTOR_STRUCT_OBJECT, error) == VKTOR_ERROR) {
+						return VKTOR_ERROR;
+					}
+					
+					vktor_parser_set_token(parser, VKTOR_T_OBJECT_START, NULL);
+					
+					// Expecting: object key or object end
+					parser->expected = VKTOR_T_OBJECT_KEY |
+					                   VKTOR_T_OBJECT_END;
+					
+					done = 1;
 					break;
 					
-				default:
-					// Unexpected character
-					set_error_unexpected_c(error, c);
-					return VKTOR_ERROR;
+				case '[':
+					if (! (parser->expected & VKTOR_T_ARRAY_START)) {
+						set_error_unexpected_c(error, c);
+						return VKTOR_ERROR;
+					}
+					
+					if (vktor_nest_stack_add(parser, VKTOR_STRUCT_ARRAY, error) == VKTOR_ERROR) {
+						return VKTOR_ERROR;
+					}
+					
+					vktor_parser_set_token(parser, VKTOR_T_ARRAY_START, NULL);
+					
+					// Expecting: any value or array end
+					parser->expected = VKTOR_VALUE_TOKEN | 
+					                   VKTOR_T_ARRAY_END;
+					
+					done = 1;
+					break;
+					
+				case '"':
+					if (! (parser->expected & (VKTOR_T_STRING | 
+					                           VKTOR_T_OBJECT_KEY))) {
+						set_error_unexpected_c(error, c);
+						return VKTOR_ERROR;
+					}
+				
+					INCREMENT_BUFFER_PTR(parser);
+					
+					if (parser->expected & VKTOR_T_OBJECT_KEY) {
+						return parser_read_objkey_token(parser, error);
+					} else {
+						return parser_read_string_token(parser, error);
+					}
+					
 					break;
+				
+				case ',':
+					if (! (parser->expected & VKTOR_C_COMMA)) {
+						set_error_unexpected_c(error, c);
+						return VKTOR_ERROR;
+					}
+					
+					switch(nest_stack_top(parser)) {
+						case VKTOR_STRUCT_OBJECT:
+							parser->expected = VKTOR_T_OBJECT_KEY;
+							break;
+							
+						case VKTOR_STRUCT_ARRAY:
+							parser->expected = VKTOR_VALUE_TOKEN;
+							break;
+							
+						default:
+							set_error(parser, error, VKTOR_ERR_INTERNAL_ERR, 
+								"internal parser error: unexpected nesting stack member");
+							return VKTOR_ERROR;
+							break;
+					}
+					break;
+				
+				case ':':
+					if (! (parser->expected & VKTOR_C_COLON)) {
+						set_error_unexpected_c(error, c);
+						return VKTOR_ERROR;
+					}
+					
+					// Colon is only expected inside objects
+					assert(nest_stack_in(parser, VKTOR_STRUCT_OBJECT));
+					
+					// Next we expected a value
+					parser->expected = VKTOR_VALUE_TOKEN;
+					break;
+					
+				case '}':
+					if (! (parser->expected & VKTOR_T_OBJECT_END &&
+					       nest_stack_in(parser, VKTOR_STRUCT_OBJECT))) {
+					
+						set_error_unexpected_c(error, c);
+						return VKTOR_ERROR;
+					}
+					
+					vktor_parser_set_token(parser, VKTOR_T_OBJECT_END, NULL);
+					
+					if (vktor_nest_stack_pop(parser, error) == VKTOR_ERROR) {
+						return VKTOR_ERROR;
+					} 
+					
+					if (parser->nest_ptr > 0) {
+						// Next can be either a comma, or end of array / object
+						parser->expected = VKTOR_C_COMMA | 
+											 VKTOR_T_OBJECT_END | 
+											 VKTOR_T_ARRAY_END;
+					} else {
+						// Next can be nothing
+						parser->expected = VKTOR_T_NONE;
+					}
+					                     
+					done = 1;
+					break;
+					
+				case ']':
+					if (! (parser->expected & VKTOR_T_ARRAY_END &&
+					       nest_stack_in(parser, VKTOR_STRUCT_ARRAY))) { 
+					
+						set_error_unexpected_c(error, c);
+						return VKTOR_ERROR;
+					}
+					vktor_parser_set_token(parser, VKTOR_T_ARRAY_END, NULL);
+					
+					if (vktor_nest_stack_pop(parser, error) == VKTOR_ERROR) {
+						return VKTOR_ERROR;
+					} 
+					
+					if (parser->nest_ptr > 0) {
+						// Next can be either a comma, or end of array / object
+						parser->expected = VKTOR_C_COMMA      | 
+						                   VKTOR_T_OBJECT_END | 
+										   VKTOR_T_ARRAY_END;
+					} else {
+						// Next can be nothing
+						parser->expected = VKTOR_T_NONE;
+					}
+					                     
+					done = 1;
+					break;
+					
+				case ' ':
+				case '\n':
+				case '\r':
+				case '\t':
+				case '\f':
+				case '\v':
+					// Whitespace - do nothing!
+					/** 
+					 * @todo consinder: read all whitespace without looping? 
+					 */
+					break;
+					
+				case 't':
+					// true?
+					if (! (parser->expected & VKTOR_T_TRUE)) {
+						set_error_unexpected_c(error, c);
+						return VKTOR_ERROR;
+					}
+					
+					return parser_read_true(parser, error);
+					break;
+					
+				case 'f':
+					// false?
+					if (! (parser->expected & VKTOR_T_FALSE)) {
+						set_error_unexpected_c(error, c);
+						return VKTOR_ERROR;
+					}
+					
+					return parser_read_false(parser, error);
+					break;
+
+				case 'n':
+					// null?
+					if (! (parser->expected & VKTOR_T_NULL)) {
+						set_error_unexpected_c(error, c);
+						return VKTOR_ERROR;
+					}
+					
+					return parser_read_null(parser, error);
+					break;
+									
+				case '0':
+				case '1':
+				case '2':
+				case '3':
+				case '4':
+				case '5':
+				case '6':
+				case '7':
+				case '8':
+				case '9':
+				case '-':
+				case '+':
+					// Read a number
+					if (! (parser->expected & (VKTOR_T_INT | 
+					                           VKTOR_T_FLOAT))) {
+						set_error_unexpected_c(error, c);
+						return VKTOR_ERROR;
+					}
+					
+					return parser_read_number_token(parser, error);
+					break;
+					
+				default:
+					// Unexpected character
+					set_error_unexpected_c(error, c);
+					return VKTOR_ERROR;
+					break;
+			}
+			
+			INCREMENT_BUFFER_PTR(parser);
+			if (done) break;
+		}
+		
+		if (done) break;
+		vktor_parser_advance_buffer(parser);	
+	}
+	
+	assert(parser->nest_ptr >= 0);
+	
+	if (parser->buffer != NULL) {
+		return VKTOR_OK;
+	} else {
+		if (root_value_done(parser)) {
+			return VKTOR_COMPLETE;
+		} else {
+			return VKTOR_MORE_DATA;
+		}
+	}
+}
+
+/**
+ * @brief Append a piece of a captured value
+ * 
+ * Copy a piece of a value captured by vktor_capture_value() which spans more
+ * than one buffer, growing the capture memory geometrically if needed.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [in]     piece  Piece of the value
+ * @param [in]     len    Length of the piece
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK or VKTOR_ERROR
+ */
+static vktor_status
+parser_capture_append(vktor_parser *parser, const char *piece, long len, 
+                      vktor_error **error)
+{
+	char *buff;
+	long  size;
+	
+	if (parser->skip->capture_len + len > parser->skip->capture_size) {
+		size = (parser->skip->capture_size > 0 ? parser->skip->capture_size * 2 : 
+		                                   VKTOR_STR_MEMCHUNK);
+		while (size < parser->skip->capture_len + len) {
+			size *= 2;
+		}
+		
+		if ((buff = vrealloc(parser, parser->skip->capture_buff, size)) == NULL) {
+			set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+				"unable to allocate %ld bytes for captured value", size);
+			return VKTOR_ERROR;
+		}
+		
+		parser->skip->capture_buff = buff;
+		parser->skip->capture_size = size;
+	}
+	
+	memcpy(parser->skip->capture_buff + parser->skip->capture_len, piece, len);
+	parser->skip->capture_len += len;
+	
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Skip a value token by token, hashing or checking it
+ * 
+ * Read the tokens of the value being skipped without returning them, so the
+ * hash of the value is computed, and the value is checked against the 
+ * schema, the same way as if it was read using vktor_parse(). Used by 
+ * vktor_skip_value() when hashing subtrees or validating against a schema.
+ * 
+ * @param [in,out] parser Parser object, with subtree hashing or a schema 
+ *                        enabled
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK once the value is skipped, VKTOR_MORE_DATA or
+ *   VKTOR_ERROR
+ */
+static vktor_status
+parser_skip_tokens(vktor_parser *parser, vktor_error **error)
+{
+	vktor_status status;
+	
+	while ((status = parser_parse_token(parser, error)) == VKTOR_OK) {
+		// The struct ended, or a key was found, instead of a value
+		if (parser->nest_ptr < parser->skip->base || 
+		    (parser->nest_ptr == parser->skip->base && 
+		     parser->token_type == VKTOR_T_OBJECT_KEY)) {
+			set_error(parser, error, VKTOR_ERR_UNEXPECTED_INPUT, 
+				"expecting a value to skip");
+			return VKTOR_ERROR;
+		}
+		
+		if (parser->hash != NULL && 
+		    parser_hash_token(parser, error) == VKTOR_ERROR) {
+			return VKTOR_ERROR;
+		}
+		
+		if (parser->schema != NULL && 
+		    vktor_parser_schema_token(parser, error) == VKTOR_ERROR) {
+			return VKTOR_ERROR;
+		}
+		
+		if (parser->nest_ptr == parser->skip->base && 
+		    parser->token_type != VKTOR_T_STRING_PART) {
+			return VKTOR_OK;
+		}
+	}
+	
+	return status;
+}
+
+/** @} */ // end of internal PAI
+
+/**
+ * External API
+ * 
+ * @defgroup external External API
+ * @{
+ */
+
+/**
+ * @brief Set memory handling function implementation
+ *
+ * Allows one to set alternative implementations of malloc, realloc and free. If 
+ * set, the alternative implementations will be used by vktor globally to manage
+ * memory. Since this has global effect it is recommended to set this once before
+ * doing anything with vktor, and not to change this.
+ *
+ * These functions make up the default allocator, used by parsers which were 
+ * not initialized with an allocator of their own. To use different memory 
+ * management functions per parser, or to pass them a context, use 
+ * vktor_parser_init_allocator() instead.
+ *
+ * You can pass NULL as any of the functions, in which case the standard malloc, 
+ * realloc or free will be used.
+ *
+ * @param [in] vmalloc  malloc implementation
+ * @param [in] vrealloc realloc implementation
+ * @param [in] free     free implementation
+ */
+void 
+vktor_set_memory_handlers(vktor_malloc vmallocf, vktor_realloc vreallocf, 
+                          vktor_free vfreef)
+{
+	global_malloc  = (vmallocf  == NULL ? malloc  : vmallocf);
+	global_realloc = (vreallocf == NULL ? realloc : vreallocf);
+	global_free    = (vfreef    == NULL ? free    : vfreef);
+}
+
+/**
+ * @brief Get the memory size needed for a parser
+ * 
+ * Get the size of the memory block needed to initialize a parser with 
+ * vktor_parser_init_inplace(). This does not depend on the maximal nesting 
+ * level, as the nesting stack is held inside the parser for up to 
+ * VKTOR_NEST_INLINE levels, and only allocated when it grows deeper.
+ * 
+ * @return memory size in bytes
+ */
+size_t
+vktor_parser_size(void)
+{
+	return sizeof(vktor_parser);
+}
+
+/**
+ * @brief Initialize a new parser in caller provided memory
+ * 
+ * Initialize a new parser struct inside a memory block provided by the caller,
+ * for example on the stack or in an arena, without allocating any memory. The 
+ * memory block must be suitably aligned for any type (like memory returned by 
+ * malloc()), and at least vktor_parser_size() bytes long. Any memory 
+ * beyond that is used for token values when parsing complete input (see 
+ * vktor_feed_complete()).
+ * 
+ * The parser still needs to be freed with vktor_parser_free(), which will free
+ * any memory allocated while parsing but not the memory block itself. Parsing 
+ * does not allocate memory for the first few buffers fed to the parser at any
+ * given time.
+ * 
+ * @param [in] mem       memory block
+ * @param [in] size      size of the memory block
+ * @param [in] max_nest  maximal nesting level
+ * @param [in] allocator allocator to use for memory allocated while parsing, 
+ *                       or NULL for the default allocator
+ * 
+ * @return the initialized parser, or NULL if the memory block is too small
+ */
+vktor_parser*
+vktor_parser_init_inplace(void *mem, size_t size, int max_nest, 
+                          const vktor_allocator *allocator)
+{
+	vktor_parser *parser = mem;
+	size_t        min_size = vktor_parser_size();
+	
+	if (mem == NULL || max_nest < 1 || size < min_size) {
+		return NULL;
+	}
+	
+	parser->buffer       = NULL;
+	parser->last_buffer  = NULL;
+	parser->token_type   = VKTOR_T_NONE;
+	parser->token_value  = NULL;
+	parser->token_alloc  = 0;
+	parser->token_resume = 0;
+	parser->unicode_c    = 0;
+	
+	// complete input is only set by vktor_feed_complete()
+	parser->complete_text   = NULL;
+	parser->complete_ptr    = NULL;
+	parser->complete_end    = NULL;
+	parser->complete_free   = 0;
+	parser->token_buff      = NULL;
+	parser->token_buff_size = 0;
+	parser->token_buff_free = 0;
+	
+	if (size > min_size) {
+		parser->token_buff      = (char *) mem + min_size;
+		parser->token_buff_size = size - min_size;
+	}
+	
+	parser->buffer_pool_used = 0;
+	parser->inplace          = 1;
+	parser->string_chunk     = 0;
+	parser->base64           = NULL;
+	parser->skip             = NULL;
+	parser->valid            = NULL;
+	parser->shape            = NULL;
+	parser->key_id           = -1;
+	parser->hash             = NULL;
+	parser->fed              = 0;
+	parser->inflate          = NULL;
+	parser->schema           = NULL;
+	parser->allocator        = (allocator == NULL ? vktor_default_allocator : 
+	                                                *allocator);
+	
+	// set expectated tokens
+	parser->expected   = VKTOR_VALUE_TOKEN;
+
+	// set up nesting stack, stored inside the parser struct until it grows
+	parser->nest_stack = parser->nest_inline;
+	parser->nest_ptr   = 0;
+	parser->nest_size  = VKTOR_NEST_INLINE;
+	parser->max_nest   = max_nest;
+	
+#ifdef BYTECOUNTER
+	parser->bytecounter = 0;
+#endif
+
+	return parser;
+}
+
+/**
+ * @brief Initialize a new parser 
+ * 
+ * Initialize and return a new parser struct. Will return NULL if memory can't 
+ * be allocated.
+ * 
+ * @param [in] max_nest maximal nesting level
+ * 
+ * @return a newly allocated parser
+ */
+vktor_parser*
+vktor_parser_init(int max_nest)
+{
+	return vktor_parser_init_allocator(max_nest, NULL);
+}
+
+/**
+ * @brief Initialize a new parser using an allocator
+ * 
+ * Initialize and return a new parser struct, allocated along with any memory 
+ * used by the parser and its errors using the given allocator. Will return 
+ * NULL if memory can't be allocated.
+ * 
+ * @param [in] max_nest  maximal nesting level
+ * @param [in] allocator allocator to use, or NULL for the default allocator 
+ *                       (see vktor_set_memory_handlers()). It is copied, so 
+ *                       it doesn't need to outlive this call.
+ * 
+ * @return a newly allocated parser
+ */
+vktor_parser*
+vktor_parser_init_allocator(int max_nest, const vktor_allocator *allocator)
+{
+	vktor_parser *parser;
+	size_t        size = vktor_parser_size();
+	void         *mem;
+	
+	if (allocator == NULL) {
+		allocator = &vktor_default_allocator;
+	}
+	
+	if ((mem = allocator->malloc(allocator->ctx, size)) == NULL) {
+		return NULL;
+	}
+	
+	parser = vktor_parser_init_inplace(mem, size, max_nest, allocator);
+	if (parser == NULL) {
+		allocator->free(allocator->ctx, mem);
+		return NULL;
+	}
+	
+	parser->inplace = 0;
+	
+	return parser;
+}
+
+/**
+ * @brief Feed the parser's internal buffer with more JSON data
+ * 
+ * Feed the parser's internal buffer with more JSON data, to be used later when 
+ * parsing. This function should be called before starting to parse at least
+ * once, and again whenever new data is available and the VKTOR_MORE_DATA 
+ * status is returned from vktor_parse().
+ * 
+ * @param [in] parser   parser object
+ * @param [in] text     text to add to buffer
+ * @param [in] text_len length of text to add to buffer
+ * @param [in] char     whether to free the buffer when done (1) or not (0)
+ * @param [in,out] err  pointer to an unallocated error struct to return any 
+ *                      errors, or NULL if there is no need for error handling
+ * 
+ * @return vktor status code 
+ *  - VKTOR_OK on success 
+ *  - VKTOR_ERROR otherwise
+ */
+vktor_status 
+vktor_feed(vktor_parser *parser, char *text, long text_len, 
+           char free, vktor_error **err) 
+{
+	vktor_buffer *buffer;
+	
+	if (parser->complete_text != NULL) {
+		set_error(parser, err, VKTOR_ERR_INVALID_STATE, 
+			"parser was already fed with complete input");
+		return VKTOR_ERROR;
+	}
+	
+#ifdef HAVE_LIBZ
+	if (parser->inflate != NULL && parser->inflate->status < 0) {
+		return parser_inflate_error(parser, err);
+	}
+#endif
+	
+	// Create buffer
+	if ((buffer = buffer_init(parser, text, text_len, free)) == NULL) {
+		set_error(parser, err, VKTOR_ERR_OUT_OF_MEMORY, 
+			"Unable to allocate memory buffer for %ld bytes", text_len);
+		return VKTOR_ERROR;
+	}
+	
+#ifdef HAVE_LIBZ
+	// Compressed input is queued, and only inflated when the parser needs it
+	if (parser->inflate != NULL) {
+		if (parser->inflate->last_input == NULL) {
+			parser->inflate->input = buffer;
+		} else {
+			parser->inflate->last_input->next_buff = buffer;
+		}
+		parser->inflate->last_input = buffer;
+		
+		if (parser->buffer == NULL) {
+			parser_inflate(parser);
+			if (parser->inflate->status < 0) {
+				return parser_inflate_error(parser, err);
+			}
+		}
+		
+		return VKTOR_OK;
+	}
+#endif
+	
+	parser->fed += text_len;
+	
+	// Link buffer to end of parser buffer chain
+	if (parser->last_buffer == NULL) {
+		assert(parser->buffer == NULL);
+		parser->buffer = buffer;
+		parser->last_buffer = buffer;
+	} else {
+		parser->last_buffer->next_buff = buffer;
+		parser->last_buffer = buffer;
+	}
+	
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Feed the parser with a complete JSON document
+ * 
+ * Feed the parser with an entire JSON document which is already available in
+ * a single contiguous buffer. vktor_parse() will then read tokens using a 
+ * faster code path which does not need to handle tokens split across buffers,
+ * and will reuse a single memory block for all token values.
+ * 
+ * This function must be called once on a new parser, and the parser cannot be
+ * fed with any more data afterwards. If the end of the text is reached before
+ * the document is complete, vktor_parse() will fail with 
+ * VKTOR_ERR_INCOMPLETE_DATA instead of returning VKTOR_MORE_DATA.
+ * 
+ * @param [in] parser   parser object
+ * @param [in] text     complete JSON text
+ * @param [in] text_len length of text
+ * @param [in] free     whether to free the text when done (1) or not (0)
+ * @param [in,out] err  pointer to an unallocated error struct to return any 
+ *                      errors, or NULL if there is no need for error handling
+ * 
+ * @return vktor status code 
+ *  - VKTOR_OK on success 
+ *  - VKTOR_ERROR otherwise
+ */
+vktor_status 
+vktor_feed_complete(vktor_parser *parser, char *text, long text_len, 
+                    char free, vktor_error **err)
+{
+	assert(parser != NULL);
+	assert(text != NULL);
+	
+	if (parser->complete_text != NULL || parser->buffer != NULL ||
+	    parser->token_type != VKTOR_T_NONE) {
+		set_error(parser, err, VKTOR_ERR_INVALID_STATE, 
+			"complete input can only be fed to a new parser");
+		return VKTOR_ERROR;
+	}
+	
+	if (parser->inflate != NULL) {
+		set_error(parser, err, VKTOR_ERR_INVALID_STATE, 
+			"compressed input can't be fed as complete input");
+		return VKTOR_ERROR;
+	}
+	
+	parser->complete_text = text;
+	parser->complete_ptr  = text;
+	parser->complete_end  = text + text_len;
+	parser->complete_free = free;
+	
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Read compressed input
+ * 
+ * Enable an input stage which inflates gzip or zlib compressed data fed using
+ * vktor_feed(). Compressed buffers are queued, and inflated one chunk at a 
+ * time into buffers of chunk_size bytes whenever the parser reaches the end of
+ * the previous one, so parsing works on inflated data while it is still in 
+ * the CPU cache. 
+ * 
+ * @param [in,out] parser     parser object
+ * @param [in]     chunk_size size of inflated buffers, or 0 for the default
+ * @param [out]    error      error object pointer pointer or NULL
+ * 
+ * @return VKTOR_OK or VKTOR_ERROR if the parser was already fed, memory can't
+ *         be allocated or vktor was built without zlib
+ */
+vktor_status
+vktor_enable_inflate(vktor_parser *parser, long chunk_size, 
+                     vktor_error **error)
+{
+#ifdef HAVE_LIBZ
+	struct _vktor_inflate_struct *inf;
+	
+	assert(parser != NULL);
+	assert(chunk_size >= 0);
+	
+	if (parser->inflate != NULL) {
+		return VKTOR_OK;
+	}
+	
+	if (parser->complete_text != NULL || parser->buffer != NULL || 
+	    parser->fed != 0 || parser->token_type != VKTOR_T_NONE) {
+		set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"compressed input can only be enabled on a new parser");
+		return VKTOR_ERROR;
+	}
+	
+	if ((inf = vmalloc(parser, sizeof(struct _vktor_inflate_struct))) == NULL) {
+		set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+			"unable to allocate %d bytes for inflate stream", 
+			(int) sizeof(struct _vktor_inflate_struct));
+		return VKTOR_ERROR;
+	}
+	
+	inf->stream.zalloc   = inflate_alloc;
+	inf->stream.zfree    = inflate_free;
+	inf->stream.opaque   = parser;
+	inf->stream.next_in  = Z_NULL;
+	inf->stream.avail_in = 0;
+	
+	// 15 + 32 - maximal window size, detect either a gzip or a zlib header
+	if (inflateInit2(&inf->stream, 15 + 32) != Z_OK) {
+		set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+			"unable to initialize inflate stream");
+		vfree(parser, inf);
+		return VKTOR_ERROR;
+	}
+	
+	inf->input      = NULL;
+	inf->last_input = NULL;
+	inf->chunk      = (chunk_size > 0 ? chunk_size : VKTOR_INFLATE_CHUNK);
+	inf->status     = Z_OK;
+	inf->in         = 0;
+	inf->out        = 0;
+	
+	parser->inflate = inf;
+	
+	return VKTOR_OK;
+#else
+	set_error(parser, error, VKTOR_ERR_UNSUPPORTED, 
+		"vktor was built without zlib support");
+	return VKTOR_ERROR;
+#endif
+}
+
+/**
+ * @brief Get the compressed input statistics
+ * 
+ * @param [in]  parser   parser object
+ * @param [out] in       number of compressed bytes read
+ * @param [out] inflated number of inflated bytes
+ */
+void
+vktor_get_inflate_stats(vktor_parser *parser, long long *in, 
+                        long long *inflated)
+{
+	assert(parser != NULL);
+	
+	*in       = 0;
+	*inflated = 0;
+	
+#ifdef HAVE_LIBZ
+	if (parser->inflate != NULL) {
+		*in       = parser->inflate->in;
+		*inflated = parser->inflate->out;
+	}
+#endif
+}
+
+/**
+ * @brief Deliver long string values in parts
+ * 
+ * Set the size at which string values are delivered in parts instead of as a 
+ * single token, so memory stays bounded when reading very long strings. Once 
+ * a string value reaches chunk_size bytes, vktor_parse() returns it as a 
+ * VKTOR_T_STRING_PART token and continues reading the rest of the string on 
+ * the next call. The last part of the string is returned as a regular 
+ * VKTOR_T_STRING token, which is also how strings shorter than chunk_size are
+ * returned. 
+ * 
+ * Parts are split on byte boundaries, so a multi-byte UTF-8 character may be 
+ * split between two parts. The value of each part is only valid until the 
+ * next call to vktor_parse(). Object keys are always returned whole, as are 
+ * strings read from complete input (see vktor_feed_complete()) which is 
+ * already held in memory.
+ * 
+ * @param [in,out] parser     parser object
+ * @param [in]     chunk_size part size in bytes, or 0 to disable (the default)
+ */
+void
+vktor_set_string_chunk(vktor_parser *parser, long chunk_size)
+{
+	assert(parser != NULL);
+	assert(chunk_size >= 0);
+	
+	parser->string_chunk = chunk_size;
+}
+
+/**
+ * @brief Enable the object key shape cache
+ * 
+ * Enable a cache of the keys of the last object read at each nesting level.
+ * When objects have the same keys in the same order, as records of an array
+ * usually do, each key is verified against the input with a single memcmp()
+ * and copied from the cache instead of being decoded character by character.
+ * Keys which don't match fall back to regular decoding and replace the cached
+ * key. Only the first few nesting levels and keys of each object are cached. 
+ * 
+ * Hits and misses can be checked with vktor_get_shape_stats(), and the 
+ * position of a key found in the cache with vktor_get_key_id(). 
+ * 
+ * @param [in,out] parser Parser object
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return VKTOR_OK or VKTOR_ERROR if memory can't be allocated
+ */
+vktor_status
+vktor_enable_shape_cache(vktor_parser *parser, vktor_error **error)
+{
+	int i, j;
+	
+	assert(parser != NULL);
+	
+	if (parser->shape != NULL) {
+		return VKTOR_OK;
+	}
+	
+	parser->shape = vmalloc(parser, sizeof(vktor_shape_cache));
+	if (parser->shape == NULL) {
+		set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+			"unable to allocate %d bytes for shape cache", 
+			(int) sizeof(vktor_shape_cache));
+		return VKTOR_ERROR;
+	}
+	
+	for (i = 0; i < VKTOR_SHAPE_DEPTH; i++) {
+		for (j = 0; j < VKTOR_SHAPE_KEYS; j++) {
+			parser->shape->keys[i][j].len = -1;
+		}
+		parser->shape->pos[i] = 0;
+	}
+	parser->shape->hits   = 0;
+	parser->shape->misses = 0;
+	
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Get the shape cache statistics
+ * 
+ * Get the number of object keys found in the shape cache, and the number of 
+ * object keys which had to be decoded since the cache was enabled. Both are 
+ * 0 if the shape cache is not enabled.
+ * 
+ * @param [in]  parser Parser object
+ * @param [out] hits   number of keys found in the cache
+ * @param [out] misses number of keys not found in the cache
+ */
+void
+vktor_get_shape_stats(vktor_parser *parser, long *hits, long *misses)
+{
+	assert(parser != NULL);
+	
+	*hits   = (parser->shape != NULL ? parser->shape->hits : 0);
+	*misses = (parser->shape != NULL ? parser->shape->misses : 0);
+}
+
+/**
+ * @brief Enable subtree hashing
+ * 
+ * Compute a 64 bit hash of every value as it is parsed. The hash of an array
+ * or an object covers all of its contents, and is available when its end 
+ * token is returned. Hashes only depend on the tokens of the value, and not 
+ * on whitespace, escaping or how the input is split into buffers, so equal 
+ * values always have equal hashes. They can be used to find repeated values,
+ * such as embedded objects which were already decoded.
+ * 
+ * When subtree hashing is enabled, vktor_skip_value() reads the skipped value
+ * token by token so its hash is available once it is skipped, and values can't
+ * be read using vktor_read_base64() or the number array readers. 
+ * 
+ * Subtree hashing can only be enabled before the parser enters an array or
+ * an object.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return VKTOR_OK or VKTOR_ERROR
+ */
+vktor_status
+vktor_enable_subtree_hash(vktor_parser *parser, vktor_error **error)
+{
+	vktor_subtree_hasher *hash;
+	
+	assert(parser != NULL);
+	
+	if (parser->hash != NULL) {
+		return VKTOR_OK;
+	}
+	
+	if (parser->nest_ptr > 0 || parser->token_resume) {
+		set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"subtree hashing must be enabled at the top level");
+		return VKTOR_ERROR;
+	}
+	
+	hash = vktor_parser_alloc_state(parser, sizeof(vktor_subtree_hasher), error);
+	if (hash == NULL) {
+		return VKTOR_ERROR;
+	}
+	
+	hash->size  = 16;
+	hash->stack = vmalloc(parser, sizeof(unsigned long long) * hash->size);
+	if (hash->stack == NULL) {
+		vfree(parser, hash);
+		set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+			"unable to allocate %d bytes for subtree hashes", 
+			(int) sizeof(unsigned long long) * 16);
+		return VKTOR_ERROR;
+	}
+	
+	parser->hash = hash;
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Read and decode a base64 encoded string value
+ * 
+ * Read the next value, which must be a string, decoding its base64 encoded 
+ * contents directly into the output buffer instead of copying the encoded 
+ * text into a token. Can be called instead of vktor_parse() whenever a value 
+ * is expected. 
+ * 
+ * If the output buffer fills up or the input runs out before the end of the 
+ * string, VKTOR_OK is returned with a token type of VKTOR_T_STRING_PART and 
+ * vktor_read_base64() must be called again to read the rest of the string. 
+ * Once the string is read, the token type is VKTOR_T_STRING. While a string is
+ * partially read, calling vktor_parse() is an error. 
+ * 
+ * Both the standard and the URL-safe alphabet are accepted, padding is 
+ * optional and escaped slashes and line breaks are allowed.
+ * 
+ * @param [in,out] parser   Parser object
+ * @param [out]    out      Output buffer
+ * @param [in]     out_size Size of the output buffer, at least 3 bytes
+ * @param [out]    out_len  Number of bytes written to the output buffer
+ * @param [out]    error    Error object pointer pointer or NULL
+ * 
+ * @return status code:
+ *  - VKTOR_OK        if the string or a part of it was decoded
+ *  - VKTOR_ERROR     if an error has occured, including if the next value is
+ *                    not a string or is not valid base64
+ *  - VKTOR_MORE_DATA if we need more data in order to continue reading
+ */
+vktor_status
+vktor_read_base64(vktor_parser *parser, unsigned char *out, long out_size, 
+                  long *out_len, vktor_error **error)
+{
+	vktor_status  status;
+	char         *pos, *start;
+	
+	assert(parser != NULL);
+	assert(out != NULL);
+	assert(out_size >= 3);
+	assert(out_len != NULL);
+	
+	*out_len = 0;
+	
+	if ((parser->token_resume && ! base64_active(parser)) ||
+	    skip_active(parser)) {
+		set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"a token is partially read, use vktor_parse()");
+		return VKTOR_ERROR;
+	}
+	
+	// Values which are not read as tokens can't be hashed
+	if (parser->hash != NULL) {
+		set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"strings can't be read as base64 while hashing subtrees");
+		return VKTOR_ERROR;
+	}
+	
+	if (parser->schema != NULL) {
+		set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"strings can't be read as base64 while a schema is enabled");
+		return VKTOR_ERROR;
+	}
+	
+	if (parser->base64 == NULL) {
+		parser->base64 = vktor_parser_alloc_state(parser, 
+			sizeof(vktor_base64_decoder), error);
+		if (parser->base64 == NULL) {
+			return VKTOR_ERROR;
+		}
+	}
+	
+	if (parser->complete_text != NULL) {
+		// Token values point to the reused token memory and are never freed
+		parser->token_value = NULL;
+		
+		pos = parser->complete_ptr;
+		status = parser_read_base64(parser, &pos, parser->complete_end, 
+			out, out_size, out_len, error);
+		if (status == VKTOR_MORE_DATA) {
+			complete_error_incomplete(parser, pos);
+		}
+		
+		vktor_complete_set_position(parser, pos);
+		return status;
+	}
+	
+	while (parser->buffer != NULL) {
+		start = pos = parser->buffer->text + parser->buffer->ptr;
+		status = parser_read_base64(parser, &pos, 
+			parser->buffer->text + parser->buffer->size, 
+			out, out_size, out_len, error);
+		
+		parser->buffer->ptr += pos - start;
+#ifdef BYTECOUNTER
+		parser->bytecounter += pos - start;
+#endif
+		
+		if (status != VKTOR_MORE_DATA) {
+			return status;
+		}
+		
+		vktor_parser_advance_buffer(parser);
+	}
+	
+	// Hand over what was decoded so far before asking for more data
+	if (*out_len > 0) {
+		parser->token_type = VKTOR_T_STRING_PART;
+		return VKTOR_OK;
+	}
+	
+	return VKTOR_MORE_DATA;
+}
+
+/**
+ * @brief Skip the next value
+ * 
+ * Skip over the next value, including all of its contents if it is an array
+ * or an object, without creating any tokens or allocating memory for them. 
+ * Can be called instead of vktor_parse() whenever a value is expected, for 
+ * example right after reading an object key which is not of interest. Once
+ * the value is skipped, the token type is VKTOR_T_NONE.
+ * 
+ * Skipped values are only checked for balanced arrays and objects, unless 
+ * a schema is enabled. While a value is partially skipped, calling 
+ * vktor_parse() is an error.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return status code:
+ *  - VKTOR_OK        if the value was skipped
+ *  - VKTOR_ERROR     if an error has occured
+ *  - VKTOR_MORE_DATA if we need more data in order to continue skipping
+ */
+vktor_status
+vktor_skip_value(vktor_parser *parser, vktor_error **error)
+{
+	vktor_status  status;
+	char         *pos, *start;
+	
+	assert(parser != NULL);
+	
+	if (! skip_active(parser)) {
+		if (parser->token_resume || base64_active(parser)) {
+			set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+				"a token is partially read, use vktor_parse()");
+			return VKTOR_ERROR;
+		}
+		
+		if (vktor_parser_skip_start(parser, error) == VKTOR_ERROR) {
+			return VKTOR_ERROR;
+		}
+		
+		if (parser->complete_text != NULL) {
+			// Token values point to the reused token memory and are never freed
+			parser->token_value = NULL;
+		}
+		
+		vktor_parser_set_token(parser, VKTOR_T_NONE, NULL);
+		
+		// Values are hashed, or checked against the schema, token by token
+		if (parser->hash != NULL || 
+		    (parser->schema != NULL && ! vktor_parser_schema_any(parser))) {
+			parser->skip->state = VKTOR_SKIP_TOKENS;
+		}
+		
+	} else if (parser->skip->capture) {
+		set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"a value is being captured by vktor_capture_value()");
+		return VKTOR_ERROR;
+	}
+	
+	if (parser->skip->state == VKTOR_SKIP_TOKENS) {
+		status = parser_skip_tokens(parser, error);
+		
+	} else if (parser->complete_text != NULL) {
+		pos = parser->complete_ptr;
+		status = vktor_parser_skip(parser, &pos, parser->complete_end, NULL, error);
+		
+		// A number, true, false or null may end with the input
+		if (status == VKTOR_MORE_DATA && 
+		    parser->skip->state == VKTOR_SKIP_SCALAR &&
+		    parser->nest_ptr == parser->skip->base) {
+			status = VKTOR_OK;
+		}
+		
+		if (status == VKTOR_MORE_DATA) {
+			complete_error_incomplete(parser, pos);
+		}
+		
+		vktor_complete_set_position(parser, pos);
+		
+	} else {
+		status = VKTOR_MORE_DATA;
+		while (parser->buffer != NULL) {
+			start = pos = parser->buffer->text + parser->buffer->ptr;
+			status = vktor_parser_skip(parser, &pos, 
+				parser->buffer->text + parser->buffer->size, NULL, error);
+			
+			parser->buffer->ptr += pos - start;
+#ifdef BYTECOUNTER
+			parser->bytecounter += pos - start;
+#endif
+			
+			if (status != VKTOR_MORE_DATA) {
+				break;
+			}
+			
+			vktor_parser_advance_buffer(parser);
+		}
+	}
+	
+	if (status == VKTOR_OK) {
+		if (parser->skip->state == VKTOR_SKIP_TOKENS) {
+			// The tokens of the value are not returned
+			if (parser->complete_text != NULL) {
+				parser->token_value = NULL;
+			}
+			vktor_parser_set_token(parser, VKTOR_T_NONE, NULL);
+		}
+		
+		parser->skip->state = VKTOR_SKIP_NONE;
+		expect_next_value_token(parser);
+	}
+	
+	return status;
+}
+
+/**
+ * @brief Capture the raw input of the next value
+ * 
+ * Skip over the next value the same way vktor_skip_value() does, and return 
+ * its exact input bytes, from its first to its last character. This allows 
+ * passing values through without reading and writing them token by token.
+ * 
+ * If the value is contained in a single input buffer, or the parser was fed
+ * complete input, value points into the input itself. Otherwise the pieces 
+ * of the value are copied into memory held by the parser. Either way, value
+ * is only valid until the next call to any other parser function. Like 
+ * skipped values, captured values are only checked for balanced arrays and 
+ * objects, and they can't be captured while hashing subtrees or while a 
+ * schema is enabled.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [out]    value  Set to the raw value, which is not NULL terminated
+ * @param [out]    len    Set to the length of the raw value
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return status code:
+ *  - VKTOR_OK        if the value was captured
+ *  - VKTOR_ERROR     if an error has occured
+ *  - VKTOR_MORE_DATA if we need more data in order to continue capturing
+ */
+vktor_status
+vktor_capture_value(vktor_parser *parser, char **value, long *len, 
+                    vktor_error **error)
+{
+	vktor_status  status;
+	char         *pos, *start, *piece;
+	
+	assert(parser != NULL);
+	
+	if (! skip_active(parser)) {
+		if (parser->token_resume || base64_active(parser)) {
+			set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+				"a token is partially read, use vktor_parse()");
+			return VKTOR_ERROR;
+		}
+		
+		// Values which are not read as tokens can't be hashed
+		if (parser->hash != NULL) {
+			set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+				"values can't be captured while hashing subtrees");
+			return VKTOR_ERROR;
+		}
+		
+		if (parser->schema != NULL) {
+			set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+				"values can't be captured while a schema is enabled");
+			return VKTOR_ERROR;
+		}
+		
+		if (vktor_parser_skip_start(parser, error) == VKTOR_ERROR) {
+			return VKTOR_ERROR;
+		}
+		
+		if (parser->complete_text != NULL) {
+			// Token values point to the reused token memory and are never freed
+			parser->token_value = NULL;
+		}
+		
+		vktor_parser_set_token(parser, VKTOR_T_NONE, NULL);
+		parser->skip->capture     = 1;
+		parser->skip->capture_len = 0;
+		
+	} else if (! parser->skip->capture) {
+		set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"a value is being skipped by vktor_skip_value()");
+		return VKTOR_ERROR;
+	}
+	
+	if (parser->complete_text != NULL) {
+		// The whole value is always read at once
+		pos = parser->complete_ptr;
+		status = vktor_parser_skip(parser, &pos, parser->complete_end, &piece, error);
+		
+		// A number, true, false or null may end with the input
+		if (status == VKTOR_MORE_DATA && 
+		    parser->skip->state == VKTOR_SKIP_SCALAR &&
+		    parser->nest_ptr == parser->skip->base) {
+			status = VKTOR_OK;
+		}
+		
+		if (status == VKTOR_MORE_DATA) {
+			complete_error_incomplete(parser, pos);
+		}
+		
+		vktor_complete_set_position(parser, pos);
+		
+		if (status == VKTOR_OK) {
+			*value = piece;
+			*len   = pos - piece;
+		}
+		
+	} else {
+		status = VKTOR_MORE_DATA;
+		while (parser->buffer != NULL) {
+			start = pos = parser->buffer->text + parser->buffer->ptr;
+			piece = NULL;
+			status = vktor_parser_skip(parser, &pos, 
+				parser->buffer->text + parser->buffer->size, &piece, error);
+			
+			parser->buffer->ptr += pos - start;
+#ifdef BYTECOUNTER
+			parser->bytecounter += pos - start;
+#endif
+			
+			if (status == VKTOR_ERROR) {
+				break;
+			}
+			
+			// A value contained in this buffer is returned as is
+			if (status == VKTOR_OK && piece != NULL) {
+				*value = piece;
+				*len   = pos - piece;
+				break;
+			}
+			
+			// Otherwise, keep the piece of the value in this buffer
+			if (piece == NULL && parser->skip->state != VKTOR_SKIP_START) {
+				piece = start;
 			}
 			
-			INCREMENT_BUFFER_PTR(parser);
-			if (done) break;
+			if (piece != NULL && 
+			    parser_capture_append(parser, piece, pos - piece, error) == 
+			    VKTOR_ERROR) {
+				status = VKTOR_ERROR;
+				break;
+			}
+			
+			if (status == VKTOR_OK) {
+				*value = parser->skip->capture_buff;
+				*len   = parser->skip->capture_len;
+				break;
+			}
+			
+			vktor_parser_advance_buffer(parser);
 		}
-		
-		if (done) break;
-		parser_advance_buffer(parser);	
 	}
 	
-	assert(parser->nest_ptr >= 0);
+	if (status == VKTOR_OK) {
+		parser->skip->state = VKTOR_SKIP_NONE;
+		parser->skip->capture    = 0;
+		expect_next_value_token(parser);
+	}
 	
-	if (parser->buffer != NULL) {
-		return VKTOR_OK;
-	} else {
-		if (parser->nest_ptr == 0 && parser->token_type != VKTOR_T_NONE) {
-			return VKTOR_COMPLETE;
-		} else {
-			return VKTOR_MORE_DATA;
-		}
+	return status;
+}
+
+/**
+ * @brief Read the numbers of an array into an array of doubles
+ * 
+ * Read consecutive numbers of the current array directly into out, without 
+ * creating a token for each number. Can be called right after the 
+ * VKTOR_T_ARRAY_START token or any value inside an array. Reading stops:
+ *  - At the end of the array, which is consumed, and the token type is then 
+ *    VKTOR_T_ARRAY_END
+ *  - Before the first value which is not a number, or when out is full, and
+ *    the token type is then VKTOR_T_NONE. If out is not full, the next value
+ *    should be read using vktor_parse().
+ *  - After a number which cannot be stored in out, such as one which is out 
+ *    of range. The number is then the current token, and can be read using 
+ *    the vktor_get_value_*() functions.
+ * 
+ * Values stored in out are valid whenever count is set, including when 
+ * VKTOR_MORE_DATA is returned. 
+ * 
+ * @param [in,out] parser Parser object
+ * @param [out]    out    Output array
+ * @param [in]     cap    Number of elements in out
+ * @param [out]    count  Number of elements stored in out
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return status code:
+ *  - VKTOR_OK        if reading stopped as described above
+ *  - VKTOR_ERROR     if an error has occured, or if not reading an array
+ *  - VKTOR_MORE_DATA if we need more data in order to continue reading
+ */
+vktor_status
+vktor_read_number_array(vktor_parser *parser, double *out, long cap, 
+                        long *count, vktor_error **error)
+{
+	return parser_read_number_array(parser, VKTOR_NUM_DOUBLE, out, cap, count,
+		error);
+}
+
+/**
+ * @brief Read the numbers of an array into an array of floats
+ * 
+ * Same as vktor_read_number_array(), only numbers are stored as single 
+ * precision floats. Numbers beyond the range of a float are not stored.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [out]    out    Output array
+ * @param [in]     cap    Number of elements in out
+ * @param [out]    count  Number of elements stored in out
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return status code, see vktor_read_number_array()
+ */
+vktor_status
+vktor_read_float_array(vktor_parser *parser, float *out, long cap, 
+                       long *count, vktor_error **error)
+{
+	return parser_read_number_array(parser, VKTOR_NUM_FLOAT, out, cap, count,
+		error);
+}
+
+/**
+ * @brief Read the numbers of an array into an array of 64 bit integers
+ * 
+ * Same as vktor_read_number_array(), only numbers are stored as 64 bit 
+ * integers. Floating point numbers and integers beyond the range of a long 
+ * long are not stored.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [out]    out    Output array
+ * @param [in]     cap    Number of elements in out
+ * @param [out]    count  Number of elements stored in out
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return status code, see vktor_read_number_array()
+ */
+vktor_status
+vktor_read_int64_array(vktor_parser *parser, long long *out, long cap, 
+                       long *count, vktor_error **error)
+{
+	return parser_read_number_array(parser, VKTOR_NUM_INT64, out, cap, count,
+		error);
+}
+
+/**
+ * @brief Parse some JSON text and return on the next token
+ * 
+ * Parse the text buffer until the next JSON token is encountered
+ * 
+ * In case of error, if error is not NULL, it will be populated with error 
+ * information, and VKTOR_ERROR will be returned
+ * 
+ * @param [in,out] parser The parser object to work with
+ * @param [out]    error  A vktor_error pointer pointer, or NULL
+ * 
+ * @return status code:
+ *  - VKTOR_OK        if a token was encountered
+ *  - VKTOR_ERROR     if an error has occured
+ *  - VKTOR_MORE_DATA if we need more data in order to continue parsing
+ *  - VKTOR_COMPLETE  if parsing is complete and no further data is expected
+ */
+vktor_status 
+vktor_parse(vktor_parser *parser, vktor_error **error)
+{
+	vktor_status status;
+	
+	assert(parser != NULL);
+	
+	// A base64 string must be read to its end by vktor_read_base64()
+	if (base64_active(parser)) {
+		set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"a base64 string is being read by vktor_read_base64()");
+		return VKTOR_ERROR;
+	}
+	
+	// A document being validated must be validated to its end
+	if (valid_active(parser)) {
+		set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"the document is being validated by vktor_validate()");
+		return VKTOR_ERROR;
+	}
+	
+	// A skipped value must be skipped to its end by vktor_skip_value()
+	if (skip_active(parser)) {
+		set_error(parser, error, VKTOR_ERR_INVALID_STATE, (parser->skip->capture ? 
+			"a value is being captured by vktor_capture_value()" : 
+			"a value is being skipped by vktor_skip_value()"));
+		return VKTOR_ERROR;
+	}
+	
+	status = parser_parse_token(parser, error);
+	
+#ifdef HAVE_LIBZ
+	// Running out of data may be due to an inflate error
+	if (status == VKTOR_MORE_DATA && parser->inflate != NULL && 
+	    parser->inflate->status < 0) {
+		return parser_inflate_error(parser, error);
 	}
+#endif
+	
+	if (status == VKTOR_OK && parser->hash != NULL && 
+	    parser_hash_token(parser, error) == VKTOR_ERROR) {
+		return VKTOR_ERROR;
+	}
+	
+	if (status == VKTOR_OK && parser->schema != NULL) {
+		return vktor_parser_schema_token(parser, error);
+	}
+	
+	return status;
 }
 
 /**
@@ -1566,6 +4679,62 @@ vktor_get_depth(vktor_parser *parser)
 	return parser->nest_ptr;	
 }
 
+/**
+ * @brief Get the subtree hash of the current value
+ * 
+ * Get the hash of the value which ended with the current token: a scalar 
+ * value, or an array or object if the current token is its end token. Also 
+ * available after a value was skipped with vktor_skip_value(). Subtree 
+ * hashing must be enabled using vktor_enable_subtree_hash().
+ * 
+ * @param [in]  parser Parser object
+ * @param [out] hash   hash of the value
+ * @param [out] error  Error object pointer pointer or NULL
+ * 
+ * @return VKTOR_OK, or VKTOR_ERROR if no value ended with the current token
+ */
+vktor_status
+vktor_get_subtree_hash(vktor_parser *parser, unsigned long long *hash, 
+                       vktor_error **error)
+{
+	assert(parser != NULL);
+	
+	if (parser->hash == NULL || ! parser->hash->valid || 
+	    skip_active(parser)) {
+		set_error(parser, error, VKTOR_ERR_NO_VALUE, 
+			"no value hash is available for the current token");
+		return VKTOR_ERROR;
+	}
+	
+	*hash = parser->hash->value;
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Get the shape cache position of the current object key
+ * 
+ * Get the position of the current object key in its object, if the key was
+ * found in the shape cache (see vktor_enable_shape_cache()). As long as 
+ * objects keep the same shape, the same key always has the same position, 
+ * which can be used to identify it without comparing strings.
+ * 
+ * @param [in] parser Parser object
+ * 
+ * @return key position, or -1 if the current token is not an object key or 
+ *   the key was not found in the shape cache
+ */
+int
+vktor_get_key_id(vktor_parser *parser)
+{
+	assert(parser != NULL);
+	
+	if (parser->token_type != VKTOR_T_OBJECT_KEY || parser->token_resume) {
+		return -1;
+	}
+	
+	return parser->key_id;
+}
+
 /**
  * @brief Get the current struct type
  * 
@@ -1581,7 +4750,7 @@ vktor_struct
 vktor_get_current_struct(vktor_parser *parser)
 {
 	assert(parser != NULL);
-	return parser->nest_stack[parser->nest_ptr];
+	return nest_stack_top(parser);
 }
 
 /**
@@ -1627,14 +4796,14 @@ vktor_get_value_long(vktor_parser *parser, vktor_error **error)
 	assert(parser != NULL);
 	
 	if (parser->token_value == NULL) {
-		set_error(error, VKTOR_ERR_NO_VALUE, "token value is unknown");
+		set_error(parser, error, VKTOR_ERR_NO_VALUE, "token value is unknown");
 		return 0;
 	}
 	
 	errno = 0;
 	val = strtol((char *) parser->token_value, NULL, 10);
 	if (errno == ERANGE) {
-		set_error(error, VKTOR_ERR_OUT_OF_RANGE,
+		set_error(parser, error, VKTOR_ERR_OUT_OF_RANGE,
 			"integer value overflows maximal long value");
 		return 0;
 	}
@@ -1667,14 +4836,14 @@ vktor_get_value_double(vktor_parser *parser, vktor_error **error)
 	assert(parser != NULL);
 	
 	if (parser->token_value == NULL) {
-		set_error(error, VKTOR_ERR_NO_VALUE, "token value is unknown");
+		set_error(parser, error, VKTOR_ERR_NO_VALUE, "token value is unknown");
 		return 0;
 	}
 	
 	errno = 0;
 	val = strtod((char *) parser->token_value, NULL);
 	if (errno == ERANGE) {
-		set_error(error, VKTOR_ERR_OUT_OF_RANGE,
+		set_error(parser, error, VKTOR_ERR_OUT_OF_RANGE,
 			"number value overflows maximal double value");
 		return 0;
 	}
@@ -1706,7 +4875,7 @@ vktor_get_value_str(vktor_parser *parser, char **val, vktor_error **error)
 	assert(parser != NULL);
 	
 	if (parser->token_value == NULL) {
-		set_error(error, VKTOR_ERR_NO_VALUE, "token value is unknown");
+		set_error(parser, error, VKTOR_ERR_NO_VALUE, "token value is unknown");
 		return -1;
 	}
 	
@@ -1719,7 +4888,8 @@ vktor_get_value_str(vktor_parser *parser, char **val, vktor_error **error)
  * 
  * Similar to vktor_get_value_str(), only this function will provide a copy of 
  * the string, which will need to be freed by the user when it is no longer 
- * used. 
+ * used. The copy is allocated using the parser's allocator, and should be 
+ * freed using vktor_value_str_free(). 
  * 
  * @param [in]  parser Parser object
  * @param [out] val    Pointer-pointer to be populated with the value
@@ -1737,18 +4907,153 @@ vktor_get_value_str_copy(vktor_parser *parser, char **val, vktor_error **error)
 	assert(parser != NULL);
 	
 	if (parser->token_value == NULL) {
-		set_error(error, VKTOR_ERR_NO_VALUE, "token value is unknown");
+		set_error(parser, error, VKTOR_ERR_NO_VALUE, "token value is unknown");
+		return 0;
+	}
+	
+	str = vmalloc(parser, sizeof(char) * (parser->token_size + 1));
+	if (str == NULL) {
+		set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+			"unable to allocate %d bytes for string copy", 
+			parser->token_size + 1);
 		return 0;
 	}
 	
-	str = vmalloc(sizeof(char) * (parser->token_size + 1));
-	str = memcpy(str, parser->token_value, parser->token_size);
+	memcpy(str, parser->token_value, parser->token_size);
 	str[parser->token_size] = '\0';
 	
 	*val = str;
 	return parser->token_size;
 }
 
+/**
+ * @brief Free a string copied by vktor_get_value_str_copy()
+ * 
+ * Free a string copy using the allocator of the parser it was copied by. 
+ * Copies made by parsers using the default allocator can also be freed after
+ * the parser is freed, using the free function set by 
+ * vktor_set_memory_handlers() (free() by default).
+ * 
+ * @param [in]     parser Parser object which copied the string
+ * @param [in,out] str    String to free
+ */
+void
+vktor_value_str_free(vktor_parser *parser, char *str)
+{
+	assert(parser != NULL);
+	
+	vfree(parser, str);
+}
+
+/**
+ * @brief Get the token value as a timestamp
+ * 
+ * Decode the value of the current token as an RFC 3339 timestamp. The value 
+ * is decoded in place, without copying or NULL termination.
+ * 
+ * @param [in]  parser Parser object
+ * @param [out] ts     Populated with the decoded time
+ * @param [out] error  Error object pointer pointer or NULL
+ * 
+ * @return Status code - VKTOR_OK or VKTOR_ERROR
+ */
+vktor_status
+vktor_get_value_timespec(vktor_parser *parser, struct timespec *ts, 
+                         vktor_error **error)
+{
+	assert(parser != NULL);
+	assert(ts != NULL);
+	
+	if (parser->token_value == NULL) {
+		set_error(parser, error, VKTOR_ERR_NO_VALUE, "token value is unknown");
+		return VKTOR_ERROR;
+	}
+	
+	if (! vktor_typed_timestamp((char *) parser->token_value, 
+	                            parser->token_size, ts)) {
+		set_error(parser, error, VKTOR_ERR_INVALID_FORMAT, 
+			"value is not a valid timestamp");
+		return VKTOR_ERROR;
+	}
+	
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Get the token value as a UUID
+ * 
+ * Decode the value of the current token as a UUID into 16 bytes. The value is
+ * decoded in place, without copying or NULL termination.
+ * 
+ * @param [in]  parser Parser object
+ * @param [out] uuid   16 byte buffer populated with the UUID
+ * @param [out] error  Error object pointer pointer or NULL
+ * 
+ * @return Status code - VKTOR_OK or VKTOR_ERROR
+ */
+vktor_status
+vktor_get_value_uuid(vktor_parser *parser, unsigned char *uuid, 
+                     vktor_error **error)
+{
+	assert(parser != NULL);
+	assert(uuid != NULL);
+	
+	if (parser->token_value == NULL) {
+		set_error(parser, error, VKTOR_ERR_NO_VALUE, "token value is unknown");
+		return VKTOR_ERROR;
+	}
+	
+	if (! vktor_typed_uuid((char *) parser->token_value, parser->token_size, 
+	                       uuid)) {
+		set_error(parser, error, VKTOR_ERR_INVALID_FORMAT, 
+			"value is not a valid UUID");
+		return VKTOR_ERROR;
+	}
+	
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Get the token value as a hexadecimal number
+ * 
+ * Decode the value of the current token as up to 16 hexadecimal digits. The 
+ * value is decoded in place, without copying or NULL termination.
+ * 
+ * @param [in]  parser Parser object
+ * @param [out] error  Error object pointer pointer or NULL
+ * 
+ * @return The numeric value of the current token
+ * @retval 0 in case of error (although 0 might also be normal, so check the 
+ *         value of error)
+ */
+unsigned long long
+vktor_get_value_hex(vktor_parser *parser, vktor_error **error)
+{
+	unsigned long long val;
+	
+	assert(parser != NULL);
+	
+	if (parser->token_value == NULL) {
+		set_error(parser, error, VKTOR_ERR_NO_VALUE, "token value is unknown");
+		return 0;
+	}
+	
+	if (parser->token_size > 16) {
+		set_error(parser, error, VKTOR_ERR_OUT_OF_RANGE,
+			"hexadecimal value overflows 64 bits");
+		return 0;
+	}
+	
+	if (! vktor_typed_hex((char *) parser->token_value, parser->token_size, 
+	                      &val)) {
+		set_error(parser, error, VKTOR_ERR_INVALID_FORMAT, 
+			"value is not a valid hexadecimal number");
+		return 0;
+	}
+	
+	return val;
+}
+
 /**
  * @brief Free a parser and any associated memory
  * 
@@ -1762,17 +5067,127 @@ vktor_parser_free(vktor_parser *parser)
 {
 	assert(parser != NULL);
 	
-	if (parser->buffer != NULL) {
-		buffer_free_all(parser->buffer);
+	parser_free_memory(parser);
+	
+	if (! parser->inplace) {
+		vfree(parser, parser);
 	}
+}
+
+/**
+ * @brief Release memory held by an idle parser
+ * 
+ * Compact a streaming parser which is waiting for more data, such as a parser
+ * attached to an idle network connection, so it holds as little memory as 
+ * possible. Any partially read token is shrunk to its exact size, any data 
+ * which was fed but not parsed yet is copied into a single block, and all 
+ * other memory held by the parser is released. 
+ * 
+ * After hibernating, the parser no longer refers to any buffer fed to it, so 
+ * buffers fed with the free flag unset can be reused by the caller. The value
+ * of the current token is released, so it must be copied beforehand if it is 
+ * still needed. Parsing can continue normally afterwards.
+ * 
+ * @param [in,out] parser parser object
+ * @param [in,out] error  pointer to an unallocated error struct to return any
+ *                        errors, or NULL if there is no need for error handling
+ * 
+ * @return vktor status code 
+ *  - VKTOR_OK on success 
+ *  - VKTOR_ERROR if memory could not be allocated, in which case the parser 
+ *    is left untouched
+ */
+vktor_status
+vktor_parser_hibernate(vktor_parser *parser, vktor_error **error)
+{
+	long           size;
+	void          *token;
+	unsigned char *stack;
 	
-	if (parser->token_value != NULL) {
-		vfree(parser->token_value);
+	assert(parser != NULL);
+	
+	// Complete input is never waiting for more data
+	if (parser->complete_text != NULL) {
+		return VKTOR_OK;
+	}
+	
+	// Copy any unparsed data into a single block, unless it already is one
+	if (buffer_compact(parser, &parser->buffer, &parser->last_buffer, 
+	                   error) != VKTOR_OK) {
+		return VKTOR_ERROR;
+	}
+	
+#ifdef HAVE_LIBZ
+	// Same for compressed data which wasn't inflated yet
+	if (parser->inflate != NULL && 
+	    buffer_compact(parser, &parser->inflate->input, 
+	                   &parser->inflate->last_input, error) != VKTOR_OK) {
+		return VKTOR_ERROR;
+	}
+#endif
+	
+	// Shrink a partial token, or release the value of a complete one or of a
+	// delivered string part
+	if (parser->token_value != NULL && parser->token_resume && 
+	    parser->token_type != VKTOR_T_STRING_PART) {
+		size = (parser->token_size > 0 ? parser->token_size : 1);
+		if ((token = vrealloc(parser, parser->token_value, size)) != NULL) {
+			parser->token_value = token;
+			parser->token_alloc = size;
+		}
+		
+	} else if (parser->token_value != NULL) {
+		vfree(parser, parser->token_value);
+		parser->token_value = NULL;
+		parser->token_size  = 0;
+		parser->token_alloc = 0;
+	}
+	
+	// Move the nesting stack back into the parser, or shrink it
+	if (parser->nest_stack != parser->nest_inline) {
+		if (parser->nest_ptr <= VKTOR_NEST_INLINE) {
+			memcpy(parser->nest_inline, parser->nest_stack, 
+				sizeof(parser->nest_inline));
+			vfree(parser, parser->nest_stack);
+			parser->nest_stack = parser->nest_inline;
+			parser->nest_size  = VKTOR_NEST_INLINE;
+			
+		} else {
+			size = (parser->nest_ptr + 7) / 8;
+			if ((stack = vrealloc(parser, parser->nest_stack, size)) != NULL) {
+				parser->nest_stack = stack;
+				parser->nest_size  = size * 8;
+			}
+		}
 	}
 	
-	vfree(parser->nest_stack);
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Set an error
+ * 
+ * Allocate a new error struct using the parser's allocator, and set error to
+ * point to it. Does nothing if error is NULL. Allows code built on top of 
+ * vktor, such as decoders generated by vktor-bindgen, to report its own 
+ * errors along with those of the parser, to be freed using vktor_error_free().
+ * 
+ * @param [in]  parser Parser object
+ * @param [out] error  Error object pointer pointer or NULL
+ * @param [in]  code   Error code
+ * @param [in]  fmt    Error message (sprintf-style format)
+ */
+void
+vktor_set_error(vktor_parser *parser, vktor_error **error, vktor_errcode code,
+	const char *fmt, ...)
+{
+	va_list ap;
+	
+	assert(parser != NULL);
 	
-	vfree(parser);
+	va_start(ap, fmt);
+	set_error_va(parser, error, code, fmt, ap);
+	va_end(ap);
 }
 
 /**
@@ -1785,11 +5200,10 @@ vktor_parser_free(vktor_parser *parser)
 void 
 vktor_error_free(vktor_error *err)
 {
-	if (err->message != NULL) {
-		vfree(err->message);
-	}
+	vktor_error_alloc *alloc = (vktor_error_alloc *) err;
 	
-	vfree(err);
+	// The message is allocated along with the error struct
+	alloc->allocator.free(alloc->allocator.ctx, alloc);
 }
 
 /** @} */ // end of external API
@@ -34,12 +34,44 @@
 
 #ifndef _VKTOR_H
 
+#include <stddef.h>
+
+/**
+ * Declared by <time.h>, which only defines it in some standard modes. Needs 
+ * to be defined by the caller to use vktor_get_value_timespec().
+ */
+struct timespec;
+
 /**
  * Parser struct - this is the main object used by the user to parse a JSON 
- * stream. This opaque structure is defined internally in vktor.c.
+ * stream. This opaque structure is defined internally in vktor_internal.h.
  */
 typedef struct _vktor_parser_struct vktor_parser;
 
+/**
+ * Parser pool struct - holds idle parsers which can be reused, see 
+ * vktor_pool.c.
+ */
+typedef struct _vktor_parser_pool_struct vktor_parser_pool;
+
+/**
+ * Columnar reader struct - builds column batches from an array of objects, 
+ * see vktor_columns.c.
+ */
+typedef struct _vktor_columns_struct vktor_columns;
+
+/**
+ * Offset index struct - holds the offsets of the members of the root array or
+ * object of a document, see vktor_index.c.
+ */
+typedef struct _vktor_index_struct vktor_index;
+
+/**
+ * Compiled schema struct - holds a JSON Schema compiled for validating 
+ * documents while they are parsed, see vktor_schema.c.
+ */
+typedef struct _vktor_schema_struct vktor_schema;
+
 /* type definitions */
 
 /**
@@ -69,6 +101,7 @@ typedef enum {
 	VKTOR_T_OBJECT_START =  1 << 8,  /**< object beginning */
 	VKTOR_T_OBJECT_KEY   =  1 << 9,  /**< an object pair key */
 	VKTOR_T_OBJECT_END   =  1 << 10, /**< object end */
+	VKTOR_T_STRING_PART  =  1 << 11, /**< a part of a long string value */
 } vktor_token;
 
 /**
@@ -107,7 +140,11 @@ typedef enum {
 	VKTOR_ERR_NO_VALUE,         /**< trying to read non-existing value */
 	VKTOR_ERR_OUT_OF_RANGE,     /**< long or double value is out of range */
 	VKTOR_ERR_MAX_NEST,         /**< maximal nesting level reached */
-	VKTOR_ERR_INTERNAL_ERR      /**< internal parser error */
+	VKTOR_ERR_INTERNAL_ERR,     /**< internal parser error */
+	VKTOR_ERR_INVALID_STATE,    /**< operation not allowed in parser state */
+	VKTOR_ERR_INVALID_FORMAT,   /**< value is not in the expected format */
+	VKTOR_ERR_UNSUPPORTED,      /**< feature not available in this build */
+	VKTOR_ERR_SCHEMA            /**< document does not match the schema */
 } vktor_errcode;
 
 /** 
@@ -129,6 +166,21 @@ typedef void *(*vktor_realloc) (void *pointer, size_t size);
  */
 typedef void  (*vktor_free)    (void *pointer);
 
+/**
+ * Allocator structure, holding memory management functions along with a 
+ * context pointer passed to each of them. 
+ * 
+ * An allocator can be passed when initializing a parser, in which case it is
+ * used for all memory allocated by that parser and its errors. This allows 
+ * using a different allocator, such as a per-thread arena, for each parser.
+ */
+typedef struct _vktor_allocator_struct {
+	void *(*malloc)  (void *ctx, size_t size);                /**< malloc */
+	void *(*realloc) (void *ctx, void *pointer, size_t size); /**< realloc */
+	void  (*free)    (void *ctx, void *pointer);              /**< free */
+	void   *ctx;                                              /**< context */
+} vktor_allocator;
+
 /**
  * Error structure, signifying the error code and error message
  * 
@@ -139,6 +191,55 @@ typedef struct _vktor_error_struct {
 	char          *message; /**< error message */
 } vktor_error;
 
+/**
+ * @enum vktor_column_type
+ * 
+ * Column types for vktor_columns_init()
+ */
+typedef enum {
+	VKTOR_COL_INT64,  /**< integers, stored as long long */
+	VKTOR_COL_DOUBLE, /**< numbers, stored as double */
+	VKTOR_COL_BOOL,   /**< true or false, stored as one char per row */
+	VKTOR_COL_STRING  /**< strings, stored as offsets into character data */
+} vktor_column_type;
+
+/**
+ * Column specification, naming an object key and the type of its values
+ */
+typedef struct _vktor_column_spec_struct {
+	const char        *path; /**< object key, or dot separated keys of 
+	                              nested objects */
+	vktor_column_type  type; /**< column type */
+} vktor_column_spec;
+
+/**
+ * A column of a batch. 
+ * 
+ * Values of row i are at values[i] for numeric and boolean columns. String 
+ * values are stored back to back in data without a terminating NULL byte, and
+ * the value of row i is the range from offsets[i] to offsets[i + 1]. The 
+ * value of a row is only set if bit (i % 8) of valid[i / 8] is set - rows 
+ * with a null or missing value have the bit cleared.
+ */
+typedef struct _vktor_column_struct {
+	const char         *path;    /**< object key or path of the column */
+	vktor_column_type   type;    /**< column type */
+	void               *values;  /**< long long, double or char values */
+	long               *offsets; /**< string offsets, one more than rows */
+	char               *data;    /**< string data */
+	unsigned char      *valid;   /**< validity bitmap */
+} vktor_column;
+
+/**
+ * A batch of rows, stored as one array per column
+ */
+typedef struct _vktor_batch_struct {
+	long          rows;        /**< number of rows in the batch */
+	int           num_columns; /**< number of columns */
+	vktor_column *columns;     /**< columns, in the order of the spec */
+	int           last;        /**< set if the array ended with this batch */
+} vktor_batch;
+
 /* function prototypes */
 
 /**
@@ -147,12 +248,70 @@ typedef struct _vktor_error_struct {
  * Initialize and return a new parser struct. Will return NULL if memory can't 
  * be allocated.
  * 
+ * The maximal nesting level is a safety limit - memory for the nesting stack 
+ * is only allocated as needed, so it can be set high without any cost.
+ * 
  * @param [in] max_nest maximal nesting level
  * 
  * @return a newly allocated parser
  */
 vktor_parser* vktor_parser_init(int max_nest);
 
+/**
+ * @brief Initialize a new parser using an allocator
+ * 
+ * Initialize and return a new parser struct, allocated along with any memory 
+ * used by the parser and its errors using the given allocator. Will return 
+ * NULL if memory can't be allocated.
+ * 
+ * @param [in] max_nest  maximal nesting level
+ * @param [in] allocator allocator to use, or NULL for the default allocator 
+ *                       (see vktor_set_memory_handlers()). It is copied, so 
+ *                       it doesn't need to outlive this call.
+ * 
+ * @return a newly allocated parser
+ */
+vktor_parser* vktor_parser_init_allocator(int max_nest, 
+                                          const vktor_allocator *allocator);
+
+/**
+ * @brief Get the memory size needed for a parser
+ * 
+ * Get the size of the memory block needed to initialize a parser with 
+ * vktor_parser_init_inplace(). This does not depend on the maximal nesting 
+ * level, as the nesting stack is held inside the parser for up to 
+ * VKTOR_NEST_INLINE levels, and only allocated when it grows deeper.
+ * 
+ * @return memory size in bytes
+ */
+size_t vktor_parser_size(void);
+
+/**
+ * @brief Initialize a new parser in caller provided memory
+ * 
+ * Initialize a new parser struct inside a memory block provided by the caller,
+ * for example on the stack or in an arena, without allocating any memory. The 
+ * memory block must be suitably aligned for any type (like memory returned by 
+ * malloc()), and at least vktor_parser_size() bytes long. Any memory 
+ * beyond that is used for token values when parsing complete input (see 
+ * vktor_feed_complete()).
+ * 
+ * The parser still needs to be freed with vktor_parser_free(), which will free
+ * any memory allocated while parsing but not the memory block itself. Parsing 
+ * does not allocate memory for the first few buffers fed to the parser at any
+ * given time.
+ * 
+ * @param [in] mem       memory block
+ * @param [in] size      size of the memory block
+ * @param [in] max_nest  maximal nesting level
+ * @param [in] allocator allocator to use for memory allocated while parsing, 
+ *                       or NULL for the default allocator
+ * 
+ * @return the initialized parser, or NULL if the memory block is too small
+ */
+vktor_parser* vktor_parser_init_inplace(void *mem, size_t size, int max_nest,
+                                        const vktor_allocator *allocator);
+
 /**
  * @brief Free a parser and any associated memory
  * 
@@ -163,6 +322,138 @@ vktor_parser* vktor_parser_init(int max_nest);
  */
 void vktor_parser_free(vktor_parser *parser);
 
+/**
+ * @brief Release memory held by an idle parser
+ * 
+ * Compact a streaming parser which is waiting for more data, such as a parser
+ * attached to an idle network connection, so it holds as little memory as 
+ * possible. Any partially read token is shrunk to its exact size, any data 
+ * which was fed but not parsed yet is copied into a single block, and all 
+ * other memory held by the parser is released. 
+ * 
+ * After hibernating, the parser no longer refers to any buffer fed to it, so 
+ * buffers fed with the free flag unset can be reused by the caller. The value
+ * of the current token is released, so it must be copied beforehand if it is 
+ * still needed. Parsing can continue normally afterwards.
+ * 
+ * @param [in,out] parser parser object
+ * @param [in,out] error  pointer to an unallocated error struct to return any
+ *                        errors, or NULL if there is no need for error handling
+ * 
+ * @return vktor status code 
+ *  - VKTOR_OK on success 
+ *  - VKTOR_ERROR if memory could not be allocated, in which case the parser 
+ *    is left untouched
+ */
+vktor_status vktor_parser_hibernate(vktor_parser *parser, vktor_error **error);
+
+/**
+ * @brief Save the state of a parser
+ * 
+ * Write a checkpoint holding the state of the parser along with the offset 
+ * in the input it has reached, so parsing can be resumed later, possibly in
+ * another process, using vktor_parser_restore(). This includes the nesting
+ * stack, the tokens expected next and any partially read token. Checkpoints 
+ * are small: a few bytes plus the nesting depth in bits and the length of a 
+ * partially read token.
+ * 
+ * Checkpoints can be taken between calls to vktor_parse(), but not while a 
+ * value is skipped, captured or read as base64, while a document is being 
+ * validated, or while subtree hashing or a schema is enabled. The value of 
+ * the current token is not saved, and neither is the state of a columnar 
+ * reader using the parser.
+ * 
+ * @param [in]  parser   parser object
+ * @param [out] out      memory to write the checkpoint to, or NULL to only 
+ *                       get its size
+ * @param [in]  out_size size of out
+ * @param [out] len      set to the size of the checkpoint in bytes, which is 
+ *                       only written if it fits in out_size bytes
+ * @param [out] error    error object pointer pointer or NULL
+ * 
+ * @return Status code - VKTOR_OK or VKTOR_ERROR
+ */
+vktor_status vktor_parser_checkpoint(vktor_parser *parser, unsigned char *out,
+                                     long out_size, long *len, 
+                                     vktor_error **error);
+
+/**
+ * @brief Restore the state of a parser
+ * 
+ * Restore a checkpoint written by vktor_parser_checkpoint() into a new 
+ * parser. If the parser was fed complete input using vktor_feed_complete(), 
+ * it is moved to the checkpoint's offset in it. Otherwise, it must be fed 
+ * with the input starting at that offset.
+ * 
+ * The restored state is checked to be one the parser can reach: a checkpoint
+ * which was damaged or not written by vktor_parser_checkpoint() fails with 
+ * VKTOR_ERR_INVALID_FORMAT.
+ * 
+ * @param [in,out] parser new parser object
+ * @param [in]     data   checkpoint
+ * @param [in]     len    length of the checkpoint
+ * @param [out]    offset set to the offset in the input to resume from
+ * @param [out]    error  error object pointer pointer or NULL
+ * 
+ * @return Status code - VKTOR_OK or VKTOR_ERROR
+ */
+vktor_status vktor_parser_restore(vktor_parser *parser, 
+                                  const unsigned char *data, long len, 
+                                  long *offset, vktor_error **error);
+
+/**
+ * @brief Initialize a new parser pool
+ * 
+ * Initialize a pool of parsers which can be acquired and released quickly, 
+ * instead of initializing and freeing a parser for each stream. Released 
+ * parsers are reset and kept for reuse, up to max_idle parsers.
+ * 
+ * A pool is not thread safe. Use a separate pool, possibly with its own 
+ * allocator, for each thread. 
+ * 
+ * @param [in] max_nest  maximal nesting level of parsers in the pool
+ * @param [in] max_idle  maximal number of idle parsers kept in the pool
+ * @param [in] allocator allocator to use for the pool and its parsers, or NULL
+ *                       for the default allocator
+ * 
+ * @return a newly allocated pool, or NULL if memory can't be allocated
+ */
+vktor_parser_pool* vktor_parser_pool_init(int max_nest, int max_idle, 
+                                          const vktor_allocator *allocator);
+
+/**
+ * @brief Acquire a parser from a pool
+ * 
+ * Get a parser ready to parse a new stream, reusing an idle parser from the 
+ * pool if there is one. 
+ * 
+ * @param [in,out] pool parser pool
+ * 
+ * @return a parser, or NULL if memory can't be allocated
+ */
+vktor_parser* vktor_parser_pool_acquire(vktor_parser_pool *pool);
+
+/**
+ * @brief Release a parser back into a pool
+ * 
+ * Reset a parser acquired from a pool and keep it for reuse. If the pool 
+ * already holds max_idle parsers, the parser is freed instead. 
+ * 
+ * @param [in,out] pool   parser pool
+ * @param [in,out] parser parser acquired from the same pool
+ */
+void vktor_parser_pool_release(vktor_parser_pool *pool, vktor_parser *parser);
+
+/**
+ * @brief Free a parser pool
+ * 
+ * Free a parser pool along with all idle parsers held by it. Parsers which 
+ * were acquired and not released must still be freed by vktor_parser_free().
+ * 
+ * @param [in,out] pool parser pool
+ */
+void vktor_parser_pool_free(vktor_parser_pool *pool);
+
 /**
  * @brief Free an error struct
  * 
@@ -172,6 +463,22 @@ void vktor_parser_free(vktor_parser *parser);
  */
 void vktor_error_free(vktor_error *err);
 
+/**
+ * @brief Set an error
+ * 
+ * Allocate a new error struct using the parser's allocator, and set error to
+ * point to it. Does nothing if error is NULL. Allows code built on top of 
+ * vktor, such as decoders generated by vktor-bindgen, to report its own 
+ * errors along with those of the parser, to be freed using vktor_error_free().
+ * 
+ * @param [in]  parser Parser object
+ * @param [out] error  Error object pointer pointer or NULL
+ * @param [in]  code   Error code
+ * @param [in]  fmt    Error message (sprintf-style format)
+ */
+void vktor_set_error(vktor_parser *parser, vktor_error **error, 
+                     vktor_errcode code, const char *fmt, ...);
+
 /**
  * @brief Feed the parser's internal buffer with more JSON data
  * 
@@ -194,6 +501,254 @@ void vktor_error_free(vktor_error *err);
 vktor_status vktor_feed(vktor_parser *parser, char *text, long text_len, 
                         char free, vktor_error **err);
 
+/**
+ * @brief Feed the parser with a complete JSON document
+ * 
+ * Feed the parser with an entire JSON document which is already available in
+ * a single contiguous buffer. vktor_parse() will then read tokens using a 
+ * faster code path which does not need to handle tokens split across buffers,
+ * and will reuse a single memory block for all token values.
+ * 
+ * This function must be called once on a new parser, and the parser cannot be
+ * fed with any more data afterwards. If the end of the text is reached before
+ * the document is complete, vktor_parse() will fail with 
+ * VKTOR_ERR_INCOMPLETE_DATA instead of returning VKTOR_MORE_DATA.
+ * 
+ * @param [in] parser   parser object
+ * @param [in] text     complete JSON text
+ * @param [in] text_len length of text
+ * @param [in] free     whether to free the text when done (1) or not (0)
+ * @param [in,out] err  pointer to an unallocated error struct to return any 
+ *                      errors, or NULL if there is no need for error handling
+ * 
+ * @return vktor status code 
+ *  - VKTOR_OK on success 
+ *  - VKTOR_ERROR otherwise
+ */
+vktor_status vktor_feed_complete(vktor_parser *parser, char *text, 
+                                 long text_len, char free, vktor_error **err);
+
+/**
+ * @brief Read compressed input
+ * 
+ * Enable an input stage which inflates gzip or zlib compressed data fed to 
+ * the parser using vktor_feed(). Compressed data is inflated lazily, one 
+ * buffer of chunk_size bytes at a time whenever the parser reaches the end of
+ * the previous one, so only a single chunk of inflated input is held in 
+ * memory at a time. Concatenated gzip members are read as a single stream.
+ * 
+ * Must be called on a new parser, before it is fed. Input offsets, such as 
+ * those of checkpoints and indexes, count inflated bytes. Compressed input 
+ * can't be fed using vktor_feed_complete(), and parsers reading it can't seek
+ * or be restored from a checkpoint.
+ * 
+ * Only available if vktor was built with zlib, otherwise error will indicate
+ * VKTOR_ERR_UNSUPPORTED.
+ * 
+ * @param [in,out] parser     parser object
+ * @param [in]     chunk_size size of inflated buffers, or 0 for the default 
+ *                            of 64kB
+ * @param [out]    error      error object pointer pointer or NULL
+ * 
+ * @return Status code - VKTOR_OK or VKTOR_ERROR
+ */
+vktor_status vktor_enable_inflate(vktor_parser *parser, long chunk_size, 
+                                  vktor_error **error);
+
+/**
+ * @brief Get the compressed input statistics
+ * 
+ * Get the number of compressed bytes read and the number of bytes they were 
+ * inflated to so far. Both are 0 if compressed input is not enabled.
+ * 
+ * @param [in]  parser   parser object
+ * @param [out] in       number of compressed bytes read
+ * @param [out] inflated number of inflated bytes
+ */
+void vktor_get_inflate_stats(vktor_parser *parser, long long *in, 
+                             long long *inflated);
+
+/**
+ * @brief Deliver long string values in parts
+ * 
+ * Set the size at which string values are delivered in parts instead of as a 
+ * single token, so memory stays bounded when reading very long strings. Once 
+ * a string value reaches chunk_size bytes, vktor_parse() returns it as a 
+ * VKTOR_T_STRING_PART token and continues reading the rest of the string on 
+ * the next call. The last part of the string is returned as a regular 
+ * VKTOR_T_STRING token, which is also how strings shorter than chunk_size are
+ * returned. 
+ * 
+ * Parts are split on byte boundaries, so a multi-byte UTF-8 character may be 
+ * split between two parts. The value of each part is only valid until the 
+ * next call to vktor_parse(). Object keys are always returned whole, as are 
+ * strings read from complete input (see vktor_feed_complete()) which is 
+ * already held in memory.
+ * 
+ * @param [in,out] parser     parser object
+ * @param [in]     chunk_size part size in bytes, or 0 to disable (the default)
+ */
+void vktor_set_string_chunk(vktor_parser *parser, long chunk_size);
+
+/**
+ * @brief Enable the object key shape cache
+ * 
+ * Enable a cache of the keys of the last object read at each nesting level.
+ * When objects have the same keys in the same order, as records of an array
+ * usually do, each key is verified against the input with a single memcmp()
+ * and copied from the cache instead of being decoded character by character.
+ * Keys which don't match fall back to regular decoding and replace the cached
+ * key. Only the first few nesting levels and keys of each object are cached. 
+ * 
+ * Hits and misses can be checked with vktor_get_shape_stats(), and the 
+ * position of a key found in the cache with vktor_get_key_id(). 
+ * 
+ * @param [in,out] parser Parser object
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return VKTOR_OK or VKTOR_ERROR if memory can't be allocated
+ */
+vktor_status vktor_enable_shape_cache(vktor_parser *parser, 
+                                      vktor_error **error);
+
+/**
+ * @brief Get the shape cache statistics
+ * 
+ * Get the number of object keys found in the shape cache, and the number of 
+ * object keys which had to be decoded since the cache was enabled. Both are 
+ * 0 if the shape cache is not enabled.
+ * 
+ * @param [in]  parser Parser object
+ * @param [out] hits   number of keys found in the cache
+ * @param [out] misses number of keys not found in the cache
+ */
+void vktor_get_shape_stats(vktor_parser *parser, long *hits, long *misses);
+
+/**
+ * @brief Enable subtree hashing
+ * 
+ * Compute a 64 bit hash of every value as it is parsed. The hash of an array
+ * or an object covers all of its contents, and is available when its end 
+ * token is returned. Hashes only depend on the tokens of the value, and not 
+ * on whitespace, escaping or how the input is split into buffers, so equal 
+ * values always have equal hashes. They can be used to find repeated values,
+ * such as embedded objects which were already decoded.
+ * 
+ * When subtree hashing is enabled, vktor_skip_value() reads the skipped value
+ * token by token so its hash is available once it is skipped, and values can't
+ * be read using vktor_read_base64() or the number array readers. 
+ * 
+ * Subtree hashing can only be enabled before the parser enters an array or
+ * an object.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return VKTOR_OK or VKTOR_ERROR
+ */
+vktor_status vktor_enable_subtree_hash(vktor_parser *parser, 
+                                       vktor_error **error);
+
+/**
+ * @brief Read and decode a base64 encoded string value
+ * 
+ * Read the next value, which must be a string, decoding its base64 encoded 
+ * contents directly into out without keeping the encoded text in memory. Can 
+ * be called instead of vktor_parse() whenever a value is expected, for 
+ * example right after reading the object key of a known binary field.
+ * 
+ * If out fills up or the input runs out before the end of the string, the 
+ * token type is VKTOR_T_STRING_PART and vktor_read_base64() must be called 
+ * again to read the rest of the string; the last part has a token type of 
+ * VKTOR_T_STRING. VKTOR_MORE_DATA is only returned when more input is needed
+ * and nothing was decoded yet. Both the standard and the URL-safe alphabets are 
+ * accepted, and padding is optional.
+ * 
+ * @param [in,out] parser   parser object
+ * @param [out]    out      output buffer
+ * @param [in]     out_size size of out, must be at least 3 bytes
+ * @param [out]    out_len  number of bytes written to out
+ * @param [out]    error    error object pointer pointer or NULL
+ * 
+ * @return status code:
+ *  - VKTOR_OK        if the string or a part of it was decoded
+ *  - VKTOR_MORE_DATA if more data is needed
+ *  - VKTOR_ERROR     if the next value is not a valid base64 string
+ */
+vktor_status vktor_read_base64(vktor_parser *parser, unsigned char *out, 
+                               long out_size, long *out_len, 
+                               vktor_error **error);
+
+/**
+ * @brief Read the numbers of an array into an array of doubles
+ * 
+ * Read consecutive numbers of the current array directly into out, skipping
+ * the per-number tokens, allocations and type checks of vktor_parse(). Can be
+ * called right after a VKTOR_T_ARRAY_START token, or after any value inside 
+ * an array. Reading stops:
+ *  - At the end of the array, which is consumed - the token type is then 
+ *    VKTOR_T_ARRAY_END
+ *  - When out is full, or before the first value which is not a number - the
+ *    token type is then VKTOR_T_NONE. If out is not full, the next value 
+ *    should be read using vktor_parse().
+ *  - After a number which cannot be stored in out, such as one which is out
+ *    of range - it is then the current token, and can be read using the 
+ *    vktor_get_value_*() functions.
+ * 
+ * The values stored in out are valid whenever count is set, including when 
+ * VKTOR_MORE_DATA is returned.
+ * 
+ * @param [in,out] parser parser object
+ * @param [out]    out    output array
+ * @param [in]     cap    number of elements in out
+ * @param [out]    count  number of elements stored in out
+ * @param [out]    error  error object pointer pointer or NULL
+ * 
+ * @return status code:
+ *  - VKTOR_OK        if reading stopped as described above
+ *  - VKTOR_MORE_DATA if more data is needed
+ *  - VKTOR_ERROR     if an error has occured, or if not reading an array
+ */
+vktor_status vktor_read_number_array(vktor_parser *parser, double *out, 
+                                     long cap, long *count, 
+                                     vktor_error **error);
+
+/**
+ * @brief Read the numbers of an array into an array of floats
+ * 
+ * Same as vktor_read_number_array(), only numbers are stored as single 
+ * precision floats. Numbers beyond the range of a float are not stored.
+ * 
+ * @param [in,out] parser parser object
+ * @param [out]    out    output array
+ * @param [in]     cap    number of elements in out
+ * @param [out]    count  number of elements stored in out
+ * @param [out]    error  error object pointer pointer or NULL
+ * 
+ * @return status code, see vktor_read_number_array()
+ */
+vktor_status vktor_read_float_array(vktor_parser *parser, float *out, long cap,
+                                    long *count, vktor_error **error);
+
+/**
+ * @brief Read the numbers of an array into an array of 64 bit integers
+ * 
+ * Same as vktor_read_number_array(), only numbers are stored as 64 bit 
+ * integers. Floating point numbers and integers beyond the range of a long 
+ * long are not stored.
+ * 
+ * @param [in,out] parser parser object
+ * @param [out]    out    output array
+ * @param [in]     cap    number of elements in out
+ * @param [out]    count  number of elements stored in out
+ * @param [out]    error  error object pointer pointer or NULL
+ * 
+ * @return status code, see vktor_read_number_array()
+ */
+vktor_status vktor_read_int64_array(vktor_parser *parser, long long *out, 
+                                    long cap, long *count, 
+                                    vktor_error **error);
+
 /**
  * @brief Parse some JSON text and return on the next token
  * 
@@ -212,6 +767,353 @@ vktor_status vktor_feed(vktor_parser *parser, char *text, long text_len,
  *  - VKTOR_COMPLETE  if parsing is complete and no further data is expected
  */
 vktor_status vktor_parse(vktor_parser *parser, vktor_error **error);
+
+/**
+ * @brief Skip the next value
+ * 
+ * Skip over the next value, including all of its contents if it is an array
+ * or an object, without creating any tokens or allocating memory for them. 
+ * Can be called instead of vktor_parse() whenever a value is expected, for 
+ * example right after reading an object key which is not of interest. Once
+ * the value is skipped, the token type is VKTOR_T_NONE. If the root value 
+ * is skipped, the next call to vktor_parse() returns VKTOR_COMPLETE.
+ * 
+ * Skipped values are only checked for balanced arrays and objects, unless 
+ * a schema is enabled. While a value is partially skipped, calling 
+ * vktor_parse() is an error.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return status code:
+ *  - VKTOR_OK        if the value was skipped
+ *  - VKTOR_ERROR     if an error has occured
+ *  - VKTOR_MORE_DATA if we need more data in order to continue skipping
+ */
+vktor_status vktor_skip_value(vktor_parser *parser, vktor_error **error);
+
+/**
+ * @brief Capture the raw input of the next value
+ * 
+ * Skip over the next value the same way vktor_skip_value() does, and return 
+ * its exact input bytes, from its first to its last character. This allows 
+ * passing values through without reading and writing them token by token.
+ * 
+ * If the value is contained in a single input buffer, or the parser was fed
+ * complete input, value points into the input itself. Otherwise the pieces 
+ * of the value are copied into memory held by the parser. Either way, value
+ * is only valid until the next call to any other parser function. Like 
+ * skipped values, captured values are only checked for balanced arrays and 
+ * objects, and they can't be captured while hashing subtrees or while a 
+ * schema is enabled. If the root value is captured, the next call to 
+ * vktor_parse() returns VKTOR_COMPLETE.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [out]    value  Set to the raw value, which is not NULL terminated
+ * @param [out]    len    Set to the length of the raw value
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return status code:
+ *  - VKTOR_OK        if the value was captured
+ *  - VKTOR_ERROR     if an error has occured
+ *  - VKTOR_MORE_DATA if we need more data in order to continue capturing
+ */
+vktor_status vktor_capture_value(vktor_parser *parser, char **value, 
+                                 long *len, vktor_error **error);
+
+/**
+ * @brief Validate the rest of the document
+ * 
+ * Check the rest of the document against the JSON grammar without reading 
+ * it into tokens, which is much faster than reading it with vktor_parse() 
+ * and throwing the tokens away. Nesting, separators, numbers, true, false, 
+ * null and string escapes are checked, including the pairing of escaped 
+ * UTF-16 surrogates. If check_utf8 is set, strings must be valid UTF-8 as 
+ * well: no overlong forms, surrogates or code points above U+10FFFF. 
+ * 
+ * Can be called on a new parser, or between tokens after reading part of the
+ * document with vktor_parse(). Numbers are checked strictly, so a leading 
+ * plus sign or leading zeros, which vktor_parse() accepts, are errors here. 
+ * Like with vktor_parse(), only whitespace may follow the root value, and 
+ * the document is complete once all input fed so far was read. 
+ * 
+ * While a document is partially validated, calling vktor_parse() is an error.
+ * No tokens are available once it is validated. Can't be used while subtree
+ * hashing or a schema is enabled.
+ * 
+ * @param [in,out] parser     Parser object
+ * @param [in]     check_utf8 Whether to validate UTF-8 in strings
+ * @param [out]    error      Error object pointer pointer or NULL
+ * 
+ * @return status code:
+ *  - VKTOR_COMPLETE  if the document is valid
+ *  - VKTOR_ERROR     if the document is invalid or an error has occured
+ *  - VKTOR_MORE_DATA if we need more data in order to continue validating
+ */
+vktor_status vktor_validate(vktor_parser *parser, int check_utf8, 
+                            vktor_error **error);
+
+/**
+ * @brief Initialize a columnar reader
+ * 
+ * Initialize a reader which pivots an array of objects into batches of 
+ * columns, one column for each entry of spec. Nested object members are 
+ * named by a dot separated path, such as "user.id". Object keys which are 
+ * not part of any path are skipped without being read into tokens.
+ * 
+ * The spec is copied, and can be freed once the reader is initialized. 
+ * 
+ * @param [in] spec        column specifications
+ * @param [in] num_columns number of column specifications
+ * @param [in] batch_rows  maximal number of rows in each batch
+ * @param [in] allocator   allocator to use for the reader and its batches, or
+ *                         NULL for the default allocator
+ * 
+ * @return a newly allocated reader, or NULL if memory can't be allocated or 
+ *   if the spec is invalid (a path is repeated or is a prefix of another)
+ */
+vktor_columns* vktor_columns_init(const vktor_column_spec *spec, 
+                                  int num_columns, long batch_rows, 
+                                  const vktor_allocator *allocator);
+
+/**
+ * @brief Read the next batch of rows from an array of objects
+ * 
+ * Read objects from the array the parser is in into a batch of columns. 
+ * The first call must be made right after the array start token was read, 
+ * and the same parser must be passed in all following calls until the last
+ * batch of the array was read. 
+ * 
+ * Members which don't match their column type are an error, except for null
+ * which leaves the row's value unset. A null array member is read as a row 
+ * with no values. Other non-object members of the array are an error.
+ * 
+ * The batch is owned by the reader and is valid until the next call. After 
+ * the last batch of an array, which has the last flag set and may have no 
+ * rows, the parser is positioned after the array end token and the reader 
+ * can be used for another array.
+ * 
+ * @param [in,out] columns columnar reader
+ * @param [in,out] parser  parser positioned in an array of objects
+ * @param [out]    batch   batch pointer pointer, set when VKTOR_OK is 
+ *                         returned
+ * @param [out]    error   error object pointer pointer or NULL
+ * 
+ * @return status code:
+ *  - VKTOR_OK        if a batch is full or the array has ended
+ *  - VKTOR_ERROR     if an error has occured
+ *  - VKTOR_MORE_DATA if we need more data in order to continue reading
+ */
+vktor_status vktor_columns_read(vktor_columns *columns, vktor_parser *parser,
+                                vktor_batch **batch, vktor_error **error);
+
+/**
+ * @brief Free a columnar reader
+ * 
+ * Free a columnar reader along with its batch
+ * 
+ * @param [in,out] columns columnar reader
+ */
+void vktor_columns_free(vktor_columns *columns);
+
+/**
+ * @brief Initialize an offset index
+ * 
+ * Initialize an empty index, to be built using vktor_index_build() or loaded
+ * from a serialized index using vktor_index_load().
+ * 
+ * @param [in] allocator allocator to use for the index, or NULL for the 
+ *                       default allocator
+ * 
+ * @return a newly allocated index, or NULL if memory can't be allocated
+ */
+vktor_index* vktor_index_init(const vktor_allocator *allocator);
+
+/**
+ * @brief Build an offset index of a document
+ * 
+ * Read a document whose root value is an array or an object, and record the 
+ * byte offset of each of its members: the first character of each array 
+ * member, or of each object member's key. Members are skipped the same way 
+ * vktor_skip_value() skips values, so building an index is much faster than
+ * parsing the document, and it only needs to be done once. 
+ * 
+ * The parser must be new, and is read to the end of the document. Offsets 
+ * are counted from the first byte fed to it. Once the index is built, 
+ * vktor_parser_seek() can be used to start parsing at any member.
+ * 
+ * @param [in,out] index  index to build, replacing any previous contents
+ * @param [in,out] parser new parser, fed with the document
+ * @param [out]    error  error object pointer pointer or NULL
+ * 
+ * @return status code:
+ *  - VKTOR_OK        if the index was built
+ *  - VKTOR_ERROR     if an error has occured
+ *  - VKTOR_MORE_DATA if we need more data in order to continue building
+ */
+vktor_status vktor_index_build(vktor_index *index, vktor_parser *parser, 
+                               vktor_error **error);
+
+/**
+ * @brief Get the number of members in an index
+ * 
+ * @param [in] index offset index
+ * 
+ * @return number of members of the indexed array or object
+ */
+long vktor_index_count(vktor_index *index);
+
+/**
+ * @brief Get the offset of a member in an index
+ * 
+ * @param [in] index offset index
+ * @param [in] n     member number, starting from 0
+ * 
+ * @return byte offset of member n, or -1 if there is no such member
+ */
+long vktor_index_offset(vktor_index *index, long n);
+
+/**
+ * @brief Serialize an offset index
+ * 
+ * Write an index in a compact binary format which can be saved alongside the
+ * document, and loaded again using vktor_index_load(). Offsets are stored as
+ * variable length differences, usually taking 1 or 2 bytes per member.
+ * 
+ * @param [in]  index    offset index
+ * @param [out] out      memory to write the index to, or NULL to only get 
+ *                       the size of the serialized index
+ * @param [in]  out_size size of out
+ * 
+ * @return size of the serialized index in bytes, which is only written if it
+ *   fits in out_size bytes
+ */
+long vktor_index_serialize(vktor_index *index, unsigned char *out, 
+                           long out_size);
+
+/**
+ * @brief Load a serialized offset index
+ * 
+ * @param [in] data      serialized index, see vktor_index_serialize()
+ * @param [in] len       length of data
+ * @param [in] allocator allocator to use for the index, or NULL for the 
+ *                       default allocator
+ * 
+ * @return a newly allocated index, or NULL if memory can't be allocated or 
+ *   if data is not a valid serialized index
+ */
+vktor_index* vktor_index_load(const unsigned char *data, long len, 
+                              const vktor_allocator *allocator);
+
+/**
+ * @brief Free an offset index
+ * 
+ * @param [in,out] index offset index
+ */
+void vktor_index_free(vktor_index *index);
+
+/**
+ * @brief Start parsing at a member of an indexed document
+ * 
+ * Reset the parser to the state it would be in right before member n of the
+ * root array or object, so the next call to vktor_parse() returns the member
+ * (or its key), followed by the rest of the document. Any current token and 
+ * partially read value are dropped.
+ * 
+ * If the parser was fed complete input using vktor_feed_complete(), it is 
+ * moved to the member's offset in it. Otherwise, all buffers fed to the 
+ * parser are dropped, and it must be fed with the document starting at 
+ * vktor_index_offset(index, n). Subtree hashes can't be calculated after 
+ * seeking.
+ * 
+ * @param [in,out] parser parser object
+ * @param [in]     index  offset index of the document
+ * @param [in]     n      member number, starting from 0
+ * @param [out]    error  error object pointer pointer or NULL
+ * 
+ * @return Status code - VKTOR_OK or VKTOR_ERROR
+ */
+vktor_status vktor_parser_seek(vktor_parser *parser, vktor_index *index, 
+                               long n, vktor_error **error);
+
+/**
+ * @brief Initialize a schema
+ * 
+ * Initialize an empty schema, to be compiled using vktor_schema_compile().
+ * 
+ * @param [in] allocator allocator to use for the schema, or NULL for the 
+ *                       default allocator
+ * 
+ * @return a newly allocated schema, or NULL if memory can't be allocated
+ */
+vktor_schema* vktor_schema_init(const vktor_allocator *allocator);
+
+/**
+ * @brief Compile a JSON Schema
+ * 
+ * Read the next value from the parser as a JSON Schema, and compile it so 
+ * documents can be validated against it while they are parsed. The schema 
+ * is usually a document of its own, but can be any value. 
+ * 
+ * The following keywords are supported: type, properties, required, 
+ * additionalProperties, items (a single schema), enum (of strings, numbers, 
+ * true, false and null), minimum, maximum, exclusiveMinimum and 
+ * exclusiveMaximum (as numbers), minLength, maxLength, minItems and maxItems.
+ * The annotations $schema, $id, id, $comment, title, description, default, 
+ * examples and format are ignored. Schemas may be true or false as well. Any
+ * other keyword is an error, so documents are never validated against only 
+ * a part of a schema. 
+ * 
+ * Once compiled, a schema is not modified by validation, and can be used by 
+ * any number of parsers at the same time.
+ * 
+ * @param [in,out] schema schema to compile, replacing any previous contents
+ * @param [in,out] parser parser to read the schema from
+ * @param [out]    error  error object pointer pointer or NULL
+ * 
+ * @return status code:
+ *  - VKTOR_OK        if the schema was compiled
+ *  - VKTOR_ERROR     if an error has occured, or the schema is invalid
+ *  - VKTOR_MORE_DATA if we need more data in order to continue compiling
+ */
+vktor_status vktor_schema_compile(vktor_schema *schema, vktor_parser *parser,
+                                  vktor_error **error);
+
+/**
+ * @brief Free a schema
+ * 
+ * @param [in,out] schema schema
+ */
+void vktor_schema_free(vktor_schema *schema);
+
+/**
+ * @brief Validate the document against a schema while it is parsed
+ * 
+ * Check every token returned by vktor_parse() against a compiled schema, 
+ * without building the document in memory. Only the current path through 
+ * the document is tracked, along with the required properties seen in each 
+ * object. A value which does not match the schema is an error with the code
+ * VKTOR_ERR_SCHEMA, returned as soon as the token which violates the schema 
+ * is read, and parsing should not continue after it. A missing required 
+ * property or too few array members are reported at the end of the object or
+ * array.
+ * 
+ * Values skipped using vktor_skip_value() are checked token by token, unless
+ * the schema allows any value in their place. Values can't be read using 
+ * vktor_read_base64(), vktor_capture_value(), vktor_validate() or the number
+ * array readers while a schema is enabled.
+ * 
+ * A schema can only be enabled before the document is read, and must not be
+ * freed before the parser.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [in]     schema compiled schema
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return VKTOR_OK or VKTOR_ERROR
+ */
+vktor_status vktor_enable_schema(vktor_parser *parser, vktor_schema *schema, 
+                                 vktor_error **error);
 		  
 /**
  * @brief Get the current token type
@@ -236,6 +1138,39 @@ vktor_token vktor_get_token_type(vktor_parser *parser);
  */
 int vktor_get_depth(vktor_parser *parser);
 
+/**
+ * @brief Get the subtree hash of the current value
+ * 
+ * Get the hash of the value which ended with the current token: a scalar 
+ * value, or an array or object if the current token is its end token. Also 
+ * available after a value was skipped with vktor_skip_value(). Subtree 
+ * hashing must be enabled using vktor_enable_subtree_hash().
+ * 
+ * @param [in]  parser Parser object
+ * @param [out] hash   hash of the value
+ * @param [out] error  Error object pointer pointer or NULL
+ * 
+ * @return VKTOR_OK, or VKTOR_ERROR if no value ended with the current token
+ */
+vktor_status vktor_get_subtree_hash(vktor_parser *parser, 
+                                    unsigned long long *hash, 
+                                    vktor_error **error);
+
+/**
+ * @brief Get the shape cache position of the current object key
+ * 
+ * Get the position of the current object key in its object, if the key was
+ * found in the shape cache (see vktor_enable_shape_cache()). As long as 
+ * objects keep the same shape, the same key always has the same position, 
+ * which can be used to identify it without comparing strings.
+ * 
+ * @param [in] parser Parser object
+ * 
+ * @return key position, or -1 if the current token is not an object key or 
+ *   the key was not found in the shape cache
+ */
+int vktor_get_key_id(vktor_parser *parser);
+
 /**
  * @brief Get the current struct type
  * 
@@ -314,7 +1249,8 @@ int vktor_get_value_str(vktor_parser *parser, char **val, vktor_error **error);
  * 
  * Similar to vktor_get_value_str(), only this function will provide a copy of 
  * the string, which will need to be freed by the user when it is no longer 
- * used. 
+ * used. The copy is allocated using the parser's allocator, and should be 
+ * freed using vktor_value_str_free(). 
  * 
  * @param [in]  parser Parser object
  * @param [out] val    Pointer-pointer to be populated with the value
@@ -326,6 +1262,79 @@ int vktor_get_value_str(vktor_parser *parser, char **val, vktor_error **error);
  */
 int vktor_get_value_str_copy(vktor_parser *parser, char **val, vktor_error **error);
 
+/**
+ * @brief Free a string copied by vktor_get_value_str_copy()
+ * 
+ * Free a string copy using the allocator of the parser it was copied by. 
+ * Copies made by parsers using the default allocator can also be freed after
+ * the parser is freed, using the free function set by 
+ * vktor_set_memory_handlers() (free() by default).
+ * 
+ * @param [in]     parser Parser object which copied the string
+ * @param [in,out] str    String to free
+ */
+void vktor_value_str_free(vktor_parser *parser, char *str);
+
+/**
+ * @brief Get the token value as a timestamp
+ * 
+ * Decode the value of the current token, which should be a string holding an
+ * RFC 3339 (ISO-8601) timestamp such as "2009-05-21T14:03:59.123Z" or 
+ * "2009-05-21 16:03:59+02:00", into seconds and nanoseconds since the Unix 
+ * epoch. The time zone offset is required, and the result does not depend on
+ * the locale or the local time zone. No memory is allocated. 
+ * 
+ * If the value is not a valid timestamp, error will indicate 
+ * VKTOR_ERR_INVALID_FORMAT.
+ * 
+ * @param [in]  parser Parser object
+ * @param [out] ts     Populated with the decoded time
+ * @param [out] error  Error object pointer pointer or NULL
+ * 
+ * @return Status code - VKTOR_OK or VKTOR_ERROR
+ */
+vktor_status vktor_get_value_timespec(vktor_parser *parser, struct timespec *ts,
+                                      vktor_error **error);
+
+/**
+ * @brief Get the token value as a UUID
+ * 
+ * Decode the value of the current token, which should be a string holding a 
+ * UUID in its canonical 8-4-4-4-12 form or as 32 hexadecimal digits, into 16
+ * bytes in the order in which they are written. No memory is allocated.
+ * 
+ * If the value is not a valid UUID, error will indicate 
+ * VKTOR_ERR_INVALID_FORMAT.
+ * 
+ * @param [in]  parser Parser object
+ * @param [out] uuid   16 byte buffer populated with the UUID
+ * @param [out] error  Error object pointer pointer or NULL
+ * 
+ * @return Status code - VKTOR_OK or VKTOR_ERROR
+ */
+vktor_status vktor_get_value_uuid(vktor_parser *parser, unsigned char *uuid, 
+                                  vktor_error **error);
+
+/**
+ * @brief Get the token value as a hexadecimal number
+ * 
+ * Decode the value of the current token, which should be a string of 1 to 16
+ * hexadecimal digits without any prefix, into an unsigned 64 bit number. No 
+ * memory is allocated.
+ * 
+ * If the value is longer than 16 digits error will indicate 
+ * VKTOR_ERR_OUT_OF_RANGE, and if it is not a hexadecimal number error will 
+ * indicate VKTOR_ERR_INVALID_FORMAT. 
+ * 
+ * @param [in]  parser Parser object
+ * @param [out] error  Error object pointer pointer or NULL
+ * 
+ * @return The numeric value of the current token
+ * @retval 0 in case of error (although 0 might also be normal, so check the 
+ *         value of error)
+ */
+unsigned long long vktor_get_value_hex(vktor_parser *parser, vktor_error **error);
+
 /**
  * @brief Set memory handling function implementation
  *
@@ -334,6 +1343,11 @@ int vktor_get_value_str_copy(vktor_parser *parser, char **val, vktor_error **err
  * memory. Since this has global effect it is recommended to set this once before
  * doing anything with vktor, and not to change this.
  *
+ * These functions make up the default allocator, used by parsers which were 
+ * not initialized with an allocator of their own. To use different memory 
+ * management functions per parser, or to pass them a context, use 
+ * vktor_parser_init_allocator() instead.
+ *
  * You can pass NULL as any of the functions, in which case the standard malloc, 
  * realloc or free will be used.
  *
@@ -0,0 +1,112 @@
+/* 
+ * vktor JSON pull-parser library
+ * 
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE. 
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "vktor.h"
+#include "vktor_internal.h"
+#include "vktor_base64.h"
+
+/**
+ * Base64 decoding table, mapping each character to its 6 bit value or to 
+ * VKTOR_BASE64_INVALID. Both the standard and the URL safe alphabets are 
+ * accepted.
+ */
+const unsigned char vktor_base64_table[256] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3e, 0xff, 0x3e, 0xff, 0x3f,
+	0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0x3f,
+	0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+/**
+ * @brief Decode complete groups of base64 characters
+ * 
+ * Decode as many complete groups of 4 base64 characters as possible from the
+ * input into the output buffer, 3 bytes per group. Stops before the first 
+ * group containing a character which is not part of the base64 alphabet (such
+ * as padding, an escape character or the closing quote of a string), before 
+ * the first incomplete group, or when the output buffer has no room for 
+ * another group. 
+ * 
+ * Each group is decoded with four table lookups and a single validity check,
+ * so the loop is free of data dependent branches.
+ * 
+ * @param [in]  in       input characters
+ * @param [in]  in_len   number of input characters
+ * @param [out] out      output buffer
+ * @param [in]  out_size size of the output buffer
+ * @param [out] out_len  number of bytes written to the output buffer
+ * 
+ * @return number of input characters consumed (a multiple of 4)
+ */
+long
+vktor_base64_decode_groups(const char *in, long in_len, unsigned char *out, 
+                           long out_size, long *out_len)
+{
+	const unsigned char *p   = (const unsigned char *) in;
+	const unsigned char *end = p + (in_len & ~3L);
+	unsigned char       *o   = out;
+	unsigned long        a, b, c, d, v;
+	
+	while (p < end && (o - out) + 3 <= out_size) {
+		a = vktor_base64_table[p[0]];
+		b = vktor_base64_table[p[1]];
+		c = vktor_base64_table[p[2]];
+		d = vktor_base64_table[p[3]];
+		
+		// Invalid characters have the high bit set
+		if ((a | b | c | d) & 0x80) {
+			break;
+		}
+		
+		v = (a << 18) | (b << 12) | (c << 6) | d;
+		o[0] = (unsigned char) (v >> 16);
+		o[1] = (unsigned char) (v >> 8);
+		o[2] = (unsigned char) v;
+		
+		o += 3;
+		p += 4;
+	}
+	
+	*out_len = o - out;
+	return (const char *) p - in;
+}
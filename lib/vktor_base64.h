@@ -0,0 +1,84 @@
+/* 
+ * vktor JSON pull-parser library
+ * 
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE. 
+ */
+
+/**
+ * @file vktor_base64.h
+ * 
+ * vktor base64 header file - base64 decoding functions
+ * 
+ * @internal
+ */
+
+#ifndef _VKTOR_BASE64_H
+
+/**
+ * @ingroup internal
+ * @{
+ */
+
+/**
+ * Value of characters which are not part of the base64 alphabet in 
+ * vktor_base64_table
+ */
+#define VKTOR_BASE64_INVALID 0xff
+
+/**
+ * Base64 decoding table, mapping each character to its 6 bit value or to 
+ * VKTOR_BASE64_INVALID. Both the standard and the URL safe alphabets are 
+ * accepted.
+ */
+extern VKTOR_INTERNAL const unsigned char vktor_base64_table[256];
+
+/**
+ * @brief Decode complete groups of base64 characters
+ * 
+ * Decode as many complete groups of 4 base64 characters as possible from the
+ * input into the output buffer, 3 bytes per group. Stops before the first 
+ * group containing a character which is not part of the base64 alphabet (such
+ * as padding, an escape character or the closing quote of a string), before 
+ * the first incomplete group, or when the output buffer has no room for 
+ * another group. 
+ * 
+ * Each group is decoded with four table lookups and a single validity check,
+ * so the loop is free of data dependent branches.
+ * 
+ * @param [in]  in       input characters
+ * @param [in]  in_len   number of input characters
+ * @param [out] out      output buffer
+ * @param [in]  out_size size of the output buffer
+ * @param [out] out_len  number of bytes written to the output buffer
+ * 
+ * @return number of input characters consumed (a multiple of 4)
+ */
+VKTOR_INTERNAL long
+vktor_base64_decode_groups(const char *in, long in_len, unsigned char *out,
+                           long out_size, long *out_len);
+
+/** @} */ // end of internal API
+
+#define _VKTOR_BASE64_H
+#endif /* VKTOR_BASE64_H */
@@ -0,0 +1,447 @@
+/* 
+ * vktor JSON pull-parser library
+ * 
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE. 
+ */
+
+/**
+ * @file vktor_checkpoint.c
+ * 
+ * vktor checkpoints - serializes the state of a parser so it can be 
+ * restored in another process
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+
+#include "vktor.h"
+#include "vktor_internal.h"
+
+/**
+ * @ingroup internal
+ * @{
+ */
+
+/**
+ * @brief Write a parser checkpoint
+ * 
+ * The checkpoint is the magic bytes "VKCP" and a format version byte, 
+ * followed by the input offset, token type, expected tokens, unicode 
+ * character being decoded, token resume flag and nesting depth, then the 
+ * nesting stack bits and finally the length and contents of a partially read
+ * token, if any. Token contents are only saved for strings, object keys and
+ * numbers - for true, false and null the length is enough.
+ * 
+ * @param [in]  parser Parser object
+ * @param [out] out    Memory to write to, or NULL to only measure the size
+ * @param [in]  offset Input offset the parser has reached
+ * 
+ * @return Size of the checkpoint
+ */
+static long
+parser_checkpoint_write(vktor_parser *parser, unsigned char *out, long offset)
+{
+	long pos, size = 0;
+	long stack_bytes = (parser->nest_ptr + 7) / 8;
+	
+	if (out != NULL) {
+		memcpy(out, "VKCP", 4);
+		out[4] = 1;
+	}
+	
+	pos = vktor_varint_write(out, 5, (unsigned long) offset);
+	pos = vktor_varint_write(out, pos, (unsigned long) parser->token_type);
+	pos = vktor_varint_write(out, pos, (unsigned long) parser->expected);
+	pos = vktor_varint_write(out, pos, parser->unicode_c);
+	pos = vktor_varint_write(out, pos, (unsigned long) parser->token_resume);
+	pos = vktor_varint_write(out, pos, (unsigned long) parser->nest_ptr);
+	
+	if (out != NULL && stack_bytes > 0) {
+		memcpy(out + pos, parser->nest_stack, stack_bytes);
+	}
+	pos += stack_bytes;
+	
+	if (parser->token_resume) {
+		// A delivered string part is not needed to read the next one
+		if (parser->token_type != VKTOR_T_STRING_PART) {
+			size = parser->token_size;
+		}
+		pos = vktor_varint_write(out, pos, (unsigned long) size);
+		
+		switch (parser->token_type) {
+			case VKTOR_T_STRING:
+			case VKTOR_T_OBJECT_KEY:
+			case VKTOR_T_INT:
+			case VKTOR_T_FLOAT:
+				if (out != NULL && size > 0) {
+					memcpy(out + pos, parser->token_value, size);
+				}
+				pos += size;
+				break;
+				
+			default:
+				break;
+		}
+	}
+	
+	return pos;
+}
+
+/**
+ * @brief Check the token state of a parser checkpoint
+ * 
+ * Check that a restored token type, expected token map and token resume 
+ * flag could have been saved by parser_checkpoint_write(), given the nesting
+ * stack which was already restored. Between tokens, only the tokens and 
+ * separators which may follow in the current struct can be expected. While
+ * a token is being read, expected holds the state of reading that token.
+ * 
+ * @param [in] parser   Parser object, with the nesting stack restored
+ * @param [in] token    token type
+ * @param [in] expected expected token map
+ * @param [in] resume   token resume flag
+ * @param [in] size     length of the partially read token
+ * 
+ * @return 1 if the state is valid, 0 otherwise
+ */
+static int
+parser_checkpoint_valid(vktor_parser *parser, unsigned long token, 
+                        unsigned long expected, unsigned long resume, 
+                        unsigned long size)
+{
+	unsigned long allowed;
+	
+	// A single token type, or none
+	if (token > VKTOR_T_STRING_PART || (token & (token - 1)) != 0) {
+		return 0;
+	}
+	
+	// After the end of a struct both ends are expected, the one which does 
+	// not match the nesting stack is rejected when it is read
+	switch (nest_stack_top(parser)) {
+		case VKTOR_STRUCT_OBJECT:
+			allowed = VKTOR_VALUE_TOKEN | VKTOR_T_OBJECT_KEY | 
+			          VKTOR_T_OBJECT_END | VKTOR_T_ARRAY_END | 
+			          VKTOR_C_COMMA | VKTOR_C_COLON;
+			break;
+			
+		case VKTOR_STRUCT_ARRAY:
+			allowed = VKTOR_VALUE_TOKEN | VKTOR_T_OBJECT_END | 
+			          VKTOR_T_ARRAY_END | VKTOR_C_COMMA;
+			break;
+			
+		default:
+			allowed = VKTOR_VALUE_TOKEN;
+			break;
+	}
+	
+	if (! resume) {
+		// A string part is always followed by more of the string
+		return (token != VKTOR_T_STRING_PART && (expected & ~allowed) == 0);
+	}
+	
+	switch (token) {
+		case VKTOR_T_STRING:
+		case VKTOR_T_STRING_PART:
+			// Until an escape sequence is read, a string value keeps the
+			// map of tokens expected before it
+			if ((expected & VKTOR_T_STRING) && (expected & ~allowed) == 0) {
+				return 1;
+			}
+			// fall through
+			
+		case VKTOR_T_OBJECT_KEY:
+			if (token == VKTOR_T_OBJECT_KEY && 
+			    nest_stack_top(parser) != VKTOR_STRUCT_OBJECT) {
+				return 0;
+			}
+			
+			switch (expected) {
+				case VKTOR_T_STRING:
+				case VKTOR_C_ESCAPED:
+				case VKTOR_C_UNIC1:
+				case VKTOR_C_UNIC2:
+				case VKTOR_C_UNIC3:
+				case VKTOR_C_UNIC4:
+				case VKTOR_C_UNIC_LS:
+				case VKTOR_C_UNIC_LU:
+					return 1;
+			}
+			return 0;
+			
+		case VKTOR_T_INT:
+		case VKTOR_T_FLOAT:
+			return (expected & ~(VKTOR_T_INT | VKTOR_T_FLOAT | VKTOR_C_DOT | 
+			                     VKTOR_C_EXP | VKTOR_C_SIGNUM)) == 0;
+			
+		case VKTOR_T_NULL:
+		case VKTOR_T_TRUE:
+			// Part of the literal, but not all of it, was read
+			return (size > 0 && size < 4 && (expected & ~allowed) == 0);
+			
+		case VKTOR_T_FALSE:
+			return (size > 0 && size < 5 && (expected & ~allowed) == 0);
+			
+		default:
+			return 0;
+	}
+}
+
+/** @} */ // end of internal API
+
+/**
+ * @ingroup external
+ * @{
+ */
+
+/**
+ * @brief Save the state of a parser
+ * 
+ * Write a checkpoint holding the state of the parser along with the offset 
+ * in the input it has reached, so parsing can be resumed later, possibly in
+ * another process, using vktor_parser_restore(). This includes the nesting
+ * stack, the tokens expected next and any partially read token. Checkpoints 
+ * are small: a few bytes plus the nesting depth in bits and the length of a 
+ * partially read token.
+ * 
+ * Checkpoints can be taken between calls to vktor_parse(), but not while a 
+ * value is skipped, captured or read as base64, while a document is being 
+ * validated, or while subtree hashing or a schema is enabled. The value of 
+ * the current token is not saved, and neither is the state of a columnar 
+ * reader using the parser.
+ * 
+ * @param [in]  parser   parser object
+ * @param [out] out      memory to write the checkpoint to, or NULL to only 
+ *                       get its size
+ * @param [in]  out_size size of out
+ * @param [out] len      set to the size of the checkpoint in bytes, which is 
+ *                       only written if it fits in out_size bytes
+ * @param [out] error    error object pointer pointer or NULL
+ * 
+ * @return Status code - VKTOR_OK or VKTOR_ERROR
+ */
+vktor_status
+vktor_parser_checkpoint(vktor_parser *parser, unsigned char *out, 
+                        long out_size, long *len, vktor_error **error)
+{
+	vktor_buffer *buffer;
+	long          offset;
+	
+	assert(parser != NULL);
+	assert(len != NULL);
+	
+	if (skip_active(parser) || 
+	    base64_active(parser) || 
+	    valid_active(parser)) {
+		vktor_set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"a value is partially skipped, captured, validated or read as base64");
+		return VKTOR_ERROR;
+	}
+	
+	if (parser->hash != NULL) {
+		vktor_set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"can't checkpoint while subtree hashing is enabled");
+		return VKTOR_ERROR;
+	}
+	
+	if (parser->schema != NULL) {
+		vktor_set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"can't checkpoint while a schema is enabled");
+		return VKTOR_ERROR;
+	}
+	
+	// The offset is what was fed, less what was not parsed yet
+	if (parser->complete_text != NULL) {
+		offset = parser->complete_ptr - parser->complete_text;
+	} else {
+		offset = parser->fed;
+		for (buffer = parser->buffer; buffer != NULL; buffer = buffer->next_buff) {
+			offset -= buffer->size - buffer->ptr;
+		}
+	}
+	
+	*len = parser_checkpoint_write(parser, NULL, offset);
+	if (out != NULL && *len <= out_size) {
+		parser_checkpoint_write(parser, out, offset);
+	}
+	
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Restore the state of a parser
+ * 
+ * Restore a checkpoint written by vktor_parser_checkpoint() into a new 
+ * parser. If the parser was fed complete input using vktor_feed_complete(), 
+ * it is moved to the checkpoint's offset in it. Otherwise, it must be fed 
+ * with the input starting at that offset.
+ * 
+ * The restored state is checked to be one the parser can reach: a checkpoint
+ * which was damaged or not written by vktor_parser_checkpoint() fails with 
+ * VKTOR_ERR_INVALID_FORMAT.
+ * 
+ * @param [in,out] parser new parser object
+ * @param [in]     data   checkpoint
+ * @param [in]     len    length of the checkpoint
+ * @param [out]    offset set to the offset in the input to resume from
+ * @param [out]    error  error object pointer pointer or NULL
+ * 
+ * @return Status code - VKTOR_OK or VKTOR_ERROR
+ */
+vktor_status
+vktor_parser_restore(vktor_parser *parser, const unsigned char *data, long len,
+                     long *offset, vktor_error **error)
+{
+	unsigned long  num[6], size = 0;
+	long           pos = 5, level;
+	int            i, has_value = 0;
+	char          *token = NULL;
+	
+	assert(parser != NULL);
+	assert(data != NULL);
+	
+	if (parser->token_type != VKTOR_T_NONE || parser->nest_ptr != 0 || 
+	    parser->buffer != NULL || parser->fed != 0 || 
+	    parser->complete_ptr != parser->complete_text) {
+		vktor_set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"a checkpoint can only be restored into a new parser");
+		return VKTOR_ERROR;
+	}
+	
+	if (parser->inflate != NULL) {
+		vktor_set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"a checkpoint can't be restored into compressed input");
+		return VKTOR_ERROR;
+	}
+	
+	// Offset, token type, expected, unicode_c, token_resume and nest_ptr
+	if (len < 5 || memcmp(data, "VKCP", 4) != 0 || data[4] != 1) {
+		goto invalid;
+	}
+	for (i = 0; i < 6; i++) {
+		if (! vktor_varint_read(data, len, &pos, &num[i])) {
+			goto invalid;
+		}
+	}
+	
+	if (num[4] && parser->complete_text != NULL) {
+		vktor_set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"a partially read token can't be restored into complete input");
+		return VKTOR_ERROR;
+	}
+	
+	if (num[0] > LONG_MAX || num[4] > 1 || 
+	    num[5] > (unsigned long) (len - pos) * 8 || 
+	    (parser->complete_text != NULL && 
+	     num[0] > (unsigned long) (parser->complete_end - parser->complete_text))) {
+		goto invalid;
+	}
+	
+	// Rebuild the nesting stack level by level
+	for (level = 0; level < (long) num[5]; level++) {
+		if (vktor_nest_stack_add(parser, 
+		    (data[pos + (level >> 3)] & (1 << (level & 7)) ? 
+		     VKTOR_STRUCT_OBJECT : VKTOR_STRUCT_ARRAY), error) == VKTOR_ERROR) {
+			parser->nest_ptr = 0;
+			return VKTOR_ERROR;
+		}
+	}
+	pos += (num[5] + 7) / 8;
+	
+	if (num[4]) {
+		switch (num[1]) {
+			case VKTOR_T_STRING:
+			case VKTOR_T_OBJECT_KEY:
+			case VKTOR_T_INT:
+			case VKTOR_T_FLOAT:
+				has_value = 1;
+				break;
+		}
+		
+		if (! vktor_varint_read(data, len, &pos, &size) || size > INT_MAX || 
+		    (has_value && size > (unsigned long) (len - pos))) {
+			parser->nest_ptr = 0;
+			goto invalid;
+		}
+		
+		if (has_value) {
+			if ((token = vmalloc(parser, (size > 0 ? size : 1))) == NULL) {
+				parser->nest_ptr = 0;
+				vktor_set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+					"unable to allocate %lu bytes for token", size);
+				return VKTOR_ERROR;
+			}
+			memcpy(token, data + pos, size);
+			pos += size;
+		}
+	}
+	
+	if (pos != len || ! parser_checkpoint_valid(parser, num[1], num[2], num[4], 
+	    size)) {
+		if (token != NULL) {
+			vfree(parser, token);
+		}
+		parser->nest_ptr = 0;
+		goto invalid;
+	}
+	
+	// The current token is only kept if it is being read, or if the 
+	// document has ended
+	if (num[4] || num[5] == 0) {
+		parser->token_type = (vktor_token) num[1];
+	}
+	parser->token_value  = token;
+	parser->token_size   = (int) size;
+	parser->token_alloc  = (token == NULL ? 0 : (size > 0 ? (int) size : 1));
+	parser->token_resume = (char) num[4];
+	parser->expected     = (long) num[2];
+	parser->unicode_c    = num[3];
+	
+	if (parser->complete_text != NULL) {
+		vktor_complete_set_position(parser, parser->complete_text + num[0]);
+	} else {
+		parser->fed = (long) num[0];
+#ifdef BYTECOUNTER
+		parser->bytecounter = num[0];
+#endif
+	}
+	
+	if (offset != NULL) {
+		*offset = (long) num[0];
+	}
+	
+	return VKTOR_OK;
+	
+invalid:
+	vktor_set_error(parser, error, VKTOR_ERR_INVALID_FORMAT, 
+		"data is not a valid parser checkpoint");
+	return VKTOR_ERROR;
+}
+
+/** @} */ // end of external API
@@ -0,0 +1,667 @@
+/* 
+ * vktor JSON pull-parser library
+ * 
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE. 
+ */
+
+/**
+ * @file vktor_columns.c
+ * 
+ * vktor columnar reader - pivots an array of objects into batches of 
+ * columns
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <float.h>
+#include <assert.h>
+
+#include "vktor.h"
+#include "vktor_internal.h"
+
+/**
+ * Node of the tree of object keys read by a columnar reader
+ */
+typedef struct _vktor_column_node_struct {
+	const char *key;     /**< object key, not NULL terminated */
+	int         key_len; /**< length of the object key */
+	int         parent;  /**< parent node, or -1 for keys of the row object */
+	int         column;  /**< column of the value, or -1 for nested objects */
+} vktor_column_node;
+
+/**
+ * Columnar reader struct, building column batches from an array of objects
+ */
+struct _vktor_columns_struct {
+	vktor_allocator    allocator;  /**< allocator used for the reader */
+	long               batch_rows; /**< maximal number of rows in a batch */
+	vktor_batch        batch;      /**< current batch */
+	long              *data_size;  /**< allocated string data of each column */
+	vktor_column_node *nodes;      /**< tree of object keys */
+	int                num_nodes;  /**< number of nodes */
+	int               *stack;      /**< node of each object in the row */
+	int                depth;      /**< object nesting level in the row */
+	int                pending;    /**< node of the next value, or -1 */
+	char               started;    /**< an array is being read */
+	char               skipping;   /**< the next value is being skipped */
+	char               in_part;    /**< a string is read in parts */
+	char               handed;     /**< the batch was returned */
+};
+
+/**
+ * @ingroup internal
+ * @{
+ */
+
+/**
+ * @brief Find the node of an object key in a columnar reader
+ * 
+ * @param [in] columns Columnar reader
+ * @param [in] parent  Node of the object the key is in, or -1 for the row
+ * @param [in] key     Object key
+ * @param [in] key_len Length of the object key
+ * 
+ * @return node index, or -1 if the key is not read into any column
+ */
+static int
+columns_find_node(vktor_columns *columns, int parent, const char *key, 
+                  int key_len)
+{
+	int i;
+	
+	for (i = 0; i < columns->num_nodes; i++) {
+		if (columns->nodes[i].parent == parent && 
+		    columns->nodes[i].key_len == key_len &&
+		    memcmp(columns->nodes[i].key, key, key_len) == 0) {
+			return i;
+		}
+	}
+	
+	return -1;
+}
+
+/**
+ * @brief Start a new row of the current batch
+ * 
+ * Values of the row are unset until they are read
+ * 
+ * @param [in,out] columns Columnar reader
+ */
+static void
+columns_row_start(vktor_columns *columns)
+{
+	vktor_column *col;
+	long          row = columns->batch.rows;
+	int           i;
+	
+	for (i = 0; i < columns->batch.num_columns; i++) {
+		col = &columns->batch.columns[i];
+		switch (col->type) {
+			case VKTOR_COL_INT64:
+				((long long *) col->values)[row] = 0;
+				break;
+				
+			case VKTOR_COL_DOUBLE:
+				((double *) col->values)[row] = 0;
+				break;
+				
+			case VKTOR_COL_BOOL:
+				((char *) col->values)[row] = 0;
+				break;
+				
+			case VKTOR_COL_STRING:
+				col->offsets[row + 1] = col->offsets[row];
+				break;
+		}
+	}
+}
+
+/**
+ * @brief Store the current token as the value of a column in the current row
+ * 
+ * String values may be delivered in parts, which are appended to the value.
+ * A string value replaces any previous value of the same row, in case an 
+ * object key is repeated.
+ * 
+ * @param [in,out] columns Columnar reader
+ * @param [in,out] parser  Parser object
+ * @param [in]     index   Column index
+ * @param [out]    error   Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK or VKTOR_ERROR
+ */
+static vktor_status
+columns_store(vktor_columns *columns, vktor_parser *parser, int index, 
+              vktor_error **error)
+{
+	vktor_column *col   = &columns->batch.columns[index];
+	long          row   = columns->batch.rows;
+	vktor_token   token = parser->token_type;
+	long          end, size;
+	char         *data;
+	double        dval;
+	
+	if (token == VKTOR_T_NULL) {
+		if (col->type == VKTOR_COL_STRING) {
+			col->offsets[row + 1] = col->offsets[row];
+		}
+		col->valid[row / 8] &= ~(1 << (row % 8));
+		return VKTOR_OK;
+	}
+	
+	switch (col->type) {
+		case VKTOR_COL_INT64:
+			if (token != VKTOR_T_INT) {
+				break;
+			}
+			errno = 0;
+			((long long *) col->values)[row] = 
+				strtoll((char *) parser->token_value, NULL, 10);
+			if (errno == ERANGE) {
+				vktor_set_error(parser, error, VKTOR_ERR_OUT_OF_RANGE, 
+					"value of column '%s' overflows maximal long long value",
+					col->path);
+				return VKTOR_ERROR;
+			}
+			col->valid[row / 8] |= 1 << (row % 8);
+			return VKTOR_OK;
+			
+		case VKTOR_COL_DOUBLE:
+			if (token != VKTOR_T_INT && token != VKTOR_T_FLOAT) {
+				break;
+			}
+			errno = 0;
+			dval = strtod((char *) parser->token_value, NULL);
+			if (errno == ERANGE && (dval > DBL_MAX || dval < -DBL_MAX)) {
+				vktor_set_error(parser, error, VKTOR_ERR_OUT_OF_RANGE, 
+					"value of column '%s' overflows maximal double value",
+					col->path);
+				return VKTOR_ERROR;
+			}
+			((double *) col->values)[row] = dval;
+			col->valid[row / 8] |= 1 << (row % 8);
+			return VKTOR_OK;
+			
+		case VKTOR_COL_BOOL:
+			if (token != VKTOR_T_TRUE && token != VKTOR_T_FALSE) {
+				break;
+			}
+			((char *) col->values)[row] = (token == VKTOR_T_TRUE);
+			col->valid[row / 8] |= 1 << (row % 8);
+			return VKTOR_OK;
+			
+		case VKTOR_COL_STRING:
+			if (token != VKTOR_T_STRING && token != VKTOR_T_STRING_PART) {
+				break;
+			}
+			
+			// A new value replaces the value of a repeated key
+			if (! columns->in_part) {
+				col->offsets[row + 1] = col->offsets[row];
+			}
+			columns->in_part = (token == VKTOR_T_STRING_PART);
+			
+			end = col->offsets[row + 1] + parser->token_size;
+			if (end > columns->data_size[index]) {
+				size = columns->data_size[index] * 2;
+				while (size < end) {
+					size *= 2;
+				}
+				
+				data = columns->allocator.realloc(columns->allocator.ctx, 
+					col->data, size);
+				if (data == NULL) {
+					vktor_set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+						"unable to allocate %ld bytes for column data", size);
+					return VKTOR_ERROR;
+				}
+				col->data = data;
+				columns->data_size[index] = size;
+			}
+			
+			if (parser->token_size > 0) {
+				memcpy(col->data + col->offsets[row + 1], parser->token_value, 
+					parser->token_size);
+			}
+			col->offsets[row + 1] = end;
+			col->valid[row / 8] |= 1 << (row % 8);
+			return VKTOR_OK;
+	}
+	
+	vktor_set_error(parser, error, VKTOR_ERR_INVALID_FORMAT, 
+		"value of column '%s' does not match the column type", col->path);
+	return VKTOR_ERROR;
+}
+
+/**
+ * @brief Read rows into the current batch of a columnar reader
+ * 
+ * Read objects of the array into rows until the batch is full or the array
+ * ends. Unknown object keys are skipped along with their values.
+ * 
+ * @param [in,out] columns Columnar reader
+ * @param [in,out] parser  Parser object
+ * @param [out]    error   Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK once the batch is ready, VKTOR_MORE_DATA or 
+ *   VKTOR_ERROR
+ */
+static vktor_status
+columns_read_rows(vktor_columns *columns, vktor_parser *parser, 
+                  vktor_error **error)
+{
+	vktor_status status;
+	vktor_token  token;
+	int          node;
+	
+	while (1) {
+		if (columns->skipping) {
+			if ((status = vktor_skip_value(parser, error)) != VKTOR_OK) {
+				return status;
+			}
+			columns->skipping = 0;
+		}
+		
+		if (columns->depth == 0 && 
+		    columns->batch.rows == columns->batch_rows) {
+			return VKTOR_OK;
+		}
+		
+		if ((status = vktor_parse(parser, error)) != VKTOR_OK) {
+			return status;
+		}
+		token = parser->token_type;
+		
+		// Between rows
+		if (columns->depth == 0) {
+			switch (token) {
+				case VKTOR_T_OBJECT_START:
+					columns_row_start(columns);
+					columns->depth    = 1;
+					columns->stack[1] = -1;
+					columns->pending  = -1;
+					break;
+					
+				case VKTOR_T_NULL:
+					columns_row_start(columns);
+					columns->batch.rows++;
+					break;
+					
+				case VKTOR_T_ARRAY_END:
+					columns->batch.last = 1;
+					return VKTOR_OK;
+					
+				default:
+					vktor_set_error(parser, error, VKTOR_ERR_INVALID_FORMAT, 
+						"array member is not an object");
+					return VKTOR_ERROR;
+			}
+			continue;
+		}
+		
+		switch (token) {
+			case VKTOR_T_OBJECT_KEY:
+				node = columns_find_node(columns, 
+					columns->stack[columns->depth], 
+					(char *) parser->token_value, parser->token_size);
+				if (node == -1) {
+					columns->skipping = 1;
+				}
+				columns->pending = node;
+				break;
+				
+			case VKTOR_T_OBJECT_END:
+				if (--columns->depth == 0) {
+					columns->batch.rows++;
+				}
+				break;
+				
+			case VKTOR_T_OBJECT_START:
+				assert(columns->pending != -1);
+				if (columns->nodes[columns->pending].column == -1) {
+					columns->stack[++columns->depth] = columns->pending;
+					columns->pending = -1;
+					break;
+				}
+				
+				// Objects don't match any column type
+				if (columns_store(columns, parser, 
+				    columns->nodes[columns->pending].column, error) != 
+				    VKTOR_OK) {
+					return VKTOR_ERROR;
+				}
+				break;
+				
+			default:
+				assert(columns->pending != -1);
+				node = columns->pending;
+				
+				if (columns->nodes[node].column == -1) {
+					// Only objects and null can be read into nested keys
+					if (token != VKTOR_T_NULL) {
+						vktor_set_error(parser, error, VKTOR_ERR_INVALID_FORMAT, 
+							"value of key '%.*s' is not an object", 
+							columns->nodes[node].key_len, 
+							columns->nodes[node].key);
+						return VKTOR_ERROR;
+					}
+					
+				} else if (columns_store(columns, parser, 
+				           columns->nodes[node].column, error) != VKTOR_OK) {
+					return VKTOR_ERROR;
+				}
+				
+				if (! columns->in_part) {
+					columns->pending = -1;
+				}
+				break;
+		}
+	}
+}
+
+/** @} */ // end of internal API
+
+/**
+ * @ingroup external
+ * @{
+ */
+
+/**
+ * @brief Initialize a columnar reader
+ * 
+ * Initialize a reader which pivots an array of objects into batches of 
+ * columns, one column for each entry of spec. Nested object members are 
+ * named by a dot separated path, such as "user.id". Object keys which are 
+ * not part of any path are skipped without being read into tokens.
+ * 
+ * The spec is copied, and can be freed once the reader is initialized. 
+ * 
+ * @param [in] spec        column specifications
+ * @param [in] num_columns number of column specifications
+ * @param [in] batch_rows  maximal number of rows in each batch
+ * @param [in] allocator   allocator to use for the reader and its batches, or
+ *                         NULL for the default allocator
+ * 
+ * @return a newly allocated reader, or NULL if memory can't be allocated or 
+ *   if the spec is invalid (a path is repeated or is a prefix of another)
+ */
+vktor_columns*
+vktor_columns_init(const vktor_column_spec *spec, int num_columns, 
+                   long batch_rows, const vktor_allocator *allocator)
+{
+	vktor_columns *columns;
+	vktor_column  *col;
+	size_t         size, paths_size = 0;
+	int            i, node, parent, key_len, num_keys = 0, max_keys = 0;
+	int            keys;
+	char          *paths, *key, *dot;
+	
+	if (num_columns < 1 || batch_rows < 1) {
+		return NULL;
+	}
+	
+	if (allocator == NULL) {
+		allocator = &vktor_default_allocator;
+	}
+	
+	for (i = 0; i < num_columns; i++) {
+		paths_size += strlen(spec[i].path) + 1;
+		for (keys = 1, key = (char *) spec[i].path; *key; key++) {
+			keys += (*key == '.');
+		}
+		num_keys += keys;
+		if (keys > max_keys) {
+			max_keys = keys;
+		}
+	}
+	
+	// The columns, key tree, nesting stack and paths are allocated along with 
+	// the reader, in order of alignment
+	size = sizeof(vktor_columns) + 
+	       sizeof(vktor_column) * num_columns + 
+	       sizeof(vktor_column_node) * num_keys + 
+	       sizeof(long) * num_columns + 
+	       sizeof(int) * (max_keys + 1) + 
+	       paths_size;
+	
+	columns = allocator->malloc(allocator->ctx, size);
+	if (columns == NULL) {
+		return NULL;
+	}
+	memset(columns, 0, size);
+	
+	columns->allocator         = *allocator;
+	columns->batch_rows        = batch_rows;
+	columns->batch.num_columns = num_columns;
+	columns->batch.columns     = (vktor_column *) (columns + 1);
+	columns->nodes             = (vktor_column_node *) 
+	                             (columns->batch.columns + num_columns);
+	columns->data_size         = (long *) (columns->nodes + num_keys);
+	columns->stack             = (int *) (columns->data_size + num_columns);
+	columns->handed            = 1;
+	paths                      = (char *) (columns->stack + max_keys + 1);
+	
+	for (i = 0; i < num_columns; i++) {
+		col       = &columns->batch.columns[i];
+		col->type = spec[i].type;
+		col->path = paths;
+		strcpy(paths, spec[i].path);
+		paths += strlen(paths) + 1;
+		
+		// Add the keys of the path to the key tree
+		parent = -1;
+		for (key = (char *) col->path; ; key = dot + 1) {
+			if ((dot = strchr(key, '.')) == NULL) {
+				dot = key + strlen(key);
+			}
+			key_len = dot - key;
+			
+			node = columns_find_node(columns, parent, key, key_len);
+			if (key_len == 0 || (node != -1 && 
+			    (*dot == '\0' || columns->nodes[node].column != -1))) {
+				// Empty, repeated or conflicting path
+				vktor_columns_free(columns);
+				return NULL;
+			}
+			
+			if (node == -1) {
+				node = columns->num_nodes++;
+				columns->nodes[node].key     = key;
+				columns->nodes[node].key_len = key_len;
+				columns->nodes[node].parent  = parent;
+				columns->nodes[node].column  = (*dot == '\0' ? i : -1);
+			}
+			
+			if (*dot == '\0') {
+				break;
+			}
+			parent = node;
+		}
+		
+		switch (col->type) {
+			case VKTOR_COL_INT64:
+				size = sizeof(long long);
+				break;
+				
+			case VKTOR_COL_DOUBLE:
+				size = sizeof(double);
+				break;
+				
+			case VKTOR_COL_BOOL:
+				size = sizeof(char);
+				break;
+				
+			default:
+				size = 0;
+				break;
+		}
+		
+		if (size > 0) {
+			col->values = allocator->malloc(allocator->ctx, size * batch_rows);
+		} else {
+			columns->data_size[i] = 64;
+			col->data    = allocator->malloc(allocator->ctx, 64);
+			col->offsets = allocator->malloc(allocator->ctx, 
+				sizeof(long) * (batch_rows + 1));
+		}
+		col->valid = allocator->malloc(allocator->ctx, (batch_rows + 7) / 8);
+		
+		if (col->valid == NULL || (size > 0 ? col->values == NULL : 
+		    (col->data == NULL || col->offsets == NULL))) {
+			vktor_columns_free(columns);
+			return NULL;
+		}
+	}
+	
+	return columns;
+}
+
+/**
+ * @brief Read the next batch of rows from an array of objects
+ * 
+ * Read objects from the array the parser is in into a batch of columns. 
+ * The first call must be made right after the array start token was read, 
+ * and the same parser must be passed in all following calls until the last
+ * batch of the array was read. 
+ * 
+ * Members which don't match their column type are an error, except for null
+ * which leaves the row's value unset. A null array member is read as a row 
+ * with no values. Other non-object members of the array are an error.
+ * 
+ * The batch is owned by the reader and is valid until the next call. After 
+ * the last batch of an array, which has the last flag set and may have no 
+ * rows, the parser is positioned after the array end token and the reader 
+ * can be used for another array.
+ * 
+ * @param [in,out] columns columnar reader
+ * @param [in,out] parser  parser positioned in an array of objects
+ * @param [out]    batch   batch pointer pointer, set when VKTOR_OK is 
+ *                         returned
+ * @param [out]    error   error object pointer pointer or NULL
+ * 
+ * @return status code:
+ *  - VKTOR_OK        if a batch is full or the array has ended
+ *  - VKTOR_ERROR     if an error has occured
+ *  - VKTOR_MORE_DATA if we need more data in order to continue reading
+ */
+vktor_status
+vktor_columns_read(vktor_columns *columns, vktor_parser *parser, 
+                   vktor_batch **batch, vktor_error **error)
+{
+	vktor_status status;
+	int          i;
+	
+	assert(columns != NULL);
+	assert(parser != NULL);
+	
+	if (! columns->started) {
+		if (parser->token_type != VKTOR_T_ARRAY_START || 
+		    skip_active(parser)) {
+			vktor_set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+				"parser is not at the start of an array");
+			return VKTOR_ERROR;
+		}
+		
+		columns->started  = 1;
+		columns->depth    = 0;
+		columns->skipping = 0;
+		columns->in_part  = 0;
+	}
+	
+	// The previously returned batch is reused
+	if (columns->handed) {
+		columns->handed     = 0;
+		columns->batch.rows = 0;
+		columns->batch.last = 0;
+		for (i = 0; i < columns->batch.num_columns; i++) {
+			memset(columns->batch.columns[i].valid, 0, 
+				(columns->batch_rows + 7) / 8);
+			if (columns->batch.columns[i].type == VKTOR_COL_STRING) {
+				columns->batch.columns[i].offsets[0] = 0;
+			}
+		}
+	}
+	
+	status = columns_read_rows(columns, parser, error);
+	
+	switch (status) {
+		case VKTOR_OK:
+			columns->handed  = 1;
+			columns->started = ! columns->batch.last;
+			*batch = &columns->batch;
+			break;
+			
+		case VKTOR_MORE_DATA:
+			break;
+			
+		default:
+			// The array can't be read any further
+			columns->handed  = 1;
+			columns->started = 0;
+			break;
+	}
+	
+	return status;
+}
+
+/**
+ * @brief Free a columnar reader
+ * 
+ * Free a columnar reader along with its batch
+ * 
+ * @param [in,out] columns columnar reader
+ */
+void
+vktor_columns_free(vktor_columns *columns)
+{
+	vktor_column *col;
+	int           i;
+	
+	assert(columns != NULL);
+	
+	for (i = 0; i < columns->batch.num_columns; i++) {
+		col = &columns->batch.columns[i];
+		if (col->values != NULL) {
+			columns->allocator.free(columns->allocator.ctx, col->values);
+		}
+		if (col->offsets != NULL) {
+			columns->allocator.free(columns->allocator.ctx, col->offsets);
+		}
+		if (col->data != NULL) {
+			columns->allocator.free(columns->allocator.ctx, col->data);
+		}
+		if (col->valid != NULL) {
+			columns->allocator.free(columns->allocator.ctx, col->valid);
+		}
+	}
+	
+	columns->allocator.free(columns->allocator.ctx, columns);
+}
+
+/** @} */ // end of external API
@@ -0,0 +1,179 @@
+/* 
+ * vktor JSON pull-parser library
+ * 
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE. 
+ */
+
+/**
+ * @file vktor_hash.c
+ * 
+ * 64 bit hash function. Input is mixed in 8 bytes at a time, each multiplied
+ * by a large odd constant and rotated into the state, and the final hash is 
+ * passed through the splitmix64 finalizer so that every input bit affects all
+ * output bits. Words are always assembled in little-endian order, so hashes 
+ * are the same on all platforms.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "vktor.h"
+#include "vktor_internal.h"
+#include "vktor_hash.h"
+
+#define HASH_K1 0x9E3779B97F4A7C15ULL
+#define HASH_K2 0xC2B2AE3D27D4EB4FULL
+
+/* Rotate a 64 bit word left */
+#define rotl64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+/**
+ * @brief Mix an 8 byte word into the hash
+ * 
+ * @param [in] h hash
+ * @param [in] w word
+ * 
+ * @return new hash
+ */
+static unsigned long long
+hash_mix(unsigned long long h, unsigned long long w)
+{
+	h ^= rotl64(w * HASH_K1, 31) * HASH_K2;
+	return rotl64(h, 27) * 5 + 0x52DCE729;
+}
+
+/**
+ * @brief Mix all bits of a hash (the splitmix64 finalizer)
+ * 
+ * @param [in] h hash
+ * 
+ * @return mixed hash
+ */
+static unsigned long long
+hash_fmix(unsigned long long h)
+{
+	h ^= h >> 30;
+	h *= 0xBF58476D1CE4E5B9ULL;
+	h ^= h >> 27;
+	h *= 0x94D049BB133111EBULL;
+	h ^= h >> 31;
+	return h;
+}
+
+/**
+ * @brief Start a new hash
+ * 
+ * @param [out] state hash state
+ * @param [in]  seed  seed, so equal input with a different seed (such as a 
+ *                    different token type) has a different hash
+ */
+void
+vktor_hash_init(vktor_hash_state *state, unsigned long long seed)
+{
+	state->h        = hash_fmix(seed + HASH_K1);
+	state->tail     = 0;
+	state->tail_len = 0;
+	state->len      = 0;
+}
+
+/**
+ * @brief Add input to a hash
+ * 
+ * Input can be added in any number of parts - the hash only depends on the 
+ * concatenated input.
+ * 
+ * @param [in,out] state hash state
+ * @param [in]     data  input
+ * @param [in]     len   input length
+ */
+void
+vktor_hash_update(vktor_hash_state *state, const void *data, long len)
+{
+	const unsigned char *p = data, *end = p + len;
+	unsigned long long   w;
+	
+	state->len += len;
+	
+	// Complete the word left over from the previous part
+	while (state->tail_len > 0 && p < end) {
+		state->tail |= (unsigned long long) *p++ << (state->tail_len * 8);
+		if (++state->tail_len == 8) {
+			state->h        = hash_mix(state->h, state->tail);
+			state->tail     = 0;
+			state->tail_len = 0;
+		}
+	}
+	
+	for (; end - p >= 8; p += 8) {
+		w = (unsigned long long) p[0]         | 
+		    (unsigned long long) p[1] << 8    | 
+		    (unsigned long long) p[2] << 16   | 
+		    (unsigned long long) p[3] << 24   | 
+		    (unsigned long long) p[4] << 32   | 
+		    (unsigned long long) p[5] << 40   | 
+		    (unsigned long long) p[6] << 48   | 
+		    (unsigned long long) p[7] << 56;
+		state->h = hash_mix(state->h, w);
+	}
+	
+	// Keep the rest for the next part
+	for (; p < end; p++) {
+		state->tail |= (unsigned long long) *p << (state->tail_len * 8);
+		state->tail_len++;
+	}
+}
+
+/**
+ * @brief Get the hash of all input added
+ * 
+ * @param [in] state hash state
+ * 
+ * @return 64 bit hash, which is the same on all platforms
+ */
+unsigned long long
+vktor_hash_final(const vktor_hash_state *state)
+{
+	unsigned long long h = state->h;
+	
+	if (state->tail_len > 0) {
+		h = hash_mix(h, state->tail);
+	}
+	
+	return hash_fmix(h ^ (unsigned long long) state->len);
+}
+
+/**
+ * @brief Combine a hash into an ordered sequence of hashes
+ * 
+ * @param [in] h hash of the sequence so far
+ * @param [in] v hash to add to the sequence
+ * 
+ * @return hash of the sequence, which depends on the order of hashes added
+ */
+unsigned long long
+vktor_hash_combine(unsigned long long h, unsigned long long v)
+{
+	return hash_mix(h, v);
+}
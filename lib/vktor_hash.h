@@ -0,0 +1,102 @@
+/* 
+ * vktor JSON pull-parser library
+ * 
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE. 
+ */
+
+/**
+ * @file vktor_hash.h
+ * 
+ * vktor hash header file - a fast 64 bit hash function which can be fed its 
+ * input in parts, used for hashing subtrees
+ * 
+ * @internal
+ */
+
+#ifndef _VKTOR_HASH_H
+
+/**
+ * @ingroup internal
+ * @{
+ */
+
+/**
+ * Hash state, holding the hash of the input so far along with up to 7 bytes
+ * of input which were not mixed in yet
+ */
+typedef struct _vktor_hash_state_struct {
+	unsigned long long h;        /**< hash of the mixed input */
+	unsigned long long tail;     /**< input bytes not mixed in yet */
+	int                tail_len; /**< number of bytes in tail */
+	long               len;      /**< total input length */
+} vktor_hash_state;
+
+/**
+ * @brief Start a new hash
+ * 
+ * @param [out] state hash state
+ * @param [in]  seed  seed, so equal input with a different seed (such as a 
+ *                    different token type) has a different hash
+ */
+VKTOR_INTERNAL void
+vktor_hash_init(vktor_hash_state *state, unsigned long long seed);
+
+/**
+ * @brief Add input to a hash
+ * 
+ * Input can be added in any number of parts - the hash only depends on the 
+ * concatenated input.
+ * 
+ * @param [in,out] state hash state
+ * @param [in]     data  input
+ * @param [in]     len   input length
+ */
+VKTOR_INTERNAL void
+vktor_hash_update(vktor_hash_state *state, const void *data, long len);
+
+/**
+ * @brief Get the hash of all input added
+ * 
+ * @param [in] state hash state
+ * 
+ * @return 64 bit hash, which is the same on all platforms
+ */
+VKTOR_INTERNAL unsigned long long
+vktor_hash_final(const vktor_hash_state *state);
+
+/**
+ * @brief Combine a hash into an ordered sequence of hashes
+ * 
+ * @param [in] h hash of the sequence so far
+ * @param [in] v hash to add to the sequence
+ * 
+ * @return hash of the sequence, which depends on the order of hashes added
+ */
+VKTOR_INTERNAL unsigned long long
+vktor_hash_combine(unsigned long long h, unsigned long long v);
+
+/** @} */ // end of internal API
+
+#define _VKTOR_HASH_H
+#endif /* VKTOR_HASH_H */
@@ -0,0 +1,733 @@
+/* 
+ * vktor JSON pull-parser library
+ * 
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE. 
+ */
+
+/**
+ * @file vktor_index.c
+ * 
+ * vktor offset index - records the offsets of the members of a root array or
+ * object, so parsing can start at any of them
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+
+#include "vktor.h"
+#include "vktor_internal.h"
+
+/**
+ * Offset index struct, holding the offsets of the members of a root array or
+ * object
+ */
+struct _vktor_index_struct {
+	vktor_allocator  allocator; /**< allocator used for the index */
+	vktor_struct     root;      /**< type of the indexed root value */
+	long            *offsets;   /**< offset of each member */
+	long             count;     /**< number of members */
+	long             size;      /**< number of offsets allocated */
+	long             consumed;  /**< bytes read while building the index */
+	char             state;     /**< state of the index being built */
+};
+
+/**
+ * @enum vktor_index_state
+ * 
+ * State of an index being built by vktor_index_build()
+ */
+typedef enum {
+	VKTOR_INDEX_NONE,   /**< not building an index */
+	VKTOR_INDEX_ROOT,   /**< before the root value */
+	VKTOR_INDEX_MEMBER, /**< between members of the root value */
+	VKTOR_INDEX_KEY,    /**< skipping the key of an object member */
+	VKTOR_INDEX_VALUE   /**< skipping the value of a member */
+} vktor_index_state;
+
+/**
+ * @ingroup internal
+ * @{
+ */
+
+/**
+ * @brief Write a variable length number
+ * 
+ * Numbers are written 7 bits per byte, least significant first, with the 
+ * high bit set on all bytes but the last. Used for serializing indexes and 
+ * checkpoints.
+ * 
+ * @param [out] out Memory to write to, or NULL to only measure the number
+ * @param [in]  pos Position in out to write at
+ * @param [in]  num Number to write
+ * 
+ * @return Position after the number
+ */
+long
+vktor_varint_write(unsigned char *out, long pos, unsigned long num)
+{
+	do {
+		if (out != NULL) {
+			out[pos] = (num & 0x7f) | (num > 0x7f ? 0x80 : 0);
+		}
+		pos++;
+		num >>= 7;
+	} while (num > 0);
+	
+	return pos;
+}
+
+/**
+ * @brief Read a variable length number written by vktor_varint_write()
+ * 
+ * @param [in]     data Data to read from
+ * @param [in]     len  Length of data
+ * @param [in,out] pos  Position in data, advanced past the number
+ * @param [out]    num  Set to the number
+ * 
+ * @return 1 if a number was read, or 0 if data ends or the number overflows
+ */
+int
+vktor_varint_read(const unsigned char *data, long len, long *pos, unsigned long *num)
+{
+	int shift;
+	
+	*num = 0;
+	for (shift = 0; *pos < len && shift < (int) sizeof(long) * 8; shift += 7) {
+		*num |= (unsigned long) (data[*pos] & 0x7f) << shift;
+		if (! (data[(*pos)++] & 0x80)) {
+			return 1;
+		}
+	}
+	
+	return 0;
+}
+
+/**
+ * @brief Add a member offset to an index being built
+ * 
+ * @param [in,out] index  Index being built
+ * @param [in]     parser Parser object, used for reporting errors
+ * @param [in]     offset Offset of the member
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK or VKTOR_ERROR
+ */
+static vktor_status
+index_add(vktor_index *index, vktor_parser *parser, long offset, 
+          vktor_error **error)
+{
+	long *offsets;
+	long  size;
+	
+	if (index->count == index->size) {
+		size = (index->size > 0 ? index->size * 2 : 64);
+		if (index->offsets == NULL) {
+			offsets = index->allocator.malloc(index->allocator.ctx, 
+				sizeof(long) * size);
+		} else {
+			offsets = index->allocator.realloc(index->allocator.ctx, 
+				index->offsets, sizeof(long) * size);
+		}
+		
+		if (offsets == NULL) {
+			vktor_set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+				"unable to allocate %ld bytes for index offsets", 
+				(long) (sizeof(long) * size));
+			return VKTOR_ERROR;
+		}
+		
+		index->offsets = offsets;
+		index->size    = size;
+	}
+	
+	index->offsets[index->count++] = offset;
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Build an index over a range of input
+ * 
+ * Read the root array or object start, the separators between its members 
+ * and its end, recording the offset of each member. Keys and values are 
+ * skipped using vktor_parser_skip(), and the state of the index being built is 
+ * kept in the index, so building can continue on the next range of input.
+ * 
+ * Used by vktor_index_build() on each input buffer, or on complete input.
+ * 
+ * @param [in,out] index  Index being built
+ * @param [in,out] parser Parser object
+ * @param [in,out] pos    Position in the input, advanced as it is read
+ * @param [in]     end    End of the input range
+ * @param [in]     offset Offset of pos from the start of the document
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK once the root value has ended, 
+ *   VKTOR_MORE_DATA at the end of the range or VKTOR_ERROR
+ */
+static vktor_status
+index_scan(vktor_index *index, vktor_parser *parser, char **pos, char *end, 
+           long offset, vktor_error **error)
+{
+	vktor_status  status;
+	char         *p, *start = *pos;
+	char          c;
+	
+	for (p = *pos; p < end; ) {
+		c = *p;
+		
+		switch (index->state) {
+			case VKTOR_INDEX_ROOT:
+				switch (c) {
+					case ' ':
+					case '\n':
+					case '\r':
+					case '\t':
+					case '\f':
+					case '\v':
+						// Whitespace
+						break;
+						
+					case '[':
+					case '{':
+						index->root = (c == '{' ? VKTOR_STRUCT_OBJECT : 
+						                          VKTOR_STRUCT_ARRAY);
+						if (vktor_nest_stack_add(parser, index->root, error) == VKTOR_ERROR) {
+							*pos = p;
+							return VKTOR_ERROR;
+						}
+						
+						parser->expected = (c == '{' ? 
+							(VKTOR_T_OBJECT_KEY | VKTOR_T_OBJECT_END) : 
+							(VKTOR_VALUE_TOKEN | VKTOR_T_ARRAY_END));
+						index->state = VKTOR_INDEX_MEMBER;
+						break;
+						
+					default:
+						*pos = p;
+						vktor_set_error(parser, error, VKTOR_ERR_INVALID_FORMAT, 
+							"only an array or an object can be indexed");
+						return VKTOR_ERROR;
+				}
+				break;
+				
+			case VKTOR_INDEX_MEMBER:
+				switch (c) {
+					case ' ':
+					case '\n':
+					case '\r':
+					case '\t':
+					case '\f':
+					case '\v':
+						// Whitespace
+						break;
+						
+					case ',':
+						if (! (parser->expected & VKTOR_C_COMMA)) {
+							*pos = p;
+							set_error_unexpected_c(error, c);
+							return VKTOR_ERROR;
+						}
+						
+						parser->expected = (index->root == VKTOR_STRUCT_OBJECT ? 
+							VKTOR_T_OBJECT_KEY : VKTOR_VALUE_TOKEN);
+						break;
+						
+					case '}':
+					case ']':
+						if (! (parser->expected & (c == '}' ? VKTOR_T_OBJECT_END : 
+						                                      VKTOR_T_ARRAY_END))) {
+							*pos = p;
+							set_error_unexpected_c(error, c);
+							return VKTOR_ERROR;
+						}
+						
+						if (vktor_nest_stack_pop(parser, error) == VKTOR_ERROR) {
+							*pos = p;
+							return VKTOR_ERROR;
+						}
+						
+						// The parser is left after the end of the root value
+						vktor_parser_set_token(parser, (c == '}' ? VKTOR_T_OBJECT_END : 
+						                                VKTOR_T_ARRAY_END), NULL);
+						parser->expected = VKTOR_T_NONE;
+						index->state     = VKTOR_INDEX_NONE;
+						*pos = p + 1;
+						return VKTOR_OK;
+						
+					default:
+						if (index->root == VKTOR_STRUCT_OBJECT ? 
+						    (c != '"' || ! (parser->expected & VKTOR_T_OBJECT_KEY)) :
+						    ! (parser->expected & VKTOR_T_NULL)) {
+							*pos = p;
+							set_error_unexpected_c(error, c);
+							return VKTOR_ERROR;
+						}
+						
+						if (index_add(index, parser, offset + (p - start), 
+						              error) == VKTOR_ERROR) {
+							*pos = p;
+							return VKTOR_ERROR;
+						}
+						
+						// Skip the key as a string value, then the value
+						if (vktor_parser_skip_start(parser, error) == VKTOR_ERROR) {
+							*pos = p;
+							return VKTOR_ERROR;
+						}
+						if (index->root == VKTOR_STRUCT_OBJECT) {
+							parser->expected = VKTOR_VALUE_TOKEN;
+							index->state     = VKTOR_INDEX_KEY;
+						} else {
+							index->state     = VKTOR_INDEX_VALUE;
+						}
+						continue;
+				}
+				break;
+				
+			default:
+				status = vktor_parser_skip(parser, &p, end, NULL, error);
+				if (status != VKTOR_OK) {
+					*pos = p;
+					return status;
+				}
+				
+				if (index->state == VKTOR_INDEX_KEY) {
+					parser->expected   = VKTOR_C_COLON;
+					parser->skip->state = VKTOR_SKIP_START;
+					index->state       = VKTOR_INDEX_VALUE;
+				} else {
+					parser->skip->state = VKTOR_SKIP_NONE;
+					expect_next_value_token(parser);
+					index->state       = VKTOR_INDEX_MEMBER;
+				}
+				continue;
+		}
+		
+		p++;
+	}
+	
+	*pos = p;
+	return VKTOR_MORE_DATA;
+}
+
+/** @} */ // end of internal API
+
+/**
+ * @ingroup external
+ * @{
+ */
+
+/**
+ * @brief Initialize an offset index
+ * 
+ * Initialize an empty index, to be built using vktor_index_build() or loaded
+ * from a serialized index using vktor_index_load().
+ * 
+ * @param [in] allocator allocator to use for the index, or NULL for the 
+ *                       default allocator
+ * 
+ * @return a newly allocated index, or NULL if memory can't be allocated
+ */
+vktor_index*
+vktor_index_init(const vktor_allocator *allocator)
+{
+	vktor_index *index;
+	
+	if (allocator == NULL) {
+		allocator = &vktor_default_allocator;
+	}
+	
+	index = allocator->malloc(allocator->ctx, sizeof(vktor_index));
+	if (index == NULL) {
+		return NULL;
+	}
+	memset(index, 0, sizeof(vktor_index));
+	
+	index->allocator = *allocator;
+	index->root      = VKTOR_STRUCT_NONE;
+	index->state     = VKTOR_INDEX_NONE;
+	
+	return index;
+}
+
+/**
+ * @brief Build an offset index of a document
+ * 
+ * Read a document whose root value is an array or an object, and record the 
+ * byte offset of each of its members: the first character of each array 
+ * member, or of each object member's key. Members are skipped the same way 
+ * vktor_skip_value() skips values, so building an index is much faster than
+ * parsing the document, and it only needs to be done once. 
+ * 
+ * The parser must be new, and is read to the end of the document. Offsets 
+ * are counted from the first byte fed to it. Once the index is built, 
+ * vktor_parser_seek() can be used to start parsing at any member.
+ * 
+ * @param [in,out] index  index to build, replacing any previous contents
+ * @param [in,out] parser new parser, fed with the document
+ * @param [out]    error  error object pointer pointer or NULL
+ * 
+ * @return status code:
+ *  - VKTOR_OK        if the index was built
+ *  - VKTOR_ERROR     if an error has occured
+ *  - VKTOR_MORE_DATA if we need more data in order to continue building
+ */
+vktor_status
+vktor_index_build(vktor_index *index, vktor_parser *parser, 
+                  vktor_error **error)
+{
+	vktor_status  status;
+	char         *pos, *start;
+	
+	assert(index != NULL);
+	assert(parser != NULL);
+	
+	if (index->state == VKTOR_INDEX_NONE) {
+		if (parser->token_type != VKTOR_T_NONE || parser->nest_ptr != 0 || 
+		    skip_active(parser) || parser->schema != NULL || 
+		    (parser->complete_text != NULL && 
+		     parser->complete_ptr != parser->complete_text)) {
+			vktor_set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+				"an index can only be built using a new parser");
+			return VKTOR_ERROR;
+		}
+		
+		index->root     = VKTOR_STRUCT_NONE;
+		index->count    = 0;
+		index->consumed = 0;
+		index->state    = VKTOR_INDEX_ROOT;
+	}
+	
+	if (parser->complete_text != NULL) {
+		pos = parser->complete_ptr;
+		status = index_scan(index, parser, &pos, parser->complete_end, 
+			pos - parser->complete_text, error);
+		
+		if (status == VKTOR_MORE_DATA) {
+			index->state = VKTOR_INDEX_NONE;
+			complete_error_incomplete(parser, pos);
+		}
+		
+		vktor_complete_set_position(parser, pos);
+		
+	} else {
+		status = VKTOR_MORE_DATA;
+		while (parser->buffer != NULL) {
+			start = pos = parser->buffer->text + parser->buffer->ptr;
+			status = index_scan(index, parser, &pos, 
+				parser->buffer->text + parser->buffer->size, 
+				index->consumed, error);
+			
+			parser->buffer->ptr += pos - start;
+			index->consumed     += pos - start;
+#ifdef BYTECOUNTER
+			parser->bytecounter += pos - start;
+#endif
+			
+			if (status != VKTOR_MORE_DATA) {
+				break;
+			}
+			
+			vktor_parser_advance_buffer(parser);
+		}
+	}
+	
+	if (status == VKTOR_ERROR) {
+		index->state = VKTOR_INDEX_NONE;
+	}
+	
+	return status;
+}
+
+/**
+ * @brief Get the number of members in an index
+ * 
+ * @param [in] index offset index
+ * 
+ * @return number of members of the indexed array or object
+ */
+long
+vktor_index_count(vktor_index *index)
+{
+	assert(index != NULL);
+	
+	return index->count;
+}
+
+/**
+ * @brief Get the offset of a member in an index
+ * 
+ * @param [in] index offset index
+ * @param [in] n     member number, starting from 0
+ * 
+ * @return byte offset of member n, or -1 if there is no such member
+ */
+long
+vktor_index_offset(vktor_index *index, long n)
+{
+	assert(index != NULL);
+	
+	if (n < 0 || n >= index->count) {
+		return -1;
+	}
+	
+	return index->offsets[n];
+}
+
+/**
+ * @brief Serialize an offset index
+ * 
+ * Write an index in a compact binary format which can be saved alongside the
+ * document, and loaded again using vktor_index_load(). Offsets are stored as
+ * variable length differences, usually taking 1 or 2 bytes per member.
+ * 
+ * The format is the magic bytes "VKIX", a format version byte, the root 
+ * value's opening character, the number of members and the difference of 
+ * each member's offset from the previous one (the first is from 0), all in 
+ * LEB128 encoding.
+ * 
+ * @param [in]  index    offset index
+ * @param [out] out      memory to write the index to, or NULL to only get 
+ *                       the size of the serialized index
+ * @param [in]  out_size size of out
+ * 
+ * @return size of the serialized index in bytes, which is only written if it
+ *   fits in out_size bytes
+ */
+long
+vktor_index_serialize(vktor_index *index, unsigned char *out, long out_size)
+{
+	long i, len;
+	
+	assert(index != NULL);
+	
+	len = vktor_varint_write(NULL, 6, (unsigned long) index->count);
+	for (i = 0; i < index->count; i++) {
+		len = vktor_varint_write(NULL, len, (unsigned long) 
+			(index->offsets[i] - (i > 0 ? index->offsets[i - 1] : 0)));
+	}
+	
+	if (out == NULL || len > out_size) {
+		return len;
+	}
+	
+	memcpy(out, "VKIX", 4);
+	out[4] = 1;
+	out[5] = (index->root == VKTOR_STRUCT_OBJECT ? '{' : '[');
+	len = vktor_varint_write(out, 6, (unsigned long) index->count);
+	for (i = 0; i < index->count; i++) {
+		len = vktor_varint_write(out, len, (unsigned long) 
+			(index->offsets[i] - (i > 0 ? index->offsets[i - 1] : 0)));
+	}
+	
+	return len;
+}
+
+/**
+ * @brief Load a serialized offset index
+ * 
+ * @param [in] data      serialized index, see vktor_index_serialize()
+ * @param [in] len       length of data
+ * @param [in] allocator allocator to use for the index, or NULL for the 
+ *                       default allocator
+ * 
+ * @return a newly allocated index, or NULL if memory can't be allocated or 
+ *   if data is not a valid serialized index
+ */
+vktor_index*
+vktor_index_load(const unsigned char *data, long len, 
+                 const vktor_allocator *allocator)
+{
+	vktor_index   *index;
+	unsigned long  num;
+	long           i, pos = 6, prev = 0;
+	
+	// Each member takes at least one byte
+	if (len < 7 || memcmp(data, "VKIX", 4) != 0 || data[4] != 1 || 
+	    (data[5] != '[' && data[5] != '{') || 
+	    ! vktor_varint_read(data, len, &pos, &num) || 
+	    num > (unsigned long) (len - pos)) {
+		return NULL;
+	}
+	
+	if ((index = vktor_index_init(allocator)) == NULL) {
+		return NULL;
+	}
+	
+	index->root = (data[5] == '{' ? VKTOR_STRUCT_OBJECT : VKTOR_STRUCT_ARRAY);
+	index->size = (long) num;
+	if (num > 0) {
+		index->offsets = index->allocator.malloc(index->allocator.ctx, 
+			sizeof(long) * num);
+		if (index->offsets == NULL) {
+			vktor_index_free(index);
+			return NULL;
+		}
+	}
+	
+	for (i = 0; i < index->size; i++) {
+		if (! vktor_varint_read(data, len, &pos, &num) || 
+		    num > (unsigned long) (LONG_MAX - prev)) {
+			vktor_index_free(index);
+			return NULL;
+		}
+		
+		prev += (long) num;
+		index->offsets[index->count++] = prev;
+	}
+	
+	if (pos != len) {
+		vktor_index_free(index);
+		return NULL;
+	}
+	
+	return index;
+}
+
+/**
+ * @brief Free an offset index
+ * 
+ * @param [in,out] index offset index
+ */
+void
+vktor_index_free(vktor_index *index)
+{
+	assert(index != NULL);
+	
+	if (index->offsets != NULL) {
+		index->allocator.free(index->allocator.ctx, index->offsets);
+	}
+	
+	index->allocator.free(index->allocator.ctx, index);
+}
+
+/**
+ * @brief Start parsing at a member of an indexed document
+ * 
+ * Reset the parser to the state it would be in right before member n of the
+ * root array or object, so the next call to vktor_parse() returns the member
+ * (or its key), followed by the rest of the document. Any current token and 
+ * partially read value are dropped.
+ * 
+ * If the parser was fed complete input using vktor_feed_complete(), it is 
+ * moved to the member's offset in it. Otherwise, all buffers fed to the 
+ * parser are dropped, and it must be fed with the document starting at 
+ * vktor_index_offset(index, n). Subtree hashes can't be calculated after 
+ * seeking.
+ * 
+ * @param [in,out] parser parser object
+ * @param [in]     index  offset index of the document
+ * @param [in]     n      member number, starting from 0
+ * @param [out]    error  error object pointer pointer or NULL
+ * 
+ * @return Status code - VKTOR_OK or VKTOR_ERROR
+ */
+vktor_status
+vktor_parser_seek(vktor_parser *parser, vktor_index *index, long n, 
+                  vktor_error **error)
+{
+	long offset;
+	
+	assert(parser != NULL);
+	assert(index != NULL);
+	
+	if (index->state != VKTOR_INDEX_NONE || index->root == VKTOR_STRUCT_NONE) {
+		vktor_set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"index was not built");
+		return VKTOR_ERROR;
+	}
+	
+	if (parser->hash != NULL) {
+		vktor_set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"can't seek while subtree hashing is enabled");
+		return VKTOR_ERROR;
+	}
+	
+	if (parser->schema != NULL) {
+		vktor_set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"can't seek while a schema is enabled");
+		return VKTOR_ERROR;
+	}
+	
+	if (parser->inflate != NULL) {
+		vktor_set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"can't seek in compressed input");
+		return VKTOR_ERROR;
+	}
+	
+	offset = vktor_index_offset(index, n);
+	if (offset < 0 || (parser->complete_text != NULL && 
+	    offset >= parser->complete_end - parser->complete_text)) {
+		vktor_set_error(parser, error, VKTOR_ERR_OUT_OF_RANGE, 
+			"member %ld is out of the indexed range", n);
+		return VKTOR_ERROR;
+	}
+	
+	if (parser->complete_text != NULL) {
+		// Token values point to the reused token memory and are never freed
+		parser->token_value = NULL;
+	} else if (parser->buffer != NULL) {
+		vktor_buffer_free_all(parser, parser->buffer);
+		parser->buffer      = NULL;
+		parser->last_buffer = NULL;
+	}
+	
+	vktor_parser_set_token(parser, VKTOR_T_NONE, NULL);
+	parser->token_resume = 0;
+	parser->key_id       = -1;
+	
+	if (parser->base64 != NULL) {
+		parser->base64->state = VKTOR_B64_NONE;
+	}
+	if (parser->skip != NULL) {
+		parser->skip->state   = VKTOR_SKIP_NONE;
+		parser->skip->capture = 0;
+	}
+	
+	// The root value is the only nesting level
+	parser->nest_ptr = 0;
+	if (vktor_nest_stack_add(parser, index->root, error) == VKTOR_ERROR) {
+		return VKTOR_ERROR;
+	}
+	parser->expected = (index->root == VKTOR_STRUCT_OBJECT ? 
+		VKTOR_T_OBJECT_KEY : VKTOR_VALUE_TOKEN);
+	
+	if (parser->complete_text != NULL) {
+		vktor_complete_set_position(parser, parser->complete_text + offset);
+	} else {
+		parser->fed = offset;
+#ifdef BYTECOUNTER
+		parser->bytecounter = offset;
+#endif
+	}
+	
+	return VKTOR_OK;
+}
+
+/** @} */ // end of external API
@@ -0,0 +1,689 @@
+/* 
+ * vktor JSON pull-parser library
+ * 
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE. 
+ */
+
+/**
+ * @file vktor_internal.h
+ * 
+ * vktor internal header file - the parser struct, along with the macros and 
+ * functions shared by the library's source files
+ * 
+ * @internal
+ */
+
+#ifndef _VKTOR_INTERNAL_H
+
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
+/**
+ * Marks functions and data shared by the library's source files, which are 
+ * not part of the external API. Where supported, they are hidden from users 
+ * of the shared library, so calls to them within a file can be inlined.
+ */
+#if defined(__GNUC__) && __GNUC__ >= 4
+#define VKTOR_INTERNAL __attribute__ ((visibility ("hidden")))
+#else
+#define VKTOR_INTERNAL
+#endif
+
+#include "vktor_hash.h"
+
+/**
+ * @ingroup internal
+ * @{
+ */
+
+/**
+ * Number of buffers held inside the parser struct, which are used before 
+ * allocating any buffers on the heap. Can't be more than the number of bits in
+ * an int.
+ */
+#ifndef VKTOR_BUFFER_POOL
+#define VKTOR_BUFFER_POOL 4
+#endif
+
+/**
+ * Number of nesting levels stored inside the parser struct, before the 
+ * nesting stack is moved to the heap. Must be a multiple of 8.
+ */
+#ifndef VKTOR_NEST_INLINE
+#define VKTOR_NEST_INLINE 64
+#endif
+
+/**
+ * Dimensions of the object key shape cache: number of nesting levels, number 
+ * of keys per object and maximal key length cached
+ */
+#ifndef VKTOR_SHAPE_DEPTH
+#define VKTOR_SHAPE_DEPTH  8
+#endif
+#ifndef VKTOR_SHAPE_KEYS
+#define VKTOR_SHAPE_KEYS   32
+#endif
+#ifndef VKTOR_SHAPE_KEYLEN
+#define VKTOR_SHAPE_KEYLEN 31
+#endif
+
+/**
+ * Convenience macro to check if we are at the end of a buffer
+ */
+#define eobuffer(b) (b->ptr >= b->size)
+
+/**
+ * Set some macros depending on whether byte counting is enabled or not 
+ */
+#ifdef BYTECOUNTER
+
+#define INCREMENT_BUFFER_PTR(p) \
+	p->buffer->ptr++;       \
+	p->bytecounter++;       
+
+#define BYTECOUNT_TPL " at %d bytes"
+#define BYTECOUNT_VAL , parser->bytecounter
+
+#else
+
+#define INCREMENT_BUFFER_PTR(p) p->buffer->ptr++;
+#define BYTECOUNT_TPL
+#define BYTECOUNT_VAL
+
+#endif
+
+
+/**
+ * When debugging is enabled, file and line info can be added to error macros 
+ */
+#ifdef ENABLE_DEBUG
+#define _VK_QUOTEME(x) #x
+#define VK_QUOTEME(x) _VK_QUOTEME(x)
+#define LINEINFO "[" __FILE__ ":" VK_QUOTEME(__LINE__) "] "
+#else
+#define LINEINFO 
+#endif
+
+/**
+ * Convenience macro to set an 'unexpected character' error
+ */
+#define set_error_unexpected_c(e, c)                                      \
+	vktor_set_error(parser, e, VKTOR_ERR_UNEXPECTED_INPUT,            \
+		LINEINFO "Unexpected character in input: '%c' (0x%02hhx)" \
+		BYTECOUNT_TPL, c, c BYTECOUNT_VAL)
+
+/**
+ * A bitmask representing any 'value' token 
+ */
+#define VKTOR_VALUE_TOKEN VKTOR_T_NULL         | \
+                          VKTOR_T_FALSE        | \
+                          VKTOR_T_TRUE         | \
+                          VKTOR_T_INT          | \
+                          VKTOR_T_FLOAT        | \
+                          VKTOR_T_STRING       | \
+                          VKTOR_T_ARRAY_START  | \
+                          VKTOR_T_OBJECT_START
+
+/**
+ * Convenience macro to get the type of the current JSON struct. The nesting 
+ * stack holds a single bit per level - set for objects and clear for arrays. 
+ * Level 0 is the top level, which is not stored.
+ */
+#define nest_stack_top(p)                                                    \
+	((p)->nest_ptr == 0 ? VKTOR_STRUCT_NONE :                            \
+	 ((p)->nest_stack[((p)->nest_ptr - 1) >> 3] &                        \
+	  (1 << (((p)->nest_ptr - 1) & 7))) ? VKTOR_STRUCT_OBJECT :          \
+	                                      VKTOR_STRUCT_ARRAY)
+
+/**
+ * Convenience macro to check if we are in a specific type of JSON struct
+ */
+#define nest_stack_in(p, c) (nest_stack_top(p) == c)
+
+/**
+ * Convenience macro to easily set the expected next token map after a value
+ * token, taking current struct struct (if any) into account.
+ */
+#define expect_next_value_token(p)                        \
+	switch(nest_stack_top(p)) {                       \
+		case VKTOR_STRUCT_OBJECT:                 \
+			p->expected = VKTOR_C_COMMA |     \
+			              VKTOR_T_OBJECT_END; \
+			break;                            \
+			                                  \
+		case VKTOR_STRUCT_ARRAY:                  \
+			p->expected = VKTOR_C_COMMA |     \
+			              VKTOR_T_ARRAY_END;  \
+			break;                            \
+			                                  \
+		default:                                  \
+			p->expected = VKTOR_T_NONE;       \
+			break;                            \
+	}
+
+/**
+ * Convenience macro to check if the root value was completely read, so that
+ * parsing is complete. Nothing is expected once the root value was read or 
+ * skipped. A root number is only known to end at the end of the input, so it
+ * is considered complete once its token was started, unless it is still being
+ * read.
+ */
+#define root_value_done(p)                                  \
+	((p)->nest_ptr == 0 && ! (p)->token_resume &&            \
+	 ((p)->expected == VKTOR_T_NONE ||                       \
+	  (p)->token_type != VKTOR_T_NONE))
+
+/**
+ * Convenience macro to set an 'incomplete data' error when the end of complete
+ * input is reached in the middle of a token or a struct
+ */
+#define complete_error_incomplete(p, pos)                                   \
+	{                                                                   \
+		vktor_complete_set_position(p, pos);                        \
+		vktor_set_error(parser, error, VKTOR_ERR_INCOMPLETE_DATA,   \
+			LINEINFO "Unexpected end of input" BYTECOUNT_TPL    \
+			BYTECOUNT_VAL);                                     \
+		return VKTOR_ERROR;                                         \
+	}
+
+/**
+ * Convenience macros to check if a base64 string is being read, a value is 
+ * being skipped or a document is being validated. Their state is only 
+ * allocated once they are first used.
+ */
+#define base64_active(p) \
+	((p)->base64 != NULL && (p)->base64->state != VKTOR_B64_NONE)
+#define skip_active(p) \
+	((p)->skip != NULL && (p)->skip->state != VKTOR_SKIP_NONE)
+#define valid_active(p) \
+	((p)->valid != NULL && (p)->valid->state != VKTOR_VALID_NONE)
+
+/**
+ * Buffer struct, containing some text to parse along with an internal pointer
+ * and a link to the next buffer.
+ * 
+ * vktor internally holds text to be parsed as a linked list of buffers pushed
+ * by the user, so no memory reallocations are required. Whenever a buffer is 
+ * completely parsed, the parser will advance to the next buffer pointed by 
+ * #next_buff and will free the previous buffer
+ * 
+ * This is done internally by the parser
+ */
+typedef struct _vktor_buffer_struct {
+	char                        *text;      /**< buffer text */
+	long                         size;      /**< buffer size */
+	long                         ptr;       /**< internal buffer position */
+	char                         free;      /**< free the bffer when done */
+	struct _vktor_buffer_struct *next_buff;	/**< pointer to the next buffer */
+} vktor_buffer;
+
+/**
+ * An object key cached by the shape cache, stored as it appears in the input
+ */
+typedef struct _vktor_shape_key_struct {
+	int  len;                          /**< key length, or -1 if not cached */
+	char key[VKTOR_SHAPE_KEYLEN + 1];  /**< NULL terminated key */
+} vktor_shape_key;
+
+/**
+ * Object key shape cache, holding the keys of the last object read at each 
+ * nesting level in order. Objects with the same keys in the same order are 
+ * very common, so the next key can be verified against the input instead of
+ * being decoded.
+ */
+typedef struct _vktor_shape_cache_struct {
+	vktor_shape_key keys[VKTOR_SHAPE_DEPTH][VKTOR_SHAPE_KEYS]; /**< keys */
+	int             pos[VKTOR_SHAPE_DEPTH]; /**< next key in each object */
+	long            hits;                   /**< keys found in the cache */
+	long            misses;                 /**< keys not found in the cache */
+} vktor_shape_cache;
+
+#ifdef HAVE_LIBZ
+/**
+ * Compressed input stage - holds compressed data fed to the parser until it 
+ * is inflated into the parser's buffers
+ */
+struct _vktor_inflate_struct {
+	z_stream      stream;       /**< zlib inflate stream */
+	vktor_buffer *input;        /**< compressed buffers not inflated yet */
+	vktor_buffer *last_input;   /**< last compressed buffer */
+	long          chunk;        /**< size of inflated buffers */
+	int           status;       /**< zlib status of the last inflate call */
+	long long     in;           /**< compressed bytes read */
+	long long     out;          /**< inflated bytes */
+};
+#endif
+
+/**
+ * State of a base64 string value being read by vktor_read_base64(), 
+ * allocated the first time a string is read as base64
+ */
+typedef struct _vktor_base64_decoder_struct {
+	unsigned long bits;  /**< bits of a partially read base64 group */
+	char          state; /**< state of a base64 string being read */
+	char          count; /**< characters in bits */
+	char          pad;   /**< padding characters read */
+} vktor_base64_decoder;
+
+/**
+ * State of a value being skipped by vktor_skip_value() or captured by 
+ * vktor_capture_value(), allocated the first time a value is skipped
+ */
+typedef struct _vktor_value_skipper_struct {
+	char  state;        /**< state of a value being skipped */
+	int   base;         /**< nesting level of a value being skipped */
+	char  capture;      /**< the value being skipped is captured */
+	char *capture_buff; /**< captured value spanning buffers */
+	long  capture_len;  /**< length of the captured value */
+	long  capture_size; /**< memory allocated for capture_buff */
+} vktor_value_skipper;
+
+/**
+ * State of a document being validated by vktor_validate(), allocated the 
+ * first time a document is validated
+ */
+typedef struct _vktor_validator_struct {
+	char state; /**< state of a document being validated */
+	char utf8;  /**< UTF-8 in strings is validated too */
+	int  count; /**< characters read of a literal or escape */
+} vktor_validator;
+
+/**
+ * Subtree hashing state, allocated by vktor_enable_subtree_hash()
+ */
+typedef struct _vktor_subtree_hasher_struct {
+	unsigned long long *stack;   /**< subtree hash of each nesting level */
+	int                 size;    /**< number of levels stack can hold */
+	unsigned long long  value;   /**< hash of the last complete value */
+	char                valid;   /**< value is the current token's */
+	char                in_part; /**< a string is being hashed in parts */
+	vktor_hash_state    str;     /**< hash of a string read in parts */
+} vktor_subtree_hasher;
+
+/**
+ * Schema validation state, defined in vktor_schema.c
+ */
+typedef struct _vktor_schema_validator_struct vktor_schema_validator;
+
+/**
+ * Parser struct - this is the main object used by the user to parse a JSON 
+ * stream. 
+ */
+struct _vktor_parser_struct {
+	vktor_buffer   *buffer;       /**< the current buffer being parsed */
+	vktor_buffer   *last_buffer;  /**< a pointer to the last buffer */
+	vktor_token     token_type;   /**< current token type */
+	void           *token_value;  /**< current token value, if any */
+	int             token_size;   /**< current token value length, if any */
+	int             token_alloc;  /**< memory allocated for a token being read */
+	char            token_resume; /**< current token is only half read */  
+	long            expected;     /**< bitmask of possible expected tokens */
+	unsigned char  *nest_stack;   /**< bit array holding current nesting stack */
+	int             nest_ptr;     /**< pointer to the current nesting level */
+	int             nest_size;    /**< number of levels nest_stack can hold */
+	int             max_nest;     /**< maximal nesting level */
+	unsigned char   nest_inline[VKTOR_NEST_INLINE / 8]; /**< inline nesting stack */
+	unsigned long   unicode_c;    /**< temp container for unicode characters */
+	char           *complete_text; /**< complete input, see vktor_feed_complete() */
+	char           *complete_ptr;  /**< current position in complete input */
+	char           *complete_end;  /**< end of complete input */
+	char            complete_free; /**< free the complete input when done */
+	char           *token_buff;    /**< token memory reused for complete input */
+	long            token_buff_size; /**< allocated size of token_buff */
+	char            token_buff_free; /**< token_buff was allocated on the heap */
+	vktor_buffer    buffer_pool[VKTOR_BUFFER_POOL]; /**< preallocated buffers */
+	int             buffer_pool_used; /**< bitmask of buffer_pool members in use */
+	char            inplace;      /**< parser is in caller provided memory */
+	long            string_chunk; /**< deliver strings in parts of this size */
+	vktor_base64_decoder *base64; /**< base64 string state, if ever read */
+	vktor_value_skipper *skip;    /**< skipped value state, if ever skipped */
+	vktor_validator *valid;       /**< validation state, if ever validated */
+	vktor_shape_cache *shape;     /**< object key shape cache, if enabled */
+	int             key_id;       /**< shape cache position of the key or -1 */
+	vktor_subtree_hasher *hash;   /**< subtree hashing state, if enabled */
+	long            fed;          /**< total bytes fed, or offset of buffers */
+	struct _vktor_inflate_struct *inflate; /**< compressed input, if enabled */
+	vktor_schema_validator *schema; /**< schema validation state, if enabled */
+	vktor_allocator allocator;    /**< allocator used for all parser memory */
+#ifdef BYTECOUNTER
+	/** Total bytes parsed counter, only enabled if BYTECOUNTER is defined **/
+	unsigned long   bytecounter;  
+#endif
+};
+
+/**
+ * @enum vktor_specialchar
+ * 
+ * Special JSON characters - these are not returned to the user as tokens 
+ * but still have a meaning when parsing JSON.
+ */
+typedef enum {
+	VKTOR_C_COMMA   = 1 << 16, /**< ",", used as struct separator */
+	VKTOR_C_COLON   = 1 << 17, /**< ":", used to separate object key:value */
+	VKTOR_C_DOT     = 1 << 18, /**< ".", used in floating-point numbers */ 
+	VKTOR_C_SIGNUM  = 1 << 19, /**< "+" or "-" used in numbers */
+	VKTOR_C_EXP     = 1 << 20, /**< "e" or "E" used for number exponent */
+	VKTOR_C_ESCAPED = 1 << 21, /**< An escaped character */
+	VKTOR_C_UNIC1   = 1 << 22, /**< Unicode encoded character (1st byte) */
+	VKTOR_C_UNIC2   = 1 << 23, /**< Unicode encoded character (2nd byte) */
+	VKTOR_C_UNIC3   = 1 << 24, /**< Unicode encoded character (3rd byte) */
+	VKTOR_C_UNIC4   = 1 << 25, /**< Unicode encoded character (4th byte) */
+	VKTOR_C_UNIC_LS = 1 << 26, /**< Unicode low surrogate */
+	VKTOR_C_UNIC_LU = 1 << 27, /**< Unicode low surrogate after the '\\' */
+} vktor_specialchar;
+
+/**
+ * @enum vktor_base64_state
+ * 
+ * State of a base64 string value being read by vktor_read_base64()
+ */
+typedef enum {
+	VKTOR_B64_NONE,    /**< not reading a base64 string */
+	VKTOR_B64_BODY,    /**< reading the string contents */
+	VKTOR_B64_ESCAPED  /**< previous character was a backslash */
+} vktor_base64_state;
+
+/**
+ * @enum vktor_skip_state
+ * 
+ * State of a value being skipped by vktor_skip_value()
+ */
+typedef enum {
+	VKTOR_SKIP_NONE,    /**< not skipping a value */
+	VKTOR_SKIP_START,   /**< before the value */
+	VKTOR_SKIP_VALUE,   /**< inside the value, between tokens */
+	VKTOR_SKIP_STRING,  /**< inside a string */
+	VKTOR_SKIP_ESCAPED, /**< after a backslash inside a string */
+	VKTOR_SKIP_SCALAR,  /**< inside a number, true, false or null */
+	VKTOR_SKIP_TOKENS   /**< skipping token by token to hash or check it */
+} vktor_skip_state;
+
+/**
+ * @enum vktor_valid_state
+ * 
+ * State of a document being validated by vktor_validate()
+ */
+typedef enum {
+	VKTOR_VALID_NONE,        /**< not validating a document */
+	VKTOR_VALID_VALUE,       /**< between tokens */
+	VKTOR_VALID_STRING,      /**< inside a string */
+	VKTOR_VALID_ESCAPED,     /**< after a backslash inside a string */
+	VKTOR_VALID_UNICODE,     /**< inside a unicode escape sequence */
+	VKTOR_VALID_LOW_ESCAPED, /**< expecting the backslash of a low surrogate */
+	VKTOR_VALID_LOW_U,       /**< expecting the u of a low surrogate */
+	VKTOR_VALID_LOW,         /**< inside the escape of a low surrogate */
+	VKTOR_VALID_UTF8,        /**< inside a multi-byte UTF-8 character */
+	VKTOR_VALID_MINUS,       /**< after the minus sign of a number */
+	VKTOR_VALID_ZERO,        /**< after a leading zero */
+	VKTOR_VALID_INT,         /**< inside the integer part of a number */
+	VKTOR_VALID_DOT,         /**< after a decimal point */
+	VKTOR_VALID_FRAC,        /**< inside the fraction part of a number */
+	VKTOR_VALID_EXP,         /**< after an exponent mark */
+	VKTOR_VALID_EXP_SIGN,    /**< after the sign of an exponent */
+	VKTOR_VALID_EXP_DIGITS,  /**< inside the exponent of a number */
+	VKTOR_VALID_LITERAL,     /**< inside true, false or null */
+	VKTOR_VALID_END          /**< after the root value */
+} vktor_valid_state;
+
+/**
+ * Convenience macros to allocate memory using the parser's allocator
+ */
+#define vmalloc(p, s)       (p)->allocator.malloc((p)->allocator.ctx, (s))
+#define vrealloc(p, ptr, s) (p)->allocator.realloc((p)->allocator.ctx, (ptr), (s))
+#define vfree(p, ptr)       (p)->allocator.free((p)->allocator.ctx, (ptr))
+
+/**
+ * Default allocator, using the memory handlers set globally with 
+ * vktor_set_memory_handlers()
+ */
+extern VKTOR_INTERNAL const vktor_allocator vktor_default_allocator;
+
+/**
+ * @brief Free an entire linked list of vktor buffers
+ * 
+ * Free an entire linked list of vktor buffers. Will usually be called by 
+ * vktor_parser_free() to free all buffers attached to a parser. 
+ * 
+ * @param[in,out] parser the parser owning the buffers
+ * @param[in,out] buffer the first buffer in the list to free
+ */
+VKTOR_INTERNAL void
+vktor_buffer_free_all(vktor_parser *parser, vktor_buffer *buffer);
+
+/**
+ * @brief Advance the parser to the next buffer
+ * 
+ * Advance the parser to the next buffer in the parser's buffer list. Called 
+ * when the end of the current buffer is reached, and more data is required. 
+ * 
+ * If no further buffers are available, will set vktor_parser->buffer and 
+ * vktor_parser->last_buffer to NULL, unless compressed input is enabled and 
+ * more of it can be inflated into a new buffer.
+ * 
+ * @param [in,out] parser The parser we are working with
+ */
+VKTOR_INTERNAL void
+vktor_parser_advance_buffer(vktor_parser *parser);
+
+/**
+ * @brief Set the current token just read by the parser
+ * 
+ * Set the current token just read by the parser. Called when a token is 
+ * encountered, before returning from vktor_parse(). The user can then access
+ * the token information. Will also take care of freeing any previous token
+ * held by the parser.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [in]     token  New token type
+ * @param [in]     value  New token value or NULL if no value
+ */
+VKTOR_INTERNAL void
+vktor_parser_set_token(vktor_parser *parser, vktor_token token, void *value);
+
+/**
+ * @brief Allocate the state of an opt-in feature
+ * 
+ * Features which are not used by most parsers keep their state out of the 
+ * parser struct, and allocate it the first time they are used. The state is
+ * zeroed, and kept until the parser is freed or reset.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [in]     size   Size of the state
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return The allocated state, or NULL if out of memory
+ */
+VKTOR_INTERNAL void *
+vktor_parser_alloc_state(vktor_parser *parser, size_t size,
+                         vktor_error **error);
+
+/**
+ * @brief add a nesting level to the nesting stack
+ * 
+ * Add a nesting level to the nesting stack when a new array or object is 
+ * encountered. Will make sure that the maximal nesting level is not 
+ * overflowed. The first VKTOR_NEST_INLINE levels are stored inside the parser
+ * struct; beyond that the stack is moved to the heap and grown geometrically.
+ * 
+ * @param [in,out] parser    Parser object
+ * @param [in]     nest_type nesting type - array or object
+ * @param [out]    error     an error struct pointer pointer or NULL
+ * 
+ * @return Status code - VKTOR_OK or VKTOR_ERROR
+ */
+VKTOR_INTERNAL vktor_status
+vktor_nest_stack_add(vktor_parser *parser, vktor_struct nest_type,
+                     vktor_error **error);
+
+/**
+ * @brief pop a nesting level out of the nesting stack
+ * 
+ * Pop a nesting level out of the nesting stack when the end of an array or an
+ * object is encountered. Will ensure there are no stack underflows.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [out]    error struct pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK or VKTOR_ERROR
+ */
+VKTOR_INTERNAL vktor_status
+vktor_nest_stack_pop(vktor_parser *parser, vktor_error **error);
+
+/**
+ * @brief Save the current position in complete input
+ * 
+ * @param [in,out] parser Parser object
+ * @param [in]     pos    Current position
+ */
+VKTOR_INTERNAL void
+vktor_complete_set_position(vktor_parser *parser, char *pos);
+
+/**
+ * @brief Start skipping the next value
+ * 
+ * Set the parser up for vktor_parser_skip() to skip the value which starts 
+ * at the current nesting level, allocating the skipping state if needed.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return VKTOR_OK, or VKTOR_ERROR if out of memory
+ */
+VKTOR_INTERNAL vktor_status
+vktor_parser_skip_start(vktor_parser *parser, vktor_error **error);
+
+/**
+ * @brief Skip a value in a range of input
+ * 
+ * Skip over the next value, including any nested arrays and objects, without
+ * creating tokens. Whitespace and separators before the value are skipped 
+ * the same way vktor_parse() skips them. Nesting is tracked using the nesting
+ * stack so that arrays and objects are balanced, but the contents of strings,
+ * numbers, true, false and null are not validated, and neither are the 
+ * separators inside the value. The state of a partially skipped value is 
+ * kept in the parser, so skipping can continue on the next range of input.
+ * 
+ * Used by vktor_skip_value() and vktor_capture_value() on each input buffer,
+ * or on complete input.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [in,out] pos    Position in the input, advanced as it is read
+ * @param [in]     end    End of the input range
+ * @param [out]    value  Set to the first character of the value if it 
+ *                        starts in this range, or NULL
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK once the value is skipped, VKTOR_MORE_DATA at
+ *   the end of the range or VKTOR_ERROR
+ */
+VKTOR_INTERNAL vktor_status
+vktor_parser_skip(vktor_parser *parser, char **pos, char *end, char **value,
+                  vktor_error **error);
+
+/**
+ * @brief Reset a parser to its initial state
+ * 
+ * Free all memory held by a parser and reinitialize it, keeping its allocator
+ * and maximal nesting level, so it can be used to parse a new stream.
+ * 
+ * @param [in,out] parser Parser object
+ */
+VKTOR_INTERNAL void
+vktor_parser_reset(vktor_parser *parser);
+
+/**
+ * @brief Write a variable length number
+ * 
+ * Numbers are written 7 bits per byte, least significant first, with the 
+ * high bit set on all bytes but the last. Used for serializing indexes and 
+ * checkpoints.
+ * 
+ * @param [out] out Memory to write to, or NULL to only measure the number
+ * @param [in]  pos Position in out to write at
+ * @param [in]  num Number to write
+ * 
+ * @return Position after the number
+ */
+VKTOR_INTERNAL long
+vktor_varint_write(unsigned char *out, long pos, unsigned long num);
+
+/**
+ * @brief Read a variable length number written by vktor_varint_write()
+ * 
+ * @param [in]     data Data to read from
+ * @param [in]     len  Length of data
+ * @param [in,out] pos  Position in data, advanced past the number
+ * @param [out]    num  Set to the number
+ * 
+ * @return 1 if a number was read, or 0 if data ends or the number overflows
+ */
+VKTOR_INTERNAL int
+vktor_varint_read(const unsigned char *data, long len, long *pos,
+                  unsigned long *num);
+
+/**
+ * @brief Check the current token against the schema
+ * 
+ * The schema node of each value is found from the array or object it is in:
+ * the node of array members, or the node of the last object key's property.
+ * The type and limits of scalar values are checked when they are read, as 
+ * are the number of array members and the object keys allowed, so a value 
+ * which does not match the schema is found as soon as possible. 
+ * 
+ * @param [in,out] parser Parser object, with a schema enabled
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK or VKTOR_ERROR
+ */
+VKTOR_INTERNAL vktor_status
+vktor_parser_schema_token(vktor_parser *parser, vktor_error **error);
+
+/**
+ * @brief Check whether the schema allows any value next
+ * 
+ * Used by vktor_skip_value() to skip values which are not checked without 
+ * reading them token by token. Members of constrained arrays are always read
+ * token by token, so they are counted.
+ * 
+ * @param [in] parser Parser object, with a schema enabled
+ * 
+ * @return 1 if any value is allowed, 0 otherwise
+ */
+VKTOR_INTERNAL int
+vktor_parser_schema_any(vktor_parser *parser);
+
+/**
+ * @brief Free a schema validation state
+ * 
+ * @param [in,out] parser Parser object the state was allocated by
+ * @param [in,out] valid  Schema validation state
+ */
+VKTOR_INTERNAL void
+vktor_parser_schema_free(vktor_parser *parser, vktor_schema_validator *valid);
+
+/** @} */ // end of internal API
+
+#define _VKTOR_INTERNAL_H
+#endif /* VKTOR_INTERNAL_H */
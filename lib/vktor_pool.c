@@ -0,0 +1,171 @@
+/* 
+ * vktor JSON pull-parser library
+ * 
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE. 
+ */
+
+/**
+ * @file vktor_pool.c
+ * 
+ * vktor parser pools - keep released parsers for reuse
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <assert.h>
+
+#include "vktor.h"
+#include "vktor_internal.h"
+
+/**
+ * Parser pool struct, holding idle parsers which can be reused
+ */
+struct _vktor_parser_pool_struct {
+	vktor_allocator   allocator;  /**< allocator used for the pool and parsers */
+	int               max_nest;   /**< maximal nesting level of parsers */
+	int               max_idle;   /**< maximal number of idle parsers */
+	int               idle_count; /**< number of idle parsers in the pool */
+	vktor_parser    **idle;       /**< idle parsers, allocated with the pool */
+};
+
+/**
+ * @ingroup external
+ * @{
+ */
+
+/**
+ * @brief Initialize a new parser pool
+ * 
+ * Initialize a pool of parsers which can be acquired and released quickly, 
+ * instead of initializing and freeing a parser for each stream. Released 
+ * parsers are reset and kept for reuse, up to max_idle parsers.
+ * 
+ * A pool is not thread safe. Use a separate pool, possibly with its own 
+ * allocator, for each thread. 
+ * 
+ * @param [in] max_nest  maximal nesting level of parsers in the pool
+ * @param [in] max_idle  maximal number of idle parsers kept in the pool
+ * @param [in] allocator allocator to use for the pool and its parsers, or NULL
+ *                       for the default allocator
+ * 
+ * @return a newly allocated pool, or NULL if memory can't be allocated
+ */
+vktor_parser_pool*
+vktor_parser_pool_init(int max_nest, int max_idle, 
+                       const vktor_allocator *allocator)
+{
+	vktor_parser_pool *pool;
+	
+	if (max_idle < 0) {
+		return NULL;
+	}
+	
+	if (allocator == NULL) {
+		allocator = &vktor_default_allocator;
+	}
+	
+	// The list of idle parsers is allocated along with the pool
+	pool = allocator->malloc(allocator->ctx, 
+		sizeof(vktor_parser_pool) + sizeof(vktor_parser *) * max_idle);
+	if (pool == NULL) {
+		return NULL;
+	}
+	
+	pool->allocator  = *allocator;
+	pool->max_nest   = max_nest;
+	pool->max_idle   = max_idle;
+	pool->idle_count = 0;
+	pool->idle       = (vktor_parser **) (pool + 1);
+	
+	return pool;
+}
+
+/**
+ * @brief Acquire a parser from a pool
+ * 
+ * Get a parser ready to parse a new stream, reusing an idle parser from the 
+ * pool if there is one. 
+ * 
+ * @param [in,out] pool parser pool
+ * 
+ * @return a parser, or NULL if memory can't be allocated
+ */
+vktor_parser*
+vktor_parser_pool_acquire(vktor_parser_pool *pool)
+{
+	assert(pool != NULL);
+	
+	if (pool->idle_count > 0) {
+		return pool->idle[--pool->idle_count];
+	}
+	
+	return vktor_parser_init_allocator(pool->max_nest, &pool->allocator);
+}
+
+/**
+ * @brief Release a parser back into a pool
+ * 
+ * Reset a parser acquired from a pool and keep it for reuse. If the pool 
+ * already holds max_idle parsers, the parser is freed instead. 
+ * 
+ * @param [in,out] pool   parser pool
+ * @param [in,out] parser parser acquired from the same pool
+ */
+void
+vktor_parser_pool_release(vktor_parser_pool *pool, vktor_parser *parser)
+{
+	assert(pool != NULL);
+	assert(parser != NULL);
+	
+	if (pool->idle_count < pool->max_idle) {
+		vktor_parser_reset(parser);
+		pool->idle[pool->idle_count++] = parser;
+	} else {
+		vktor_parser_free(parser);
+	}
+}
+
+/**
+ * @brief Free a parser pool
+ * 
+ * Free a parser pool along with all idle parsers held by it. Parsers which 
+ * were acquired and not released must still be freed by vktor_parser_free().
+ * 
+ * @param [in,out] pool parser pool
+ */
+void
+vktor_parser_pool_free(vktor_parser_pool *pool)
+{
+	assert(pool != NULL);
+	
+	while (pool->idle_count > 0) {
+		vktor_parser_free(pool->idle[--pool->idle_count]);
+	}
+	
+	pool->allocator.free(pool->allocator.ctx, pool);
+}
+
+/** @} */ // end of external API
@@ -0,0 +1,1649 @@
+/* 
+ * vktor JSON pull-parser library
+ * 
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE. 
+ */
+
+/**
+ * @file vktor_schema.c
+ * 
+ * vktor schema validation - compiles a subset of JSON Schema and checks 
+ * documents against it while they are parsed
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "vktor.h"
+#include "vktor_internal.h"
+
+/**
+ * Node of a compiled schema which allows any value, such as a true schema or
+ * a keyword which is not set
+ */
+#define VKTOR_SCHEMA_ANY   -1
+
+/**
+ * Node of a compiled schema which allows no value, such as a false schema
+ */
+#define VKTOR_SCHEMA_NEVER -2
+
+/**
+ * Node of a compiled schema, holding the keywords of a single schema object.
+ * Properties and enum values of a node are linked lists, and nodes, 
+ * properties and strings are referred to by index, since they are 
+ * reallocated while the schema is compiled.
+ */
+typedef struct _vktor_schema_node_struct {
+	int    types;        /**< bitmask of allowed types, or 0 for any type */
+	int    flags;        /**< limits which are set, see vktor_schema_flag */
+	double minimum;      /**< lower limit of numbers */
+	double maximum;      /**< upper limit of numbers */
+	long   min_length;   /**< minimal string length, or -1 */
+	long   max_length;   /**< maximal string length, or -1 */
+	long   min_items;    /**< minimal number of array members, or -1 */
+	long   max_items;    /**< maximal number of array members, or -1 */
+	int    items;        /**< node of array members */
+	int    additional;   /**< node of object members not in properties */
+	int    props;        /**< first property, or -1 */
+	int    num_required; /**< number of required properties */
+	int    enums;        /**< first enum value, or -1 */
+} vktor_schema_node;
+
+/**
+ * Object property of a compiled schema node
+ */
+typedef struct _vktor_schema_prop_struct {
+	long key;      /**< offset of the key in the schema strings */
+	int  key_len;  /**< length of the key */
+	int  node;     /**< node of the value */
+	int  required; /**< bit of the property in the required set, or -1 */
+	char declared; /**< listed in properties, and not only in required */
+	int  next;     /**< next property of the same node, or -1 */
+} vktor_schema_prop;
+
+/**
+ * Enum value of a compiled schema node
+ */
+typedef struct _vktor_schema_enum_struct {
+	vktor_token type;   /**< token type, with VKTOR_T_FLOAT for all numbers */
+	double      number; /**< value of a number */
+	long        str;    /**< offset of a string in the schema strings */
+	int         len;    /**< length of a string */
+	int         next;   /**< next enum value of the same node, or -1 */
+} vktor_schema_enum;
+
+/**
+ * Schema compiler context, describing what the tokens at a nesting level of
+ * the schema document are read into
+ */
+typedef struct _vktor_schema_ctx_struct {
+	char kind;    /**< what is being read, see vktor_schema_ctx_kind */
+	char keyword; /**< keyword whose value is read next, if any */
+	int  node;    /**< node being compiled */
+	int  prop;    /**< property whose schema is read next, or -1 */
+} vktor_schema_ctx;
+
+/**
+ * Compiled schema struct
+ */
+struct _vktor_schema_struct {
+	vktor_allocator    allocator;    /**< allocator used for the schema */
+	vktor_schema_node *nodes;        /**< schema nodes */
+	int                num_nodes;    /**< number of nodes */
+	int                nodes_size;   /**< number of nodes allocated */
+	vktor_schema_prop *props;        /**< properties of all nodes */
+	int                num_props;    /**< number of properties */
+	int                props_size;   /**< number of properties allocated */
+	vktor_schema_enum *enums;        /**< enum values of all nodes */
+	int                num_enums;    /**< number of enum values */
+	int                enums_size;   /**< number of enum values allocated */
+	char              *strings;      /**< property keys and enum strings */
+	long               strings_len;  /**< length of strings used */
+	long               strings_size; /**< size of strings allocated */
+	long               max_enum_len; /**< length of the longest enum string */
+	int                root;         /**< root node */
+	char               state;        /**< compiler state */
+	char               skipping;     /**< an annotation value is skipped */
+	vktor_schema_ctx  *stack;        /**< compiler context of each level */
+	int                depth;        /**< nesting level in the schema */
+	int                stack_size;   /**< number of levels stack can hold */
+};
+
+/**
+ * Schema state of an array or object being validated, or of the root level
+ */
+typedef struct _vktor_schema_level_struct {
+	int  node;     /**< node of the array or object */
+	int  next;     /**< node of the next value in an object, or of the root */
+	char array;    /**< the level is an array */
+	long count;    /**< number of array members so far */
+	long seen;     /**< offset of the required properties seen */
+	long seen_len; /**< bytes of required properties seen */
+} vktor_schema_level;
+
+/**
+ * Schema validation state, allocated by vktor_enable_schema()
+ */
+typedef struct _vktor_schema_validator_struct {
+	vktor_schema       *compiled;  /**< schema validated against */
+	vktor_schema_level *stack;     /**< schema state of each nesting level */
+	int                 size;      /**< number of levels stack can hold */
+	unsigned char      *seen;      /**< required properties seen at all levels */
+	long                seen_size; /**< allocated size of seen */
+	char                in_part;   /**< a string is being read in parts */
+	int                 part_node; /**< node of a string read in parts */
+	long                chars;     /**< characters of a string read in parts */
+	char               *str;       /**< string read in parts, to match enums */
+	long                str_len;   /**< length of str */
+} vktor_schema_validator;
+
+/**
+ * @enum vktor_schema_type
+ * 
+ * Value types allowed by a schema node, as a bitmask
+ */
+typedef enum {
+	VKTOR_SCHEMA_NULL    = 1 << 0, /**< null */
+	VKTOR_SCHEMA_BOOLEAN = 1 << 1, /**< true or false */
+	VKTOR_SCHEMA_INTEGER = 1 << 2, /**< numbers without a fraction */
+	VKTOR_SCHEMA_NUMBER  = 1 << 3, /**< any number */
+	VKTOR_SCHEMA_STRING  = 1 << 4, /**< string */
+	VKTOR_SCHEMA_ARRAY   = 1 << 5, /**< array */
+	VKTOR_SCHEMA_OBJECT  = 1 << 6  /**< object */
+} vktor_schema_type;
+
+/**
+ * @enum vktor_schema_flag
+ * 
+ * Limits set on a schema node
+ */
+typedef enum {
+	VKTOR_SCHEMA_MIN      = 1 << 0, /**< minimum is set */
+	VKTOR_SCHEMA_MAX      = 1 << 1, /**< maximum is set */
+	VKTOR_SCHEMA_EXCL_MIN = 1 << 2, /**< minimum is exclusive */
+	VKTOR_SCHEMA_EXCL_MAX = 1 << 3, /**< maximum is exclusive */
+	VKTOR_SCHEMA_ENUM     = 1 << 4  /**< enum is set, possibly empty */
+} vktor_schema_flag;
+
+/**
+ * @enum vktor_schema_state
+ * 
+ * State of a schema being compiled by vktor_schema_compile()
+ */
+typedef enum {
+	VKTOR_SCHEMA_NEW,       /**< not compiled */
+	VKTOR_SCHEMA_COMPILING, /**< being compiled */
+	VKTOR_SCHEMA_READY      /**< compiled */
+} vktor_schema_state;
+
+/**
+ * @enum vktor_schema_ctx_kind
+ * 
+ * What the tokens at a nesting level of a schema document are read into
+ */
+typedef enum {
+	VKTOR_SCHEMA_CTX_ROOT,       /**< the root schema */
+	VKTOR_SCHEMA_CTX_SCHEMA,     /**< keywords of a schema object */
+	VKTOR_SCHEMA_CTX_PROPERTIES, /**< schemas of properties */
+	VKTOR_SCHEMA_CTX_REQUIRED,   /**< names of required properties */
+	VKTOR_SCHEMA_CTX_ENUM,       /**< enum values */
+	VKTOR_SCHEMA_CTX_TYPE        /**< names of allowed types */
+} vktor_schema_ctx_kind;
+
+/**
+ * @enum vktor_schema_keyword
+ * 
+ * Supported schema keywords, in the order of schema_keywords
+ */
+typedef enum {
+	VKTOR_SCHEMA_KW_NONE,       /**< no keyword */
+	VKTOR_SCHEMA_KW_TYPE,       /**< type */
+	VKTOR_SCHEMA_KW_PROPERTIES, /**< properties */
+	VKTOR_SCHEMA_KW_REQUIRED,   /**< required */
+	VKTOR_SCHEMA_KW_ADDITIONAL, /**< additionalProperties */
+	VKTOR_SCHEMA_KW_ITEMS,      /**< items */
+	VKTOR_SCHEMA_KW_ENUM,       /**< enum */
+	VKTOR_SCHEMA_KW_MINIMUM,    /**< minimum */
+	VKTOR_SCHEMA_KW_MAXIMUM,    /**< maximum */
+	VKTOR_SCHEMA_KW_EXCL_MIN,   /**< exclusiveMinimum */
+	VKTOR_SCHEMA_KW_EXCL_MAX,   /**< exclusiveMaximum */
+	VKTOR_SCHEMA_KW_MIN_LENGTH, /**< minLength */
+	VKTOR_SCHEMA_KW_MAX_LENGTH, /**< maxLength */
+	VKTOR_SCHEMA_KW_MIN_ITEMS,  /**< minItems */
+	VKTOR_SCHEMA_KW_MAX_ITEMS   /**< maxItems */
+} vktor_schema_keyword;
+
+/**
+ * @ingroup internal
+ * @{
+ */
+
+/**
+ * Names of the supported schema keywords, in the order of 
+ * vktor_schema_keyword
+ */
+static const char *schema_keywords[] = {
+	"", "type", "properties", "required", "additionalProperties", "items", 
+	"enum", "minimum", "maximum", "exclusiveMinimum", "exclusiveMaximum", 
+	"minLength", "maxLength", "minItems", "maxItems", NULL
+};
+
+/**
+ * Schema keywords which are only annotations, and are ignored
+ */
+static const char *schema_annotations[] = {
+	"$schema", "$id", "id", "$comment", "title", "description", "default", 
+	"examples", "format", NULL
+};
+
+/**
+ * Names of the schema types, in the order of the vktor_schema_type bits
+ */
+static const char *schema_types[] = {
+	"null", "boolean", "integer", "number", "string", "array", "object", NULL
+};
+
+/**
+ * @brief Make room for one more member of a schema array
+ * 
+ * @param [in,out] schema Schema
+ * @param [in,out] array  Pointer to the array, which may be NULL
+ * @param [in,out] size   Number of members allocated
+ * @param [in]     count  Number of members used
+ * @param [in]     member Size of a member
+ * 
+ * @return 1 on success, or 0 if memory can't be allocated
+ */
+static int
+schema_reserve(vktor_schema *schema, void **array, int *size, int count, 
+               size_t member)
+{
+	void *mem;
+	int   new_size;
+	
+	if (count < *size) {
+		return 1;
+	}
+	
+	new_size = (*size > 0 ? *size * 2 : 16);
+	if (*array == NULL) {
+		mem = schema->allocator.malloc(schema->allocator.ctx, 
+			member * new_size);
+	} else {
+		mem = schema->allocator.realloc(schema->allocator.ctx, *array, 
+			member * new_size);
+	}
+	if (mem == NULL) {
+		return 0;
+	}
+	
+	*array = mem;
+	*size  = new_size;
+	return 1;
+}
+
+/**
+ * @brief Copy a string into the strings of a schema
+ * 
+ * @param [in,out] schema Schema
+ * @param [in]     str    String
+ * @param [in]     len    Length of the string
+ * 
+ * @return offset of the string, or -1 if memory can't be allocated
+ */
+static long
+schema_add_string(vktor_schema *schema, const char *str, int len)
+{
+	char *mem;
+	long  size;
+	
+	if (schema->strings_len + len > schema->strings_size) {
+		size = schema->strings_size * 2 + len + 64;
+		if (schema->strings == NULL) {
+			mem = schema->allocator.malloc(schema->allocator.ctx, size);
+		} else {
+			mem = schema->allocator.realloc(schema->allocator.ctx, 
+				schema->strings, size);
+		}
+		if (mem == NULL) {
+			return -1;
+		}
+		schema->strings      = mem;
+		schema->strings_size = size;
+	}
+	
+	memcpy(schema->strings + schema->strings_len, str, len);
+	schema->strings_len += len;
+	
+	return schema->strings_len - len;
+}
+
+/**
+ * @brief Add a node to a schema being compiled
+ * 
+ * @param [in,out] schema Schema
+ * 
+ * @return index of the node, with no keywords set, or -1 if memory can't be
+ *   allocated
+ */
+static int
+schema_add_node(vktor_schema *schema)
+{
+	vktor_schema_node *node;
+	
+	if (! schema_reserve(schema, (void **) &schema->nodes, 
+	                     &schema->nodes_size, schema->num_nodes, 
+	                     sizeof(vktor_schema_node))) {
+		return -1;
+	}
+	
+	node = &schema->nodes[schema->num_nodes];
+	node->types        = 0;
+	node->flags        = 0;
+	node->minimum      = 0;
+	node->maximum      = 0;
+	node->min_length   = -1;
+	node->max_length   = -1;
+	node->min_items    = -1;
+	node->max_items    = -1;
+	node->items        = VKTOR_SCHEMA_ANY;
+	node->additional   = VKTOR_SCHEMA_ANY;
+	node->props        = -1;
+	node->num_required = 0;
+	node->enums        = -1;
+	
+	return schema->num_nodes++;
+}
+
+/**
+ * @brief Find a property of a schema node, adding it if it is not found
+ * 
+ * Properties are added when they are listed in properties or in required, 
+ * whichever comes first.
+ * 
+ * @param [in,out] schema Schema
+ * @param [in]     node   Node index
+ * @param [in]     key    Property key
+ * @param [in]     len    Length of the key
+ * 
+ * @return index of the property, or -1 if memory can't be allocated
+ */
+static int
+schema_find_prop(vktor_schema *schema, int node, const char *key, int len)
+{
+	vktor_schema_prop *prop;
+	int                i;
+	long               str;
+	
+	for (i = schema->nodes[node].props; i != -1; i = prop->next) {
+		prop = &schema->props[i];
+		if (prop->key_len == len && 
+		    memcmp(schema->strings + prop->key, key, len) == 0) {
+			return i;
+		}
+	}
+	
+	if (! schema_reserve(schema, (void **) &schema->props, 
+	                     &schema->props_size, schema->num_props, 
+	                     sizeof(vktor_schema_prop)) ||
+	    (str = schema_add_string(schema, key, len)) == -1) {
+		return -1;
+	}
+	
+	i    = schema->num_props++;
+	prop = &schema->props[i];
+	prop->key      = str;
+	prop->key_len  = len;
+	prop->node     = VKTOR_SCHEMA_ANY;
+	prop->required = -1;
+	prop->declared = 0;
+	prop->next     = schema->nodes[node].props;
+	schema->nodes[node].props = i;
+	
+	return i;
+}
+
+/**
+ * @brief Add the current token of the schema parser as an enum value
+ * 
+ * @param [in,out] schema Schema
+ * @param [in]     parser Parser the schema is read from
+ * @param [in]     node   Node index
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK or VKTOR_ERROR
+ */
+static vktor_status
+schema_add_enum(vktor_schema *schema, vktor_parser *parser, int node, 
+                vktor_error **error)
+{
+	vktor_schema_enum *value;
+	vktor_token        type = parser->token_type;
+	
+	if (type & (VKTOR_T_ARRAY_START | VKTOR_T_OBJECT_START)) {
+		vktor_set_error(parser, error, VKTOR_ERR_UNSUPPORTED, 
+			"only strings, numbers, true, false and null are supported as enum "
+			"values");
+		return VKTOR_ERROR;
+	}
+	
+	if (! schema_reserve(schema, (void **) &schema->enums, 
+	                     &schema->enums_size, schema->num_enums, 
+	                     sizeof(vktor_schema_enum))) {
+		vktor_set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+			"unable to allocate memory for the schema");
+		return VKTOR_ERROR;
+	}
+	
+	value = &schema->enums[schema->num_enums];
+	value->number = 0;
+	value->str    = 0;
+	value->len    = 0;
+	
+	switch (type) {
+		case VKTOR_T_INT:
+		case VKTOR_T_FLOAT:
+			type = VKTOR_T_FLOAT;
+			value->number = strtod((char *) parser->token_value, NULL);
+			break;
+			
+		case VKTOR_T_STRING:
+			value->len = parser->token_size;
+			value->str = schema_add_string(schema, parser->token_value, 
+				parser->token_size);
+			if (value->str == -1) {
+				vktor_set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+					"unable to allocate memory for the schema");
+				return VKTOR_ERROR;
+			}
+			if (value->len > schema->max_enum_len) {
+				schema->max_enum_len = value->len;
+			}
+			break;
+			
+		default:
+			break;
+	}
+	
+	value->type = type;
+	value->next = schema->nodes[node].enums;
+	schema->nodes[node].enums = schema->num_enums++;
+	
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Add the type named by the current token of the schema parser
+ * 
+ * @param [in,out] schema Schema
+ * @param [in]     parser Parser the schema is read from
+ * @param [in]     node   Node index
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK or VKTOR_ERROR
+ */
+static vktor_status
+schema_add_type(vktor_schema *schema, vktor_parser *parser, int node, 
+                vktor_error **error)
+{
+	int i;
+	
+	for (i = 0; schema_types[i] != NULL; i++) {
+		if (strcmp(schema_types[i], (char *) parser->token_value) == 0) {
+			schema->nodes[node].types |= 1 << i;
+			return VKTOR_OK;
+		}
+	}
+	
+	vktor_set_error(parser, error, VKTOR_ERR_INVALID_FORMAT, 
+		"unknown schema type '%s'", (char *) parser->token_value);
+	return VKTOR_ERROR;
+}
+
+/**
+ * @brief Start reading an array or object of a schema
+ * 
+ * @param [in,out] schema Schema
+ * @param [in]     parser Parser the schema is read from
+ * @param [in]     kind   What the tokens of the array or object are read into
+ * @param [in]     node   Node index
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK or VKTOR_ERROR
+ */
+static vktor_status
+schema_push(vktor_schema *schema, vktor_parser *parser, char kind, int node, 
+            vktor_error **error)
+{
+	vktor_schema_ctx *ctx;
+	
+	if (! schema_reserve(schema, (void **) &schema->stack, 
+	                     &schema->stack_size, schema->depth + 1, 
+	                     sizeof(vktor_schema_ctx))) {
+		vktor_set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+			"unable to allocate memory for the schema");
+		return VKTOR_ERROR;
+	}
+	
+	ctx = &schema->stack[++schema->depth];
+	ctx->kind    = kind;
+	ctx->keyword = VKTOR_SCHEMA_KW_NONE;
+	ctx->node    = node;
+	ctx->prop    = -1;
+	
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Compile a value which is a schema
+ * 
+ * Read the root schema, or the schema of array members, additional 
+ * properties or a property. Object schemas are compiled into a new node, 
+ * while true and false are compiled as VKTOR_SCHEMA_ANY and 
+ * VKTOR_SCHEMA_NEVER.
+ * 
+ * @param [in,out] schema Schema
+ * @param [in]     parser Parser the schema is read from
+ * @param [in,out] ctx    Compiler context the schema is expected in
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK or VKTOR_ERROR
+ */
+static vktor_status
+schema_compile_schema(vktor_schema *schema, vktor_parser *parser, 
+                      vktor_schema_ctx *ctx, vktor_error **error)
+{
+	int node;
+	
+	switch (parser->token_type) {
+		case VKTOR_T_TRUE:
+			node = VKTOR_SCHEMA_ANY;
+			break;
+			
+		case VKTOR_T_FALSE:
+			node = VKTOR_SCHEMA_NEVER;
+			break;
+			
+		case VKTOR_T_OBJECT_START:
+			if ((node = schema_add_node(schema)) == -1) {
+				vktor_set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+					"unable to allocate memory for the schema");
+				return VKTOR_ERROR;
+			}
+			break;
+			
+		default:
+			vktor_set_error(parser, error, VKTOR_ERR_INVALID_FORMAT, 
+				"schema must be an object, true or false");
+			return VKTOR_ERROR;
+	}
+	
+	if (ctx->kind == VKTOR_SCHEMA_CTX_ROOT) {
+		schema->root = node;
+	} else if (ctx->kind == VKTOR_SCHEMA_CTX_PROPERTIES) {
+		schema->props[ctx->prop].node = node;
+	} else if (ctx->keyword == VKTOR_SCHEMA_KW_ITEMS) {
+		schema->nodes[ctx->node].items = node;
+	} else {
+		schema->nodes[ctx->node].additional = node;
+	}
+	
+	ctx->keyword = VKTOR_SCHEMA_KW_NONE;
+	ctx->prop    = -1;
+	
+	if (parser->token_type == VKTOR_T_OBJECT_START) {
+		return schema_push(schema, parser, VKTOR_SCHEMA_CTX_SCHEMA, node, 
+			error);
+	}
+	
+	if (schema->depth == 0) {
+		schema->state = VKTOR_SCHEMA_READY;
+	}
+	
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Compile the value of a schema keyword
+ * 
+ * @param [in,out] schema Schema
+ * @param [in]     parser Parser the schema is read from
+ * @param [in,out] ctx    Compiler context of the schema object
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK or VKTOR_ERROR
+ */
+static vktor_status
+schema_compile_keyword(vktor_schema *schema, vktor_parser *parser, 
+                       vktor_schema_ctx *ctx, vktor_error **error)
+{
+	vktor_schema_node *node = &schema->nodes[ctx->node];
+	vktor_token        token = parser->token_type;
+	int                keyword = ctx->keyword;
+	double             value;
+	long               limit;
+	
+	ctx->keyword = VKTOR_SCHEMA_KW_NONE;
+	
+	switch (keyword) {
+		case VKTOR_SCHEMA_KW_TYPE:
+			if (token == VKTOR_T_STRING) {
+				return schema_add_type(schema, parser, ctx->node, error);
+			} else if (token == VKTOR_T_ARRAY_START) {
+				return schema_push(schema, parser, VKTOR_SCHEMA_CTX_TYPE, 
+					ctx->node, error);
+			}
+			break;
+			
+		case VKTOR_SCHEMA_KW_PROPERTIES:
+			if (token == VKTOR_T_OBJECT_START) {
+				return schema_push(schema, parser, VKTOR_SCHEMA_CTX_PROPERTIES,
+					ctx->node, error);
+			}
+			break;
+			
+		case VKTOR_SCHEMA_KW_REQUIRED:
+			if (token == VKTOR_T_ARRAY_START) {
+				return schema_push(schema, parser, VKTOR_SCHEMA_CTX_REQUIRED,
+					ctx->node, error);
+			}
+			break;
+			
+		case VKTOR_SCHEMA_KW_ENUM:
+			if (token == VKTOR_T_ARRAY_START) {
+				node->flags |= VKTOR_SCHEMA_ENUM;
+				return schema_push(schema, parser, VKTOR_SCHEMA_CTX_ENUM, 
+					ctx->node, error);
+			}
+			break;
+			
+		case VKTOR_SCHEMA_KW_MINIMUM:
+		case VKTOR_SCHEMA_KW_EXCL_MIN:
+			if (token == VKTOR_T_INT || token == VKTOR_T_FLOAT) {
+				value = strtod((char *) parser->token_value, NULL);
+				
+				// With both keywords, the stricter limit applies
+				if (! (node->flags & VKTOR_SCHEMA_MIN) || value > node->minimum ||
+				    (value == node->minimum && keyword == VKTOR_SCHEMA_KW_EXCL_MIN)) {
+					node->minimum = value;
+					node->flags  |= VKTOR_SCHEMA_MIN;
+					if (keyword == VKTOR_SCHEMA_KW_EXCL_MIN) {
+						node->flags |= VKTOR_SCHEMA_EXCL_MIN;
+					} else {
+						node->flags &= ~VKTOR_SCHEMA_EXCL_MIN;
+					}
+				}
+				return VKTOR_OK;
+			}
+			break;
+			
+		case VKTOR_SCHEMA_KW_MAXIMUM:
+		case VKTOR_SCHEMA_KW_EXCL_MAX:
+			if (token == VKTOR_T_INT || token == VKTOR_T_FLOAT) {
+				value = strtod((char *) parser->token_value, NULL);
+				
+				if (! (node->flags & VKTOR_SCHEMA_MAX) || value < node->maximum ||
+				    (value == node->maximum && keyword == VKTOR_SCHEMA_KW_EXCL_MAX)) {
+					node->maximum = value;
+					node->flags  |= VKTOR_SCHEMA_MAX;
+					if (keyword == VKTOR_SCHEMA_KW_EXCL_MAX) {
+						node->flags |= VKTOR_SCHEMA_EXCL_MAX;
+					} else {
+						node->flags &= ~VKTOR_SCHEMA_EXCL_MAX;
+					}
+				}
+				return VKTOR_OK;
+			}
+			break;
+			
+		case VKTOR_SCHEMA_KW_MIN_LENGTH:
+		case VKTOR_SCHEMA_KW_MAX_LENGTH:
+		case VKTOR_SCHEMA_KW_MIN_ITEMS:
+		case VKTOR_SCHEMA_KW_MAX_ITEMS:
+			if (token == VKTOR_T_INT && 
+			    (limit = strtol((char *) parser->token_value, NULL, 10)) >= 0) {
+				if (keyword == VKTOR_SCHEMA_KW_MIN_LENGTH) {
+					node->min_length = limit;
+				} else if (keyword == VKTOR_SCHEMA_KW_MAX_LENGTH) {
+					node->max_length = limit;
+				} else if (keyword == VKTOR_SCHEMA_KW_MIN_ITEMS) {
+					node->min_items = limit;
+				} else {
+					node->max_items = limit;
+				}
+				return VKTOR_OK;
+			}
+			break;
+	}
+	
+	vktor_set_error(parser, error, VKTOR_ERR_INVALID_FORMAT, 
+		"invalid value of schema keyword '%s'", schema_keywords[keyword]);
+	return VKTOR_ERROR;
+}
+
+/**
+ * @brief Compile the current token of a schema
+ * 
+ * @param [in,out] schema Schema being compiled
+ * @param [in]     parser Parser the schema is read from
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK or VKTOR_ERROR
+ */
+static vktor_status
+schema_compile_token(vktor_schema *schema, vktor_parser *parser, 
+                     vktor_error **error)
+{
+	vktor_schema_ctx *ctx = &schema->stack[schema->depth];
+	vktor_token       token = parser->token_type;
+	int               i, prop;
+	
+	if (token == VKTOR_T_STRING_PART) {
+		vktor_set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"schema strings can't be read in parts");
+		return VKTOR_ERROR;
+	}
+	
+	// The end of an array or object of the schema
+	if (token == VKTOR_T_OBJECT_END || token == VKTOR_T_ARRAY_END) {
+		if (--schema->depth == 0) {
+			schema->state = VKTOR_SCHEMA_READY;
+		}
+		return VKTOR_OK;
+	}
+	
+	if (ctx->kind == VKTOR_SCHEMA_CTX_ROOT || ctx->prop != -1 || 
+	    ctx->keyword == VKTOR_SCHEMA_KW_ITEMS || 
+	    ctx->keyword == VKTOR_SCHEMA_KW_ADDITIONAL) {
+		return schema_compile_schema(schema, parser, ctx, error);
+	}
+	
+	switch (ctx->kind) {
+		case VKTOR_SCHEMA_CTX_SCHEMA:
+			if (ctx->keyword != VKTOR_SCHEMA_KW_NONE) {
+				return schema_compile_keyword(schema, parser, ctx, error);
+			}
+			
+			// An object key, naming a keyword or an annotation
+			for (i = 1; schema_keywords[i] != NULL; i++) {
+				if (strcmp(schema_keywords[i], (char *) parser->token_value) == 0) {
+					ctx->keyword = i;
+					return VKTOR_OK;
+				}
+			}
+			for (i = 0; schema_annotations[i] != NULL; i++) {
+				if (strcmp(schema_annotations[i], (char *) parser->token_value) == 0) {
+					schema->skipping = 1;
+					return VKTOR_OK;
+				}
+			}
+			
+			vktor_set_error(parser, error, VKTOR_ERR_UNSUPPORTED, 
+				"unsupported schema keyword '%s'", (char *) parser->token_value);
+			return VKTOR_ERROR;
+			
+		case VKTOR_SCHEMA_CTX_PROPERTIES:
+			prop = schema_find_prop(schema, ctx->node, parser->token_value, 
+				parser->token_size);
+			if (prop == -1) {
+				break;
+			}
+			schema->props[prop].declared = 1;
+			ctx->prop = prop;
+			return VKTOR_OK;
+			
+		case VKTOR_SCHEMA_CTX_REQUIRED:
+			if (token != VKTOR_T_STRING) {
+				vktor_set_error(parser, error, VKTOR_ERR_INVALID_FORMAT, 
+					"required properties must be strings");
+				return VKTOR_ERROR;
+			}
+			prop = schema_find_prop(schema, ctx->node, parser->token_value, 
+				parser->token_size);
+			if (prop == -1) {
+				break;
+			}
+			if (schema->props[prop].required == -1) {
+				schema->props[prop].required = 
+					schema->nodes[ctx->node].num_required++;
+			}
+			return VKTOR_OK;
+			
+		case VKTOR_SCHEMA_CTX_ENUM:
+			return schema_add_enum(schema, parser, ctx->node, error);
+			
+		case VKTOR_SCHEMA_CTX_TYPE:
+			if (token != VKTOR_T_STRING) {
+				vktor_set_error(parser, error, VKTOR_ERR_INVALID_FORMAT, 
+					"schema types must be strings");
+				return VKTOR_ERROR;
+			}
+			return schema_add_type(schema, parser, ctx->node, error);
+	}
+	
+	vktor_set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+		"unable to allocate memory for the schema");
+	return VKTOR_ERROR;
+}
+
+/**
+ * @brief Check whether a value matches the enum of a schema node
+ * 
+ * @param [in] schema Schema
+ * @param [in] node   Schema node, with an enum
+ * @param [in] type   Token type of the value, with VKTOR_T_FLOAT for numbers
+ * @param [in] number Value of a number
+ * @param [in] str    Value of a string
+ * @param [in] len    Length of a string
+ * 
+ * @return 1 if the value is one of the enum values, 0 otherwise
+ */
+static int
+schema_enum_match(vktor_schema *schema, vktor_schema_node *node, 
+                  vktor_token type, double number, const char *str, long len)
+{
+	vktor_schema_enum *value;
+	int                i;
+	
+	for (i = node->enums; i != -1; i = value->next) {
+		value = &schema->enums[i];
+		if (value->type != type) {
+			continue;
+		}
+		
+		if (type == VKTOR_T_FLOAT) {
+			if (value->number == number) {
+				return 1;
+			}
+		} else if (type == VKTOR_T_STRING) {
+			if (value->len == len && 
+			    memcmp(schema->strings + value->str, str, len) == 0) {
+				return 1;
+			}
+		} else {
+			return 1;
+		}
+	}
+	
+	return 0;
+}
+
+/**
+ * @brief Count the characters of a UTF-8 string
+ * 
+ * @param [in] str String
+ * @param [in] len Length of the string in bytes
+ * 
+ * @return number of characters, not counting continuation bytes
+ */
+static long
+schema_count_chars(const unsigned char *str, long len)
+{
+	long i, chars = 0;
+	
+	for (i = 0; i < len; i++) {
+		chars += ((str[i] & 0xc0) != 0x80);
+	}
+	
+	return chars;
+}
+
+/**
+ * @brief Start checking an array or object against a schema node
+ * 
+ * @param [in,out] parser Parser object, with a schema enabled
+ * @param [in]     node   Schema node of the array or object
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK or VKTOR_ERROR
+ */
+static vktor_status
+parser_schema_push(vktor_parser *parser, int node, vktor_error **error)
+{
+	vktor_schema_validator *valid = parser->schema;
+	vktor_schema_level     *level, *stack;
+	unsigned char          *seen;
+	long                    end;
+	int                     size;
+	
+	if (parser->nest_ptr >= valid->size) {
+		size  = valid->size * 2;
+		stack = vrealloc(parser, valid->stack, 
+			sizeof(vktor_schema_level) * size);
+		if (stack == NULL) {
+			vktor_set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+				"unable to allocate %d bytes for schema validation", 
+				(int) sizeof(vktor_schema_level) * size);
+			return VKTOR_ERROR;
+		}
+		valid->stack = stack;
+		valid->size  = size;
+	}
+	
+	level = &valid->stack[parser->nest_ptr];
+	level->node     = node;
+	level->next     = VKTOR_SCHEMA_ANY;
+	level->array    = (parser->token_type == VKTOR_T_ARRAY_START);
+	level->count    = 0;
+	level->seen     = level[-1].seen + level[-1].seen_len;
+	level->seen_len = 0;
+	
+	// Required properties seen in an object are kept as bits
+	if (! level->array && node >= 0 && 
+	    valid->compiled->nodes[node].num_required > 0) {
+		level->seen_len = (valid->compiled->nodes[node].num_required + 7) / 8;
+		end = level->seen + level->seen_len;
+		
+		if (end > valid->seen_size) {
+			seen = vrealloc(parser, valid->seen, end * 2);
+			if (seen == NULL) {
+				vktor_set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+					"unable to allocate %ld bytes for schema validation", 
+					end * 2);
+				return VKTOR_ERROR;
+			}
+			valid->seen      = seen;
+			valid->seen_size = end * 2;
+		}
+		memset(valid->seen + level->seen, 0, level->seen_len);
+	}
+	
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Check an object key against the schema of its object
+ * 
+ * Find the schema of the key's value, and mark the key as seen if it is 
+ * required.
+ * 
+ * @param [in,out] parser Parser object, with a schema enabled
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK or VKTOR_ERROR
+ */
+static vktor_status
+parser_schema_key(vktor_parser *parser, vktor_error **error)
+{
+	vktor_schema       *schema = parser->schema->compiled;
+	vktor_schema_level *level = &parser->schema->stack[parser->nest_ptr];
+	vktor_schema_node  *node;
+	vktor_schema_prop  *prop;
+	int                 i;
+	
+	if (level->node == VKTOR_SCHEMA_ANY) {
+		level->next = VKTOR_SCHEMA_ANY;
+		return VKTOR_OK;
+	}
+	
+	node = &schema->nodes[level->node];
+	level->next = node->additional;
+	
+	for (i = node->props; i != -1; i = prop->next) {
+		prop = &schema->props[i];
+		if (prop->key_len == parser->token_size && 
+		    memcmp(schema->strings + prop->key, parser->token_value, 
+		           prop->key_len) == 0) {
+			if (prop->required != -1) {
+				parser->schema->seen[level->seen + prop->required / 8] |= 
+					1 << (prop->required % 8);
+			}
+			if (prop->declared) {
+				level->next = prop->node;
+			}
+			break;
+		}
+	}
+	
+	if (level->next == VKTOR_SCHEMA_NEVER) {
+		vktor_set_error(parser, error, VKTOR_ERR_SCHEMA, 
+			"property '%.*s' is not allowed by the schema", parser->token_size, 
+			(char *) parser->token_value);
+		return VKTOR_ERROR;
+	}
+	
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Check an array or object which has ended against its schema
+ * 
+ * @param [in,out] parser Parser object, with a schema enabled
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK or VKTOR_ERROR
+ */
+static vktor_status
+parser_schema_end(vktor_parser *parser, vktor_error **error)
+{
+	vktor_schema       *schema = parser->schema->compiled;
+	vktor_schema_level *level;
+	vktor_schema_node  *node;
+	vktor_schema_prop  *prop;
+	int                 i;
+	
+	// The level of the struct was already popped
+	level = &parser->schema->stack[parser->nest_ptr + 1];
+	if (level->node == VKTOR_SCHEMA_ANY) {
+		return VKTOR_OK;
+	}
+	node = &schema->nodes[level->node];
+	
+	if (level->array) {
+		if (level->count < node->min_items) {
+			vktor_set_error(parser, error, VKTOR_ERR_SCHEMA, 
+				"array has less than %ld members", node->min_items);
+			return VKTOR_ERROR;
+		}
+		return VKTOR_OK;
+	}
+	
+	for (i = node->props; i != -1 && node->num_required > 0; i = prop->next) {
+		prop = &schema->props[i];
+		if (prop->required != -1 && 
+		    ! (parser->schema->seen[level->seen + prop->required / 8] & 
+		       (1 << (prop->required % 8)))) {
+			vktor_set_error(parser, error, VKTOR_ERR_SCHEMA, 
+				"required property '%.*s' is missing", prop->key_len, 
+				schema->strings + prop->key);
+			return VKTOR_ERROR;
+		}
+	}
+	
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Check a string value, or a part of it, against a schema node
+ * 
+ * String length is counted in characters. Strings read in parts are kept 
+ * only while they may still match an enum value.
+ * 
+ * @param [in,out] parser Parser object, with a schema enabled
+ * @param [in]     node   Schema node of the string
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK or VKTOR_ERROR
+ */
+static vktor_status
+parser_schema_string(vktor_parser *parser, vktor_schema_node *node, 
+                     vktor_error **error)
+{
+	vktor_schema_validator *valid = parser->schema;
+	long                    chars, len = parser->token_size;
+	char                   *str = parser->token_value;
+	
+	chars = (valid->in_part ? valid->chars : 0) + 
+		schema_count_chars((unsigned char *) parser->token_value, 
+		                   parser->token_size);
+	
+	if (node->max_length != -1 && chars > node->max_length) {
+		vktor_set_error(parser, error, VKTOR_ERR_SCHEMA, 
+			"string is longer than %ld characters", node->max_length);
+		return VKTOR_ERROR;
+	}
+	
+	if (valid->in_part && (node->flags & VKTOR_SCHEMA_ENUM)) {
+		if (valid->str_len + len <= valid->compiled->max_enum_len) {
+			memcpy(valid->str + valid->str_len, parser->token_value, len);
+			valid->str_len += len;
+		} else {
+			valid->str_len = valid->compiled->max_enum_len + 1;
+		}
+		str = valid->str;
+		len = valid->str_len;
+	}
+	
+	if (parser->token_type == VKTOR_T_STRING_PART) {
+		valid->chars = chars;
+		return VKTOR_OK;
+	}
+	
+	if (chars < node->min_length) {
+		vktor_set_error(parser, error, VKTOR_ERR_SCHEMA, 
+			"string is shorter than %ld characters", node->min_length);
+		return VKTOR_ERROR;
+	}
+	
+	if ((node->flags & VKTOR_SCHEMA_ENUM) && 
+	    (len > valid->compiled->max_enum_len || 
+	     ! schema_enum_match(valid->compiled, node, VKTOR_T_STRING, 0, str, 
+	                         len))) {
+		vktor_set_error(parser, error, VKTOR_ERR_SCHEMA, 
+			"string is not one of the values allowed by the schema");
+		return VKTOR_ERROR;
+	}
+	
+	return VKTOR_OK;
+}
+
+/**
+ * @brief Check the current token against the schema
+ * 
+ * The schema node of each value is found from the array or object it is in:
+ * the node of array members, or the node of the last object key's property.
+ * The type and limits of scalar values are checked when they are read, as 
+ * are the number of array members and the object keys allowed, so a value 
+ * which does not match the schema is found as soon as possible. 
+ * 
+ * @param [in,out] parser Parser object, with a schema enabled
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_OK or VKTOR_ERROR
+ */
+vktor_status
+vktor_parser_schema_token(vktor_parser *parser, vktor_error **error)
+{
+	vktor_schema       *schema = parser->schema->compiled;
+	vktor_schema_level *level;
+	vktor_schema_node  *node;
+	vktor_token         token = parser->token_type;
+	double              number = 0;
+	int                 n, i, types;
+	char                expected[64];
+	
+	switch (token) {
+		case VKTOR_T_OBJECT_KEY:
+			return parser_schema_key(parser, error);
+			
+		case VKTOR_T_ARRAY_END:
+		case VKTOR_T_OBJECT_END:
+			return parser_schema_end(parser, error);
+			
+		default:
+			break;
+	}
+	
+	if (parser->schema->in_part) {
+		// The rest of a string read in parts
+		n = parser->schema->part_node;
+		
+	} else {
+		// The level the value is in, which for an array or object is the 
+		// level below its own
+		level = &parser->schema->stack[parser->nest_ptr - 
+			(token == VKTOR_T_ARRAY_START || token == VKTOR_T_OBJECT_START)];
+		
+		if (! level->array) {
+			n = level->next;
+		} else if (level->node == VKTOR_SCHEMA_ANY) {
+			n = VKTOR_SCHEMA_ANY;
+		} else {
+			n = schema->nodes[level->node].items;
+			level->count++;
+			if (schema->nodes[level->node].max_items != -1 && 
+			    level->count > schema->nodes[level->node].max_items) {
+				vktor_set_error(parser, error, VKTOR_ERR_SCHEMA, 
+					"array has more than %ld members", 
+					schema->nodes[level->node].max_items);
+				return VKTOR_ERROR;
+			}
+		}
+		
+		if (n == VKTOR_SCHEMA_NEVER) {
+			vktor_set_error(parser, error, VKTOR_ERR_SCHEMA, 
+				"value is not allowed by the schema");
+			return VKTOR_ERROR;
+		}
+		
+		if (token == VKTOR_T_STRING_PART) {
+			parser->schema->in_part   = 1;
+			parser->schema->part_node = n;
+			parser->schema->chars     = 0;
+			parser->schema->str_len   = 0;
+		}
+	}
+	
+	if (n == VKTOR_SCHEMA_ANY) {
+		node = NULL;
+	} else {
+		node = &schema->nodes[n];
+	}
+	
+	// Check the type of the value
+	switch (token) {
+		case VKTOR_T_ARRAY_START:
+			types = VKTOR_SCHEMA_ARRAY;
+			break;
+			
+		case VKTOR_T_OBJECT_START:
+			types = VKTOR_SCHEMA_OBJECT;
+			break;
+			
+		case VKTOR_T_STRING:
+		case VKTOR_T_STRING_PART:
+			types = VKTOR_SCHEMA_STRING;
+			break;
+			
+		case VKTOR_T_INT:
+		case VKTOR_T_FLOAT:
+			number = strtod((char *) parser->token_value, NULL);
+			types  = VKTOR_SCHEMA_NUMBER;
+			
+			// Numbers without a fraction are integers, whatever their form
+			if (token == VKTOR_T_INT || number < -9e18 || number > 9e18 || 
+			    (double) (long long) number == number) {
+				types |= VKTOR_SCHEMA_INTEGER;
+			}
+			break;
+			
+		case VKTOR_T_NULL:
+			types = VKTOR_SCHEMA_NULL;
+			break;
+			
+		default:
+			types = VKTOR_SCHEMA_BOOLEAN;
+			break;
+	}
+	
+	if (node != NULL && node->types != 0 && ! (node->types & types)) {
+		expected[0] = '\0';
+		for (i = 0; schema_types[i] != NULL; i++) {
+			if (node->types & (1 << i)) {
+				if (expected[0] != '\0') {
+					strcat(expected, " or ");
+				}
+				strcat(expected, schema_types[i]);
+			}
+		}
+		vktor_set_error(parser, error, VKTOR_ERR_SCHEMA, 
+			"value does not match the schema, expecting %s", expected);
+		return VKTOR_ERROR;
+	}
+	
+	switch (token) {
+		case VKTOR_T_ARRAY_START:
+		case VKTOR_T_OBJECT_START:
+			// Only scalar enum values are supported
+			if (node != NULL && (node->flags & VKTOR_SCHEMA_ENUM)) {
+				break;
+			}
+			return parser_schema_push(parser, n, error);
+			
+		case VKTOR_T_STRING:
+		case VKTOR_T_STRING_PART:
+			if (node != NULL && 
+			    parser_schema_string(parser, node, error) == VKTOR_ERROR) {
+				return VKTOR_ERROR;
+			}
+			parser->schema->in_part = (token == VKTOR_T_STRING_PART);
+			return VKTOR_OK;
+			
+		case VKTOR_T_INT:
+		case VKTOR_T_FLOAT:
+			if (node == NULL) {
+				return VKTOR_OK;
+			}
+			
+			if ((node->flags & VKTOR_SCHEMA_MIN) && 
+			    (number < node->minimum || 
+			     (number == node->minimum && 
+			      (node->flags & VKTOR_SCHEMA_EXCL_MIN)))) {
+				vktor_set_error(parser, error, VKTOR_ERR_SCHEMA, 
+					"number is below the minimum of %g", node->minimum);
+				return VKTOR_ERROR;
+			}
+			
+			if ((node->flags & VKTOR_SCHEMA_MAX) && 
+			    (number > node->maximum || 
+			     (number == node->maximum && 
+			      (node->flags & VKTOR_SCHEMA_EXCL_MAX)))) {
+				vktor_set_error(parser, error, VKTOR_ERR_SCHEMA, 
+					"number is above the maximum of %g", node->maximum);
+				return VKTOR_ERROR;
+			}
+			
+			if (! (node->flags & VKTOR_SCHEMA_ENUM) || 
+			    schema_enum_match(schema, node, VKTOR_T_FLOAT, number, NULL, 0)) {
+				return VKTOR_OK;
+			}
+			break;
+			
+		default:
+			// true, false and null
+			if (node == NULL || ! (node->flags & VKTOR_SCHEMA_ENUM) || 
+			    schema_enum_match(schema, node, token, 0, NULL, 0)) {
+				return VKTOR_OK;
+			}
+			break;
+	}
+	
+	vktor_set_error(parser, error, VKTOR_ERR_SCHEMA, 
+		"value is not one of the values allowed by the schema");
+	return VKTOR_ERROR;
+}
+
+/**
+ * @brief Check whether the schema allows any value next
+ * 
+ * Used by vktor_skip_value() to skip values which are not checked without 
+ * reading them token by token. Members of constrained arrays are always read
+ * token by token, so they are counted.
+ * 
+ * @param [in] parser Parser object, with a schema enabled
+ * 
+ * @return 1 if any value is allowed, 0 otherwise
+ */
+int
+vktor_parser_schema_any(vktor_parser *parser)
+{
+	vktor_schema_level *level = &parser->schema->stack[parser->nest_ptr];
+	
+	if (level->array) {
+		return (level->node == VKTOR_SCHEMA_ANY);
+	}
+	
+	return (level->next == VKTOR_SCHEMA_ANY);
+}
+
+/**
+ * @brief Free a schema validation state
+ * 
+ * @param [in,out] parser Parser object the state was allocated by
+ * @param [in,out] valid  Schema validation state
+ */
+void
+vktor_parser_schema_free(vktor_parser *parser, vktor_schema_validator *valid)
+{
+	if (valid->stack != NULL) {
+		vfree(parser, valid->stack);
+	}
+	
+	if (valid->seen != NULL) {
+		vfree(parser, valid->seen);
+	}
+	
+	if (valid->str != NULL) {
+		vfree(parser, valid->str);
+	}
+	
+	vfree(parser, valid);
+}
+
+/** @} */ // end of internal API
+
+/**
+ * @ingroup external
+ * @{
+ */
+
+/**
+ * @brief Initialize a schema
+ * 
+ * Initialize an empty schema, to be compiled using vktor_schema_compile().
+ * 
+ * @param [in] allocator allocator to use for the schema, or NULL for the 
+ *                       default allocator
+ * 
+ * @return a newly allocated schema, or NULL if memory can't be allocated
+ */
+vktor_schema*
+vktor_schema_init(const vktor_allocator *allocator)
+{
+	vktor_schema *schema;
+	
+	if (allocator == NULL) {
+		allocator = &vktor_default_allocator;
+	}
+	
+	schema = allocator->malloc(allocator->ctx, sizeof(vktor_schema));
+	if (schema == NULL) {
+		return NULL;
+	}
+	memset(schema, 0, sizeof(vktor_schema));
+	
+	schema->allocator = *allocator;
+	schema->root      = VKTOR_SCHEMA_ANY;
+	schema->state     = VKTOR_SCHEMA_NEW;
+	
+	return schema;
+}
+
+/**
+ * @brief Compile a JSON Schema
+ * 
+ * Read the next value from the parser as a JSON Schema, and compile it so 
+ * documents can be validated against it while they are parsed. The schema 
+ * is usually a document of its own, but can be any value. 
+ * 
+ * The following keywords are supported: type, properties, required, 
+ * additionalProperties, items (a single schema), enum (of strings, numbers, 
+ * true, false and null), minimum, maximum, exclusiveMinimum and 
+ * exclusiveMaximum (as numbers), minLength, maxLength, minItems and maxItems.
+ * The annotations $schema, $id, id, $comment, title, description, default, 
+ * examples and format are ignored. Schemas may be true or false as well. Any
+ * other keyword is an error, so documents are never validated against only 
+ * a part of a schema. 
+ * 
+ * Once compiled, a schema is not modified by validation, and can be used by 
+ * any number of parsers at the same time.
+ * 
+ * @param [in,out] schema schema to compile, replacing any previous contents
+ * @param [in,out] parser parser to read the schema from
+ * @param [out]    error  error object pointer pointer or NULL
+ * 
+ * @return status code:
+ *  - VKTOR_OK        if the schema was compiled
+ *  - VKTOR_ERROR     if an error has occured, or the schema is invalid
+ *  - VKTOR_MORE_DATA if we need more data in order to continue compiling
+ */
+vktor_status
+vktor_schema_compile(vktor_schema *schema, vktor_parser *parser, 
+                     vktor_error **error)
+{
+	vktor_status status = VKTOR_OK;
+	
+	assert(schema != NULL);
+	assert(parser != NULL);
+	
+	if (schema->state != VKTOR_SCHEMA_COMPILING) {
+		if (! schema_reserve(schema, (void **) &schema->stack, 
+		                     &schema->stack_size, 0, 
+		                     sizeof(vktor_schema_ctx))) {
+			vktor_set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+				"unable to allocate memory for the schema");
+			return VKTOR_ERROR;
+		}
+		
+		schema->num_nodes    = 0;
+		schema->num_props    = 0;
+		schema->num_enums    = 0;
+		schema->strings_len  = 0;
+		schema->max_enum_len = 0;
+		schema->root         = VKTOR_SCHEMA_ANY;
+		schema->skipping     = 0;
+		schema->depth        = 0;
+		schema->state        = VKTOR_SCHEMA_COMPILING;
+		
+		schema->stack[0].kind    = VKTOR_SCHEMA_CTX_ROOT;
+		schema->stack[0].keyword = VKTOR_SCHEMA_KW_NONE;
+		schema->stack[0].node    = -1;
+		schema->stack[0].prop    = -1;
+	}
+	
+	while (schema->state == VKTOR_SCHEMA_COMPILING) {
+		// Annotations are skipped
+		if (schema->skipping) {
+			if ((status = vktor_skip_value(parser, error)) != VKTOR_OK) {
+				break;
+			}
+			schema->skipping = 0;
+			continue;
+		}
+		
+		if ((status = vktor_parse(parser, error)) != VKTOR_OK) {
+			break;
+		}
+		
+		if ((status = schema_compile_token(schema, parser, error)) != VKTOR_OK) {
+			break;
+		}
+	}
+	
+	switch (status) {
+		case VKTOR_OK:
+		case VKTOR_MORE_DATA:
+			break;
+			
+		case VKTOR_COMPLETE:
+			vktor_set_error(parser, error, VKTOR_ERR_INCOMPLETE_DATA, 
+				"the document has ended before the schema");
+			status = VKTOR_ERROR;
+			// fall through
+			
+		default:
+			schema->state = VKTOR_SCHEMA_NEW;
+			break;
+	}
+	
+	return status;
+}
+
+/**
+ * @brief Free a schema
+ * 
+ * @param [in,out] schema schema
+ */
+void
+vktor_schema_free(vktor_schema *schema)
+{
+	assert(schema != NULL);
+	
+	if (schema->nodes != NULL) {
+		schema->allocator.free(schema->allocator.ctx, schema->nodes);
+	}
+	if (schema->props != NULL) {
+		schema->allocator.free(schema->allocator.ctx, schema->props);
+	}
+	if (schema->enums != NULL) {
+		schema->allocator.free(schema->allocator.ctx, schema->enums);
+	}
+	if (schema->strings != NULL) {
+		schema->allocator.free(schema->allocator.ctx, schema->strings);
+	}
+	if (schema->stack != NULL) {
+		schema->allocator.free(schema->allocator.ctx, schema->stack);
+	}
+	
+	schema->allocator.free(schema->allocator.ctx, schema);
+}
+
+/**
+ * @brief Validate the document against a schema while it is parsed
+ * 
+ * Check every token returned by vktor_parse() against a compiled schema, 
+ * without building the document in memory. Only the current path through 
+ * the document is tracked, along with the required properties seen in each 
+ * object. A value which does not match the schema is an error with the code
+ * VKTOR_ERR_SCHEMA, returned as soon as the token which violates the schema 
+ * is read, and parsing should not continue after it. A missing required 
+ * property or too few array members are reported at the end of the object or
+ * array.
+ * 
+ * Values skipped using vktor_skip_value() are checked token by token, unless
+ * the schema allows any value in their place. Values can't be read using 
+ * vktor_read_base64(), vktor_capture_value(), vktor_validate() or the number
+ * array readers while a schema is enabled.
+ * 
+ * A schema can only be enabled before the document is read, and must not be
+ * freed before the parser.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [in]     schema compiled schema
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return VKTOR_OK or VKTOR_ERROR
+ */
+vktor_status
+vktor_enable_schema(vktor_parser *parser, vktor_schema *schema, 
+                    vktor_error **error)
+{
+	vktor_schema_validator *valid;
+	
+	assert(parser != NULL);
+	assert(schema != NULL);
+	
+	if (parser->schema != NULL) {
+		vktor_set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"a schema is already enabled");
+		return VKTOR_ERROR;
+	}
+	
+	if (schema->state != VKTOR_SCHEMA_READY) {
+		vktor_set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"the schema was not compiled");
+		return VKTOR_ERROR;
+	}
+	
+	if (parser->token_type != VKTOR_T_NONE || parser->nest_ptr != 0 || 
+	    skip_active(parser) || 
+	    valid_active(parser) || 
+	    parser->expected == VKTOR_T_NONE) {
+		vktor_set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+			"a schema must be enabled before the document is read");
+		return VKTOR_ERROR;
+	}
+	
+	valid = vktor_parser_alloc_state(parser, sizeof(vktor_schema_validator), error);
+	if (valid == NULL) {
+		return VKTOR_ERROR;
+	}
+	
+	valid->compiled  = schema;
+	valid->size      = 16;
+	valid->stack     = vmalloc(parser, sizeof(vktor_schema_level) * valid->size);
+	valid->seen_size = 64;
+	valid->seen      = vmalloc(parser, valid->seen_size);
+	if (schema->max_enum_len > 0) {
+		valid->str = vmalloc(parser, schema->max_enum_len);
+	}
+	
+	if (valid->stack == NULL || valid->seen == NULL || 
+	    (schema->max_enum_len > 0 && valid->str == NULL)) {
+		vktor_parser_schema_free(parser, valid);
+		vktor_set_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, 
+			"unable to allocate memory for schema validation");
+		return VKTOR_ERROR;
+	}
+	
+	// The root level only holds the node of the root value
+	valid->stack[0].node     = VKTOR_SCHEMA_ANY;
+	valid->stack[0].next     = schema->root;
+	valid->stack[0].array    = 0;
+	valid->stack[0].count    = 0;
+	valid->stack[0].seen     = 0;
+	valid->stack[0].seen_len = 0;
+	
+	parser->schema = valid;
+	
+	return VKTOR_OK;
+}
+
+/** @} */ // end of external API
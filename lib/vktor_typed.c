@@ -0,0 +1,340 @@
+/* 
+ * vktor JSON pull-parser library
+ * 
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE. 
+ */
+
+/**
+ * @file vktor_typed.c
+ * 
+ * Typed string decoders. Hexadecimal digits and the fixed part of timestamps
+ * are validated 8 characters at a time, by treating each 8 characters as the
+ * bytes of one 64 bit word and checking all of them with a few arithmetic 
+ * operations (SIMD within a register). 
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <time.h>
+
+#include "vktor.h"
+#include "vktor_internal.h"
+#include "vktor_typed.h"
+
+typedef unsigned long long vktor_word;
+
+/* Each byte of a word set to b */
+#define word_repeat(b) (((vktor_word) 0x0101010101010101ULL) * (b))
+
+/* The high bit of each byte of a word */
+#define WORD_HIGH_BITS word_repeat(0x80)
+
+/* Number of days in each month of a non-leap year */
+static const int month_days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+/**
+ * @brief Load 8 characters into a word
+ * 
+ * @param [in] str input, at least 8 characters long
+ * 
+ * @return word with the characters as its bytes, in memory order
+ */
+static vktor_word
+word_load(const char *str)
+{
+	vktor_word w;
+	
+	memcpy(&w, str, sizeof(w));
+	return w;
+}
+
+/**
+ * @brief Check the byte ranges of a word
+ * 
+ * @param [in] w  word, with the high bit of every byte clear
+ * @param [in] lo lowest allowed byte value
+ * @param [in] hi highest allowed byte value
+ * 
+ * @return word with the high bit set in every byte between lo and hi
+ */
+static vktor_word
+word_in_range(vktor_word w, unsigned char lo, unsigned char hi)
+{
+	// Bytes are below 0x80, so none of these additions carry into the next
+	// byte, and the high bit of each byte tells if the byte was >= lo or > hi
+	vktor_word ge = w + word_repeat(0x80 - lo);
+	vktor_word gt = w + word_repeat(0x7f - hi);
+	
+	return ge & ~gt & WORD_HIGH_BITS;
+}
+
+/**
+ * @brief Decode 8 hexadecimal digits
+ * 
+ * @param [in]  str input, at least 8 characters long
+ * @param [out] val decoded 32 bit number
+ * 
+ * @return 1 if all 8 characters are hexadecimal digits, 0 otherwise
+ */
+static int
+hex_decode8(const char *str, unsigned long *val)
+{
+	vktor_word           w = word_load(str);
+	vktor_word           digit, alpha;
+	const unsigned short one = 1;
+	
+	if (w & WORD_HIGH_BITS) {
+		return 0;
+	}
+	
+	digit = word_in_range(w, '0', '9');
+	alpha = word_in_range(w | word_repeat(0x20), 'a', 'f');
+	if ((digit | alpha) != WORD_HIGH_BITS) {
+		return 0;
+	}
+	
+	// Value of each digit, one per byte
+	w = (w & word_repeat(0x0f)) + (alpha >> 7) * 9;
+	
+	// Put the first digit in the most significant byte
+	if (*(const unsigned char *) &one) {
+		w = ((w & 0x00ff00ff00ff00ffULL) << 8)  | ((w >> 8)  & 0x00ff00ff00ff00ffULL);
+		w = ((w & 0x0000ffff0000ffffULL) << 16) | ((w >> 16) & 0x0000ffff0000ffffULL);
+		w = (w << 32) | (w >> 32);
+	}
+	
+	// Pack the digits, 4 bits each
+	w = (w | (w >> 4))  & 0x00ff00ff00ff00ffULL;
+	w = (w | (w >> 8))  & 0x0000ffff0000ffffULL;
+	w = (w | (w >> 16)) & 0x00000000ffffffffULL;
+	
+	*val = (unsigned long) w;
+	return 1;
+}
+
+/**
+ * @brief Read a number of decimal digits
+ * 
+ * @param [in]  str   input
+ * @param [in]  count number of digits to read
+ * @param [out] val   decoded number
+ * 
+ * @return 1 if all characters are digits, 0 otherwise
+ */
+static int
+dec_decode(const char *str, int count, int *val)
+{
+	int i;
+	
+	*val = 0;
+	for (i = 0; i < count; i++) {
+		if (str[i] < '0' || str[i] > '9') {
+			return 0;
+		}
+		*val = *val * 10 + (str[i] - '0');
+	}
+	
+	return 1;
+}
+
+int
+vktor_typed_hex(const char *str, long len, unsigned long long *val)
+{
+	char          digits[16];
+	unsigned long hi, lo;
+	
+	if (len < 1 || len > 16) {
+		return 0;
+	}
+	
+	// Pad to 16 digits with leading zeros
+	memset(digits, '0', sizeof(digits) - len);
+	memcpy(digits + sizeof(digits) - len, str, len);
+	
+	if (! (hex_decode8(digits, &hi) && hex_decode8(digits + 8, &lo))) {
+		return 0;
+	}
+	
+	*val = ((unsigned long long) hi << 32) | lo;
+	return 1;
+}
+
+int
+vktor_typed_uuid(const char *str, long len, unsigned char *uuid)
+{
+	char          digits[32];
+	unsigned long part;
+	int           i;
+	
+	if (len == 36) {
+		if (str[8] != '-' || str[13] != '-' || str[18] != '-' || str[23] != '-') {
+			return 0;
+		}
+		
+		memcpy(digits, str, 8);
+		memcpy(digits + 8, str + 9, 4);
+		memcpy(digits + 12, str + 14, 4);
+		memcpy(digits + 16, str + 19, 4);
+		memcpy(digits + 20, str + 24, 12);
+		str = digits;
+		
+	} else if (len != 32) {
+		return 0;
+	}
+	
+	for (i = 0; i < 16; i += 4) {
+		if (! hex_decode8(str + i * 2, &part)) {
+			return 0;
+		}
+		
+		uuid[i]     = (unsigned char) (part >> 24);
+		uuid[i + 1] = (unsigned char) (part >> 16);
+		uuid[i + 2] = (unsigned char) (part >> 8);
+		uuid[i + 3] = (unsigned char) part;
+	}
+	
+	return 1;
+}
+
+int
+vktor_typed_timestamp(const char *str, long len, struct timespec *ts)
+{
+	// Digits and separators of "YYYY-MM-" and "DDTHH:MM", the 'T' is checked
+	// separately as it may also be a 't' or a space
+	static const char date_digits[8]   = {'\x80', '\x80', '\x80', '\x80', 0, '\x80', '\x80', 0};
+	static const char date_sepmask[8]  = {0, 0, 0, 0, '\xff', 0, 0, '\xff'};
+	static const char date_seps[8]     = {0, 0, 0, 0, '-', 0, 0, '-'};
+	static const char time_digits[8]   = {'\x80', '\x80', 0, '\x80', '\x80', 0, '\x80', '\x80'};
+	static const char time_sepmask[8]  = {0, 0, 0, 0, 0, '\xff', 0, 0};
+	static const char time_seps[8]     = {0, 0, 0, 0, 0, ':', 0, 0};
+	
+	vktor_word     date, time;
+	unsigned char  d[16];
+	int            year, month, day, hour, min, sec, mdays;
+	int            off_hour = 0, off_min = 0, off_sign = 0, nsec = 0, digits;
+	long long      y, era, yoe, doy, secs;
+	const char    *p;
+	
+	if (len < 20) {
+		return 0;
+	}
+	
+	date = word_load(str);
+	time = word_load(str + 8);
+	if ((date | time) & WORD_HIGH_BITS) {
+		return 0;
+	}
+	
+	// Check the first 16 characters, 8 at a time
+	if (word_in_range(date, '0', '9') != word_load(date_digits) ||
+	    word_in_range(time, '0', '9') != word_load(time_digits) ||
+	    (date & word_load(date_sepmask)) != word_load(date_seps) ||
+	    (time & word_load(time_sepmask)) != word_load(time_seps)) {
+		return 0;
+	}
+	
+	if ((str[10] != 'T' && str[10] != 't' && str[10] != ' ') || str[16] != ':' ||
+	    ! dec_decode(str + 17, 2, &sec)) {
+		return 0;
+	}
+	
+	// Value of each digit, one per byte
+	date &= word_repeat(0x0f);
+	time &= word_repeat(0x0f);
+	memcpy(d, &date, 8);
+	memcpy(d + 8, &time, 8);
+	
+	year  = d[0] * 1000 + d[1] * 100 + d[2] * 10 + d[3];
+	month = d[5] * 10 + d[6];
+	day   = d[8] * 10 + d[9];
+	hour  = d[11] * 10 + d[12];
+	min   = d[14] * 10 + d[15];
+	
+	// Fraction of a second, digits beyond nanoseconds are ignored
+	p = str + 19;
+	if (*p == '.') {
+		for (p++, digits = 0; p < str + len && *p >= '0' && *p <= '9'; p++, digits++) {
+			if (digits < 9) {
+				nsec = nsec * 10 + (*p - '0');
+			}
+		}
+		
+		if (digits == 0) {
+			return 0;
+		}
+		
+		for (; digits < 9; digits++) {
+			nsec *= 10;
+		}
+	}
+	
+	// Time zone offset
+	if (p + 1 == str + len && (*p == 'Z' || *p == 'z')) {
+		off_sign = 0;
+		
+	} else if (p + 6 == str + len && (*p == '+' || *p == '-') && p[3] == ':' &&
+	           dec_decode(p + 1, 2, &off_hour) && dec_decode(p + 4, 2, &off_min)) {
+		off_sign = (*p == '-' ? -1 : 1);
+		
+	} else {
+		return 0;
+	}
+	
+	// Check ranges - a leap second is allowed, and counted as the next second
+	if (month < 1 || month > 12) {
+		return 0;
+	}
+	
+	mdays = month_days[month - 1];
+	if (month == 2 && year % 4 == 0 && (year % 100 != 0 || year % 400 == 0)) {
+		mdays++;
+	}
+	
+	if (day < 1 || day > mdays || hour > 23 || min > 59 || sec > 60 ||
+	    off_hour > 23 || off_min > 59) {
+		return 0;
+	}
+	
+	// Days since the epoch, counting years from March so leap days come last
+	y    = (month <= 2 ? year - 1 : year);
+	era  = (y >= 0 ? y : y - 399) / 400;
+	yoe  = y - era * 400;
+	doy  = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	secs = era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+	
+	secs = secs * 86400 + hour * 3600 + min * 60 + sec - 
+	       off_sign * (off_hour * 3600 + off_min * 60);
+	
+	// Make sure the time fits in time_t
+	if ((long long) (time_t) secs != secs) {
+		return 0;
+	}
+	
+	ts->tv_sec  = (time_t) secs;
+	ts->tv_nsec = nsec;
+	return 1;
+}
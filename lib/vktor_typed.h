@@ -0,0 +1,98 @@
+/* 
+ * vktor JSON pull-parser library
+ * 
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE. 
+ */
+
+/**
+ * @file vktor_typed.h
+ * 
+ * vktor typed string header file - functions for decoding timestamps, UUIDs 
+ * and hexadecimal numbers from string values
+ * 
+ * @internal
+ */
+
+#ifndef _VKTOR_TYPED_H
+
+struct timespec;
+
+/**
+ * @ingroup internal
+ * @{
+ */
+
+/**
+ * @brief Decode a hexadecimal number
+ * 
+ * Decode 1 to 16 hexadecimal digits, in either lower or upper case, into an
+ * unsigned 64 bit number. No prefix, sign or whitespace is allowed.
+ * 
+ * @param [in]  str input string, not necessarily NULL terminated
+ * @param [in]  len input string length
+ * @param [out] val decoded number
+ * 
+ * @return 1 if the string was decoded, 0 if it is not a valid number
+ */
+VKTOR_INTERNAL int
+vktor_typed_hex(const char *str, long len, unsigned long long *val);
+
+/**
+ * @brief Decode a UUID
+ * 
+ * Decode a UUID in its canonical 36 character form (8-4-4-4-12 hexadecimal 
+ * digits separated by hyphens) or as 32 hexadecimal digits into its 16 bytes,
+ * in the order in which they are written.
+ * 
+ * @param [in]  str  input string, not necessarily NULL terminated
+ * @param [in]  len  input string length
+ * @param [out] uuid 16 byte output buffer
+ * 
+ * @return 1 if the string was decoded, 0 if it is not a valid UUID
+ */
+VKTOR_INTERNAL int
+vktor_typed_uuid(const char *str, long len, unsigned char *uuid);
+
+/**
+ * @brief Decode an ISO-8601 timestamp
+ * 
+ * Decode a complete RFC 3339 (ISO-8601) timestamp with an optional fraction 
+ * of a second and a mandatory time zone offset, such as 
+ * "2009-05-21T14:03:59.123Z" or "2009-05-21 16:03:59+02:00", into the number
+ * of seconds and nanoseconds since the Unix epoch. Does not depend on the 
+ * locale or the local time zone. 
+ * 
+ * @param [in]  str input string, not necessarily NULL terminated
+ * @param [in]  len input string length
+ * @param [out] ts  decoded time
+ * 
+ * @return 1 if the string was decoded, 0 if it is not a valid timestamp
+ */
+VKTOR_INTERNAL int
+vktor_typed_timestamp(const char *str, long len, struct timespec *ts);
+
+/** @} */ // end of internal API
+
+#define _VKTOR_TYPED_H
+#endif /* VKTOR_TYPED_H */
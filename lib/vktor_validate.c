@@ -0,0 +1,577 @@
+/* 
+ * vktor JSON pull-parser library
+ * 
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE. 
+ */
+
+/**
+ * @file vktor_validate.c
+ * 
+ * vktor validation - validates a JSON document without producing tokens,
+ * for vktor_validate()
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <assert.h>
+
+#include "vktor.h"
+#include "vktor_internal.h"
+
+/**
+ * Each byte of a 64 bit word set to b, and checks if any byte of word w is 
+ * below b (which must be at most 0x80) or equal to b
+ */
+#define word_repeat(b)       (0x0101010101010101ULL * (b))
+#define word_has_less(w, b)  (((w) - word_repeat(b)) & ~(w) & word_repeat(0x80))
+#define word_has_byte(w, b)  word_has_less((w) ^ word_repeat(b), 1)
+
+/**
+ * @ingroup internal
+ * @{
+ */
+
+/**
+ * Literals read by vktor_validate(), indexed by the parser's unicode_c 
+ */
+static const char *valid_literals[] = {"true", "false", "null"};
+
+/**
+ * @brief Skip plain characters inside a string being validated
+ * 
+ * Skip characters which need no checking inside a string: anything but a 
+ * double quote, a backslash or a control character, and unless UTF-8 is 
+ * validated, any non-ASCII character too. Eight characters are checked at a
+ * time. 
+ * 
+ * @param [in] p          Position in the input
+ * @param [in] end        End of the input range
+ * @param [in] check_utf8 Whether non-ASCII characters need checking
+ * 
+ * @return Position of the first character which needs checking, or end
+ */
+static char *
+valid_string_span(char *p, char *end, int check_utf8)
+{
+	unsigned long long w, high = (check_utf8 ? word_repeat(0x80) : 0);
+	unsigned char      c;
+	
+	while (end - p >= 8) {
+		memcpy(&w, p, sizeof(w));
+		if (word_has_byte(w, '"') | word_has_byte(w, '\\') | 
+		    word_has_less(w, 0x20) | (w & high)) {
+			break;
+		}
+		p += 8;
+	}
+	
+	for (; p < end; p++) {
+		c = (unsigned char) *p;
+		if (c == '"' || c == '\\' || c < 0x20 || (c & 0x80 && check_utf8)) {
+			break;
+		}
+	}
+	
+	return p;
+}
+
+/**
+ * @brief Validate a range of input
+ * 
+ * Check the input against the JSON grammar without creating any tokens. The
+ * nesting stack and the expected token map are used the same way 
+ * vktor_parse() uses them, while the state inside strings, numbers and 
+ * literals is kept in the parser's validation state, so validation can 
+ * continue on the next range of input. 
+ * 
+ * Used by vktor_validate() on each input buffer, or on complete input.
+ * 
+ * @param [in,out] parser Parser object
+ * @param [in,out] pos    Position in the input, advanced as it is read
+ * @param [in]     end    End of the input range
+ * @param [out]    error  Error object pointer pointer or NULL
+ * 
+ * @return Status code: VKTOR_MORE_DATA at the end of the range or 
+ *   VKTOR_ERROR
+ */
+static vktor_status
+parser_validate(vktor_parser *parser, char **pos, char *end, 
+                vktor_error **error)
+{
+	vktor_validator *valid = parser->valid;
+	char            *p;
+	unsigned char    c;
+	int              state = valid->state, digit;
+	
+	for (p = *pos; p < end; ) {
+		c = (unsigned char) *p;
+		
+		switch (state) {
+			case VKTOR_VALID_VALUE:
+				switch (c) {
+					case ' ':
+					case '\n':
+					case '\r':
+					case '\t':
+						// Whitespace
+						break;
+						
+					case '{':
+						if (! (parser->expected & VKTOR_T_OBJECT_START)) {
+							goto invalid;
+						}
+						if (vktor_nest_stack_add(parser, VKTOR_STRUCT_OBJECT, error) == VKTOR_ERROR) {
+							goto failed;
+						}
+						parser->expected = VKTOR_T_OBJECT_KEY | VKTOR_T_OBJECT_END;
+						break;
+						
+					case '[':
+						if (! (parser->expected & VKTOR_T_ARRAY_START)) {
+							goto invalid;
+						}
+						if (vktor_nest_stack_add(parser, VKTOR_STRUCT_ARRAY, error) == VKTOR_ERROR) {
+							goto failed;
+						}
+						parser->expected = (VKTOR_VALUE_TOKEN) | VKTOR_T_ARRAY_END;
+						break;
+						
+					case '}':
+					case ']':
+						if (! (parser->expected & (c == '}' ? VKTOR_T_OBJECT_END : 
+						                                      VKTOR_T_ARRAY_END) && 
+						       nest_stack_in(parser, (c == '}' ? VKTOR_STRUCT_OBJECT : 
+						                                         VKTOR_STRUCT_ARRAY)))) {
+							goto invalid;
+						}
+						if (vktor_nest_stack_pop(parser, error) == VKTOR_ERROR) {
+							goto failed;
+						}
+						p++;
+						goto value_end;
+						
+					case ',':
+						if (! (parser->expected & VKTOR_C_COMMA)) {
+							goto invalid;
+						}
+						parser->expected = (nest_stack_in(parser, VKTOR_STRUCT_OBJECT) ?
+							VKTOR_T_OBJECT_KEY : (VKTOR_VALUE_TOKEN));
+						break;
+						
+					case ':':
+						if (! (parser->expected & VKTOR_C_COLON)) {
+							goto invalid;
+						}
+						parser->expected = VKTOR_VALUE_TOKEN;
+						break;
+						
+					case '"':
+						if (! (parser->expected & (VKTOR_T_STRING | VKTOR_T_OBJECT_KEY))) {
+							goto invalid;
+						}
+						state = VKTOR_VALID_STRING;
+						break;
+						
+					case 't':
+					case 'f':
+					case 'n':
+						if (! (parser->expected & VKTOR_T_NULL)) {
+							goto invalid;
+						}
+						parser->unicode_c   = (c == 't' ? 0 : (c == 'f' ? 1 : 2));
+						valid->count = 1;
+						state = VKTOR_VALID_LITERAL;
+						break;
+						
+					case '-':
+					case '0':
+					case '1':
+					case '2':
+					case '3':
+					case '4':
+					case '5':
+					case '6':
+					case '7':
+					case '8':
+					case '9':
+						if (! (parser->expected & VKTOR_T_INT)) {
+							goto invalid;
+						}
+						state = (c == '-' ? VKTOR_VALID_MINUS : 
+						        (c == '0' ? VKTOR_VALID_ZERO : VKTOR_VALID_INT));
+						break;
+						
+					default:
+						goto invalid;
+				}
+				break;
+				
+			case VKTOR_VALID_STRING:
+				p = valid_string_span(p, end, valid->utf8);
+				if (p == end) {
+					continue;
+				}
+				c = (unsigned char) *p;
+				
+				if (c == '"') {
+					if (parser->expected & VKTOR_T_OBJECT_KEY) {
+						parser->expected = VKTOR_C_COLON;
+						state = VKTOR_VALID_VALUE;
+						break;
+					}
+					p++;
+					goto value_end;
+					
+				} else if (c == '\\') {
+					state = VKTOR_VALID_ESCAPED;
+					
+				} else if (c < 0x20) {
+					goto invalid;
+					
+				} else {
+					// The first byte of a UTF-8 character sets the number of 
+					// bytes which follow, and the range of the second one 
+					if (c >= 0xc2 && c <= 0xdf) {
+						valid->count = 1;
+						parser->unicode_c   = 0x80bf;
+					} else if (c >= 0xe0 && c <= 0xef) {
+						valid->count = 2;
+						parser->unicode_c   = (c == 0xe0 ? 0xa0bf : 
+						                      (c == 0xed ? 0x809f : 0x80bf));
+					} else if (c >= 0xf0 && c <= 0xf4) {
+						valid->count = 3;
+						parser->unicode_c   = (c == 0xf0 ? 0x90bf : 
+						                      (c == 0xf4 ? 0x808f : 0x80bf));
+					} else {
+						goto invalid;
+					}
+					state = VKTOR_VALID_UTF8;
+				}
+				break;
+				
+			case VKTOR_VALID_UTF8:
+				if (c < (parser->unicode_c >> 8) || c > (parser->unicode_c & 0xff)) {
+					goto invalid;
+				}
+				parser->unicode_c = 0x80bf;
+				if (--valid->count == 0) {
+					state = VKTOR_VALID_STRING;
+				}
+				break;
+				
+			case VKTOR_VALID_ESCAPED:
+				switch (c) {
+					case '"':
+					case '\\':
+					case '/':
+					case 'b':
+					case 'f':
+					case 'n':
+					case 'r':
+					case 't':
+						state = VKTOR_VALID_STRING;
+						break;
+						
+					case 'u':
+						parser->unicode_c   = 0;
+						valid->count = 0;
+						state = VKTOR_VALID_UNICODE;
+						break;
+						
+					default:
+						goto invalid;
+				}
+				break;
+				
+			case VKTOR_VALID_UNICODE:
+			case VKTOR_VALID_LOW:
+				if (c >= '0' && c <= '9') {
+					digit = c - '0';
+				} else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+					digit = (c | 0x20) - 'a' + 10;
+				} else {
+					goto invalid;
+				}
+				
+				parser->unicode_c = (parser->unicode_c << 4) | digit;
+				if (++valid->count < 4) {
+					break;
+				}
+				
+				// High surrogates must be followed by a low surrogate, which 
+				// can't appear on its own
+				if (state == VKTOR_VALID_LOW) {
+					if (parser->unicode_c < 0xdc00 || parser->unicode_c > 0xdfff) {
+						goto invalid;
+					}
+					state = VKTOR_VALID_STRING;
+				} else if (parser->unicode_c >= 0xd800 && parser->unicode_c <= 0xdbff) {
+					state = VKTOR_VALID_LOW_ESCAPED;
+				} else if (parser->unicode_c >= 0xdc00 && parser->unicode_c <= 0xdfff) {
+					goto invalid;
+				} else {
+					state = VKTOR_VALID_STRING;
+				}
+				break;
+				
+			case VKTOR_VALID_LOW_ESCAPED:
+				if (c != '\\') {
+					goto invalid;
+				}
+				state = VKTOR_VALID_LOW_U;
+				break;
+				
+			case VKTOR_VALID_LOW_U:
+				if (c != 'u') {
+					goto invalid;
+				}
+				parser->unicode_c   = 0;
+				valid->count = 0;
+				state = VKTOR_VALID_LOW;
+				break;
+				
+			case VKTOR_VALID_MINUS:
+				if (c < '0' || c > '9') {
+					goto invalid;
+				}
+				state = (c == '0' ? VKTOR_VALID_ZERO : VKTOR_VALID_INT);
+				break;
+				
+			case VKTOR_VALID_ZERO:
+			case VKTOR_VALID_INT:
+			case VKTOR_VALID_FRAC:
+				if (c >= '0' && c <= '9') {
+					// Leading zeros are not allowed
+					if (state == VKTOR_VALID_ZERO) {
+						goto invalid;
+					}
+				} else if (c == '.' && state != VKTOR_VALID_FRAC) {
+					state = VKTOR_VALID_DOT;
+				} else if (c == 'e' || c == 'E') {
+					state = VKTOR_VALID_EXP;
+				} else {
+					goto value_end;
+				}
+				break;
+				
+			case VKTOR_VALID_DOT:
+				if (c < '0' || c > '9') {
+					goto invalid;
+				}
+				state = VKTOR_VALID_FRAC;
+				break;
+				
+			case VKTOR_VALID_EXP:
+				if (c == '+' || c == '-') {
+					state = VKTOR_VALID_EXP_SIGN;
+					break;
+				}
+				/* fall through */
+				
+			case VKTOR_VALID_EXP_SIGN:
+				if (c < '0' || c > '9') {
+					goto invalid;
+				}
+				state = VKTOR_VALID_EXP_DIGITS;
+				break;
+				
+			case VKTOR_VALID_EXP_DIGITS:
+				if (c < '0' || c > '9') {
+					goto value_end;
+				}
+				break;
+				
+			case VKTOR_VALID_END:
+				if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+					goto invalid;
+				}
+				break;
+				
+			case VKTOR_VALID_LITERAL:
+				if (c != valid_literals[parser->unicode_c][valid->count]) {
+					goto invalid;
+				}
+				if (valid_literals[parser->unicode_c][++valid->count] == '\0') {
+					p++;
+					goto value_end;
+				}
+				break;
+		}
+		
+		p++;
+		continue;
+		
+	value_end:
+		// A value has ended, and only whitespace may follow the root value.
+		// After a number, the current character is read again.
+		state = (parser->nest_ptr == 0 ? VKTOR_VALID_END : VKTOR_VALID_VALUE);
+		expect_next_value_token(parser);
+	}
+	
+	*pos = p;
+	valid->state = state;
+	return VKTOR_MORE_DATA;
+	
+invalid:
+	set_error_unexpected_c(error, *p);
+	
+failed:
+	*pos = p;
+	valid->state = state;
+	return VKTOR_ERROR;
+}
+
+/** @} */ // end of internal API
+
+/**
+ * @ingroup external
+ * @{
+ */
+
+/**
+ * @brief Validate the rest of the document
+ * 
+ * Check the rest of the document against the JSON grammar without reading 
+ * it into tokens. Nesting, separators, numbers, literals and string escapes
+ * are checked, and if check_utf8 is set strings must be valid UTF-8 too. No 
+ * memory is allocated for token values, and runs of plain string characters
+ * are checked a word at a time.
+ * 
+ * @param [in,out] parser     Parser object
+ * @param [in]     check_utf8 Whether to validate UTF-8 in strings
+ * @param [out]    error      Error object pointer pointer or NULL
+ * 
+ * @return status code:
+ *  - VKTOR_COMPLETE  if the document is valid
+ *  - VKTOR_ERROR     if the document is invalid or an error has occured
+ *  - VKTOR_MORE_DATA if we need more data in order to continue validating
+ */
+vktor_status
+vktor_validate(vktor_parser *parser, int check_utf8, vktor_error **error)
+{
+	vktor_status  status;
+	char         *pos, *start;
+	
+	assert(parser != NULL);
+	
+	if (! valid_active(parser)) {
+		if (parser->token_resume || base64_active(parser) || 
+		    skip_active(parser)) {
+			vktor_set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+				"a token is partially read, use vktor_parse()");
+			return VKTOR_ERROR;
+		}
+		
+		if (parser->hash != NULL) {
+			vktor_set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+				"can't validate while subtree hashing is enabled");
+			return VKTOR_ERROR;
+		}
+		
+		if (parser->schema != NULL) {
+			vktor_set_error(parser, error, VKTOR_ERR_INVALID_STATE, 
+				"can't validate while a schema is enabled, use vktor_parse()");
+			return VKTOR_ERROR;
+		}
+		
+		if (parser->valid == NULL) {
+			parser->valid = vktor_parser_alloc_state(parser, sizeof(vktor_validator),
+				error);
+			if (parser->valid == NULL) {
+				return VKTOR_ERROR;
+			}
+		}
+		
+		if (parser->complete_text != NULL) {
+			// Token values point to the reused token memory and are never freed
+			parser->token_value = NULL;
+		}
+		
+		// The root value may have been read already
+		if (parser->nest_ptr == 0 && parser->expected == VKTOR_T_NONE) {
+			parser->valid->state = VKTOR_VALID_END;
+		} else {
+			parser->valid->state = VKTOR_VALID_VALUE;
+		}
+		
+		vktor_parser_set_token(parser, VKTOR_T_NONE, NULL);
+	}
+	
+	parser->valid->utf8 = (check_utf8 != 0);
+	
+	if (parser->complete_text != NULL) {
+		pos = parser->complete_ptr;
+		status = parser_validate(parser, &pos, parser->complete_end, error);
+		
+		// A root number may end with the input
+		if (status == VKTOR_MORE_DATA && parser->nest_ptr == 0 && 
+		    (parser->valid->state == VKTOR_VALID_ZERO || 
+		     parser->valid->state == VKTOR_VALID_INT || 
+		     parser->valid->state == VKTOR_VALID_FRAC || 
+		     parser->valid->state == VKTOR_VALID_EXP_DIGITS)) {
+			parser->valid->state = VKTOR_VALID_END;
+			parser->expected     = VKTOR_T_NONE;
+		}
+		
+		if (status == VKTOR_MORE_DATA && 
+		    parser->valid->state != VKTOR_VALID_END) {
+			complete_error_incomplete(parser, pos);
+		}
+		
+		vktor_complete_set_position(parser, pos);
+		
+	} else {
+		status = VKTOR_MORE_DATA;
+		while (parser->buffer != NULL) {
+			start = pos = parser->buffer->text + parser->buffer->ptr;
+			status = parser_validate(parser, &pos, 
+				parser->buffer->text + parser->buffer->size, error);
+			
+			parser->buffer->ptr += pos - start;
+#ifdef BYTECOUNTER
+			parser->bytecounter += pos - start;
+#endif
+			
+			if (status != VKTOR_MORE_DATA) {
+				break;
+			}
+			
+			vktor_parser_advance_buffer(parser);
+		}
+	}
+	
+	// Like with vktor_parse(), the document is complete once all input after
+	// the root value was read
+	if (status == VKTOR_MORE_DATA && parser->valid->state == VKTOR_VALID_END) {
+		parser->valid->state = VKTOR_VALID_NONE;
+		status = VKTOR_COMPLETE;
+	}
+	
+	return status;
+}
+
+/** @} */ // end of external API
@@ -0,0 +1,252 @@
+/*
+ * vktor JSON pull-parser library
+ *
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file vktor-columns.c
+ *
+ * Reads a JSON array of objects into batches of columns, used here for
+ * testing vktor_columns_read().
+ *
+ *   vktor-columns [-b size] [-n rows] column[,column...]
+ *
+ * Each column is given as a path and a type, such as "user.score:double".
+ * The type is one of int64, double, bool and string. The stream is read from
+ * standard input in chunks of the size given by -b (64 bytes by default), and
+ * the root array is read in batches of up to the number of rows given by -n
+ * (2 by default). Each batch is written out column by column, with ~ for
+ * missing values.
+ *
+ * The return code of the program is 0 if all is ok, or the VKTOR_ERR code of
+ * a parser error. 255 is returned in case of an error unrelated to the parser.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vktor.h>
+
+#define DEFAULT_BUFFSIZE 64
+#define DEFAULT_ROWS     2
+#define MAXDEPTH         128
+#define MAX_COLUMNS      16
+
+/* Initialize a columnar reader from a list of columns such as "id:int64" */
+static vktor_columns *
+init_columns(char *list, long batch_rows)
+{
+	vktor_column_spec  spec[MAX_COLUMNS];
+	int                count = 0;
+	char              *path, *type;
+
+	for (path = strtok(list, ","); path != NULL && count < MAX_COLUMNS;
+	     path = strtok(NULL, ",")) {
+		if ((type = strchr(path, ':')) == NULL) {
+			return NULL;
+		}
+		*type++ = '\0';
+
+		spec[count].path = path;
+		if (strcmp(type, "int64") == 0) {
+			spec[count].type = VKTOR_COL_INT64;
+		} else if (strcmp(type, "double") == 0) {
+			spec[count].type = VKTOR_COL_DOUBLE;
+		} else if (strcmp(type, "bool") == 0) {
+			spec[count].type = VKTOR_COL_BOOL;
+		} else if (strcmp(type, "string") == 0) {
+			spec[count].type = VKTOR_COL_STRING;
+		} else {
+			return NULL;
+		}
+		count++;
+	}
+
+	return vktor_columns_init(spec, count, batch_rows, NULL);
+}
+
+/* Write out a batch of rows, column by column */
+static void
+print_batch(vktor_batch *batch)
+{
+	vktor_column *col;
+	long          row;
+	int           i;
+
+	if (batch->rows == 0) {
+		return;
+	}
+
+	printf("BATCH %ld rows\n", batch->rows);
+
+	for (i = 0; i < batch->num_columns; i++) {
+		col = &batch->columns[i];
+		printf("  %s:", col->path);
+
+		for (row = 0; row < batch->rows; row++) {
+			printf(row == 0 ? " " : ", ");
+			if (! (col->valid[row / 8] & (1 << (row % 8)))) {
+				printf("~");
+				continue;
+			}
+
+			switch (col->type) {
+				case VKTOR_COL_INT64:
+					printf("%lld", ((long long *) col->values)[row]);
+					break;
+
+				case VKTOR_COL_DOUBLE:
+					printf("%.5f", ((double *) col->values)[row]);
+					break;
+
+				case VKTOR_COL_BOOL:
+					printf(((char *) col->values)[row] ? "true" : "false");
+					break;
+
+				case VKTOR_COL_STRING:
+					printf("\"");
+					fwrite(col->data + col->offsets[row], sizeof(char),
+						col->offsets[row + 1] - col->offsets[row], stdout);
+					printf("\"");
+					break;
+			}
+		}
+		printf("\n");
+	}
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-b size] [-n rows] column[,column...]\n",
+		prog);
+	exit(255);
+}
+
+int
+main(int argc, char *argv[])
+{
+	vktor_parser   *parser;
+	vktor_columns  *columns;
+	vktor_batch    *batch;
+	vktor_status    status;
+	vktor_error    *error = NULL;
+	char           *buffer;
+	size_t          read_bytes;
+	long            rows = DEFAULT_ROWS;
+	int             opt, done = 0, ret = 0, in_columns = 0;
+	int             buffsize = DEFAULT_BUFFSIZE;
+
+	while ((opt = getopt(argc, argv, "b:n:")) != -1) {
+		switch (opt) {
+			case 'b':
+				buffsize = atoi(optarg);
+				break;
+			case 'n':
+				rows = atol(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (buffsize < 1 || rows < 1 || optind != argc - 1) {
+		usage(argv[0]);
+	}
+
+	if ((columns = init_columns(argv[optind], rows)) == NULL) {
+		fprintf(stderr, "Error: invalid columns\n");
+		return 255;
+	}
+
+	parser = vktor_parser_init(MAXDEPTH);
+
+	do {
+		if (in_columns) {
+			status = vktor_columns_read(columns, parser, &batch, &error);
+		} else {
+			status = vktor_parse(parser, &error);
+		}
+
+		switch (status) {
+
+			case VKTOR_OK:
+				if (in_columns) {
+					print_batch(batch);
+					in_columns = ! batch->last;
+
+				} else if (vktor_get_token_type(parser) == VKTOR_T_ARRAY_START &&
+				           vktor_get_depth(parser) == 1) {
+					// Read the rows of the root array in batches
+					in_columns = 1;
+
+				} else {
+					fprintf(stderr, "Error: root value is not an array\n");
+					ret = 255;
+					done = 1;
+				}
+				break;
+
+			case VKTOR_MORE_DATA:
+				// We need to read more data
+				buffer = malloc(sizeof(char) * buffsize);
+				read_bytes = fread(buffer, sizeof(char), buffsize, stdin);
+
+				if (read_bytes) {
+					vktor_feed(parser, buffer, read_bytes, 1, &error);
+
+				} else {
+					// Nothing left to read
+					free(buffer);
+					fprintf(stderr, "Error: premature end of stream\n");
+					ret = 255;
+					done = 1;
+				}
+				break;
+
+			case VKTOR_COMPLETE:
+				done = 1;
+				break;
+
+			case VKTOR_ERROR:
+				fprintf(stderr, "Parser error [%d]: %s\n", error->code,
+					error->message);
+				ret = error->code;
+				done = 1;
+				break;
+		}
+
+	} while (! done);
+
+	if (error != NULL) {
+		vktor_error_free(error);
+	}
+
+	vktor_parser_free(parser);
+	vktor_columns_free(columns);
+
+	return ret;
+}
@@ -0,0 +1,173 @@
+/* 
+ * vktor JSON pull-parser library
+ * 
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE. 
+ */
+
+/**
+ * @file vktor-decode.c
+ * 
+ * Decodes a JSON document into a struct using a decoder generated by 
+ * vktor-bindgen from bindgen-sample.json, used here for testing purposes.
+ * 
+ * This program reads a JSON document from standard input, decodes it using 
+ * sample_decode() and writes the decoded members back to standard output.
+ * 
+ * If the ARENA_SIZE environment variable is set, it defines the size of the
+ * arena decoded strings are copied into (the default is 4096 bytes). If 
+ * STRING_CHUNK is set, the document is fed using vktor_feed() and long 
+ * strings are read in parts of that size (see vktor_set_string_chunk()). 
+ * Otherwise it is fed as complete input using vktor_feed_complete().
+ * 
+ * The return code of the program is 0 if the document was decoded, or the 
+ * VKTOR_ERR code of the error otherwise. 255 is retuned in case of an error 
+ * unrelated to the decoder.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vktor.h>
+#include "vktor-print.h"
+
+#include "bindgen-sample.h"
+
+#define DEFAULT_ARENA_SIZE 4096
+#define MAXDEPTH           32
+
+/* Write a decoded string, which may contain NUL characters */
+static void
+print_string(const char *str, size_t len)
+{
+	putchar('"');
+	fwrite(str, sizeof(char), len, stdout);
+	putchar('"');
+}
+
+static void
+print_sample(sample *record)
+{
+	long i;
+	
+	if (record->present & SAMPLE_HAS_ID) {
+		printf("id: %ld\n", record->id);
+	}
+	if (record->present & SAMPLE_HAS_NAME) {
+		printf("name: ");
+		print_string(record->name, record->name_len);
+		printf("\n");
+	}
+	if (record->present & SAMPLE_HAS_SCORE) {
+		printf("score: %g\n", record->score);
+	}
+	if (record->present & SAMPLE_HAS_ACTIVE) {
+		printf("active: %s\n", (record->active ? "true" : "false"));
+	}
+	if (record->present & SAMPLE_HAS_TAGS) {
+		printf("tags: \n");
+		for (i = 0; i < record->tags_count; i++) {
+			printf("  - ");
+			print_string(record->tags[i], record->tags_len[i]);
+			printf("\n");
+		}
+	}
+	if (record->present & SAMPLE_HAS_ADDRESS) {
+		printf("address: \n");
+		if (record->address.present & SAMPLE_ADDRESS_HAS_CITY) {
+			printf("  city: ");
+			print_string(record->address.city, record->address.city_len);
+			printf("\n");
+		}
+		if (record->address.present & SAMPLE_ADDRESS_HAS_ZIP) {
+			printf("  zip: %ld\n", record->address.zip);
+		}
+	}
+	if (record->present & SAMPLE_HAS_POINTS) {
+		printf("points: \n");
+		for (i = 0; i < record->points_count; i++) {
+			printf("  - ");
+			if (record->points[i].present & SAMPLE_POINTS_HAS_X) {
+				printf("x: %g ", record->points[i].x);
+			}
+			if (record->points[i].present & SAMPLE_POINTS_HAS_Y) {
+				printf("y: %g", record->points[i].y);
+			}
+			printf("\n");
+		}
+	}
+}
+
+int 
+main(void) 
+{
+	vktor_parser *parser;
+	vktor_error  *error = NULL;
+	sample_arena  arena;
+	sample        record;
+	char         *text, *envvar;
+	long          len, chunk = 0;
+	int           ret = 0;
+	
+	arena.size = DEFAULT_ARENA_SIZE;
+	arena.used = 0;
+	
+	/* Set arena size from environment, if set */
+	if ((envvar = getenv("ARENA_SIZE")) != NULL) {
+		arena.size = atoi(envvar);
+	}
+	
+	/* Set string chunk size from environment, if set */
+	if ((envvar = getenv("STRING_CHUNK")) != NULL) {
+		chunk = atol(envvar);
+	}
+	
+	text = read_file(stdin, &len);
+	
+	if ((arena.data = malloc(arena.size)) == NULL) {
+		fprintf(stderr, "Unable to allocate the arena\n");
+		free(text);
+		return 255;
+	}
+	
+	parser = vktor_parser_init(MAXDEPTH);
+	if (chunk > 0) {
+		vktor_set_string_chunk(parser, chunk);
+		vktor_feed(parser, text, len, 1, NULL);
+	} else {
+		vktor_feed_complete(parser, text, len, 1, NULL);
+	}
+	
+	if (sample_decode(parser, &arena, &record, &error) == VKTOR_OK) {
+		print_sample(&record);
+	} else {
+		fprintf(stderr, "Decode error [%d]: %s\n", error->code, 
+			error->message);
+		ret = error->code;
+		vktor_error_free(error);
+	}
+	
+	vktor_parser_free(parser);
+	free(arena.data);
+	
+	return ret;
+}
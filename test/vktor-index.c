@@ -0,0 +1,212 @@
+/*
+ * vktor JSON pull-parser library
+ *
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file vktor-index.c
+ *
+ * Builds an offset index of a JSON stream and starts parsing it at one of the
+ * members of its root value, used here for testing vktor_index_build(),
+ * vktor_index_serialize(), vktor_index_load() and vktor_parser_seek().
+ *
+ *   vktor-index [-b size] member
+ *
+ * The stream is read from standard input into memory, and indexed by a parser
+ * fed in chunks of the size given by -b (64 bytes by default). The index is
+ * saved and loaded again, and the number of members and the size of the saved
+ * index are written out. Another parser then seeks to the given member, and
+ * is fed the input from that member on. Its tokens are written out one per
+ * line.
+ *
+ * The return code of the program is 0 if all is ok, or the VKTOR_ERR code of
+ * a parser error. 255 is returned in case of an error unrelated to the parser.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vktor.h>
+#include "vktor-print.h"
+
+#define DEFAULT_BUFFSIZE 64
+#define MAXDEPTH         128
+
+/*
+ * Build an offset index of the input using a parser fed in chunks, and round
+ * trip it through its saved form
+ */
+static vktor_index *
+build_index(char *text, long len, int buffsize, vktor_error **error)
+{
+	vktor_parser   *parser;
+	vktor_index    *index;
+	vktor_status    status;
+	unsigned char  *saved;
+	long            size, fed = 0;
+
+	parser = vktor_parser_init(MAXDEPTH);
+	index = vktor_index_init(NULL);
+
+	while ((status = vktor_index_build(index, parser, error)) ==
+	       VKTOR_MORE_DATA && fed < len) {
+		size = (len - fed < buffsize ? len - fed : buffsize);
+		vktor_feed(parser, text + fed, size, 0, error);
+		fed += size;
+	}
+
+	vktor_parser_free(parser);
+
+	if (status != VKTOR_OK) {
+		if (status == VKTOR_MORE_DATA) {
+			fprintf(stderr, "Error: premature end of stream\n");
+		}
+		vktor_index_free(index);
+		return NULL;
+	}
+
+	// Save the index and load it again
+	size = vktor_index_serialize(index, NULL, 0);
+	saved = malloc(size);
+	vktor_index_serialize(index, saved, size);
+	vktor_index_free(index);
+
+	index = vktor_index_load(saved, size, NULL);
+	free(saved);
+
+	if (index == NULL) {
+		fprintf(stderr, "Error: saved index could not be loaded\n");
+		return NULL;
+	}
+
+	printf("# index: %ld members, %ld bytes\n", vktor_index_count(index), size);
+	return index;
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-b size] member\n", prog);
+	exit(255);
+}
+
+int
+main(int argc, char *argv[])
+{
+	vktor_parser  *parser;
+	vktor_index   *index;
+	vktor_status   status;
+	vktor_error   *error = NULL;
+	char          *text;
+	long           len, member, fed, size;
+	int            opt, done = 0, ret = 0;
+	int            buffsize = DEFAULT_BUFFSIZE;
+
+	while ((opt = getopt(argc, argv, "b:")) != -1) {
+		switch (opt) {
+			case 'b':
+				buffsize = atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (buffsize < 1 || optind != argc - 1) {
+		usage(argv[0]);
+	}
+
+	member = atol(argv[optind]);
+	text = read_file(stdin, &len);
+
+	if ((index = build_index(text, len, buffsize, &error)) == NULL) {
+		if (error != NULL) {
+			fprintf(stderr, "Index error [%d]: %s\n", error->code,
+				error->message);
+			ret = error->code;
+			vktor_error_free(error);
+		} else {
+			ret = 255;
+		}
+		free(text);
+		return ret;
+	}
+
+	parser = vktor_parser_init(MAXDEPTH);
+
+	if (vktor_parser_seek(parser, index, member, &error) != VKTOR_OK) {
+		fprintf(stderr, "Seek error [%d]: %s\n", error->code, error->message);
+		ret = error->code;
+		done = 1;
+	}
+
+	fed = vktor_index_offset(index, member);
+
+	while (! done) {
+		status = vktor_parse(parser, &error);
+
+		switch (status) {
+
+			case VKTOR_OK:
+				print_token(parser);
+				break;
+
+			case VKTOR_MORE_DATA:
+				// Feed the next chunk of input after the member
+				if (fed < len) {
+					size = (len - fed < buffsize ? len - fed : buffsize);
+					vktor_feed(parser, text + fed, size, 0, &error);
+					fed += size;
+
+				} else {
+					fprintf(stderr, "Error: premature end of stream\n");
+					ret = 255;
+					done = 1;
+				}
+				break;
+
+			case VKTOR_COMPLETE:
+				done = 1;
+				break;
+
+			case VKTOR_ERROR:
+				fprintf(stderr, "Parser error [%d]: %s\n", error->code,
+					error->message);
+				ret = error->code;
+				done = 1;
+				break;
+		}
+	}
+
+	if (error != NULL) {
+		vktor_error_free(error);
+	}
+
+	vktor_parser_free(parser);
+	vktor_index_free(index);
+	free(text);
+
+	return ret;
+}
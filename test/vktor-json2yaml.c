@@ -38,6 +38,14 @@
  * for reading from STDIN (the default value is 64 bytes - this is very small
  * but is intentional for testing purposes)
  * 
+ * If a file name is passed as the first argument, the program runs in high
+ * throughput mode: a regular file is mapped into memory and fed to the parser
+ * as complete input using vktor_feed_complete(), and other files (pipes, 
+ * devices) are read in large chunks. "-" can be passed to read standard input
+ * in this mode. Output is always written in large blocks, and numbers are 
+ * formatted without going through printf() whenever the result is known to be
+ * identical.
+ * 
  * Please note that this tool is not meant to produce valid YAML output - 
  * the purpose is only to generate some consistent output which could be used
  * to test the JSON parser. This is not meant to be a good example of a YAML 
@@ -55,26 +63,144 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <vktor.h>
 
 #define DEFAULT_BUFFSIZE 64
+#define FILE_BUFFSIZE    (1024 * 1024)
+#define OUT_BUFFSIZE     (256 * 1024)
 #define INDENT_STR "  "
 
-#define print_indent(s) for (i = 0; i < indent; i++) { printf(s);	}
+#define print_indent(s) for (i = 0; i < indent; i++) { out_str(s); }
 
 #define print_array_indent_dash(s)    \
 	if (nest == VKTOR_STRUCT_ARRAY) { \
 		print_indent(s);              \
-		printf("- ");                 \
+		out_write("- ", 2);           \
 	}
 
 int indent  = 0;
 int is_root = 1;
 
+static char   out_buffer[OUT_BUFFSIZE];
+static size_t out_len = 0;
+
+/* Write out everything collected in the output buffer */
+static void
+out_flush(void)
+{
+	if (out_len > 0) {
+		fwrite(out_buffer, sizeof(char), out_len, stdout);
+		out_len = 0;
+	}
+}
+
+/* Append len bytes to the output buffer, flushing it when full */
+static void
+out_write(const char *str, size_t len)
+{
+	if (out_len + len > OUT_BUFFSIZE) {
+		out_flush();
+		if (len > OUT_BUFFSIZE) {
+			fwrite(str, sizeof(char), len, stdout);
+			return;
+		}
+	}
+	
+	memcpy(out_buffer + out_len, str, len);
+	out_len += len;
+}
+
+/* Append a NULL terminated string to the output buffer */
+static void
+out_str(const char *str)
+{
+	out_write(str, strlen(str));
+}
+
+/* Append a long integer followed by a line break, same as printf("%ld\n") */
+static void
+out_long_ln(long num)
+{
+	char           digits[24];
+	char          *p = digits + sizeof(digits);
+	unsigned long  u;
+	
+	*--p = '\n';
+	u = (num < 0 ? 0UL - (unsigned long) num : (unsigned long) num);
+	do {
+		*--p = '0' + (u % 10);
+		u /= 10;
+	} while (u > 0);
+	
+	if (num < 0) {
+		*--p = '-';
+	}
+	
+	out_write(p, digits + sizeof(digits) - p);
+}
+
+/* 
+ * Append a floating point number token followed by a line break, the same
+ * way printf("%.5f\n") would have printed it after strtod(). 
+ * 
+ * When the token has no exponent, at most 5 fractional digits and at most 10
+ * integer digits, the decimal value is closer to its nearest double than half
+ * a unit in the 5th decimal place, so the digits can be copied as they are. 
+ * Returns 0 if the token does not qualify and printf() should be used.
+ */
+static int
+out_float_str_ln(const char *str)
+{
+	char        digits[24];
+	const char *intp, *frac = NULL;
+	int         intlen = 0, fraclen = 0, len = 0;
+	
+	if (*str == '-') {
+		digits[len++] = '-';
+		str++;
+	} else if (*str == '+') {
+		str++;
+	}
+	
+	// Skip leading zeros, they do not change the value
+	while (*str == '0' && str[1] >= '0' && str[1] <= '9') str++;
+	
+	for (intp = str; *str >= '0' && *str <= '9'; str++) intlen++;
+	
+	if (*str == '.') {
+		for (frac = ++str; *str >= '0' && *str <= '9'; str++) fraclen++;
+	}
+	
+	if (*str != '\0' || intlen == 0 || intlen > 10 || fraclen > 5) {
+		return 0;
+	}
+	
+	memcpy(digits + len, intp, intlen);
+	len += intlen;
+	digits[len++] = '.';
+	if (fraclen > 0) {
+		memcpy(digits + len, frac, fraclen);
+		len += fraclen;
+	}
+	for (; fraclen < 5; fraclen++) {
+		digits[len++] = '0';
+	}
+	digits[len++] = '\n';
+	
+	out_write(digits, len);
+	return 1;
+}
+
 static int
 handle_token(vktor_parser *parser, vktor_struct nest, vktor_error **error)
 {
 	char   *str;
+	char    fmt[64];
 	long    num;
 	int     i;
 	double  dbl;
@@ -87,7 +213,7 @@ handle_token(vktor_parser *parser, vktor_struct nest, vktor_error **error)
 		case VKTOR_T_ARRAY_START:
 			if (! is_root) {
 				print_array_indent_dash(INDENT_STR);
-				printf("\n");
+				out_write("\n", 1);
 				indent++;
 			} else {
 				is_root = 0;
@@ -97,7 +223,7 @@ handle_token(vktor_parser *parser, vktor_struct nest, vktor_error **error)
 		case VKTOR_T_OBJECT_START:
 			if (! is_root) {
 				print_array_indent_dash(INDENT_STR);
-				printf("\n");
+				out_write("\n", 1);
 				indent++;
 			} else {
 				is_root = 0;
@@ -112,7 +238,9 @@ handle_token(vktor_parser *parser, vktor_struct nest, vktor_error **error)
 				return 0;
 			}
 			
-			printf("\"%s\": ", str);
+			out_write("\"", 1);
+			out_str(str);
+			out_write("\": ", 3);
 			break;
 		
 		case VKTOR_T_STRING:
@@ -122,7 +250,9 @@ handle_token(vktor_parser *parser, vktor_struct nest, vktor_error **error)
 				return 0;
 			}
 			
-			printf("\"%s\"\n", str);
+			out_write("\"", 1);
+			out_str(str);
+			out_write("\"\n", 2);
 			break;
 		
 		case VKTOR_T_INT:
@@ -135,7 +265,8 @@ handle_token(vktor_parser *parser, vktor_struct nest, vktor_error **error)
 					if (*error != NULL) {
 						return 0;
 					}
-					printf("%s ## AS STRING ##\n", str);
+					out_str(str);
+					out_str(" ## AS STRING ##\n");
 					break;
 				} else {
 					return 0;
@@ -143,28 +274,44 @@ handle_token(vktor_parser *parser, vktor_struct nest, vktor_error **error)
 			}
 			
 			print_array_indent_dash(INDENT_STR);
-			printf("%ld\n", num);
+			out_long_ln(num);
 			break;
 			
 		case VKTOR_T_FLOAT:
+			vktor_get_value_str(parser, &str, error);
+			if (*error != NULL) {
+				return 0;
+			}
+			
+			// Most floats can be copied as they are without printf()
+			print_array_indent_dash(INDENT_STR);
+			if (out_float_str_ln(str)) {
+				break;
+			}
+			
 			dbl = vktor_get_value_double(parser, error);
 			if (*error != NULL) {
 				if ((*error)->code == VKTOR_ERR_OUT_OF_RANGE) {
 					// Out of range, get value as string
-					print_array_indent_dash(INDENT_STR);
 					vktor_get_value_str(parser, &str, error);
 					if (*error != NULL) {
 						return 0;
 					}
-					printf("%s ## AS STRING ##\n", str);
+					out_str(str);
+					out_str(" ## AS STRING ##\n");
 					break;
 				} else {
 					return 0;
 				}
 			}
 			
-			print_array_indent_dash(INDENT_STR);
-			printf("%.5f\n", dbl);
+			if (snprintf(fmt, sizeof(fmt), "%.5f\n", dbl) < (int) sizeof(fmt)) {
+				out_str(fmt);
+			} else {
+				// Very large numbers don't fit, let printf() do it
+				out_flush();
+				printf("%.5f\n", dbl);
+			}
 			break;
 			
 		case VKTOR_T_ARRAY_END:
@@ -177,23 +324,24 @@ handle_token(vktor_parser *parser, vktor_struct nest, vktor_error **error)
 		
 		case VKTOR_T_NULL:
 			print_array_indent_dash(INDENT_STR);
-			printf("null\n");
+			out_write("null\n", 5);
 			break;
 		
 		case VKTOR_T_TRUE:
 			print_array_indent_dash(INDENT_STR);
-			printf("true\n");
+			out_write("true\n", 5);
 			break;
 		
 		case VKTOR_T_FALSE:
 			print_array_indent_dash(INDENT_STR);
-			printf("false\n");
+			out_write("false\n", 6);
 			break;
 			
 		default:  // not yet handled stuff
 			print_array_indent_dash(INDENT_STR);
-			printf("--- VKTOR UNHANDLED TOKEN: %d\n", 
+			snprintf(fmt, sizeof(fmt), "--- VKTOR UNHANDLED TOKEN: %d\n", 
 				vktor_get_token_type(parser));
+			out_str(fmt);
 			break;
 	}
 	
@@ -201,7 +349,7 @@ handle_token(vktor_parser *parser, vktor_struct nest, vktor_error **error)
 }
 
 int 
-main(int argc, char *argv[], char *envp[]) 
+main(int argc, char *argv[]) 
 {
 	vktor_parser    *parser;
 	vktor_status     status;
@@ -212,15 +360,47 @@ main(int argc, char *argv[], char *envp[])
 	int              done = 0, ret = 0;
 	char            *buffsize_c;
 	int              buffsize = DEFAULT_BUFFSIZE;
+	FILE            *infile = stdin;
+	struct stat      st;
+	char            *map = NULL;
+	size_t           map_size = 0;
+	
+	parser = vktor_parser_init(128);
+	
+	// High throughput mode - read from a file given on the command line
+	if (argc > 1) {
+		if (strcmp(argv[1], "-") != 0 && 
+		    (infile = fopen(argv[1], "r")) == NULL) {
+			perror("Error opening input file");
+			return 255;
+		}
+		
+		buffsize = FILE_BUFFSIZE;
+		if (fstat(fileno(infile), &st) == 0 && S_ISREG(st.st_mode) && 
+		    st.st_size > 0) {
+			map_size = (size_t) st.st_size;
+			map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fileno(infile), 0);
+			if (map == MAP_FAILED) {
+				map = NULL;
+			} else {
+				madvise(map, map_size, MADV_SEQUENTIAL);
+				if (vktor_feed_complete(parser, map, (long) map_size, 0, 
+				                        &error) != VKTOR_OK) {
+					fprintf(stderr, "Feed error [%d]: %s\n", error->code, 
+						error->message);
+					ret = error->code;
+					done = 1;
+				}
+			}
+		}
+	}
 	
 	// Set buffer size from environment, if set
 	if ((buffsize_c = getenv("BUFFSIZE")) != NULL) {
 		buffsize = atoi(buffsize_c);
 	}
 	
-	parser = vktor_parser_init(128);
-	
-	do {
+	while (! done) {
 		nest = vktor_get_current_struct(parser);
 		status = vktor_parse(parser, &error);
 		
@@ -229,6 +409,7 @@ main(int argc, char *argv[], char *envp[])
 			case VKTOR_OK:
 				// Print the token
 				if (! handle_token(parser, nest, &error)) {
+					out_flush();
 					fprintf(stderr, "Parser error [%d]: %s\n", error->code, 
 						error->message);
 					ret = error->code;
@@ -238,8 +419,14 @@ main(int argc, char *argv[], char *envp[])
 				
 			case VKTOR_MORE_DATA:
 				// We need to read more data
-				buffer = malloc(sizeof(char) * buffsize);
-				read_bytes = fread(buffer, sizeof(char), buffsize, stdin);
+				if (map != NULL) {
+					// The entire file was already fed to the parser
+					read_bytes = 0;
+				} else {
+					buffer = malloc(sizeof(char) * buffsize);
+					read_bytes = fread(buffer, sizeof(char), buffsize, infile);
+				}
+				
 				if (read_bytes) {
 					vktor_feed(parser, buffer, read_bytes, 1, &error);
 					
@@ -247,6 +434,7 @@ main(int argc, char *argv[], char *envp[])
 					// Nothing left to read
 					done = 1;
 					ret = 255;
+					out_flush();
 					fprintf(stderr, "Error: premature end of stream\n");
 				}
 				break;
@@ -258,6 +446,7 @@ main(int argc, char *argv[], char *envp[])
 				
 			case VKTOR_ERROR:
 				// We have a parse error
+				out_flush();
 				fprintf(stderr, "Paser error [%d]: %s\n", error->code, 
 					error->message);
 				ret = error->code;
@@ -265,7 +454,9 @@ main(int argc, char *argv[], char *envp[])
 				break;
 		}
 		
-	} while (! done);
+	}
+	
+	out_flush();
 	
 	if (error != NULL) {
 		vktor_error_free(error);
@@ -273,5 +464,13 @@ main(int argc, char *argv[], char *envp[])
 	
 	vktor_parser_free(parser);
 	
+	if (map != NULL) {
+		munmap(map, map_size);
+	}
+	
+	if (infile != stdin) {
+		fclose(infile);
+	}
+	
 	return ret;
 }
@@ -0,0 +1,277 @@
+/*
+ * vktor JSON pull-parser library
+ *
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file vktor-pool.c
+ *
+ * Parses a set of JSON documents using parsers acquired from a parser pool,
+ * used here for testing vktor_parser_pool_acquire() and 
+ * vktor_parser_pool_release().
+ *
+ *   vktor-pool [-i max_idle] [-n count]
+ *
+ * Each line of standard input is a separate document. Documents are parsed in
+ * rounds of the number given by -n (2 by default): a parser is acquired from a
+ * pool keeping up to the number of idle parsers given by -i (1 by default) 
+ * for each document of the round, and all of them are released at the end of
+ * the round. Documents which end in the middle are released as they are, so a
+ * reused parser must start over.
+ *
+ * Each acquired parser is written out along with whether it is new or was 
+ * reused, followed by the tokens of its document one per line. Parsers freed
+ * by the pool are written out as they are freed. The pool and its parsers use
+ * an allocator which makes sure all memory is freed by the end.
+ *
+ * The return code of the program is 0 if all is ok, or the VKTOR_ERR code of
+ * the last parser error. 255 is returned in case of an error unrelated to the
+ * parser.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vktor.h>
+#include "vktor-print.h"
+
+#define MAXDEPTH    32
+#define MAX_PARSERS 64
+
+/* A parser acquired from the pool at least once */
+typedef struct {
+	vktor_parser *parser; /* parser, or NULL once it was freed */
+	int           idle;   /* whether the parser was released */
+} pool_parser;
+
+static pool_parser  parsers[MAX_PARSERS];
+static int          parser_count = 0;
+static long         live_blocks = 0;
+
+static void *
+pool_malloc(void *ctx, size_t size)
+{
+	(void) ctx;
+	live_blocks++;
+	return malloc(size);
+}
+
+static void *
+pool_realloc(void *ctx, void *ptr, size_t size)
+{
+	(void) ctx;
+	if (ptr == NULL) {
+		live_blocks++;
+	}
+	return realloc(ptr, size);
+}
+
+/* Free memory, writing out any parser which is freed */
+static void
+pool_free(void *ctx, void *ptr)
+{
+	int i;
+
+	(void) ctx;
+	if (ptr == NULL) {
+		return;
+	}
+
+	for (i = 0; i < parser_count; i++) {
+		if (parsers[i].parser == ptr) {
+			printf("# parser %d freed\n", i + 1);
+			parsers[i].parser = NULL;
+		}
+	}
+
+	live_blocks--;
+	free(ptr);
+}
+
+static const vktor_allocator pool_allocator = {
+	pool_malloc, pool_realloc, pool_free, NULL
+};
+
+/* Acquire a parser from the pool, and write out which one it is */
+static vktor_parser *
+acquire_parser(vktor_parser_pool *pool)
+{
+	vktor_parser *parser;
+	int           i;
+
+	if ((parser = vktor_parser_pool_acquire(pool)) == NULL) {
+		fprintf(stderr, "Error: unable to acquire a parser\n");
+		exit(255);
+	}
+
+	for (i = 0; i < parser_count; i++) {
+		if (parsers[i].parser == parser) {
+			if (! parsers[i].idle) {
+				fprintf(stderr, "Error: parser %d acquired twice\n", i + 1);
+				exit(255);
+			}
+			parsers[i].idle = 0;
+			printf("# parser %d: reused\n", i + 1);
+			return parser;
+		}
+	}
+
+	if (parser_count == MAX_PARSERS) {
+		fprintf(stderr, "Error: too many parsers\n");
+		exit(255);
+	}
+
+	parsers[parser_count].parser = parser;
+	parsers[parser_count].idle   = 0;
+	printf("# parser %d: new\n", ++parser_count);
+	return parser;
+}
+
+/* Release a parser back into the pool */
+static void
+release_parser(vktor_parser_pool *pool, vktor_parser *parser)
+{
+	int i;
+
+	for (i = 0; i < parser_count; i++) {
+		if (parsers[i].parser == parser) {
+			parsers[i].idle = 1;
+		}
+	}
+
+	vktor_parser_pool_release(pool, parser);
+}
+
+/*
+ * Parse a single document, writing out its tokens. Returns 0 if all is ok, or
+ * the error code of a parser error.
+ */
+static int
+parse_document(vktor_parser *parser, char *text, long len)
+{
+	vktor_error *error = NULL;
+	int          ret = 0;
+
+	vktor_feed(parser, text, len, 0, NULL);
+
+	for (;;) {
+		switch (vktor_parse(parser, &error)) {
+			case VKTOR_OK:
+				print_token(parser);
+				continue;
+
+			case VKTOR_MORE_DATA:
+				printf("# incomplete\n");
+				break;
+
+			case VKTOR_COMPLETE:
+				break;
+
+			case VKTOR_ERROR:
+				fprintf(stderr, "Parser error [%d]: %s\n", error->code,
+					error->message);
+				ret = error->code;
+				vktor_error_free(error);
+				break;
+		}
+		break;
+	}
+
+	return ret;
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-i max_idle] [-n count]\n", prog);
+	exit(255);
+}
+
+int
+main(int argc, char *argv[])
+{
+	vktor_parser_pool  *pool;
+	vktor_parser       *round[MAX_PARSERS];
+	char               *text, *line, *end;
+	long                len;
+	int                 opt, i, count = 2, max_idle = 1, used, ret = 0, status;
+
+	while ((opt = getopt(argc, argv, "i:n:")) != -1) {
+		switch (opt) {
+			case 'i':
+				max_idle = atoi(optarg);
+				break;
+			case 'n':
+				count = atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (max_idle < 0 || count < 1 || count > MAX_PARSERS || optind != argc) {
+		usage(argv[0]);
+	}
+
+	if ((pool = vktor_parser_pool_init(MAXDEPTH, max_idle, 
+	                                   &pool_allocator)) == NULL) {
+		fprintf(stderr, "Error: unable to initialize the pool\n");
+		return 255;
+	}
+
+	text = read_file(stdin, &len);
+	line = text;
+
+	while (line < text + len) {
+		// Acquire a parser for each document in the round
+		for (used = 0; used < count && line < text + len; used++) {
+			if ((end = memchr(line, '\n', text + len - line)) == NULL) {
+				end = text + len;
+			}
+
+			round[used] = acquire_parser(pool);
+			if ((status = parse_document(round[used], line, end - line)) != 0) {
+				ret = status;
+			}
+
+			line = end + 1;
+		}
+
+		for (i = 0; i < used; i++) {
+			release_parser(pool, round[i]);
+		}
+	}
+
+	vktor_parser_pool_free(pool);
+	free(text);
+
+	if (live_blocks != 0) {
+		fprintf(stderr, "Error: %ld blocks were not freed\n", live_blocks);
+		return 255;
+	}
+
+	return ret;
+}
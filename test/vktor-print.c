@@ -0,0 +1,147 @@
+/*
+ * vktor JSON pull-parser library
+ *
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file vktor-print.c
+ *
+ * Token printing and input reading shared by the vktor test programs
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vktor.h>
+#include "vktor-print.h"
+
+#define READ_BUFFSIZE 4096
+
+void
+print_token(vktor_parser *parser)
+{
+	char *value;
+	int   len;
+
+	switch (vktor_get_token_type(parser)) {
+		case VKTOR_T_NULL:         printf("NULL");         break;
+		case VKTOR_T_FALSE:        printf("FALSE");        break;
+		case VKTOR_T_TRUE:         printf("TRUE");         break;
+		case VKTOR_T_INT:          printf("INT");          break;
+		case VKTOR_T_FLOAT:        printf("FLOAT");        break;
+		case VKTOR_T_STRING:       printf("STRING");       break;
+		case VKTOR_T_STRING_PART:  printf("STRING_PART");  break;
+		case VKTOR_T_ARRAY_START:  printf("ARRAY_START");  break;
+		case VKTOR_T_ARRAY_END:    printf("ARRAY_END");    break;
+		case VKTOR_T_OBJECT_START: printf("OBJECT_START"); break;
+		case VKTOR_T_OBJECT_KEY:   printf("OBJECT_KEY");   break;
+		case VKTOR_T_OBJECT_END:   printf("OBJECT_END");   break;
+		default:                   printf("NONE");         break;
+	}
+
+	switch (vktor_get_token_type(parser)) {
+		case VKTOR_T_INT:
+		case VKTOR_T_FLOAT:
+			vktor_get_value_str(parser, &value, NULL);
+			printf(" %s", value);
+			break;
+
+		case VKTOR_T_STRING:
+		case VKTOR_T_STRING_PART:
+		case VKTOR_T_OBJECT_KEY:
+			len = vktor_get_value_str(parser, &value, NULL);
+			printf(" \"");
+			fwrite(value, sizeof(char), len, stdout);
+			printf("\"");
+
+			if (vktor_get_key_id(parser) >= 0) {
+				printf(" #%d", vktor_get_key_id(parser));
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	printf("\n");
+}
+
+char *
+read_file(FILE *file, long *len)
+{
+	char   *text = NULL, *grown;
+	long    size = 0;
+	size_t  read_bytes;
+
+	*len = 0;
+	do {
+		if (*len == size) {
+			size = size * 2 + READ_BUFFSIZE;
+			if ((grown = realloc(text, size)) == NULL) {
+				fprintf(stderr, "Error: unable to allocate %ld bytes\n", size);
+				free(text);
+				exit(255);
+			}
+			text = grown;
+		}
+		read_bytes = fread(text + *len, sizeof(char), size - *len, file);
+		*len += read_bytes;
+	} while (read_bytes > 0);
+
+	return text;
+}
+
+vktor_schema *
+compile_schema(const char *name, int maxdepth)
+{
+	vktor_parser *parser;
+	vktor_schema *schema;
+	vktor_error  *error = NULL;
+	FILE         *file;
+	char         *text;
+	long          len;
+
+	if ((file = fopen(name, "r")) == NULL) {
+		perror("Error opening schema file");
+		return NULL;
+	}
+
+	text = read_file(file, &len);
+	fclose(file);
+
+	parser = vktor_parser_init(maxdepth);
+	vktor_feed_complete(parser, text, len, 1, NULL);
+
+	schema = vktor_schema_init(NULL);
+	if (vktor_schema_compile(schema, parser, &error) != VKTOR_OK) {
+		fprintf(stderr, "%s: Schema error [%d]: %s\n", name, error->code,
+			error->message);
+		vktor_error_free(error);
+		vktor_schema_free(schema);
+		schema = NULL;
+	}
+
+	vktor_parser_free(parser);
+	return schema;
+}
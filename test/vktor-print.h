@@ -0,0 +1,75 @@
+/*
+ * vktor JSON pull-parser library
+ *
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file vktor-print.h
+ *
+ * Token printing and input reading shared by the vktor test programs
+ */
+
+#ifndef VKTOR_PRINT_H
+#define VKTOR_PRINT_H
+
+#include <stdio.h>
+#include <vktor.h>
+
+/**
+ * @brief Write out the current token of the parser
+ *
+ * Writes out the current token on a line of its own: its type, followed by
+ * its value for numbers, strings and object keys, and by the position of the
+ * key in the shape cache for object keys found there.
+ *
+ * @param [in] parser Parser object
+ */
+void print_token(vktor_parser *parser);
+
+/**
+ * @brief Read a whole file into memory
+ *
+ * Exits the program with an error message if memory can't be allocated.
+ *
+ * @param [in]  file File to read until its end
+ * @param [out] len  Number of bytes read
+ *
+ * @return Newly allocated buffer holding the contents of the file
+ */
+char *read_file(FILE *file, long *len);
+
+/**
+ * @brief Compile the JSON Schema in a file
+ *
+ * Errors are written out to standard error.
+ *
+ * @param [in] name     Schema file name
+ * @param [in] maxdepth Maximal nesting depth of the schema document
+ *
+ * @return Compiled schema, or NULL on error
+ */
+vktor_schema *compile_schema(const char *name, int maxdepth);
+
+#endif /* VKTOR_PRINT_H */
@@ -65,6 +65,7 @@ fi
 	
 # set some default values
 TEST_NAME=$(basename $TESTFILE)
+TEST_ARGS=""
 TEST_STDIN=""
 TEST_STDOUT=""
 TEST_STDERR=""
@@ -96,9 +97,9 @@ fi
 # run the test
 echo "$TEST_STDIN" > $OUTDIR/$TEST_NAME.stdin
 
-$CWD/$TEST_PROG  < $OUTDIR/$TEST_NAME.stdin  \
-                 > $OUTDIR/$TEST_NAME.stdout \
-                2> $OUTDIR/$TEST_NAME.stderr
+$CWD/$TEST_PROG $TEST_ARGS  < $OUTDIR/$TEST_NAME.stdin  \
+                            > $OUTDIR/$TEST_NAME.stdout \
+                           2> $OUTDIR/$TEST_NAME.stderr
 RETVAL=$?
 
 # check return value
@@ -0,0 +1,250 @@
+/*
+ * vktor JSON pull-parser library
+ *
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file vktor-skip.c
+ *
+ * Writes out the tokens of a JSON stream one per line, skipping or capturing
+ * some of its values instead of reading them into tokens, used here for
+ * testing vktor_skip_value() and vktor_capture_value().
+ *
+ *   vktor-skip [-b size] [-f] [-c chunk] [-x] [-S] [-k key] [-R] [-r key]
+ *              [-s schema]
+ *
+ * The stream is read from standard input in chunks of the size given by -b
+ * (64 bytes by default). With -f, it is read into memory first and fed to the
+ * parser as complete input using vktor_feed_complete(). With -c, long strings
+ * are read in parts of the given size (see vktor_set_string_chunk()).
+ *
+ * Values of object keys named by -k are skipped, and SKIPPED is written out
+ * for each of them. With -S, the root value itself is skipped. Values of
+ * object keys named by -r are captured, and written out as RAW followed by
+ * their text as it appears in the input. With -R, the root value itself is
+ * captured.
+ *
+ * With -x, subtree hashing is enabled, and the hash of each array, object and
+ * skipped value is written out after it. With -s, the JSON Schema in the
+ * given file is compiled and the stream is validated against it as it is
+ * read, including the values which are skipped (see vktor_enable_schema()).
+ *
+ * The return code of the program is 0 if all is ok, or the VKTOR_ERR code of
+ * a parser error. 255 is returned in case of an error unrelated to the parser.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vktor.h>
+#include "vktor-print.h"
+
+#define DEFAULT_BUFFSIZE 64
+#define MAXDEPTH         128
+
+/* Write out the subtree hash of the current value */
+static void
+print_hash(vktor_parser *parser)
+{
+	unsigned long long hash;
+
+	if (vktor_get_subtree_hash(parser, &hash, NULL) == VKTOR_OK) {
+		printf("HASH %016llx\n", hash);
+	}
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-b size] [-f] [-c chunk] [-x] [-S] [-k key] "
+		"[-R] [-r key] [-s schema]\n", prog);
+	exit(255);
+}
+
+int
+main(int argc, char *argv[])
+{
+	vktor_parser  *parser;
+	vktor_status   status;
+	vktor_error   *error = NULL;
+	vktor_schema  *schema = NULL;
+	char          *buffer, *key, *raw;
+	char          *skip_key = NULL, *capture_key = NULL;
+	size_t         read_bytes;
+	long           len, raw_len;
+	int            opt, done = 0, ret = 0;
+	int            buffsize = DEFAULT_BUFFSIZE, complete = 0, hash = 0;
+	int            in_skip = 0, in_capture = 0;
+
+	parser = vktor_parser_init(MAXDEPTH);
+
+	while ((opt = getopt(argc, argv, "b:fc:xSk:Rr:s:")) != -1) {
+		switch (opt) {
+			case 'b':
+				buffsize = atoi(optarg);
+				break;
+			case 'f':
+				complete = 1;
+				break;
+			case 'c':
+				vktor_set_string_chunk(parser, atol(optarg));
+				break;
+			case 'x':
+				hash = 1;
+				vktor_enable_subtree_hash(parser, NULL);
+				break;
+			case 'S':
+				in_skip = 1;
+				break;
+			case 'k':
+				skip_key = optarg;
+				break;
+			case 'R':
+				in_capture = 1;
+				break;
+			case 'r':
+				capture_key = optarg;
+				break;
+			case 's':
+				if (schema != NULL || 
+				    (schema = compile_schema(optarg, MAXDEPTH)) == NULL) {
+					usage(argv[0]);
+				}
+				if (vktor_enable_schema(parser, schema, &error) != VKTOR_OK) {
+					fprintf(stderr, "Schema error [%d]: %s\n", error->code,
+						error->message);
+					return 255;
+				}
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (buffsize < 1 || optind != argc) {
+		usage(argv[0]);
+	}
+
+	if (complete) {
+		buffer = read_file(stdin, &len);
+		vktor_feed_complete(parser, buffer, len, 1, NULL);
+	}
+
+	do {
+		if (in_skip) {
+			status = vktor_skip_value(parser, &error);
+		} else if (in_capture) {
+			status = vktor_capture_value(parser, &raw, &raw_len, &error);
+		} else {
+			status = vktor_parse(parser, &error);
+		}
+
+		switch (status) {
+
+			case VKTOR_OK:
+				if (in_skip) {
+					printf("SKIPPED\n");
+					if (hash) {
+						print_hash(parser);
+					}
+					in_skip = 0;
+					break;
+				}
+
+				if (in_capture) {
+					printf("RAW ");
+					fwrite(raw, sizeof(char), raw_len, stdout);
+					printf("\n");
+					in_capture = 0;
+					break;
+				}
+
+				print_token(parser);
+
+				switch (vktor_get_token_type(parser)) {
+					case VKTOR_T_OBJECT_KEY:
+						vktor_get_value_str(parser, &key, NULL);
+						in_skip = (skip_key != NULL &&
+						           strcmp(key, skip_key) == 0);
+						in_capture = (capture_key != NULL &&
+						              strcmp(key, capture_key) == 0);
+						break;
+
+					case VKTOR_T_ARRAY_END:
+					case VKTOR_T_OBJECT_END:
+						if (hash) {
+							print_hash(parser);
+						}
+						break;
+
+					default:
+						break;
+				}
+				break;
+
+			case VKTOR_MORE_DATA:
+				// We need to read more data
+				buffer = malloc(sizeof(char) * buffsize);
+				read_bytes = fread(buffer, sizeof(char), buffsize, stdin);
+
+				if (read_bytes) {
+					vktor_feed(parser, buffer, read_bytes, 1, &error);
+
+				} else {
+					// Nothing left to read
+					free(buffer);
+					fprintf(stderr, "Error: premature end of stream\n");
+					ret = 255;
+					done = 1;
+				}
+				break;
+
+			case VKTOR_COMPLETE:
+				done = 1;
+				break;
+
+			case VKTOR_ERROR:
+				fprintf(stderr, "Parser error [%d]: %s\n", error->code,
+					error->message);
+				ret = error->code;
+				done = 1;
+				break;
+		}
+
+	} while (! done);
+
+	if (error != NULL) {
+		vktor_error_free(error);
+	}
+
+	vktor_parser_free(parser);
+
+	if (schema != NULL) {
+		vktor_schema_free(schema);
+	}
+
+	return ret;
+}
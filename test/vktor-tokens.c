@@ -0,0 +1,498 @@
+/*
+ * vktor JSON pull-parser library
+ *
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file vktor-tokens.c
+ *
+ * Writes out the tokens of a JSON stream one per line, used here for testing
+ * the different ways input can be fed to the parser and tokens read from it.
+ *
+ *   vktor-tokens [-b size] [-f] [-a] [-c chunk] [-H] [-C] [-r checkpoint] [-z]
+ *                [-k]
+ *
+ * The stream is read from standard input in chunks of the size given by -b
+ * (64 bytes by default). With -f, it is read into memory first and fed to the
+ * parser as complete input using vktor_feed_complete().
+ *
+ * With -a, parsers are created with a counting allocator (see 
+ * vktor_parser_init_allocator()) which input is allocated with as well, and 
+ * string values are also copied using vktor_get_value_str_copy(). The program
+ * fails if the default memory handlers are called, or if any memory allocated
+ * through the allocator was not freed once the parser and its errors are 
+ * freed. It can't be used along with -z.
+ *
+ * With -c, long strings are read in parts of the given size (see
+ * vktor_set_string_chunk()). With -H, the parser is hibernated using
+ * vktor_parser_hibernate() after each token and whenever more data is needed.
+ * With -C, whenever more data is needed the parser is replaced with a new one
+ * restored from its checkpoint (see vktor_parser_checkpoint()), and the number
+ * of checkpoints is written out at the end. With -r, the parser is restored
+ * from the checkpoint in the given file before parsing, and the input is
+ * expected to start at the offset of the checkpoint. With -z, each chunk is compressed
+ * with gzip before it is fed, and inflated by the parser (see
+ * vktor_enable_inflate()) if vktor was built with zlib. With -k, the object
+ * key shape cache is enabled, and the shape cache position of each key is
+ * written out along with it, and the hit and miss counts at the end.
+ *
+ * The return code of the program is 0 if all is ok, or the VKTOR_ERR code of
+ * a parser error. 255 is returned in case of an error unrelated to the parser.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+#include <vktor.h>
+#include "vktor-print.h"
+
+#define DEFAULT_BUFFSIZE 64
+#define MAXDEPTH         128
+
+/* Allocation counts of the counting allocator */
+typedef struct {
+	long allocs; /* number of blocks allocated */
+	long frees;  /* number of blocks freed */
+} alloc_counts;
+
+static int           buffsize = DEFAULT_BUFFSIZE;
+static long          string_chunk = 0;
+static int           shape_cache = 0;
+static int           counting = 0;
+static alloc_counts  counts = { 0, 0 };
+
+/* Make sure the counting allocator was called with its own context */
+static void
+check_ctx(void *ctx)
+{
+	if (ctx != &counts) {
+		fprintf(stderr, "Error: allocator called with the wrong context\n");
+		exit(255);
+	}
+}
+
+static void *
+count_malloc(void *ctx, size_t size)
+{
+	check_ctx(ctx);
+	((alloc_counts *) ctx)->allocs++;
+	return malloc(size);
+}
+
+static void *
+count_realloc(void *ctx, void *ptr, size_t size)
+{
+	check_ctx(ctx);
+	if (ptr == NULL) {
+		((alloc_counts *) ctx)->allocs++;
+	}
+	return realloc(ptr, size);
+}
+
+static void
+count_free(void *ctx, void *ptr)
+{
+	check_ctx(ctx);
+	if (ptr != NULL) {
+		((alloc_counts *) ctx)->frees++;
+	}
+	free(ptr);
+}
+
+static const vktor_allocator count_allocator = {
+	count_malloc, count_realloc, count_free, &counts
+};
+
+/* Default memory handlers, which must not be called when counting */
+static void *
+default_malloc(size_t size)
+{
+	(void) size;
+	fprintf(stderr, "Error: default memory handlers called\n");
+	exit(255);
+}
+
+static void *
+default_realloc(void *ptr, size_t size)
+{
+	return default_malloc(ptr == NULL ? size : 0);
+}
+
+static void
+default_free(void *ptr)
+{
+	default_malloc(ptr == NULL ? 0 : 1);
+}
+
+/* Allocate memory for input, which will be freed by the parser */
+static char *
+input_alloc(long size)
+{
+	if (counting) {
+		return count_malloc(&counts, size);
+	}
+	return malloc(size);
+}
+
+/* Initialize a parser with the options which are set */
+static vktor_parser *
+new_parser(void)
+{
+	vktor_parser *parser = vktor_parser_init_allocator(MAXDEPTH, 
+		(counting ? &count_allocator : NULL));
+
+	if (string_chunk > 0) {
+		vktor_set_string_chunk(parser, string_chunk);
+	}
+
+	return parser;
+}
+
+/*
+ * Replace the parser with a new one restored from its checkpoint, the way a
+ * consumer restarting in the middle of a stream would. All input read so far
+ * was parsed, so the checkpoint offset must be right after it, and the
+ * restored parser must ask for more data before returning anything.
+ */
+static vktor_status
+restore_parser(vktor_parser **parser, long read_total, vktor_error **error)
+{
+	unsigned char  *checkpoint;
+	long            len, offset;
+	vktor_status    status;
+
+	if (vktor_parser_checkpoint(*parser, NULL, 0, &len, error) != VKTOR_OK) {
+		return VKTOR_ERROR;
+	}
+
+	checkpoint = malloc(len);
+	vktor_parser_checkpoint(*parser, checkpoint, len, &len, error);
+	vktor_parser_free(*parser);
+
+	*parser = new_parser();
+	status = vktor_parser_restore(*parser, checkpoint, len, &offset, error);
+	free(checkpoint);
+
+	if (status != VKTOR_OK) {
+		return status;
+	}
+
+	if (offset != read_total) {
+		fprintf(stderr, "Error: checkpoint offset %ld, read %ld bytes\n",
+			offset, read_total);
+		exit(255);
+	}
+
+	// Nothing was fed to the restored parser yet, so it can only ask for more
+	status = vktor_parse(*parser, error);
+	if (status != VKTOR_MORE_DATA) {
+		fprintf(stderr, "Error: restored parser returned %d before more data "
+			"was fed\n", status);
+		exit(255);
+	}
+
+	return VKTOR_OK;
+}
+
+#ifdef HAVE_LIBZ
+/*
+ * Compress a chunk of input, the way it would arrive from a gzip stream, and
+ * return the compressed data in a new buffer. If finish is set, the end of
+ * the stream is written as well.
+ */
+static char *
+gzip_chunk(z_stream *zs, char *in, size_t len, int finish, size_t *out_len)
+{
+	size_t  size = deflateBound(zs, len) + 64;
+	char   *out = malloc(size), *grown;
+
+	zs->next_in  = (Bytef *) in;
+	zs->avail_in = len;
+	*out_len = 0;
+
+	do {
+		if (*out_len == size) {
+			size *= 2;
+			if ((grown = realloc(out, size)) == NULL) {
+				fprintf(stderr, "Error: unable to allocate %lu bytes\n", 
+					(unsigned long) size);
+				exit(255);
+			}
+			out = grown;
+		}
+		zs->next_out  = (Bytef *) out + *out_len;
+		zs->avail_out = size - *out_len;
+		deflate(zs, (finish ? Z_FINISH : Z_SYNC_FLUSH));
+		*out_len = size - zs->avail_out;
+	} while (zs->avail_out == 0);
+
+	return out;
+}
+#endif
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-b size] [-f] [-a] [-c chunk] [-H] [-C] "
+		"[-r checkpoint] [-z] [-k]\n", prog);
+	exit(255);
+}
+
+int
+main(int argc, char *argv[])
+{
+	vktor_parser  *parser;
+	vktor_status   status;
+	vktor_error   *error = NULL;
+	char          *buffer, *copy;
+	size_t         read_bytes;
+	long           len, read_total = 0, hits, misses;
+	int            opt, done = 0, ret = 0;
+	int            complete = 0, hibernate = 0, checkpoint = 0, restored = 0;
+	int            gzip_input = 0;
+	char          *restore = NULL;
+	FILE          *file;
+#ifdef HAVE_LIBZ
+	z_stream       zs;
+	char          *compressed;
+	size_t         compressed_len;
+#endif
+
+	while ((opt = getopt(argc, argv, "b:fac:HCr:zk")) != -1) {
+		switch (opt) {
+			case 'b':
+				buffsize = atoi(optarg);
+				break;
+			case 'f':
+				complete = 1;
+				break;
+			case 'a':
+				counting = 1;
+				break;
+			case 'c':
+				string_chunk = atol(optarg);
+				break;
+			case 'H':
+				hibernate = 1;
+				break;
+			case 'C':
+				checkpoint = 1;
+				break;
+			case 'r':
+				restore = optarg;
+				break;
+			case 'z':
+				gzip_input = 1;
+				break;
+			case 'k':
+				shape_cache = 1;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (buffsize < 1 || optind != argc || (counting && gzip_input)) {
+		usage(argv[0]);
+	}
+
+	if (counting) {
+		vktor_set_memory_handlers(default_malloc, default_realloc, 
+			default_free);
+	}
+
+	parser = new_parser();
+
+	if (shape_cache) {
+		vktor_enable_shape_cache(parser, NULL);
+	}
+
+	if (restore != NULL) {
+		if ((file = fopen(restore, "r")) == NULL) {
+			perror("Error opening checkpoint file");
+			return 255;
+		}
+		buffer = read_file(file, &len);
+		fclose(file);
+
+		status = vktor_parser_restore(parser, (unsigned char *) buffer, len,
+			&read_total, &error);
+		free(buffer);
+
+		if (status != VKTOR_OK) {
+			fprintf(stderr, "Checkpoint error [%d]: %s\n", error->code,
+				error->message);
+			ret = error->code;
+			vktor_error_free(error);
+			vktor_parser_free(parser);
+			return ret;
+		}
+	}
+
+	if (complete) {
+		buffer = read_file(stdin, &len);
+		if (counting) {
+			copy = input_alloc(len);
+			memcpy(copy, buffer, len);
+			free(buffer);
+			buffer = copy;
+		}
+		vktor_feed_complete(parser, buffer, len, 1, NULL);
+		gzip_input = 0;
+	}
+
+#ifdef HAVE_LIBZ
+	if (gzip_input) {
+		memset(&zs, 0, sizeof(zs));
+		deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+			Z_DEFAULT_STRATEGY);
+		vktor_enable_inflate(parser, buffsize, NULL);
+	}
+#else
+	gzip_input = 0;
+#endif
+
+	do {
+		status = vktor_parse(parser, &error);
+
+		switch (status) {
+
+			case VKTOR_OK:
+				print_token(parser);
+				if (counting) {
+					copy = NULL;
+					vktor_get_value_str_copy(parser, &copy, NULL);
+					if (copy != NULL) {
+						vktor_value_str_free(parser, copy);
+					}
+				}
+				if (hibernate) {
+					vktor_parser_hibernate(parser, NULL);
+				}
+				break;
+
+			case VKTOR_MORE_DATA:
+				// We need to read more data
+				if (hibernate) {
+					vktor_parser_hibernate(parser, NULL);
+				}
+
+				if (checkpoint) {
+					if (restore_parser(&parser, read_total, &error) != VKTOR_OK) {
+						fprintf(stderr, "Checkpoint error [%d]: %s\n",
+							error->code, error->message);
+						ret = error->code;
+						done = 1;
+						break;
+					}
+					restored++;
+				}
+
+				buffer = input_alloc(sizeof(char) * buffsize);
+				read_bytes = fread(buffer, sizeof(char), buffsize, stdin);
+
+#ifdef HAVE_LIBZ
+				// Compress what was read, or write the end of the stream
+				if (gzip_input == 1) {
+					compressed = gzip_chunk(&zs, buffer, read_bytes,
+						(read_bytes == 0), &compressed_len);
+					free(buffer);
+					buffer = compressed;
+					gzip_input = (read_bytes == 0 ? 2 : 1);
+					read_bytes = compressed_len;
+				}
+#endif
+
+				if (read_bytes) {
+					vktor_feed(parser, buffer, read_bytes, 1, &error);
+					read_total += read_bytes;
+
+				} else {
+					// Nothing left to read
+					if (counting) {
+						count_free(&counts, buffer);
+					} else {
+						free(buffer);
+					}
+					fprintf(stderr, "Error: premature end of stream\n");
+					ret = 255;
+					done = 1;
+				}
+				break;
+
+			case VKTOR_COMPLETE:
+				done = 1;
+				break;
+
+			case VKTOR_ERROR:
+				fprintf(stderr, "Parser error [%d]: %s\n", error->code,
+					error->message);
+				ret = error->code;
+				done = 1;
+				break;
+		}
+
+	} while (! done);
+
+	if (shape_cache) {
+		vktor_get_shape_stats(parser, &hits, &misses);
+		printf("# shape cache: %ld hits, %ld misses\n", hits, misses);
+	}
+
+	if (checkpoint) {
+		printf("# restored from %d checkpoints\n", restored);
+	}
+
+	if (error != NULL) {
+		vktor_error_free(error);
+	}
+
+	vktor_parser_free(parser);
+
+#ifdef HAVE_LIBZ
+	if (gzip_input) {
+		deflateEnd(&zs);
+	}
+#endif
+
+	if (counting) {
+		if (counts.allocs != counts.frees) {
+			fprintf(stderr, "Error: %ld blocks allocated, %ld freed\n", 
+				counts.allocs, counts.frees);
+			return 255;
+		}
+		printf("# counting allocator: all memory freed\n");
+	}
+
+	return ret;
+}
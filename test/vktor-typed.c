@@ -0,0 +1,308 @@
+/*
+ * vktor JSON pull-parser library
+ *
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file vktor-typed.c
+ *
+ * Writes out the tokens of a JSON stream one per line, reading some of its
+ * values into types other than strings and numbers, used here for testing
+ * vktor_get_value_timespec(), vktor_get_value_uuid(), vktor_get_value_hex(),
+ * vktor_read_base64() and the bulk number array readers.
+ *
+ *   vktor-typed [-b size] [-t] [-6 key] [-n double|float|int64]
+ *
+ * The stream is read from standard input in chunks of the size given by -b
+ * (64 bytes by default).
+ *
+ * With -t, each string which is a timestamp, a UUID or a hexadecimal number
+ * is followed by a line with its decoded value. Values of object keys named
+ * by -6 are read as base64, and written out as BASE64 followed by the decoded
+ * data in hex. With -n, numbers in arrays are read in bulk into an array of
+ * the given type using vktor_read_number_array(), vktor_read_float_array() or
+ * vktor_read_int64_array(), and each number read is written out on a line of
+ * its own, as DOUBLE, FLOAT or INT64 followed by its value.
+ *
+ * The return code of the program is 0 if all is ok, or the VKTOR_ERR code of
+ * a parser error. 255 is returned in case of an error unrelated to the parser.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vktor.h>
+#include "vktor-print.h"
+
+#define DEFAULT_BUFFSIZE 64
+#define MAXDEPTH         128
+#define BASE64_BUFFSIZE  8
+#define NUMBERS_BUFFSIZE 4
+
+typedef enum {
+	NUMBERS_NONE,
+	NUMBERS_DOUBLE,
+	NUMBERS_FLOAT,
+	NUMBERS_INT64
+} numbers_type;
+
+/* Write out the decoded value of a typed string, if it is one */
+static void
+print_typed(vktor_parser *parser)
+{
+	vktor_error        *error = NULL;
+	struct timespec     ts;
+	unsigned char       uuid[16];
+	unsigned long long  hex;
+	int                 i;
+
+	if (vktor_get_value_timespec(parser, &ts, NULL) == VKTOR_OK) {
+		printf("TIME %ld.%09ld\n", (long) ts.tv_sec, ts.tv_nsec);
+
+	} else if (vktor_get_value_uuid(parser, uuid, NULL) == VKTOR_OK) {
+		printf("UUID ");
+		for (i = 0; i < 16; i++) {
+			printf("%02x", uuid[i]);
+		}
+		printf("\n");
+
+	} else {
+		hex = vktor_get_value_hex(parser, &error);
+		if (error == NULL) {
+			printf("HEX %llu\n", hex);
+		} else {
+			vktor_error_free(error);
+		}
+	}
+}
+
+/*
+ * Read numbers of an array in bulk and write them out. Sets stopped when the
+ * next value of the array is not a number, and should be read using
+ * vktor_parse().
+ */
+static vktor_status
+read_numbers(vktor_parser *parser, numbers_type type, int *stopped,
+             vktor_error **error)
+{
+	double        doubles[NUMBERS_BUFFSIZE];
+	float         floats[NUMBERS_BUFFSIZE];
+	long long     ints[NUMBERS_BUFFSIZE];
+	vktor_status  status;
+	long          count, n;
+
+	switch (type) {
+		case NUMBERS_FLOAT:
+			status = vktor_read_float_array(parser, floats, NUMBERS_BUFFSIZE,
+				&count, error);
+			break;
+
+		case NUMBERS_INT64:
+			status = vktor_read_int64_array(parser, ints, NUMBERS_BUFFSIZE,
+				&count, error);
+			break;
+
+		default:
+			status = vktor_read_number_array(parser, doubles, NUMBERS_BUFFSIZE,
+				&count, error);
+			break;
+	}
+
+	if (status == VKTOR_ERROR) {
+		return status;
+	}
+
+	for (n = 0; n < count; n++) {
+		switch (type) {
+			case NUMBERS_FLOAT:
+				printf("FLOAT %.5f\n", (double) floats[n]);
+				break;
+
+			case NUMBERS_INT64:
+				printf("INT64 %lld\n", ints[n]);
+				break;
+
+			default:
+				printf("DOUBLE %.5f\n", doubles[n]);
+				break;
+		}
+	}
+
+	*stopped = (status == VKTOR_OK && count < NUMBERS_BUFFSIZE &&
+	            vktor_get_token_type(parser) == VKTOR_T_NONE);
+
+	return status;
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-b size] [-t] [-6 key] [-n double|float|int64]\n",
+		prog);
+	exit(255);
+}
+
+int
+main(int argc, char *argv[])
+{
+	vktor_parser   *parser;
+	vktor_status    status;
+	vktor_error    *error = NULL;
+	char           *buffer, *key;
+	char           *base64_key = NULL;
+	unsigned char   base64[BASE64_BUFFSIZE];
+	size_t          read_bytes;
+	long            base64_len, i;
+	int             opt, done = 0, ret = 0;
+	int             buffsize = DEFAULT_BUFFSIZE, typed = 0;
+	int             in_base64 = 0, numbers_stopped = 0;
+	numbers_type    numbers = NUMBERS_NONE;
+
+	while ((opt = getopt(argc, argv, "b:t6:n:")) != -1) {
+		switch (opt) {
+			case 'b':
+				buffsize = atoi(optarg);
+				break;
+			case 't':
+				typed = 1;
+				break;
+			case '6':
+				base64_key = optarg;
+				break;
+			case 'n':
+				if (strcmp(optarg, "double") == 0) {
+					numbers = NUMBERS_DOUBLE;
+				} else if (strcmp(optarg, "float") == 0) {
+					numbers = NUMBERS_FLOAT;
+				} else if (strcmp(optarg, "int64") == 0) {
+					numbers = NUMBERS_INT64;
+				} else {
+					usage(argv[0]);
+				}
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (buffsize < 1 || optind != argc) {
+		usage(argv[0]);
+	}
+
+	parser = vktor_parser_init(MAXDEPTH);
+
+	do {
+		if (in_base64) {
+			status = vktor_read_base64(parser, base64, sizeof(base64),
+				&base64_len, &error);
+		} else if (numbers != NUMBERS_NONE && ! numbers_stopped &&
+		           vktor_get_current_struct(parser) == VKTOR_STRUCT_ARRAY) {
+			status = read_numbers(parser, numbers, &numbers_stopped, &error);
+		} else {
+			status = vktor_parse(parser, &error);
+
+			// Finish reading a token split between buffers with vktor_parse()
+			numbers_stopped = (status == VKTOR_MORE_DATA);
+		}
+
+		switch (status) {
+
+			case VKTOR_OK:
+				if (in_base64) {
+					// Parts of the same string are written on one line
+					if (in_base64 == 1) {
+						printf("BASE64 ");
+					}
+					for (i = 0; i < base64_len; i++) {
+						printf("%02x", base64[i]);
+					}
+
+					in_base64 = (vktor_get_token_type(parser) ==
+					             VKTOR_T_STRING_PART ? 2 : 0);
+					if (! in_base64) {
+						printf("\n");
+					}
+					break;
+				}
+
+				if (vktor_get_token_type(parser) == VKTOR_T_NONE) {
+					// Bulk reading stopped at the end of an array
+					break;
+				}
+
+				print_token(parser);
+
+				if (vktor_get_token_type(parser) == VKTOR_T_OBJECT_KEY &&
+				    base64_key != NULL) {
+					vktor_get_value_str(parser, &key, NULL);
+					in_base64 = (strcmp(key, base64_key) == 0);
+				}
+
+				if (vktor_get_token_type(parser) == VKTOR_T_STRING && typed) {
+					print_typed(parser);
+				}
+				break;
+
+			case VKTOR_MORE_DATA:
+				// We need to read more data
+				buffer = malloc(sizeof(char) * buffsize);
+				read_bytes = fread(buffer, sizeof(char), buffsize, stdin);
+
+				if (read_bytes) {
+					vktor_feed(parser, buffer, read_bytes, 1, &error);
+
+				} else {
+					// Nothing left to read
+					free(buffer);
+					fprintf(stderr, "Error: premature end of stream\n");
+					ret = 255;
+					done = 1;
+				}
+				break;
+
+			case VKTOR_COMPLETE:
+				done = 1;
+				break;
+
+			case VKTOR_ERROR:
+				fprintf(stderr, "Parser error [%d]: %s\n", error->code,
+					error->message);
+				ret = error->code;
+				done = 1;
+				break;
+		}
+
+	} while (! done);
+
+	if (error != NULL) {
+		vktor_error_free(error);
+	}
+
+	vktor_parser_free(parser);
+
+	return ret;
+}
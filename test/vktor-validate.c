@@ -31,11 +31,28 @@
  * A simple JSON validator, used here for testing purposes.
  * 
  * This program reads a JSON stream from standard input, and validates it as
- * it is read.
+ * it is read using vktor_validate(), without reading it into tokens.
  * 
- * The return code of the program should be 0 if all is ok and the stream is
- * valid. Otherwise, one of the VKTOR_ERR codes as returned from the parser 
- * is returned in case of a parser error. 255 is retuned in case of an error 
+ * If one or more file names are passed as arguments, each file is validated
+ * as a separate document instead. Regular files are mapped into memory and 
+ * fed to the parser as complete input, while other files ("-" for standard 
+ * input, pipes, devices) are read in chunks. Files are validated in parallel
+ * by a number of threads, one per online CPU unless set with -j, and errors
+ * are reported for each invalid file in the order the files were given.
+ * 
+ *   vktor-validate [-j jobs] [-u] [-p] [-s schema] [file ...]
+ * 
+ * With -u, strings must be valid UTF-8 as well. With -p, documents are read
+ * token by token using vktor_parse() instead, for comparison. With -s, the 
+ * JSON Schema in the given file is compiled once, and all documents are read
+ * using vktor_parse() and validated against it as they are parsed.
+ * 
+ * Parsers are initialized on the stack using vktor_parser_init_inplace(),
+ * unless they are too large for the stack buffer.
+ * 
+ * The return code of the program should be 0 if all is ok and all documents
+ * are valid. Otherwise, the VKTOR_ERR code returned from the parser for the 
+ * first invalid document is returned. 255 is retuned in case of an error 
  * unrelated to the parser.
  * 
  * You can use the code here as an example of how to write a simple JSON parser
@@ -44,40 +61,77 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
 #include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <vktor.h>
+#include "vktor-print.h"
 
 #define DEFAULT_BUFFSIZE 4096
 #define DEFAULT_MAXDEPTH 32
+#define PARSER_MEMSIZE   4096
+#define MAX_MESSAGE      256
 
-int 
-main(int argc, char *argv[], char *envp[]) 
+static int buffsize   = DEFAULT_BUFFSIZE;
+static int maxdepth   = DEFAULT_MAXDEPTH;
+static int check_utf8 = 0;
+static int use_parse  = 0;
+
+static vktor_schema *schema = NULL;
+
+/* Files validated by a group of threads */
+typedef struct {
+	char            **files;
+	int               count;
+	int               next;
+	int              *codes;
+	char            **messages;
+	pthread_mutex_t   lock;
+} validate_job;
+
+/* Format an error message into a newly allocated string */
+static char *
+new_message(const char *fmt, ...)
 {
-	vktor_parser *parser;
-	vktor_status  status;
-	vktor_error  *error = NULL;
-	char         *buffer;
-	size_t        read_bytes;
-	int           done = 0, ret = 0;
-	char         *envvar;
-	int           buffsize = DEFAULT_BUFFSIZE;
-	int           maxdepth = DEFAULT_MAXDEPTH;
+	char    *message = malloc(MAX_MESSAGE);
+	va_list  ap;
 	
-	/* Set buffer size from environment, if set */
-	if ((envvar = getenv("BUFFSIZE")) != NULL) {
-		buffsize = atoi(envvar);
+	if (message != NULL) {
+		va_start(ap, fmt);
+		vsnprintf(message, MAX_MESSAGE, fmt, ap);
+		va_end(ap);
 	}
 	
-	/* Set max depth from environment, if set */
-	if ((envvar = getenv("MAXDEPTH")) != NULL) {
-		maxdepth = atoi(envvar);
-	}
+	return message;
+}
 
-	parser = vktor_parser_init(maxdepth);
+/*
+ * Validate a single document which was fed to the parser, or is read from fp
+ * in chunks. Returns 0 if it is valid or an error code, in which case message
+ * is set to a newly allocated error message.
+ */
+static int
+validate_document(vktor_parser *parser, FILE *fp, char **message)
+{
+	vktor_status  status;
+	vktor_error  *error = NULL;
+	char         *buffer;
+	size_t        read_bytes;
+	int           ret = -1;
 	
-	do {
-		status = vktor_parse(parser, &error);
+	while (ret < 0) {
+		if (use_parse) {
+			status = vktor_parse(parser, &error);
+		} else {
+			status = vktor_validate(parser, check_utf8, &error);
+		}
 		
 		switch (status) {
 			
@@ -87,39 +141,290 @@ main(int argc, char *argv[], char *envp[])
 			case VKTOR_MORE_DATA:
 				// We need to read more data
 				buffer = malloc(sizeof(char) * buffsize);
-				read_bytes = fread(buffer, sizeof(char), buffsize, stdin);
+				read_bytes = (fp == NULL ? 0 : 
+					fread(buffer, sizeof(char), buffsize, fp));
 				if (read_bytes) {
 					vktor_feed(parser, buffer, read_bytes, 1, &error);
 					
 				} else {
 					// Nothing left to read
-					done = 1;
+					free(buffer);
+					*message = new_message("Error: premature end of stream");
 					ret = 255;
-					fprintf(stderr, "Error: premature end of stream\n");
 				}
 				break;
 				
 			case VKTOR_COMPLETE: 
-				// Parser says we are done
-				done = 1;
+				// Parser says we are done, but whatever is left in the 
+				// stream must be read as well
+				buffer = malloc(sizeof(char) * buffsize);
+				read_bytes = (fp == NULL ? 0 : 
+					fread(buffer, sizeof(char), buffsize, fp));
+				if (read_bytes) {
+					vktor_feed(parser, buffer, read_bytes, 1, &error);
+				} else {
+					free(buffer);
+					ret = 0;
+				}
 				break;
 				
 			case VKTOR_ERROR:
+				if (error->code == VKTOR_ERR_INCOMPLETE_DATA) {
+					// Complete input has ended in the middle of the document
+					*message = new_message("Error: premature end of stream");
+					ret = 255;
+					break;
+				}
+				
 				// We have a parse error
-				fprintf(stderr, "Paser error [%d]: %s\n", error->code, 
+				*message = new_message("Paser error [%d]: %s", error->code, 
 					error->message);
 				ret = error->code;
-				done = 1;
 				break;
 		}
-		
-	} while (! done);
+	}
 	
 	if (error != NULL) {
 		vktor_error_free(error);
 	}
 	
+	return ret;
+}
+
+/*
+ * Validate a file, mapping it into memory if it is a regular file. Returns 0
+ * if it is valid or an error code, in which case message is set.
+ */
+static int
+validate_file(const char *name, char **message)
+{
+	vktor_parser *parser;
+	vktor_error  *error = NULL;
+	FILE         *fp = NULL;
+	struct stat   st;
+	char         *map = NULL;
+	int           fd, ret;
+	union {
+		void   *ptr;
+		double  dbl;
+		char    mem[PARSER_MEMSIZE];
+	}             parser_mem;
+	
+	if (strcmp(name, "-") == 0) {
+		fd = STDIN_FILENO;
+	} else if ((fd = open(name, O_RDONLY)) < 0) {
+		*message = new_message("Error opening input file: %s", 
+			strerror(errno));
+		return 255;
+	}
+	
+	if (vktor_parser_size() <= sizeof(parser_mem)) {
+		parser = vktor_parser_init_inplace(&parser_mem, sizeof(parser_mem), 
+			maxdepth, NULL);
+	} else {
+		parser = vktor_parser_init(maxdepth);
+	}
+	
+	if (schema != NULL && 
+	    vktor_enable_schema(parser, schema, &error) != VKTOR_OK) {
+		*message = new_message("Schema error [%d]: %s", error->code, 
+			error->message);
+		ret = error->code;
+		vktor_error_free(error);
+		vktor_parser_free(parser);
+		if (fd != STDIN_FILENO) {
+			close(fd);
+		}
+		return ret;
+	}
+	
+	// Standard input is always read as a stream
+	if (fd != STDIN_FILENO && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && 
+	    st.st_size > 0) {
+		map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			map = NULL;
+		}
+	}
+	
+	if (map != NULL) {
+		madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+		vktor_feed_complete(parser, map, (long) st.st_size, 0, NULL);
+	} else if (fd == STDIN_FILENO) {
+		fp = stdin;
+	} else {
+		fp = fdopen(fd, "r");
+	}
+	
+	ret = validate_document(parser, fp, message);
+	
 	vktor_parser_free(parser);
 	
+	if (map != NULL) {
+		munmap(map, (size_t) st.st_size);
+	}
+	
+	if (fp != NULL && fp != stdin) {
+		fclose(fp);
+	} else if (fp == NULL && fd != STDIN_FILENO) {
+		close(fd);
+	}
+	
+	return ret;
+}
+
+/* Validate files taken from the job until none are left */
+static void *
+validate_worker(void *arg)
+{
+	validate_job *job = arg;
+	int           i;
+	
+	for (;;) {
+		pthread_mutex_lock(&job->lock);
+		i = job->next++;
+		pthread_mutex_unlock(&job->lock);
+		
+		if (i >= job->count) {
+			break;
+		}
+		
+		job->codes[i] = validate_file(job->files[i], &job->messages[i]);
+	}
+	
+	return NULL;
+}
+
+/*
+ * Validate files in parallel using the given number of threads, and report
+ * any invalid files. Returns the error code of the first invalid file, or 0.
+ */
+static int
+validate_files(char **files, int count, int jobs)
+{
+	validate_job  job;
+	pthread_t    *threads;
+	int           i, started, ret = 0;
+	
+	job.files    = files;
+	job.count    = count;
+	job.next     = 0;
+	job.codes    = calloc(count, sizeof(int));
+	job.messages = calloc(count, sizeof(char *));
+	threads      = malloc(sizeof(pthread_t) * jobs);
+	if (job.codes == NULL || job.messages == NULL || threads == NULL) {
+		fprintf(stderr, "Error: unable to allocate memory\n");
+		return 255;
+	}
+	pthread_mutex_init(&job.lock, NULL);
+	
+	// This thread validates files too
+	for (started = 0; started < jobs - 1; started++) {
+		if (pthread_create(&threads[started], NULL, validate_worker, &job) != 0) {
+			break;
+		}
+	}
+	validate_worker(&job);
+	
+	for (i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	
+	for (i = 0; i < count; i++) {
+		if (job.codes[i] != 0) {
+			fprintf(stderr, "%s: %s\n", files[i], (job.messages[i] != NULL ? 
+				job.messages[i] : "invalid"));
+			if (ret == 0) {
+				ret = job.codes[i];
+			}
+		}
+		free(job.messages[i]);
+	}
+	
+	pthread_mutex_destroy(&job.lock);
+	free(threads);
+	free(job.messages);
+	free(job.codes);
+	
+	return ret;
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-j jobs] [-u] [-p] [-s schema] [file ...]\n", 
+		prog);
+	exit(255);
+}
+
+int 
+main(int argc, char *argv[], char *envp[]) 
+{
+	char *envvar, *message = NULL;
+	int   opt, jobs = 0, ret;
+	
+	/* Set buffer size from environment, if set */
+	if ((envvar = getenv("BUFFSIZE")) != NULL) {
+		buffsize = atoi(envvar);
+	}
+	
+	/* Set max depth from environment, if set */
+	if ((envvar = getenv("MAXDEPTH")) != NULL) {
+		maxdepth = atoi(envvar);
+	}
+	
+	while ((opt = getopt(argc, argv, "j:ups:")) != -1) {
+		switch (opt) {
+			case 'j':
+				jobs = atoi(optarg);
+				break;
+			case 'u':
+				check_utf8 = 1;
+				break;
+			case 'p':
+				use_parse = 1;
+				break;
+			case 's':
+				// The compiled schema is shared by all threads
+				if ((schema = compile_schema(optarg, maxdepth)) == NULL) {
+					return 255;
+				}
+				use_parse = 1;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	
+	if (buffsize < 1 || jobs < 0) {
+		usage(argv[0]);
+	}
+	
+	if (optind == argc) {
+		/* Validate standard input as a stream */
+		if ((ret = validate_file("-", &message)) != 0) {
+			fprintf(stderr, "%s\n", (message != NULL ? message : "invalid"));
+			free(message);
+		}
+		
+	} else {
+		/* Use a thread per online CPU, but no more than the number of files */
+		if (jobs == 0) {
+			jobs = (int) sysconf(_SC_NPROCESSORS_ONLN);
+		}
+		if (jobs > argc - optind) {
+			jobs = argc - optind;
+		}
+		if (jobs < 1) {
+			jobs = 1;
+		}
+		
+		ret = validate_files(argv + optind, argc - optind, jobs);
+	}
+	
+	if (schema != NULL) {
+		vktor_schema_free(schema);
+	}
+	
 	return ret;
 }
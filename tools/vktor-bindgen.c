@@ -0,0 +1,1470 @@
+/* 
+ * vktor JSON pull-parser library
+ * 
+ * Copyright (c) 2009 Shahar Evron
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE. 
+ */
+
+/**
+ * @file vktor-bindgen.c
+ * 
+ * Decoder generator: reads a JSON Schema describing an object, and writes C
+ * code declaring a struct for it along with a function which decodes JSON
+ * documents directly into that struct using libvktor.
+ * 
+ *   vktor-bindgen [-o base] name [schema]
+ * 
+ * The schema is read from the given file, or from standard input. name is
+ * used for the root struct type and as a prefix for all other generated
+ * names. The code is written to standard output, or to base.h and base.c
+ * if -o is given.
+ * 
+ * Schemas use the same vocabulary as vktor_schema_compile(). Each property
+ * must have a type: "integer" is decoded into a long, "number" into a double,
+ * "boolean" into an int, "string" into a pointer and length, "object" into a
+ * nested struct and "array" into a fixed size array of maxItems members,
+ * which are described by items and can't be arrays themselves. A type may
+ * also allow "null", in which case null values leave the member unset.
+ * required properties must be found for an object to be decoded, and
+ * additionalProperties may be false to reject any other key. Validation
+ * keywords such as minimum or maxLength are left to vktor_enable_schema(),
+ * which can be used along with the generated decoder.
+ * 
+ * The generated decoder reads the document token by token using
+ * vktor_parse(). Keys are looked up using a perfect hash generated for each
+ * object, numbers are converted straight from the token value into their
+ * member, and unknown keys are skipped using vktor_skip_value(). Strings are
+ * copied into an arena provided by the caller, so decoding never allocates
+ * memory other than for errors. See the comment on the generated
+ * name_decode() function.
+ * 
+ * The return code of the program is 0 on success, the VKTOR_ERR code if the
+ * schema is not valid JSON, or 255 in case of any other error.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <vktor.h>
+
+#define BUFFSIZE    4096
+#define MAXDEPTH    64
+#define MAX_MEMBERS 64
+#define MAX_SEEDS   4096
+
+/* Member types */
+typedef enum {
+	BG_NONE,
+	BG_INTEGER,
+	BG_NUMBER,
+	BG_BOOLEAN,
+	BG_STRING,
+	BG_OBJECT,
+	BG_ARRAY
+} bg_type;
+
+static const char *bg_types[] = {
+	NULL, "integer", "number", "boolean", "string", "object", "array"
+};
+
+/* Keywords which are read by vktor_schema_compile() but not needed here */
+static const char *bg_ignored[] = {
+	"$schema", "$id", "id", "$comment", "title", "description", "default",
+	"examples", "format", "enum", "minimum", "maximum", "exclusiveMinimum",
+	"exclusiveMaximum", "minLength", "maxLength", "minItems", NULL
+};
+
+/* C keywords, which can't be used as member names */
+static const char *bg_keywords[] = {
+	"auto", "break", "case", "char", "const", "continue", "default", "do",
+	"double", "else", "enum", "extern", "float", "for", "goto", "if",
+	"inline", "int", "long", "register", "restrict", "return", "short",
+	"signed", "sizeof", "static", "struct", "switch", "typedef", "union",
+	"unsigned", "void", "volatile", "while", NULL
+};
+
+/*
+ * Fixed parts of the generated code, see write_code()
+ */
+
+static const char code_arena[] =
+"/* Memory for decoded strings, provided by the caller */\n"
+"typedef struct _@P@_arena {\n"
+"\tchar   *data; /* arena memory */\n"
+"\tsize_t  size; /* size of data */\n"
+"\tsize_t  used; /* bytes used so far, set to 0 to reuse the arena */\n"
+"} @P@_arena;\n"
+"\n";
+
+static const char code_decode_proto[] =
+"/*\n"
+" * Decode a document into a @P@ struct\n"
+" * \n"
+" * Reads the next value from the parser, which must be an object, and decodes\n"
+" * it into out. Members which are found are marked in out->present, and \n"
+" * unknown keys are skipped. Strings are copied into the arena with a NUL \n"
+" * terminator. The whole document must have been fed to the parser, for \n"
+" * example using vktor_feed_complete().\n"
+" * \n"
+" * Returns VKTOR_OK once the object was decoded, or VKTOR_ERROR if it could \n"
+" * not be, in which case error is set if it is not NULL: VKTOR_ERR_SCHEMA if \n"
+" * the document does not match the schema, and VKTOR_ERR_OUT_OF_MEMORY if the\n"
+" * arena is full. The contents of out are undefined in case of error.\n"
+" */\n"
+"vktor_status @P@_decode(vktor_parser *parser, @P@_arena *arena, @P@ *out, \n"
+"             @_@        vktor_error **error);\n";
+
+static const char code_helpers[] =
+"#include <stdio.h>\n"
+"#include <stdlib.h>\n"
+"#include <stdarg.h>\n"
+"#include <string.h>\n"
+"#include <errno.h>\n"
+"\n"
+"#define @U@_MAX_E_LEN 256\n"
+"\n"
+"/* A key of an object, as found in the input */\n"
+"typedef struct {\n"
+"\tconst char *name;\n"
+"\tint         len;\n"
+"} @P@_key_entry;\n"
+"\n"
+"/* Set an error, if error is not NULL, and return VKTOR_ERROR */\n"
+"static vktor_status\n"
+"@P@_error(vktor_parser *parser, vktor_error **error, vktor_errcode code, \n"
+"@_@       const char *fmt, ...)\n"
+"{\n"
+"\tchar    message[@U@_MAX_E_LEN];\n"
+"\tva_list ap;\n"
+"\t\n"
+"\tva_start(ap, fmt);\n"
+"\tvsnprintf(message, sizeof(message), fmt, ap);\n"
+"\tva_end(ap);\n"
+"\t\n"
+"\tvktor_set_error(parser, error, code, \"%s\", message);\n"
+"\treturn VKTOR_ERROR;\n"
+"}\n"
+"\n"
+"/* Set an error for a value which is not of the expected type */\n"
+"static vktor_status\n"
+"@P@_mismatch(vktor_parser *parser, const char *name, const char *expected, \n"
+"@_@          vktor_error **error)\n"
+"{\n"
+"\treturn @P@_error(parser, error, VKTOR_ERR_SCHEMA, \n"
+"\t\t\"value of '%s' does not match the schema, expecting %s\", name, \n"
+"\t\texpected);\n"
+"}\n"
+"\n"
+"/* Read the next token, which must be there */\n"
+"static vktor_status\n"
+"@P@_next(vktor_parser *parser, vktor_error **error)\n"
+"{\n"
+"\tvktor_status status = vktor_parse(parser, error);\n"
+"\t\n"
+"\tif (status == VKTOR_OK || status == VKTOR_ERROR) {\n"
+"\t\treturn status;\n"
+"\t}\n"
+"\treturn @P@_error(parser, error, VKTOR_ERR_INCOMPLETE_DATA, \n"
+"\t\t\"document ends unexpectedly\");\n"
+"}\n"
+"\n"
+"/* Skip the value of an unknown key */\n"
+"static vktor_status\n"
+"@P@_skip(vktor_parser *parser, vktor_error **error)\n"
+"{\n"
+"\tvktor_status status = vktor_skip_value(parser, error);\n"
+"\t\n"
+"\tif (status == VKTOR_OK || status == VKTOR_ERROR) {\n"
+"\t\treturn status;\n"
+"\t}\n"
+"\treturn @P@_error(parser, error, VKTOR_ERR_INCOMPLETE_DATA, \n"
+"\t\t\"document ends unexpectedly\");\n"
+"}\n"
+"\n";
+
+static const char code_scalars[] =
+"/* Hash a key: 32 bit FNV-1a, starting from a seed */\n"
+"static unsigned long\n"
+"@P@_hash(unsigned long seed, const char *key, int len)\n"
+"{\n"
+"\tunsigned long hash = (2166136261UL ^ seed) & 0xffffffffUL;\n"
+"\tint           i;\n"
+"\t\n"
+"\tfor (i = 0; i < len; i++) {\n"
+"\t\thash ^= (unsigned char) key[i];\n"
+"\t\thash  = (hash * 16777619UL) & 0xffffffffUL;\n"
+"\t}\n"
+"\treturn hash;\n"
+"}\n"
+"\n"
+"/* Read an integer value */\n"
+"static vktor_status\n"
+"@P@_read_long(vktor_parser *parser, long *out, const char *name, \n"
+"@_@           vktor_error **error)\n"
+"{\n"
+"\tchar *value;\n"
+"\t\n"
+"\tif (vktor_get_token_type(parser) != VKTOR_T_INT) {\n"
+"\t\treturn @P@_mismatch(parser, name, \"integer\", error);\n"
+"\t}\n"
+"\tvktor_get_value_str(parser, &value, NULL);\n"
+"\t\n"
+"\terrno = 0;\n"
+"\t*out  = strtol(value, NULL, 10);\n"
+"\tif (errno == ERANGE) {\n"
+"\t\treturn @P@_error(parser, error, VKTOR_ERR_OUT_OF_RANGE, \n"
+"\t\t\t\"value of '%s' overflows maximal long value\", name);\n"
+"\t}\n"
+"\treturn VKTOR_OK;\n"
+"}\n"
+"\n"
+"/* Read a number value */\n"
+"static vktor_status\n"
+"@P@_read_double(vktor_parser *parser, double *out, const char *name, \n"
+"@_@             vktor_error **error)\n"
+"{\n"
+"\tchar *value;\n"
+"\t\n"
+"\tif (! (vktor_get_token_type(parser) & (VKTOR_T_INT | VKTOR_T_FLOAT))) {\n"
+"\t\treturn @P@_mismatch(parser, name, \"number\", error);\n"
+"\t}\n"
+"\tvktor_get_value_str(parser, &value, NULL);\n"
+"\t\n"
+"\terrno = 0;\n"
+"\t*out  = strtod(value, NULL);\n"
+"\tif (errno == ERANGE) {\n"
+"\t\treturn @P@_error(parser, error, VKTOR_ERR_OUT_OF_RANGE, \n"
+"\t\t\t\"value of '%s' overflows maximal double value\", name);\n"
+"\t}\n"
+"\treturn VKTOR_OK;\n"
+"}\n"
+"\n"
+"/* Read a boolean value */\n"
+"static vktor_status\n"
+"@P@_read_bool(vktor_parser *parser, int *out, const char *name, \n"
+"@_@           vktor_error **error)\n"
+"{\n"
+"\tswitch (vktor_get_token_type(parser)) {\n"
+"\t\tcase VKTOR_T_TRUE:\n"
+"\t\t\t*out = 1;\n"
+"\t\t\treturn VKTOR_OK;\n"
+"\t\tcase VKTOR_T_FALSE:\n"
+"\t\t\t*out = 0;\n"
+"\t\t\treturn VKTOR_OK;\n"
+"\t\tdefault:\n"
+"\t\t\treturn @P@_mismatch(parser, name, \"boolean\", error);\n"
+"\t}\n"
+"}\n"
+"\n"
+"/* Read a string value, which may come in parts, into the arena */\n"
+"static vktor_status\n"
+"@P@_read_string(vktor_parser *parser, @P@_arena *arena, const char **out,\n"
+"@_@             size_t *len, const char *name, vktor_error **error)\n"
+"{\n"
+"\tsize_t  start = arena->used;\n"
+"\tchar   *value;\n"
+"\tint     size;\n"
+"\t\n"
+"\tif (! (vktor_get_token_type(parser) & \n"
+"\t       (VKTOR_T_STRING | VKTOR_T_STRING_PART))) {\n"
+"\t\treturn @P@_mismatch(parser, name, \"string\", error);\n"
+"\t}\n"
+"\t\n"
+"\twhile (1) {\n"
+"\t\tsize = vktor_get_value_str(parser, &value, NULL);\n"
+"\t\tif (arena->size - arena->used <= (size_t) size) {\n"
+"\t\t\tarena->used = start;\n"
+"\t\t\treturn @P@_error(parser, error, VKTOR_ERR_OUT_OF_MEMORY, \n"
+"\t\t\t\t\"arena is full, can't read the value of '%s'\", name);\n"
+"\t\t}\n"
+"\t\tmemcpy(arena->data + arena->used, value, size);\n"
+"\t\tarena->used += size;\n"
+"\t\t\n"
+"\t\tif (vktor_get_token_type(parser) == VKTOR_T_STRING) {\n"
+"\t\t\tbreak;\n"
+"\t\t}\n"
+"\t\tif (@P@_next(parser, error) != VKTOR_OK) {\n"
+"\t\t\treturn VKTOR_ERROR;\n"
+"\t\t}\n"
+"\t}\n"
+"\t\n"
+"\tarena->data[arena->used] = '\\0';\n"
+"\t*out = arena->data + start;\n"
+"\t*len = arena->used - start;\n"
+"\tarena->used++;\n"
+"\t\n"
+"\treturn VKTOR_OK;\n"
+"}\n"
+"\n";
+
+static const char code_find[] =
+"/* Find the member of @N@ a key is decoded into, or -1 */\n"
+"static int\n"
+"@N@_find(const char *key, int len)\n"
+"{\n";
+
+static const char code_read[] =
+"/* Read a @N@ object, after its first token */\n"
+"static vktor_status\n"
+"@N@_read(vktor_parser *parser, @P@_arena *arena, @N@ *out, \n"
+"@_@      const char *name, vktor_error **error)\n"
+"{\n";
+
+static const char code_read_loop[] =
+"\tif (vktor_get_token_type(parser) != VKTOR_T_OBJECT_START) {\n"
+"\t\treturn @P@_mismatch(parser, name, \"object\", error);\n"
+"\t}\n"
+"\tmemset(out, 0, sizeof(@N@));\n"
+"\t\n"
+"\twhile (1) {\n"
+"\t\tif (@P@_next(parser, error) != VKTOR_OK) {\n"
+"\t\t\treturn VKTOR_ERROR;\n"
+"\t\t}\n"
+"\t\tif (vktor_get_token_type(parser) == VKTOR_T_OBJECT_END) {\n"
+"\t\t\tbreak;\n"
+"\t\t}\n";
+
+static const char code_decode[] =
+"vktor_status\n"
+"@P@_decode(vktor_parser *parser, @P@_arena *arena, @P@ *out, \n"
+"@_@        vktor_error **error)\n"
+"{\n"
+"\tif (@P@_next(parser, error) != VKTOR_OK) {\n"
+"\t\treturn VKTOR_ERROR;\n"
+"\t}\n"
+"\treturn @P@_read(parser, arena, out, \"document\", error);\n"
+"}\n";
+
+typedef struct _bg_node bg_node;
+typedef struct _bg_prop bg_prop;
+
+/* A schema, and the struct generated for it if it describes an object */
+struct _bg_node {
+	bg_type        type;
+	int            nullable;
+	int            closed;     /* additionalProperties is false */
+	long           max_items;
+	bg_node       *items;
+	bg_prop       *props;
+	bg_prop       *last_prop;
+	int            num_props;
+	char          *name;       /* struct type name */
+	char          *upper;      /* name in upper case, for macros */
+	unsigned long  seed;       /* perfect hash seed, table size and slots */
+	int            slots_size;
+	int           *slots;
+};
+
+/* An object property, and its struct member */
+struct _bg_prop {
+	char     *key;
+	int       key_len;
+	char     *member;
+	int       required;
+	bg_node  *node;
+	bg_prop  *next;
+};
+
+static vktor_parser *parser;
+static const char   *schema_name = "-";
+
+static char  *prefix;
+static char  *upper;
+static char **names = NULL;
+static int    num_names = 0;
+
+static bg_node **structs = NULL;
+static int       num_structs = 0;
+
+/* Print an error message and exit */
+static void
+fail(const char *fmt, ...)
+{
+	va_list ap;
+	
+	fprintf(stderr, "%s: Schema error: ", schema_name);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	exit(255);
+}
+
+/* Allocate memory, or exit */
+static void *
+bg_alloc(size_t size)
+{
+	void *ptr = calloc(1, size);
+	
+	if (ptr == NULL) {
+		fail("out of memory");
+	}
+	return ptr;
+}
+
+/* Copy a string, or exit */
+static char *
+bg_strdup(const char *str)
+{
+	char *copy = bg_alloc(strlen(str) + 1);
+	
+	strcpy(copy, str);
+	return copy;
+}
+
+/* Read the next token of the schema */
+static vktor_token
+next_token(void)
+{
+	vktor_error *error = NULL;
+	int          code;
+	
+	switch (vktor_parse(parser, &error)) {
+		case VKTOR_OK:
+			return vktor_get_token_type(parser);
+		
+		case VKTOR_ERROR:
+			fprintf(stderr, "%s: Parser error [%d]: %s\n", schema_name,
+				error->code, error->message);
+			code = error->code;
+			vktor_error_free(error);
+			exit(code);
+		
+		default:
+			fprintf(stderr, "%s: Parser error [%d]: %s\n", schema_name,
+				VKTOR_ERR_INCOMPLETE_DATA, "schema ends unexpectedly");
+			exit(VKTOR_ERR_INCOMPLETE_DATA);
+	}
+}
+
+/* Get the value of the current string or key token */
+static char *
+token_str(int *len)
+{
+	char *str;
+	
+	*len = vktor_get_value_str(parser, &str, NULL);
+	return str;
+}
+
+/* Check if a string is in a NULL terminated list */
+static int
+in_list(const char **list, const char *str)
+{
+	for (; *list != NULL; list++) {
+		if (strcmp(*list, str) == 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Add a type to a schema from the value of the type keyword */
+static void
+add_type(bg_node *node, const char *type)
+{
+	int i;
+	
+	if (strcmp(type, "null") == 0) {
+		node->nullable = 1;
+		return;
+	}
+	
+	for (i = BG_INTEGER; i <= BG_ARRAY; i++) {
+		if (strcmp(type, bg_types[i]) == 0) {
+			break;
+		}
+	}
+	
+	if (i > BG_ARRAY) {
+		fail("unknown type '%s'", type);
+	}
+	if (node->type != BG_NONE && node->type != (bg_type) i) {
+		fail("only one type other than null is supported, got '%s' and '%s'",
+			bg_types[node->type], type);
+	}
+	node->type = i;
+}
+
+/* Find a property of a schema by its key */
+static bg_prop *
+find_prop(bg_node *node, const char *key, int len)
+{
+	bg_prop *prop;
+	
+	for (prop = node->props; prop != NULL; prop = prop->next) {
+		if (prop->key_len == len && memcmp(prop->key, key, len) == 0) {
+			return prop;
+		}
+	}
+	return NULL;
+}
+
+static bg_node *read_schema(const char *path);
+
+/* Read the properties keyword of a schema */
+static void
+read_properties(bg_node *node, const char *path)
+{
+	bg_prop *prop;
+	char    *key;
+	int      len;
+	
+	if (next_token() != VKTOR_T_OBJECT_START) {
+		fail("properties of '%s' must be an object", path);
+	}
+	
+	while (next_token() == VKTOR_T_OBJECT_KEY) {
+		key = token_str(&len);
+		if (find_prop(node, key, len) != NULL) {
+			fail("property '%s' of '%s' is declared twice", key, path);
+		}
+		
+		prop = bg_alloc(sizeof(bg_prop));
+		prop->key = bg_alloc(len + 1);
+		memcpy(prop->key, key, len);
+		prop->key_len = len;
+		
+		if (node->last_prop == NULL) {
+			node->props = prop;
+		} else {
+			node->last_prop->next = prop;
+		}
+		node->last_prop = prop;
+		node->num_props++;
+		
+		next_token();
+		prop->node = read_schema(prop->key);
+	}
+}
+
+/* Read the required keyword of a schema, after its properties were read */
+static void
+read_required(const char *path, char **required, int *count)
+{
+	vktor_token  token;
+	char        *key;
+	int          len;
+	
+	if (next_token() != VKTOR_T_ARRAY_START) {
+		fail("required of '%s' must be an array", path);
+	}
+	
+	while ((token = next_token()) != VKTOR_T_ARRAY_END) {
+		if (token != VKTOR_T_STRING) {
+			fail("required of '%s' must be an array of strings", path);
+		}
+		key = token_str(&len);
+		required[*count] = bg_alloc(len + 1);
+		memcpy(required[*count], key, len);
+		(*count)++;
+		if (*count == MAX_MEMBERS) {
+			fail("'%s' has more than %d required properties", path,
+				MAX_MEMBERS - 1);
+		}
+	}
+}
+
+/* Read a schema, and check that it can be decoded into a struct member */
+static bg_node *
+read_schema(const char *path)
+{
+	bg_node     *node = bg_alloc(sizeof(bg_node));
+	bg_prop     *prop;
+	vktor_token  token;
+	char        *key, *required[MAX_MEMBERS];
+	int          len, i, num_required = 0;
+	
+	if (vktor_get_token_type(parser) != VKTOR_T_OBJECT_START) {
+		fail("the schema of '%s' must be an object", path);
+	}
+	
+	while (next_token() == VKTOR_T_OBJECT_KEY) {
+		key = token_str(&len);
+		
+		if (strcmp(key, "type") == 0) {
+			token = next_token();
+			if (token == VKTOR_T_STRING) {
+				add_type(node, token_str(&len));
+			} else if (token == VKTOR_T_ARRAY_START) {
+				while (next_token() == VKTOR_T_STRING) {
+					add_type(node, token_str(&len));
+				}
+				if (vktor_get_token_type(parser) != VKTOR_T_ARRAY_END) {
+					fail("type of '%s' must be an array of strings", path);
+				}
+			} else {
+				fail("type of '%s' must be a string or an array", path);
+			}
+		
+		} else if (strcmp(key, "properties") == 0) {
+			read_properties(node, path);
+		
+		} else if (strcmp(key, "required") == 0) {
+			read_required(path, required, &num_required);
+		
+		} else if (strcmp(key, "additionalProperties") == 0) {
+			token = next_token();
+			if (token != VKTOR_T_TRUE && token != VKTOR_T_FALSE) {
+				fail("only true or false are supported for "
+					"additionalProperties of '%s'", path);
+			}
+			node->closed = (token == VKTOR_T_FALSE);
+		
+		} else if (strcmp(key, "items") == 0) {
+			if (next_token() != VKTOR_T_OBJECT_START) {
+				fail("items of '%s' must be a schema object", path);
+			}
+			node->items = read_schema(path);
+		
+		} else if (strcmp(key, "maxItems") == 0) {
+			if (next_token() != VKTOR_T_INT) {
+				fail("maxItems of '%s' must be an integer", path);
+			}
+			node->max_items = vktor_get_value_long(parser, NULL);
+		
+		} else if (in_list(bg_ignored, key)) {
+			if (vktor_skip_value(parser, NULL) != VKTOR_OK) {
+				fail("invalid value for %s of '%s'", key, path);
+			}
+		
+		} else {
+			fail("unsupported schema keyword '%s' in '%s'", key, path);
+		}
+	}
+	
+	// Mark required properties, which must all be declared
+	for (i = 0; i < num_required; i++) {
+		prop = find_prop(node, required[i], strlen(required[i]));
+		if (prop == NULL) {
+			fail("required property '%s' of '%s' is not declared",
+				required[i], path);
+		}
+		prop->required = 1;
+		free(required[i]);
+	}
+	
+	switch (node->type) {
+		case BG_NONE:
+			fail("'%s' has no type", path);
+			break;
+		
+		case BG_OBJECT:
+			if (node->num_props > MAX_MEMBERS) {
+				fail("'%s' has more than %d properties", path, MAX_MEMBERS);
+			}
+			break;
+		
+		case BG_ARRAY:
+			if (node->items == NULL || node->max_items < 1) {
+				fail("array '%s' needs items and a positive maxItems", path);
+			}
+			if (node->items->type == BG_ARRAY || node->items->nullable) {
+				fail("items of '%s' can't be arrays or null", path);
+			}
+			break;
+		
+		default:
+			break;
+	}
+	
+	if (node->type != BG_OBJECT && node->num_props > 0) {
+		fail("'%s' has properties but is not an object", path);
+	}
+	if (node->type != BG_ARRAY && node->items != NULL) {
+		fail("'%s' has items but is not an array", path);
+	}
+	
+	return node;
+}
+
+/* Reserve a generated name, which must be unique, and take ownership of it */
+static void
+claim_name(char *name)
+{
+	int i;
+	
+	for (i = 0; i < num_names; i++) {
+		if (strcmp(names[i], name) == 0) {
+			fail("the generated name '%s' is used twice, try renaming a "
+				"property", name);
+		}
+	}
+	
+	names = realloc(names, sizeof(char *) * (num_names + 1));
+	names[num_names++] = name;
+}
+
+/* Format a name into a newly allocated string */
+static char *
+new_name(const char *fmt, ...)
+{
+	char    *name;
+	va_list  ap;
+	int      len;
+	
+	va_start(ap, fmt);
+	len = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+	
+	name = bg_alloc(len + 1);
+	va_start(ap, fmt);
+	vsnprintf(name, len + 1, fmt, ap);
+	va_end(ap);
+	
+	return name;
+}
+
+/* Convert a name to upper case in place */
+static char *
+to_upper(char *name)
+{
+	char *p;
+	
+	for (p = name; *p != '\0'; p++) {
+		*p = toupper((unsigned char) *p);
+	}
+	return name;
+}
+
+/* Get the name of the macro for the bit of a member in present */
+static char *
+has_macro(bg_node *node, bg_prop *prop)
+{
+	return to_upper(new_name("%s_HAS_%s", node->name, prop->member));
+}
+
+/* Make a member name out of a key */
+static char *
+member_name(const char *key)
+{
+	char *member = bg_alloc(strlen(key) + 3), *p = member;
+	
+	if (! isalpha((unsigned char) *key) && *key != '_') {
+		*p++ = '_';
+	}
+	for (; *key != '\0'; key++) {
+		*p++ = (isalnum((unsigned char) *key) ? *key : '_');
+	}
+	if (in_list(bg_keywords, member)) {
+		*p++ = '_';
+	}
+	
+	return member;
+}
+
+/* Check that the members of a property don't clash with preceding ones */
+static void
+check_member(bg_node *node, bg_prop *prop)
+{
+	const char *suffixes[] = { "", "_len", "_count" };
+	bg_prop    *other;
+	char       *a, *b;
+	int         i, j, clash;
+	
+	if (strcmp(prop->member, "present") == 0) {
+		fail("property '%s' of '%s' can't be decoded into a member named "
+			"present", prop->key, node->name);
+	}
+	
+	// Any member may be followed by _len and _count members
+	for (other = node->props; other != prop; other = other->next) {
+		for (i = 0; i < 3; i++) {
+			for (j = 0; j < 3; j++) {
+				a = new_name("%s%s", prop->member, suffixes[i]);
+				b = new_name("%s%s", other->member, suffixes[j]);
+				clash = (strcmp(a, b) == 0);
+				free(a);
+				free(b);
+				if (clash) {
+					fail("properties '%s' and '%s' of '%s' would be decoded "
+						"into members with the same name", other->key, 
+						prop->key, node->name);
+				}
+			}
+		}
+	}
+}
+
+/* Hash a key, exactly as the generated code does */
+static unsigned long
+key_hash(unsigned long seed, const char *key, int len)
+{
+	unsigned long hash = (2166136261UL ^ seed) & 0xffffffffUL;
+	int           i;
+	
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char) key[i];
+		hash  = (hash * 16777619UL) & 0xffffffffUL;
+	}
+	return hash;
+}
+
+/* Find a seed and table size for which the keys of an object don't collide */
+static void
+find_perfect_hash(bg_node *node)
+{
+	bg_prop *prop;
+	int      size, i, slot;
+	
+	for (size = 1; size < node->num_props; size *= 2);
+	node->slots = bg_alloc(sizeof(int) * size * 64);
+	
+	for (; size <= node->num_props * 64; size *= 2) {
+		for (node->seed = 0; node->seed < MAX_SEEDS; node->seed++) {
+			for (slot = 0; slot < size; slot++) {
+				node->slots[slot] = -1;
+			}
+			for (prop = node->props, i = 0; prop != NULL;
+			     prop = prop->next, i++) {
+				slot = key_hash(node->seed, prop->key, prop->key_len) &
+					(size - 1);
+				if (node->slots[slot] != -1) {
+					break;
+				}
+				node->slots[slot] = i;
+			}
+			if (prop == NULL) {
+				node->slots_size = size;
+				return;
+			}
+		}
+	}
+	
+	fail("no perfect hash was found for the keys of '%s'", node->name);
+}
+
+/* Name the structs of an object and its descendants, children first */
+static void
+name_struct(bg_node *node, char *name)
+{
+	bg_prop *prop;
+	bg_node *child;
+	
+	node->name  = name;
+	node->upper = to_upper(bg_strdup(name));
+	
+	claim_name(bg_strdup(name));
+	claim_name(new_name("%s_read", name));
+	claim_name(new_name("%s_find", name));
+	claim_name(new_name("%s_keys", name));
+	
+	for (prop = node->props; prop != NULL; prop = prop->next) {
+		prop->member = member_name(prop->key);
+		check_member(node, prop);
+		claim_name(has_macro(node, prop));
+		
+		child = (prop->node->type == BG_ARRAY ? prop->node->items : prop->node);
+		if (child->type == BG_OBJECT) {
+			name_struct(child, new_name("%s_%s", name, prop->member));
+		}
+	}
+	
+	if (node->num_props > 0) {
+		find_perfect_hash(node);
+	}
+	
+	structs = realloc(structs, sizeof(bg_node *) * (num_structs + 1));
+	structs[num_structs++] = node;
+}
+
+/*
+ * Write generated code, replacing @P@ with the prefix, @U@ with the prefix in
+ * upper case, @N@ with a type name and @_@ with spaces as wide as that name,
+ * which align the continuation lines of function declarations
+ */
+static void
+write_code(FILE *out, const char *code, const char *name)
+{
+	const char *p;
+	
+	for (p = code; *p != '\0'; p++) {
+		if (p[0] != '@' || p[1] == '\0' || p[2] != '@') {
+			fputc(*p, out);
+			continue;
+		}
+		
+		switch (p[1]) {
+			case 'P':
+				fputs(prefix, out);
+				break;
+			case 'U':
+				fputs(upper, out);
+				break;
+			case 'N':
+				fputs(name, out);
+				break;
+			case '_':
+				fprintf(out, "%*s", (int) strlen(name), "");
+				break;
+			default:
+				fputc(*p, out);
+				continue;
+		}
+		p += 2;
+	}
+}
+
+/* Write a key as a C string literal */
+static void
+write_literal(FILE *out, const char *key, int len)
+{
+	int i;
+	
+	fputc('"', out);
+	for (i = 0; i < len; i++) {
+		if (isalnum((unsigned char) key[i]) || strchr(" _-.:$@/", key[i])) {
+			fputc(key[i], out);
+		} else {
+			fprintf(out, "\\%03o", (unsigned char) key[i]);
+		}
+	}
+	fputc('"', out);
+}
+
+/* Get the C type of a scalar or struct member */
+static const char *
+member_type(bg_node *node)
+{
+	switch (node->type) {
+		case BG_INTEGER: return "long";
+		case BG_NUMBER:  return "double";
+		case BG_BOOLEAN: return "int";
+		case BG_STRING:  return "const char";
+		default:         return node->name;
+	}
+}
+
+/* Write a struct member, aligning its name and comment */
+static void
+write_member(FILE *out, int width, const char *type, int pointer, char *decl,
+             int decl_width, bg_prop *prop, const char *note)
+{
+	fprintf(out, "\t%-*s %c%s", width, type, (pointer ? '*' : ' '), decl);
+	if (prop != NULL || note != NULL) {
+		fprintf(out, "%*s /* ", (int) (decl_width - strlen(decl)), "");
+		if (prop != NULL) {
+			write_literal(out, prop->key, prop->key_len);
+		} else {
+			fputs(note, out);
+		}
+		fprintf(out, " */");
+	}
+	fprintf(out, "\n");
+	free(decl);
+}
+
+/* Write the typedef of an object's struct, and its HAS macros */
+static void
+write_struct(FILE *out, bg_node *node)
+{
+	bg_prop *prop;
+	bg_node *type;
+	char    *dim, *macro;
+	int      width = strlen("unsigned long long"), decl_width, macro_width;
+	int      i;
+	
+	// Align types, the comments of members and the values of macros
+	decl_width  = strlen("present;");
+	macro_width = 0;
+	for (prop = node->props; prop != NULL; prop = prop->next) {
+		type = (prop->node->type == BG_ARRAY ? prop->node->items : prop->node);
+		if ((int) strlen(member_type(type)) > width) {
+			width = strlen(member_type(type));
+		}
+		
+		dim = (prop->node->type == BG_ARRAY ? 
+			new_name("%s[%ld];", prop->member, prop->node->max_items) :
+			new_name("%s;", prop->member));
+		if ((int) strlen(dim) > decl_width) {
+			decl_width = strlen(dim);
+		}
+		free(dim);
+		
+		macro = has_macro(node, prop);
+		if ((int) strlen(macro) > macro_width) {
+			macro_width = strlen(macro);
+		}
+		free(macro);
+	}
+	
+	fprintf(out,
+"/* Decoded %s object */\n"
+"typedef struct _%s {\n", node->name, node->name);
+	macro = new_name("%s_HAS_* bits", node->upper);
+	write_member(out, width, "unsigned long long", 0, bg_strdup("present;"),
+		decl_width, NULL, macro);
+	free(macro);
+	
+	for (prop = node->props; prop != NULL; prop = prop->next) {
+		type = (prop->node->type == BG_ARRAY ? prop->node->items : prop->node);
+		dim  = (prop->node->type == BG_ARRAY ? 
+			new_name("[%ld]", prop->node->max_items) : bg_strdup(""));
+		
+		write_member(out, width, member_type(type), type->type == BG_STRING,
+			new_name("%s%s;", prop->member, dim), decl_width, prop, NULL);
+		if (type->type == BG_STRING) {
+			write_member(out, width, "size_t", 0, 
+				new_name("%s_len%s;", prop->member, dim), decl_width, NULL, NULL);
+		}
+		if (prop->node->type == BG_ARRAY) {
+			write_member(out, width, "long", 0, 
+				new_name("%s_count;", prop->member), decl_width, NULL, NULL);
+		}
+		free(dim);
+	}
+	
+	fprintf(out, "} %s;\n\n", node->name);
+	
+	for (prop = node->props, i = 0; prop != NULL; prop = prop->next, i++) {
+		macro = has_macro(node, prop);
+		fprintf(out, "#define %-*s (1ULL << %d)\n", macro_width, macro, i);
+		free(macro);
+	}
+	if (node->num_props > 0) {
+		fprintf(out, "\n");
+	}
+}
+
+/* Write the generated header: types and the decoder prototype */
+static void
+write_header(FILE *out, const char *guard)
+{
+	int i;
+	
+	fprintf(out,
+"/* Generated by vktor-bindgen from %s, do not edit */\n"
+"\n"
+"#ifndef %s\n"
+"#define %s\n"
+"\n"
+"#include <stddef.h>\n"
+"#include <vktor.h>\n"
+"\n", schema_name, guard, guard);
+	write_code(out, code_arena, prefix);
+	
+	for (i = 0; i < num_structs; i++) {
+		write_struct(out, structs[i]);
+	}
+	
+	write_code(out, code_decode_proto, prefix);
+	fprintf(out, "\n#endif /* %s */\n", guard);
+}
+
+/* Write the code reading a value into a member, after its first token */
+static void
+write_read_value(FILE *out, bg_node *node, bg_prop *prop, const char *lvalue,
+                 const char *indent)
+{
+	const char *helper = NULL;
+	
+	switch (node->type) {
+		case BG_INTEGER: helper = "long";   break;
+		case BG_NUMBER:  helper = "double"; break;
+		case BG_BOOLEAN: helper = "bool";   break;
+		default: break;
+	}
+	
+	fprintf(out, "%sif (", indent);
+	if (helper != NULL) {
+		fprintf(out, "%s_read_%s(parser, &%s, ", prefix, helper, lvalue);
+	} else if (node->type == BG_STRING) {
+		fprintf(out, "%s_read_string(parser, arena, &%s, \n%s    &out->%s_len%s, ",
+			prefix, lvalue, indent, prop->member, lvalue +
+			strlen("out->") + strlen(prop->member));
+	} else {
+		fprintf(out, "%s_read(parser, arena, &%s, ", node->name, lvalue);
+	}
+	write_literal(out, prop->key, prop->key_len);
+	fprintf(out, ", error) \n%s    != VKTOR_OK) {\n%s\treturn VKTOR_ERROR;\n"
+		"%s}\n", indent, indent, indent);
+}
+
+/* Write the code reading the value of a property */
+static void
+write_read_prop(FILE *out, bg_node *node, bg_prop *prop)
+{
+	char *lvalue;
+	
+	if (prop->node->nullable) {
+		fprintf(out,
+"\t\t\t\tif (vktor_get_token_type(parser) == VKTOR_T_NULL) {\n"
+"\t\t\t\t\tbreak;\n"
+"\t\t\t\t}\n");
+	}
+	
+	if (prop->node->type != BG_ARRAY) {
+		lvalue = new_name("out->%s", prop->member);
+		write_read_value(out, prop->node, prop, lvalue, "\t\t\t\t");
+		free(lvalue);
+	
+	} else {
+		fprintf(out,
+"\t\t\t\tif (vktor_get_token_type(parser) != VKTOR_T_ARRAY_START) {\n"
+"\t\t\t\t\treturn %s_mismatch(parser, ", prefix);
+		write_literal(out, prop->key, prop->key_len);
+		fprintf(out, ", \"array\", error);\n"
+"\t\t\t\t}\n"
+"\t\t\t\t\n"
+"\t\t\t\tfor (out->%s_count = 0; ; out->%s_count++) {\n"
+"\t\t\t\t\tif (%s_next(parser, error) != VKTOR_OK) {\n"
+"\t\t\t\t\t\treturn VKTOR_ERROR;\n"
+"\t\t\t\t\t}\n"
+"\t\t\t\t\tif (vktor_get_token_type(parser) == VKTOR_T_ARRAY_END) {\n"
+"\t\t\t\t\t\tbreak;\n"
+"\t\t\t\t\t}\n"
+"\t\t\t\t\tif (out->%s_count == %ld) {\n"
+"\t\t\t\t\t\treturn %s_error(parser, error, VKTOR_ERR_SCHEMA, \n"
+"\t\t\t\t\t\t\t\"array '%%s' has more than %ld members\", ",
+			prop->member, prop->member, prefix, prop->member,
+			prop->node->max_items, prefix, prop->node->max_items);
+		write_literal(out, prop->key, prop->key_len);
+		fprintf(out, ");\n"
+"\t\t\t\t\t}\n");
+		lvalue = new_name("out->%s[out->%s_count]", prop->member, prop->member);
+		write_read_value(out, prop->node->items, prop, lvalue, "\t\t\t\t\t");
+		free(lvalue);
+		fprintf(out, "\t\t\t\t}\n");
+	}
+	
+	lvalue = has_macro(node, prop);
+	fprintf(out, "\t\t\t\tout->present |= %s;\n", lvalue);
+	free(lvalue);
+}
+
+/* Check if reading an object's members needs the arena */
+static int
+uses_arena(bg_node *node)
+{
+	bg_prop *prop;
+	bg_node *value;
+	
+	for (prop = node->props; prop != NULL; prop = prop->next) {
+		value = (prop->node->type == BG_ARRAY ? prop->node->items : prop->node);
+		if (value->type == BG_STRING || value->type == BG_OBJECT) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Write the key lookup and the read function of an object's struct */
+static void
+write_reader(FILE *out, bg_node *node)
+{
+	const char *indent = "\t\t";
+	bg_prop    *prop;
+	char       *macro;
+	int         i;
+	
+	if (node->num_props > 0) {
+		fprintf(out, "static const %s_key_entry %s_keys[%d] = {\n", prefix,
+			node->name, node->num_props);
+		for (prop = node->props; prop != NULL; prop = prop->next) {
+			fprintf(out, "\t{ ");
+			write_literal(out, prop->key, prop->key_len);
+			fprintf(out, ", %d }%s\n", prop->key_len,
+				(prop->next != NULL ? "," : ""));
+		}
+		fprintf(out, "};\n\n");
+		
+		write_code(out, code_find, node->name);
+		fprintf(out, "\tstatic const signed char slots[%d] = {", 
+			node->slots_size);
+		for (i = 0; i < node->slots_size; i++) {
+			fprintf(out, "%s%s%d", (i > 0 ? "," : ""),
+				(i % 16 == 0 ? "\n\t\t" : " "), node->slots[i]);
+		}
+		fprintf(out, "\n\t};\n"
+"\tint i = slots[%s_hash(%luUL, key, len) & %d];\n"
+"\t\n"
+"\tif (i < 0 || %s_keys[i].len != len || \n"
+"\t    memcmp(%s_keys[i].name, key, len) != 0) {\n"
+"\t\treturn -1;\n"
+"\t}\n"
+"\treturn i;\n"
+"}\n"
+"\n", prefix, node->seed, node->slots_size - 1, node->name, node->name);
+	}
+	
+	// Objects without properties don't need the key unless it is an error
+	write_code(out, code_read, node->name);
+	if (node->num_props > 0) {
+		fprintf(out, "\tchar *key;\n\tint   len;\n\t\n");
+	} else if (node->closed) {
+		fprintf(out, "\tchar *key;\n\t\n");
+	}
+	if (! uses_arena(node)) {
+		fprintf(out, "\t(void) arena;\n\t\n");
+	}
+	write_code(out, code_read_loop, node->name);
+	
+	if (node->num_props > 0) {
+		fprintf(out,
+"\t\tlen = vktor_get_value_str(parser, &key, NULL);\n"
+"\t\t\n"
+"\t\tswitch (%s_find(key, len)) {\n", node->name);
+		for (prop = node->props, i = 0; prop != NULL; prop = prop->next, i++) {
+			fprintf(out,
+"\t\t\tcase %d:\n"
+"\t\t\t\tif (%s_next(parser, error) != VKTOR_OK) {\n"
+"\t\t\t\t\treturn VKTOR_ERROR;\n"
+"\t\t\t\t}\n", i, prefix);
+			write_read_prop(out, node, prop);
+			fprintf(out, "\t\t\t\tbreak;\n\t\t\t\t\n");
+		}
+		fprintf(out, "\t\t\tdefault:\n");
+		indent = "\t\t\t\t";
+	} else if (node->closed) {
+		fprintf(out, "\t\tvktor_get_value_str(parser, &key, NULL);\n");
+	}
+	
+	if (node->closed) {
+		fprintf(out,
+"%sreturn %s_error(parser, error, VKTOR_ERR_SCHEMA, \n"
+"%s\t\"property '%%s' is not allowed by the schema\", key);\n",
+			indent, prefix, indent);
+	} else {
+		fprintf(out,
+"%sif (%s_skip(parser, error) != VKTOR_OK) {\n"
+"%s\treturn VKTOR_ERROR;\n"
+"%s}\n", indent, prefix, indent, indent);
+		if (node->num_props > 0) {
+			fprintf(out, "%sbreak;\n", indent);
+		}
+	}
+	if (node->num_props > 0) {
+		fprintf(out, "\t\t}\n");
+	}
+	fprintf(out, "\t}\n\t\n");
+	
+	for (prop = node->props; prop != NULL; prop = prop->next) {
+		if (! prop->required) {
+			continue;
+		}
+		macro = has_macro(node, prop);
+		fprintf(out,
+"\tif (! (out->present & %s)) {\n"
+"\t\treturn %s_error(parser, error, VKTOR_ERR_SCHEMA, \n"
+"\t\t\t\"required property '%%s' is missing\", ", macro, prefix);
+		free(macro);
+		write_literal(out, prop->key, prop->key_len);
+		fprintf(out, ");\n\t}\n");
+	}
+	
+	fprintf(out, "\treturn VKTOR_OK;\n}\n\n");
+}
+
+/* Write the generated source: helpers, readers and the decoder */
+static void
+write_source(FILE *out, const char *header)
+{
+	int i;
+	
+	fprintf(out, "/* Generated by vktor-bindgen from %s, do not edit */\n\n",
+		schema_name);
+	if (header != NULL) {
+		fprintf(out, "#include \"%s\"\n", header);
+	}
+	write_code(out, code_helpers, prefix);
+	write_code(out, code_scalars, prefix);
+	
+	// Readers call the readers of their children, which are written first
+	for (i = 0; i < num_structs; i++) {
+		write_reader(out, structs[i]);
+	}
+	
+	write_code(out, code_decode, prefix);
+}
+
+/* Read the whole schema file, and feed it to the parser */
+static void
+read_schema_file(const char *name)
+{
+	FILE   *fp = stdin;
+	char   *text = NULL;
+	long    len = 0, size = 0;
+	size_t  read_bytes;
+	
+	if (strcmp(name, "-") != 0 && (fp = fopen(name, "r")) == NULL) {
+		fprintf(stderr, "Error opening schema file: %s\n", strerror(errno));
+		exit(255);
+	}
+	
+	do {
+		if (len == size) {
+			size = size * 2 + BUFFSIZE;
+			text = realloc(text, size);
+		}
+		read_bytes = fread(text + len, sizeof(char), size - len, fp);
+		len += read_bytes;
+	} while (read_bytes > 0);
+	
+	if (fp != stdin) {
+		fclose(fp);
+	}
+	
+	parser = vktor_parser_init(MAXDEPTH);
+	vktor_feed_complete(parser, text, len, 1, NULL);
+}
+
+/* Free a schema and its properties */
+static void
+free_node(bg_node *node)
+{
+	bg_prop *prop, *next;
+	
+	for (prop = node->props; prop != NULL; prop = next) {
+		next = prop->next;
+		free_node(prop->node);
+		free(prop->key);
+		free(prop->member);
+		free(prop);
+	}
+	if (node->items != NULL) {
+		free_node(node->items);
+	}
+	free(node->name);
+	free(node->upper);
+	free(node->slots);
+	free(node);
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-o base] name [schema]\n", prog);
+	exit(255);
+}
+
+int
+main(int argc, char *argv[])
+{
+	bg_node *root;
+	FILE    *hout = stdout, *cout = stdout;
+	char    *base = NULL, *guard, *file, *p;
+	int      opt, i;
+	
+	while ((opt = getopt(argc, argv, "o:")) != -1) {
+		switch (opt) {
+			case 'o':
+				base = optarg;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	
+	if (optind == argc || argc - optind > 2) {
+		usage(argv[0]);
+	}
+	
+	prefix = argv[optind];
+	upper  = to_upper(bg_strdup(prefix));
+	for (p = prefix; *p != '\0'; p++) {
+		if (! (isalpha((unsigned char) *p) || *p == '_' ||
+		      (p > prefix && isdigit((unsigned char) *p)))) {
+			fprintf(stderr, "Name '%s' is not a valid C identifier\n", prefix);
+			return 255;
+		}
+	}
+	if (optind + 1 < argc) {
+		schema_name = argv[optind + 1];
+	}
+	
+	read_schema_file(schema_name);
+	next_token();
+	root = read_schema("document");
+	if (root->type != BG_OBJECT) {
+		fail("the document must be an object");
+	}
+	vktor_parser_free(parser);
+	
+	// Names which are used by the generated helpers
+	claim_name(new_name("%s_arena", prefix));
+	claim_name(new_name("%s_decode", prefix));
+	claim_name(new_name("%s_key_entry", prefix));
+	claim_name(new_name("%s_hash", prefix));
+	claim_name(new_name("%s_next", prefix));
+	claim_name(new_name("%s_skip", prefix));
+	claim_name(new_name("%s_error", prefix));
+	claim_name(new_name("%s_mismatch", prefix));
+	claim_name(new_name("%s_read_long", prefix));
+	claim_name(new_name("%s_read_double", prefix));
+	claim_name(new_name("%s_read_bool", prefix));
+	claim_name(new_name("%s_read_string", prefix));
+	claim_name(new_name("%s_MAX_E_LEN", upper));
+	name_struct(root, bg_strdup(prefix));
+	
+	if (base != NULL) {
+		file = new_name("%s.h", base);
+		if ((hout = fopen(file, "w")) == NULL) {
+			fprintf(stderr, "Error opening %s: %s\n", file, strerror(errno));
+			return 255;
+		}
+		free(file);
+		file = new_name("%s.c", base);
+		if ((cout = fopen(file, "w")) == NULL) {
+			fprintf(stderr, "Error opening %s: %s\n", file, strerror(errno));
+			return 255;
+		}
+		free(file);
+		
+		// The source includes the header from the same directory
+		base = ((p = strrchr(base, '/')) != NULL ? p + 1 : base);
+		guard = new_name("%s_H", base);
+	} else {
+		guard = new_name("%s_BINDGEN_H", prefix);
+	}
+	
+	for (p = guard; *p != '\0'; p++) {
+		*p = (isalnum((unsigned char) *p) ? toupper((unsigned char) *p) : '_');
+	}
+	
+	write_header(hout, guard);
+	if (base != NULL) {
+		file = new_name("%s.h", base);
+		write_source(cout, file);
+		free(file);
+		fclose(hout);
+		fclose(cout);
+	} else {
+		fprintf(cout, "\n");
+		write_source(cout, NULL);
+	}
+	
+	free(guard);
+	free(upper);
+	free_node(root);
+	for (i = 0; i < num_names; i++) {
+		free(names[i]);
+	}
+	free(names);
+	free(structs);
+	
+	return 0;
+}